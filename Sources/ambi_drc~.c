@@ -0,0 +1,231 @@
+#include <string.h>
+
+#include <m_pd.h>
+
+#include "utilities.h"
+#include "governor.h"
+#include "ambidrc.h"
+
+static t_class *ambi_drc_tilde_class;
+
+// ─────────────────────────────────────
+typedef struct _ambi_drc_tilde {
+    t_object obj;
+    t_sample sample;
+
+    int nCh;
+    int multichannel;
+    const t_sample **aIns;
+    t_sample **aOuts;
+    t_sample *inCopy; // nCh x blockSize, inputs of the separate inlets
+    int blockSize;
+    t_ambidrc drc;
+
+    t_saf_load load;
+} t_ambi_drc_tilde;
+
+// ╭─────────────────────────────────────╮
+// │               Methods               │
+// ╰─────────────────────────────────────╯
+static float ambi_drc_tilde_clip(float f, float min, float max) {
+    return f < min ? min : f > max ? max : f;
+}
+
+// ─────────────────────────────────────
+static void ambi_drc_tilde_set(t_ambi_drc_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    const char *method = s->s_name;
+    pd_assert(x, argc >= 1, "[saf.ambi_drc~] Expected a value");
+    float f = atom_getfloat(argv);
+    t_ambidrc *d = &x->drc;
+    if (strcmp(method, "threshold") == 0) {
+        d->threshold = ambi_drc_tilde_clip(f, AMBIDRC_MIN_THRESHOLD, AMBIDRC_MAX_THRESHOLD);
+    } else if (strcmp(method, "ratio") == 0) {
+        d->ratio = ambi_drc_tilde_clip(f, AMBIDRC_MIN_RATIO, AMBIDRC_MAX_RATIO);
+    } else if (strcmp(method, "knee") == 0) {
+        d->knee = ambi_drc_tilde_clip(f, 0.0f, AMBIDRC_MAX_KNEE);
+    } else if (strcmp(method, "ingain") == 0) {
+        d->inGain = ambi_drc_tilde_clip(f, -40.0f, 20.0f);
+    } else if (strcmp(method, "outgain") == 0) {
+        d->outGain = ambi_drc_tilde_clip(f, -20.0f, 40.0f);
+    } else if (strcmp(method, "attack") == 0) {
+        d->attack = ambi_drc_tilde_clip(f, AMBIDRC_MIN_ATTACK, AMBIDRC_MAX_ATTACK);
+    } else if (strcmp(method, "release") == 0) {
+        d->release = ambi_drc_tilde_clip(f, AMBIDRC_MIN_RELEASE, AMBIDRC_MAX_RELEASE);
+    } else if (strcmp(method, "kweight") == 0) {
+        // 0 follows the plain omni level
+        d->kweight = f != 0;
+    }
+    // messages and perform share the scheduler thread, the new coefficients apply from the next
+    // block
+    if (d->blockSize > 0) {
+        ambidrc_setup(d, d->sr, d->blockSize);
+    }
+}
+
+// ─────────────────────────────────────
+static void ambi_drc_tilde_loadreport(t_ambi_drc_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void ambi_drc_tilde_stats(t_ambi_drc_tilde *x) {
+    saf_load_stats(&x->load);
+    logpost(x, 2, "[saf.ambi_drc~] %d channels, %.1f dB gain reduction in the last block",
+            x->nCh, x->drc.reduction);
+}
+
+// ╭─────────────────────────────────────╮
+// │     Initialization and Perform      │
+// ╰─────────────────────────────────────╯
+t_int *ambi_drc_tilde_performmultichannel(t_int *w) {
+    t_ambi_drc_tilde *x = (t_ambi_drc_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    t_sample *ins = (t_sample *)(w[3]);
+    t_sample *outs = (t_sample *)(w[4]);
+
+    // the channels are processed where Pd holds them, [saf.encoder~ -m] needs no copy
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nCh; ch++) {
+        x->aIns[ch] = ins + ch * n;
+        x->aOuts[ch] = outs + ch * n;
+    }
+    ambidrc_process(&x->drc, x->aIns, x->aOuts, x->nCh);
+    saf_load_end(&x->load, n);
+
+    return (w + 5);
+}
+
+// ─────────────────────────────────────
+t_int *ambi_drc_tilde_perform(t_int *w) {
+    t_ambi_drc_tilde *x = (t_ambi_drc_tilde *)(w[1]);
+    int n = (int)(w[2]);
+
+    // Pd may hand the buffer of one input to another output, so the inputs are copied before the
+    // first output is written
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nCh; ch++) {
+        t_sample *in = x->inCopy + ch * n;
+        memcpy(in, (t_sample *)w[3 + ch], n * sizeof(t_sample));
+        x->aIns[ch] = in;
+        x->aOuts[ch] = (t_sample *)w[3 + x->nCh + ch];
+    }
+    ambidrc_process(&x->drc, x->aIns, x->aOuts, x->nCh);
+    saf_load_end(&x->load, n);
+
+    return (w + 3 + 2 * x->nCh);
+}
+
+// ─────────────────────────────────────
+void ambi_drc_tilde_dsp(t_ambi_drc_tilde *x, t_signal **sp) {
+    x->load.sr = sp[0]->s_sr;
+    ambidrc_setup(&x->drc, sp[0]->s_sr, sp[0]->s_n);
+    if (x->multichannel) {
+        int nCh = sp[0]->s_nchans;
+        if (nCh != x->nCh) {
+            freebytes(x->aIns, x->nCh * sizeof(t_sample *));
+            freebytes(x->aOuts, x->nCh * sizeof(t_sample *));
+            x->aIns = (const t_sample **)getbytes(nCh * sizeof(t_sample *));
+            x->aOuts = (t_sample **)getbytes(nCh * sizeof(t_sample *));
+            x->nCh = nCh;
+        }
+        signal_setmultiout(&sp[1], x->nCh);
+        dsp_add(ambi_drc_tilde_performmultichannel, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
+        return;
+    }
+
+    if (sp[0]->s_nchans > 1) {
+        pd_error(x, "[saf.ambi_drc~] Multichannel mode is off, but input is multichannel, use "
+                    "'-m' flag");
+    }
+    int n = sp[0]->s_n;
+    if (n != x->blockSize) {
+        freebytes(x->inCopy, x->nCh * x->blockSize * sizeof(t_sample));
+        x->inCopy = (t_sample *)getbytes(x->nCh * n * sizeof(t_sample));
+        x->blockSize = n;
+    }
+    int sum = 2 * x->nCh;
+    int sigvecsize = sum + 2;
+    for (int i = x->nCh; i < sum; i++) {
+        signal_setmultiout(&sp[i], 1);
+    }
+    t_int *sigvec = getbytes(sigvecsize * sizeof(t_int));
+    sigvec[0] = (t_int)x;
+    sigvec[1] = (t_int)sp[0]->s_n;
+    for (int i = 0; i < sum; i++) {
+        sigvec[2 + i] = (t_int)sp[i]->s_vec;
+    }
+    dsp_addv(ambi_drc_tilde_perform, sigvecsize, sigvec);
+    freebytes(sigvec, sigvecsize * sizeof(t_int));
+}
+
+// ─────────────────────────────────────
+void *ambi_drc_tilde_new(t_symbol *s, int argc, t_atom *argv) {
+    t_ambi_drc_tilde *x = (t_ambi_drc_tilde *)pd_new(ambi_drc_tilde_class);
+
+    // [saf.ambi_drc~ <ambisonic_order>] or [saf.ambi_drc~ -m], the channels then follow the input
+    int order = 1;
+    x->multichannel = 0;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type == A_SYMBOL && strcmp(atom_getsymbol(argv + i)->s_name, "-m") == 0) {
+            x->multichannel = 1;
+        } else if (argv[i].a_type == A_FLOAT) {
+            order = atom_getint(argv + i);
+        }
+    }
+    if (order < 0 || order > MAX_SH_ORDER) {
+        pd_error(x, "[saf.ambi_drc~] Ambisonic order must be between 0 and %d", MAX_SH_ORDER);
+        order = order < 0 ? 0 : MAX_SH_ORDER;
+    }
+
+    x->nCh = (order + 1) * (order + 1);
+    x->aIns = (const t_sample **)getbytes(x->nCh * sizeof(t_sample *));
+    x->aOuts = (t_sample **)getbytes(x->nCh * sizeof(t_sample *));
+    ambidrc_init(&x->drc);
+
+    // nothing to degrade, the sidechain is a single channel
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.ambi_drc~", 0, NULL);
+
+    if (x->multichannel) {
+        outlet_new(&x->obj, &s_signal);
+    } else {
+        for (int i = 1; i < x->nCh; i++) {
+            inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
+        }
+        for (int i = 0; i < x->nCh; i++) {
+            outlet_new(&x->obj, &s_signal);
+        }
+    }
+
+    return (void *)x;
+}
+
+// ─────────────────────────────────────
+void ambi_drc_tilde_free(t_ambi_drc_tilde *x) {
+    saf_load_free(&x->load);
+    ambidrc_free(&x->drc);
+    freebytes(x->aIns, x->nCh * sizeof(t_sample *));
+    freebytes(x->aOuts, x->nCh * sizeof(t_sample *));
+    freebytes(x->inCopy, x->nCh * x->blockSize * sizeof(t_sample));
+}
+
+// ─────────────────────────────────────
+// clang-format off
+void setup_saf0x2eambi_drc_tilde(void) {
+    ambi_drc_tilde_class =
+        class_new(gensym("saf.ambi_drc~"), (t_newmethod)ambi_drc_tilde_new,
+                  (t_method)ambi_drc_tilde_free, sizeof(t_ambi_drc_tilde),
+                  CLASS_DEFAULT | CLASS_MULTICHANNEL, A_GIMME, 0);
+
+    CLASS_MAINSIGNALIN(ambi_drc_tilde_class, t_ambi_drc_tilde, sample);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_set, gensym("threshold"), A_GIMME, 0);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_set, gensym("ratio"), A_GIMME, 0);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_set, gensym("knee"), A_GIMME, 0);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_set, gensym("ingain"), A_GIMME, 0);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_set, gensym("outgain"), A_GIMME, 0);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_set, gensym("attack"), A_GIMME, 0);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_set, gensym("release"), A_GIMME, 0);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_set, gensym("kweight"), A_GIMME, 0);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_stats, gensym("stats"), 0);
+    class_addmethod(ambi_drc_tilde_class, (t_method)ambi_drc_tilde_loadreport, gensym("saf_loadreport"), 0);
+}
@@ -0,0 +1,146 @@
+#include <math.h>
+#include <string.h>
+
+#include <m_pd.h>
+
+#include "ambidrc.h"
+
+#define AMBIDRC_PI 3.14159265358979f
+
+// ─────────────────────────────────────
+// RBJ high shelf and high-pass with the BS.1770 K-weighting parameters, for any sample rate.
+static void ambidrc_kweighting(t_ambidrc *d) {
+    float w0 = 2.0f * AMBIDRC_PI * 1681.974450955533f / d->sr;
+    float A = powf(10.0f, 3.999843853973347f / 40.0f);
+    float alpha = sinf(w0) / (2.0f * 0.7071752369554196f);
+    float c = cosf(w0);
+    float s = 2.0f * sqrtf(A) * alpha;
+    float a0 = (A + 1.0f) - (A - 1.0f) * c + s;
+    t_ambidrc_biquad *f = &d->k[0];
+    f->b0 = A * ((A + 1.0f) + (A - 1.0f) * c + s) / a0;
+    f->b1 = -2.0f * A * ((A - 1.0f) + (A + 1.0f) * c) / a0;
+    f->b2 = A * ((A + 1.0f) + (A - 1.0f) * c - s) / a0;
+    f->a1 = 2.0f * ((A - 1.0f) - (A + 1.0f) * c) / a0;
+    f->a2 = ((A + 1.0f) - (A - 1.0f) * c - s) / a0;
+
+    w0 = 2.0f * AMBIDRC_PI * 38.13547087602444f / d->sr;
+    alpha = sinf(w0) / (2.0f * 0.5003270373238773f);
+    c = cosf(w0);
+    a0 = 1.0f + alpha;
+    f = &d->k[1];
+    f->b0 = (1.0f + c) / 2.0f / a0;
+    f->b1 = -(1.0f + c) / a0;
+    f->b2 = f->b0;
+    f->a1 = -2.0f * c / a0;
+    f->a2 = (1.0f - alpha) / a0;
+}
+
+// ─────────────────────────────────────
+void ambidrc_init(t_ambidrc *d) {
+    memset(d, 0, sizeof(t_ambidrc));
+    d->sr = 48000.0f;
+    d->threshold = -10.0f;
+    d->ratio = 8.0f;
+    d->knee = 0.0f;
+    d->attack = 50.0f;
+    d->release = 100.0f;
+    d->kweight = 1;
+    d->gain = NULL;
+    d->blockSize = 0;
+}
+
+// ─────────────────────────────────────
+void ambidrc_free(t_ambidrc *d) {
+    if (d->gain) {
+        freebytes(d->gain, d->blockSize * sizeof(float));
+    }
+    d->gain = NULL;
+}
+
+// ─────────────────────────────────────
+void ambidrc_setup(t_ambidrc *d, float sr, int blockSize) {
+    if (blockSize != d->blockSize) {
+        ambidrc_free(d);
+        d->gain = (float *)getbytes(blockSize * sizeof(float));
+        d->blockSize = blockSize;
+    }
+    if (sr != d->sr) {
+        d->k[0].z1 = d->k[0].z2 = d->k[1].z1 = d->k[1].z2 = 0.0f;
+    }
+    d->sr = sr > 0 ? sr : 48000.0f;
+    d->aA = expf(-1.0f / (d->attack * 0.001f * d->sr));
+    d->aR = expf(-1.0f / (d->release * 0.001f * d->sr));
+    ambidrc_kweighting(d);
+}
+
+// ─────────────────────────────────────
+// Static curve of SAF's ambi_drc, the gain reduction in dB for an input level in dB.
+static inline float ambidrc_reduction(const t_ambidrc *d, float x) {
+    float over = x - d->threshold;
+    float y;
+    if (2.0f * over < -d->knee) {
+        y = x;
+    } else if (d->knee > 0 && 2.0f * fabsf(over) <= d->knee) {
+        float k = over + d->knee / 2.0f;
+        y = x + (1.0f / d->ratio - 1.0f) * k * k / (2.0f * d->knee);
+    } else {
+        y = d->threshold + over / d->ratio;
+    }
+    return x - y;
+}
+
+// ─────────────────────────────────────
+// One gain per sample from the (K-weighted) omni channel into d->gain.
+static void ambidrc_sidechain(t_ambidrc *d, const t_sample *omni) {
+    int n = d->blockSize;
+    float inGain = powf(10.0f, d->inGain / 20.0f);
+    float makeup = powf(10.0f, d->outGain / 20.0f);
+    float y1 = d->y1;
+    float yl = d->yl;
+    float reduction = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float x = inGain * omni[i];
+        for (int b = 0; d->kweight && b < 2; b++) {
+            t_ambidrc_biquad *f = &d->k[b];
+            float y = f->b0 * x + f->z1;
+            f->z1 = f->b1 * x - f->a1 * y + f->z2;
+            f->z2 = f->b2 * x - f->a2 * y;
+            x = y;
+        }
+        float xl = ambidrc_reduction(d, 10.0f * log10f(x * x + 1e-12f));
+        y1 = fmaxf(xl, d->aR * y1 + (1.0f - d->aR) * xl);
+        yl = d->aA * yl + (1.0f - d->aA) * y1;
+        reduction = fmaxf(reduction, yl);
+        d->gain[i] = inGain * makeup * powf(10.0f, -yl / 20.0f);
+    }
+    d->y1 = y1;
+    d->yl = yl;
+    d->reduction = reduction;
+}
+
+// ─────────────────────────────────────
+static void ambidrc_apply(const t_sample *in, t_sample *out, const float *gain, int n) {
+    int i = 0;
+#if defined(AMBIDRC_SSE)
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), _mm_loadu_ps(gain + i)));
+    }
+#elif defined(AMBIDRC_NEON)
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(out + i, vmulq_f32(vld1q_f32(in + i), vld1q_f32(gain + i)));
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = in[i] * gain[i];
+    }
+}
+
+// ─────────────────────────────────────
+void ambidrc_process(t_ambidrc *d, const t_sample *const *ins, t_sample *const *outs, int nCh) {
+    // the gains are complete before any output is written, outs[0] may be the omni input. Each
+    // channel is read once right before its output is written, so outs[ch] may only alias ins[ch]
+    ambidrc_sidechain(d, ins[0]);
+    for (int ch = 0; ch < nCh; ch++) {
+        ambidrc_apply(ins[ch], outs[ch], d->gain, d->blockSize);
+    }
+}
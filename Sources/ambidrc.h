@@ -0,0 +1,66 @@
+#ifndef SAF_AMBIDRC_H
+#define SAF_AMBIDRC_H
+
+#include <m_pd.h>
+
+#if (!defined(PD_FLOATSIZE) || PD_FLOATSIZE == 32)
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define AMBIDRC_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AMBIDRC_NEON
+#endif
+#endif
+
+// ─────────────────────────────────────
+// Dynamic range compressor for the whole Ambisonic bus of [saf.ambi_drc~]. The gain computer is
+// the one of SAF's ambi_drc (threshold, ratio and soft knee in dB, smooth decoupled attack and
+// release), but it runs once per sample on the omni channel only, K-weighted as for BS.1770
+// loudness. The same gain then scales every SH channel, which keeps the spatial image, in one
+// vectorised multiply per channel and in place when Pd hands the same buffers in and out.
+#define AMBIDRC_MIN_THRESHOLD -60.0f
+#define AMBIDRC_MAX_THRESHOLD 0.0f
+#define AMBIDRC_MIN_RATIO 1.0f
+#define AMBIDRC_MAX_RATIO 30.0f
+#define AMBIDRC_MAX_KNEE 10.0f
+#define AMBIDRC_MIN_ATTACK 10.0f // ms
+#define AMBIDRC_MAX_ATTACK 200.0f
+#define AMBIDRC_MIN_RELEASE 50.0f
+#define AMBIDRC_MAX_RELEASE 1000.0f
+
+typedef struct _ambidrc_biquad {
+    float b0, b1, b2, a1, a2;
+    float z1, z2;
+} t_ambidrc_biquad;
+
+typedef struct _ambidrc {
+    float sr;
+    float threshold; // dB
+    float ratio;
+    float knee;    // dB
+    float inGain;  // dB
+    float outGain; // dB
+    float attack;  // ms
+    float release; // ms
+    int kweight;
+    float aA; // attack and release coefficients
+    float aR;
+    float y1; // gain reduction states, dB
+    float yl;
+    t_ambidrc_biquad k[2]; // BS.1770 shelf and high-pass
+    float *gain;           // blockSize
+    int blockSize;
+    float reduction; // largest gain reduction of the last block, dB
+} t_ambidrc;
+
+// ─────────────────────────────────────
+void ambidrc_init(t_ambidrc *d);
+void ambidrc_free(t_ambidrc *d);
+// Recomputes the coefficients after a parameter change, and the gain buffer for a new block size.
+void ambidrc_setup(t_ambidrc *d, float sr, int blockSize);
+// ins and outs hold nCh channels of blockSize samples, outs[ch] may be the same buffer as ins[ch]
+// but not as any other input.
+void ambidrc_process(t_ambidrc *d, const t_sample *const *ins, t_sample *const *outs, int nCh);
+
+#endif
@@ -1,99 +1,104 @@
 #include <string.h>
-#include <math.h>
-#include <pthread.h>
 
 #include <m_pd.h>
 #include <g_canvas.h>
 #include <s_stuff.h>
 
-#include <binauraliser.h>
 #include "utilities.h"
+#include "governor.h"
+#include "designer.h"
+#include "objbinaural.h"
 
+// [saf.binauraliser_nf~] is [saf.binauraliser~ -nf], the same object with the near-field stage of
+// objbinaural.h switched on. Both externals are built from this file, each one only calls its own
+// setup.
 static t_class *binauraliser_tilde_class;
+static t_class *binauraliser_nf_tilde_class;
 
 // ─────────────────────────────────────
 typedef struct _binauraliser_tilde {
     t_object obj;
     t_canvas *glist;
     t_sample sample;
+    const char *name;
 
-    void *hAmbi;
-    int hAmbiInit;
-
-    t_sample **aIns;
-    t_sample **aOuts;
-    t_sample **aInsTmp;
-    t_sample **aOutsTmp;
-
-    int nAmbiFrameSize;
-    int nPdFrameSize;
-    int nInAccIndex;
-    int nOutAccIndex;
-
-    int nOrder;
-    int nIn;
+    int nIn; // one input per source
     int nOut;
-    int nPreviousIn;
-    int nPreviousOut;
-
     int multichannel;
+    const t_sample **aIns;
+    t_sample *aOuts[NUM_EARS];
+
+    float dirs[2 * OBJBIN_MAX_SOURCES]; // azimuth and elevation of every source, in degrees
+    float dists[OBJBIN_MAX_SOURCES];    // distance of every source in metres, near field only
+    unsigned char placed[OBJBIN_MAX_SOURCES]; // set by a 'source' message
+    t_objbin_config config;
+    t_objbin *objbin;
+    int objbinSrc; // number of sources, block size and sample rate of the latest design
+    int objbinBlock;
+    int objbinSr;
+    t_saf_designer designer;
+
+    t_saf_load load;
 } t_binauraliser_tilde;
 
 // ─────────────────────────────────────
-static void binauraliser_tilde_malloc(t_binauraliser_tilde *x) {
-    if (x->aIns) {
-        for (int i = 0; i < x->nIn; i++) {
-            if (x->aIns[i]) {
-                freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
-            }
-            if (x->aInsTmp[i]) {
-                freebytes(x->aInsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
-            }
-        }
-        freebytes(x->aIns, x->nIn * sizeof(t_sample *));
-    }
-    if (x->aOuts) {
-        for (int i = 0; i < x->nOut; i++) {
-            if (x->aOuts[i]) {
-                freebytes(x->aOuts[i], x->nAmbiFrameSize * sizeof(t_sample));
-            }
-            if (x->aOutsTmp[i]) {
-                freebytes(x->aOutsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
-            }
-        }
-        freebytes(x->aOuts, x->nOut * sizeof(t_sample *));
-    }
+typedef struct _binauraliser_tilde_design {
+    t_objbin_config config;
+    int nSrc;
+    int blockSize;
+    int fs;
+} t_binauraliser_tilde_design;
 
-    // memory allocation
-    x->aIns = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
-    x->aInsTmp = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
-    x->aOuts = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
-    x->aOutsTmp = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
+// ─────────────────────────────────────
+static void *binauraliser_tilde_designhrtfs(const void *args) {
+    const t_binauraliser_tilde_design *d = (const t_binauraliser_tilde_design *)args;
+    return objbin_new(&d->config, d->nSrc, d->blockSize, d->fs);
+}
 
-    for (int i = 0; i < x->nIn; i++) {
-        x->aIns[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
-        x->aInsTmp[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
-    }
-    for (int i = 0; i < x->nOut; i++) {
-        x->aOuts[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
-        x->aOutsTmp[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
+// ─────────────────────────────────────
+static void binauraliser_tilde_discardhrtfs(void *result) {
+    objbin_free((t_objbin *)result);
+}
+
+// ─────────────────────────────────────
+static void binauraliser_tilde_installhrtfs(t_pd *obj, const void *args, void *result) {
+    t_binauraliser_tilde *x = (t_binauraliser_tilde *)obj;
+    t_objbin *r = (t_objbin *)result;
+    (void)args;
+    if (!r) {
+        // the old HRTFs keep playing
+        pd_error(x, "[%s] Could not triangulate the HRIR directions", x->name);
+        return;
     }
-    x->nPreviousIn = x->nIn;
-    x->nPreviousOut = x->nOut;
+    objbin_free(x->objbin);
+    x->objbin = r;
+    logpost(x, 3, "[%s] HRTFs ready, %d directions, filters of %d samples in blocks of %d", x->name,
+            r->nDirs, r->filterSize, r->blockSize);
 }
 
 // ─────────────────────────────────────
-void *binauraliser_tilde_initcodec(void *x_void) {
-    t_binauraliser_tilde *x = (t_binauraliser_tilde *)x_void;
-    binauraliser_initCodec(x->hAmbi);
-    logpost(x, 2, "[saf.binauraliser~] decoder codec initialized!");
-    return NULL;
+static void binauraliser_tilde_design(t_binauraliser_tilde *x, int blockSize) {
+    // the old HRTFs keep playing until the new ones are ready
+    t_binauraliser_tilde_design d;
+    d.config = x->config;
+    d.nSrc = x->nIn;
+    d.blockSize = blockSize;
+    d.fs = (int)x->load.sr;
+    x->objbinSrc = d.nSrc;
+    x->objbinBlock = d.blockSize;
+    x->objbinSr = d.fs;
+    logpost(x, 2, "[%s] Loading HRTFs for %d sources...", x->name, x->nIn);
+    saf_designer_start(&x->designer, &d, sizeof(d));
 }
 
 // ╭─────────────────────────────────────╮
 // │               Methods               │
 // ╰─────────────────────────────────────╯
 static void binauraliser_tilde_set(t_binauraliser_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc < 2) {
+        pd_error(x, "[%s] Expected 'set <method> <value>'", x->name);
+        return;
+    }
     const char *method = atom_getsymbol(argv)->s_name;
     if (strcmp(method, "sofafile") == 0) {
         char path[MAXPDSTRING];
@@ -101,72 +106,102 @@ static void binauraliser_tilde_set(t_binauraliser_tilde *x, t_symbol *s, int arg
         t_symbol *sofa_path = atom_getsymbol(argv + 1);
         int fd = canvas_open(x->glist, sofa_path->s_name, "", path, &bufptr, MAXPDSTRING, 1);
         if (fd > 1) {
+            sys_close(fd);
             char completpath[MAXPDSTRING];
             pd_snprintf(completpath, MAXPDSTRING, "%s/%s", path, sofa_path->s_name);
-            logpost(x, 2, "[saf.binauraliser~] Opening %s", completpath);
-            binauraliser_setSofaFilePath(x->hAmbi, completpath);
+            logpost(x, 2, "[%s] Opening %s", x->name, completpath);
+            pd_snprintf(x->config.sofaPath, MAXPDSTRING, "%s", completpath);
+            x->config.useDefaultHRIRs = 0;
         } else {
-            pd_error(x->glist, "[saf.binauraliser~] Could not open sofa file!");
+            pd_error(x->glist, "[%s] Could not open sofa file!", x->name);
+            return;
         }
     } else if (strcmp(method, "defaultHRIR") == 0) {
-        t_float defaultHRIR = atom_getfloat(argv + 1);
-        binauraliser_setUseDefaultHRIRsflag(x->hAmbi, defaultHRIR);
+        x->config.useDefaultHRIRs = atom_getfloat(argv + 1) != 0;
     } else {
-        pd_error(x, "[saf.binauraliser~] Unknown set method: %s", method);
+        pd_error(x, "[%s] Unknown set method: %s", x->name, method);
+        return;
+    }
+    if (x->objbinSr > 0) {
+        binauraliser_tilde_design(x, x->objbinBlock);
+    }
+}
+
+// ─────────────────────────────────────
+static void binauraliser_tilde_source(t_binauraliser_tilde *x, t_symbol *s, int argc,
+                                      t_atom *argv) {
+    // 'source <index> <azimuth> <elevation> [<distance>]', the distance is only used with -nf
+    int index = argc >= 3 ? atom_getint(argv) - 1 : -1;
+    if (index < 0 || index >= OBJBIN_MAX_SOURCES) {
+        pd_error(x, "[%s] Expected 'source <index> <azimuth> <elevation>', index from 1 to %d",
+                 x->name, OBJBIN_MAX_SOURCES);
+        return;
+    }
+    // read by perform on the same thread, the next block moves the source
+    x->dirs[2 * index] = atom_getfloat(argv + 1);
+    x->dirs[2 * index + 1] = atom_getfloat(argv + 2);
+    if (argc >= 4) {
+        x->dists[index] = atom_getfloat(argv + 3);
     }
+    x->placed[index] = 1;
+}
+
+// ─────────────────────────────────────
+static void binauraliser_tilde_loadreport(t_binauraliser_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void binauraliser_tilde_stats(t_binauraliser_tilde *x) {
+    saf_load_stats(&x->load);
+    t_objbin *r = x->objbin;
+    if (!r) {
+        return;
+    }
+    int active = 0;
+    int near = 0;
+    for (int s = 0; s < r->nSrc; s++) {
+        active += !objbin_quiet(r, s);
+        near += x->config.nearField && x->dists[s] < OBJBIN_NF_MAX;
+    }
+    logpost(x, 2, "[%s] %d sources, %d active, %d in the near field", x->name, r->nSrc, active,
+            near);
+    logpost(x, 2, "[%s] %d taps in filters of %d samples, %d convolver partitions", x->name,
+            r->length, r->filterSize, r->conv->head.nParts);
 }
 
 // ╭─────────────────────────────────────╮
 // │     Initialization and Perform      │
 // ╰─────────────────────────────────────╯
+static void binauraliser_tilde_process(t_binauraliser_tilde *x, int n) {
+    // the HRTFs are swapped on the main thread (designer.h), never while a block is rendered
+    t_objbin *r = x->objbin;
+    if (r && r->nSrc == x->nIn && r->blockSize == n) {
+        objbin_process(r, (const float *const *)x->aIns, (float *const *)x->aOuts, x->dirs,
+                       x->config.nearField ? x->dists : NULL);
+        return;
+    }
+    for (int ear = 0; ear < NUM_EARS; ear++) {
+        memset(x->aOuts[ear], 0, n * sizeof(t_sample));
+    }
+}
+
+// ─────────────────────────────────────
 t_int *binauraliser_tilde_performmultichannel(t_int *w) {
     t_binauraliser_tilde *x = (t_binauraliser_tilde *)(w[1]);
     int n = (int)(w[2]);
     t_sample *ins = (t_sample *)(w[3]);
     t_sample *outs = (t_sample *)(w[4]);
 
-    if (n < x->nAmbiFrameSize) {
-        for (int ch = 0; ch < x->nIn; ch++) {
-            memcpy(x->aIns[ch] + x->nInAccIndex, ins + (n * ch), n * sizeof(t_sample));
-        }
-        x->nInAccIndex += n;
-
-        if (x->nInAccIndex == x->nAmbiFrameSize) {
-            binauraliser_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                                 x->nIn, x->nOut, x->nAmbiFrameSize);
-            x->nInAccIndex = 0;
-            x->nOutAccIndex = 0;
-        }
-
-        if (x->nOutAccIndex + n <= x->nAmbiFrameSize) {
-            for (int ch = 0; ch < x->nOut; ch++) {
-                memcpy(outs + (n * ch), x->aOuts[ch] + x->nOutAccIndex, n * sizeof(t_sample));
-            }
-            x->nOutAccIndex += n;
-        } else {
-            for (int ch = 0; ch < x->nOut; ch++) {
-                memset(outs + (n * ch), 0, n * sizeof(t_sample));
-            }
-        }
-    } else {
-        int chunks = n / x->nAmbiFrameSize;
-        for (int chunkIndex = 0; chunkIndex < chunks; chunkIndex++) {
-            // Copia os dados de entrada para cada canal
-            for (int ch = 0; ch < x->nIn; ch++) {
-                memcpy(x->aInsTmp[ch], (t_sample *)w[3] + ch * n + chunkIndex * x->nAmbiFrameSize,
-                       x->nAmbiFrameSize * sizeof(t_sample));
-            }
-            // Processa o bloco atual
-            binauraliser_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                                 (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
-
-            t_sample *out = (t_sample *)(w[4]);
-            for (int ch = 0; ch < x->nOut; ch++) {
-                memcpy(out + ch * n + chunkIndex * x->nAmbiFrameSize, x->aOutsTmp[ch],
-                       x->nAmbiFrameSize * sizeof(t_sample));
-            }
-        }
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nIn; ch++) {
+        x->aIns[ch] = ins + ch * n;
+    }
+    for (int ear = 0; ear < NUM_EARS; ear++) {
+        x->aOuts[ear] = outs + ear * n;
     }
+    binauraliser_tilde_process(x, n);
+    saf_load_end(&x->load, n);
 
     return (w + 5);
 }
@@ -176,69 +211,50 @@ t_int *binauraliser_tilde_perform(t_int *w) {
     t_binauraliser_tilde *x = (t_binauraliser_tilde *)(w[1]);
     int n = (int)(w[2]);
 
-    if (n < x->nAmbiFrameSize) {
-        for (int ch = 0; ch < x->nIn; ch++) {
-            memcpy(x->aIns[ch] + x->nInAccIndex, (t_sample *)w[3 + ch], n * sizeof(t_sample));
-        }
-        x->nInAccIndex += n;
-        if (x->nInAccIndex == x->nAmbiFrameSize) {
-            binauraliser_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                                 x->nIn, x->nOut, x->nAmbiFrameSize);
-            x->nInAccIndex = 0;
-            x->nOutAccIndex = 0;
-        }
-        for (int ch = 0; ch < x->nOut; ch++) {
-            t_sample *out = (t_sample *)(w[3 + x->nIn + ch]);
-            memcpy(out, x->aOuts[ch] + x->nOutAccIndex, n * sizeof(t_sample));
-        }
-        x->nOutAccIndex += n;
-    } else {
-        int chunks = n / x->nAmbiFrameSize;
-        for (int chunkIndex = 0; chunkIndex < chunks; chunkIndex++) {
-            for (int ch = 0; ch < x->nIn; ch++) {
-                memcpy(x->aInsTmp[ch], (t_sample *)w[3 + ch] + (chunkIndex * x->nAmbiFrameSize),
-                       x->nAmbiFrameSize * sizeof(t_sample));
-            }
-            binauraliser_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                                 (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
-            for (int ch = 0; ch < x->nOut; ch++) {
-                t_sample *out = (t_sample *)(w[3 + x->nIn + ch]);
-                memcpy(out + (chunkIndex * x->nAmbiFrameSize), x->aOutsTmp[ch],
-                       x->nAmbiFrameSize * sizeof(t_sample));
-            }
-        }
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nIn; ch++) {
+        x->aIns[ch] = (t_sample *)w[3 + ch];
+    }
+    for (int ear = 0; ear < NUM_EARS; ear++) {
+        x->aOuts[ear] = (t_sample *)w[3 + x->nIn + ear];
     }
+    binauraliser_tilde_process(x, n);
+    saf_load_end(&x->load, n);
 
     return (w + 3 + x->nIn + x->nOut);
 }
 
 // ─────────────────────────────────────
 void binauraliser_tilde_dsp(t_binauraliser_tilde *x, t_signal **sp) {
-    // Set frame sizes and reset indices
-    x->nAmbiFrameSize = binauraliser_getFrameSize();
-    x->nPdFrameSize = sp[0]->s_n;
-    x->nOutAccIndex = 0;
-    x->nInAccIndex = 0;
-    x->nIn = x->multichannel ? sp[0]->s_nchans : x->nIn;
-
-    int nOrder = get_ambisonic_order(x->nOut);
-    if (nOrder != x->nOrder || !x->hAmbiInit) {
-        binauraliser_setUseDefaultHRIRsflag(x->hAmbi, 1);
-        binauraliser_init(x->hAmbi, sys_getsr());
-        logpost(x, 2, "[saf.decoder~] initializing decoder codec...");
-        pthread_t initThread;
-        pthread_create(&initThread, NULL, binauraliser_tilde_initcodec, (void *)x);
-        pthread_detach(initThread);
-        x->hAmbiInit = 1;
+    x->load.sr = sp[0]->s_sr;
+    if (x->multichannel) {
+        int nIn = sp[0]->s_nchans;
+        if (nIn > OBJBIN_MAX_SOURCES) {
+            pd_error(x, "[%s] %d channels, only the first %d are rendered", x->name, nIn,
+                     OBJBIN_MAX_SOURCES);
+            nIn = OBJBIN_MAX_SOURCES;
+        }
+        if (nIn != x->nIn) {
+            freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+            x->aIns = (const t_sample **)getbytes(nIn * sizeof(t_sample *));
+            x->nIn = nIn;
+        }
     }
 
-    if (x->nPreviousIn != x->nIn || x->nPreviousOut != x->nOut) {
-        binauraliser_tilde_malloc(x);
+    // sources without a 'source' message are spread around the listener
+    for (int s = 0; s < x->nIn; s++) {
+        if (x->placed[s]) {
+            continue;
+        }
+        x->dirs[2 * s] = 360.0f / (float)x->nIn * (float)s;
+        x->dirs[2 * s + 1] = 0.0f;
+    }
+
+    if (x->nIn != x->objbinSrc || sp[0]->s_n != x->objbinBlock || (int)x->load.sr != x->objbinSr) {
+        binauraliser_tilde_design(x, sp[0]->s_n);
     }
 
-    // Initialize memory allocation for inputs and outputs
     if (x->multichannel) {
-        x->nIn = sp[0]->s_nchans;
         signal_setmultiout(&sp[1], x->nOut);
         dsp_add(binauraliser_tilde_performmultichannel, 4, x, sp[0]->s_n, sp[0]->s_vec,
                 sp[1]->s_vec);
@@ -260,27 +276,49 @@ void binauraliser_tilde_dsp(t_binauraliser_tilde *x, t_signal **sp) {
 }
 
 // ─────────────────────────────────────
-void *binauraliser_tilde_new(t_symbol *s, int argc, t_atom *argv) {
-    t_binauraliser_tilde *x = (t_binauraliser_tilde *)pd_new(binauraliser_tilde_class);
-    x->glist = canvas_getcurrent(); // TODO: add HRIR reader
-    int order = (argc >= 1) ? atom_getint(argv) : 1;
-    int num_loudspeakers = (argc >= 2) ? atom_getint(argv + 1) : 2;
-    x->multichannel = (argc >= 3) ? strcmp(atom_getsymbol(argv + 2)->s_name, "-m") == 0 : 0;
-
-    if (argc >= 1) {
-        order = atom_getint(argv);
+static void *binauraliser_tilde_create(t_class *c, int nearField, int argc, t_atom *argv) {
+    t_binauraliser_tilde *x = (t_binauraliser_tilde *)pd_new(c);
+    x->glist = canvas_getcurrent();
+    x->name = class_getname(c);
+
+    // [saf.binauraliser~ <num_sources>] or [saf.binauraliser~ -m], one input per source, -nf adds
+    // the near-field filters as [saf.binauraliser_nf~] does
+    int num_sources = 1;
+    x->multichannel = 0;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type == A_SYMBOL && strcmp(atom_getsymbol(argv + i)->s_name, "-m") == 0) {
+            x->multichannel = 1;
+        } else if (argv[i].a_type == A_SYMBOL &&
+                   strcmp(atom_getsymbol(argv + i)->s_name, "-nf") == 0) {
+            nearField = 1;
+        } else if (argv[i].a_type == A_FLOAT) {
+            num_sources = atom_getint(argv + i);
+        }
     }
-    if (argc >= 2) {
-        num_loudspeakers = atom_getint(argv + 1);
+    if (num_sources < 1 || num_sources > OBJBIN_MAX_SOURCES) {
+        pd_error(x, "[%s] Number of sources must be between 1 and %d", x->name,
+                 OBJBIN_MAX_SOURCES);
+        num_sources = num_sources < 1 ? 1 : OBJBIN_MAX_SOURCES;
     }
 
-    order = order < 0 ? 0 : order;
-    num_loudspeakers = num_loudspeakers < 1 ? 1 : num_loudspeakers;
+    x->nIn = num_sources;
+    x->nOut = NUM_EARS;
+    x->aIns = (const t_sample **)getbytes(x->nIn * sizeof(t_sample *));
+    memset(x->placed, 0, sizeof(x->placed));
+    x->config.useDefaultHRIRs = 1;
+    x->config.nearField = nearField;
+    x->config.sofaPath[0] = '\0';
+    for (int i = 0; i < OBJBIN_MAX_SOURCES; i++) {
+        x->dists[i] = OBJBIN_NF_MAX; // far field until a distance is given
+    }
+    x->objbin = NULL;
+    x->objbinSrc = 0;
+    x->objbinBlock = 0;
+    x->objbinSr = 0;
+    saf_designer_init(&x->designer, &x->obj.ob_pd, binauraliser_tilde_designhrtfs,
+                      binauraliser_tilde_installhrtfs, binauraliser_tilde_discardhrtfs);
 
-    x->nOrder = (int)floor(sqrt(num_loudspeakers) - 1);
-    x->nIn = (order + 1) * (order + 1);
-    x->nOut = num_loudspeakers;
-    binauraliser_create(&x->hAmbi);
+    saf_load_init(&x->load, &x->obj.ob_pd, x->name, 0, NULL);
 
     if (x->multichannel) {
         outlet_new(&x->obj, &s_signal);
@@ -288,61 +326,55 @@ void *binauraliser_tilde_new(t_symbol *s, int argc, t_atom *argv) {
         for (int i = 1; i < x->nIn; i++) {
             inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
         }
-
         for (int i = 0; i < x->nOut; i++) {
             outlet_new(&x->obj, &s_signal);
         }
     }
-    x->aIns = NULL;
-    x->aOuts = NULL;
 
     return (void *)x;
 }
 
+// ─────────────────────────────────────
+void *binauraliser_tilde_new(t_symbol *s, int argc, t_atom *argv) {
+    (void)s;
+    return binauraliser_tilde_create(binauraliser_tilde_class, 0, argc, argv);
+}
+
+// ─────────────────────────────────────
+void *binauraliser_nf_tilde_new(t_symbol *s, int argc, t_atom *argv) {
+    (void)s;
+    return binauraliser_tilde_create(binauraliser_nf_tilde_class, 1, argc, argv);
+}
+
 // ─────────────────────────────────────
 void binauraliser_tilde_free(t_binauraliser_tilde *x) {
-    binauraliser_destroy(&x->hAmbi);
-    for (int i = 0; i < x->nIn; i++) {
-        if (x->aIns) {
-            freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
-        }
-        if (x->aInsTmp) {
-            freebytes(x->aInsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
-        }
-    }
-    for (int i = 0; i < x->nOut; i++) {
-        if (x->aOuts) {
-            freebytes(x->aOuts[i], x->nAmbiFrameSize * sizeof(t_sample));
-        }
-        if (x->aOutsTmp) {
-            freebytes(x->aOutsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
-        }
-    }
+    saf_load_free(&x->load);
+    saf_designer_free(&x->designer);
+    objbin_free(x->objbin);
+    freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+}
 
-    if (x->aIns) {
-        freebytes(x->aIns, x->nIn * sizeof(t_sample *));
-    }
-    if (x->aInsTmp) {
-        freebytes(x->aInsTmp, x->nIn * sizeof(t_sample *));
-    }
-    if (x->aOuts) {
-        freebytes(x->aOuts, x->nOut * sizeof(t_sample *));
-    }
-    if (x->aOutsTmp) {
-        freebytes(x->aOutsTmp, x->nOut * sizeof(t_sample *));
-    }
+// ─────────────────────────────────────
+static t_class *binauraliser_tilde_newclass(const char *name, t_newmethod newmethod) {
+    t_class *c = class_new(gensym(name), newmethod, (t_method)binauraliser_tilde_free,
+                           sizeof(t_binauraliser_tilde), CLASS_DEFAULT | CLASS_MULTICHANNEL,
+                           A_GIMME, 0);
+    CLASS_MAINSIGNALIN(c, t_binauraliser_tilde, sample);
+    class_addmethod(c, (t_method)binauraliser_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(c, (t_method)binauraliser_tilde_set, gensym("set"), A_GIMME, 0);
+    class_addmethod(c, (t_method)binauraliser_tilde_source, gensym("source"), A_GIMME, 0);
+    class_addmethod(c, (t_method)binauraliser_tilde_stats, gensym("stats"), 0);
+    class_addmethod(c, (t_method)binauraliser_tilde_loadreport, gensym("saf_loadreport"), 0);
+    return c;
 }
 
 // ─────────────────────────────────────
+// clang-format off
 void setup_saf0x2ebinauraliser_tilde(void) {
-    binauraliser_tilde_class =
-        class_new(gensym("saf.binauraliser~"), (t_newmethod)binauraliser_tilde_new,
-                  (t_method)binauraliser_tilde_free, sizeof(t_binauraliser_tilde),
-                  CLASS_DEFAULT | CLASS_MULTICHANNEL, A_GIMME, 0);
-
-    CLASS_MAINSIGNALIN(binauraliser_tilde_class, t_binauraliser_tilde, sample);
-    class_addmethod(binauraliser_tilde_class, (t_method)binauraliser_tilde_dsp, gensym("dsp"),
-                    A_CANT, 0);
-    class_addmethod(binauraliser_tilde_class, (t_method)binauraliser_tilde_set, gensym("set"),
-                    A_GIMME, 0);
+    binauraliser_tilde_class = binauraliser_tilde_newclass("saf.binauraliser~", (t_newmethod)binauraliser_tilde_new);
+}
+
+// ─────────────────────────────────────
+void setup_saf0x2ebinauraliser_nf_tilde(void) {
+    binauraliser_nf_tilde_class = binauraliser_tilde_newclass("saf.binauraliser_nf~", (t_newmethod)binauraliser_nf_tilde_new);
 }
@@ -1,6 +1,5 @@
 #include <string.h>
 // #include <math.h>
-#include <pthread.h>
 
 #include <m_pd.h>
 #include <g_canvas.h>
@@ -8,6 +7,12 @@
 
 #include <ambi_bin.h>
 #include "utilities.h"
+#include "governor.h"
+#include "silence.h"
+#include "rotation.h"
+#include "headtracker.h"
+#include "shbinaural.h"
+#include "designer.h"
 
 static t_class *binaural_tilde_class;
 
@@ -17,7 +22,15 @@ typedef struct _binaural_tilde {
     t_canvas *glist;
     t_sample sample;
 
-    void *hAmbi;
+    void *hAmbi;      // settings only, never initialised
+    void *hCodec;     // renders the frames, built from the settings by codecDesigner
+    void *hCodecNext; // runs next to hCodec until its delay is flushed, then crossfades in
+    void *hCodecOld;  // replaced by hCodecNext, destroyed by codecClock
+    int codecPriming; // frames hCodecNext still runs before the crossfade
+    int codecOrder;   // order and sample rate of the latest codec design
+    int codecSr;
+    t_sample *aCodecOuts[NUM_EARS];
+    t_saf_designer codecDesigner;
 
     t_sample **aIns;
     t_sample **aOuts;
@@ -35,22 +48,220 @@ typedef struct _binaural_tilde {
     int nPreviousOut;
 
     int multichannel;
+
+    int headtracking; // yaw, pitch and roll come from signal inlets
+    int nRotIn;
+    int nRotChans;
+    t_sample *aRot[3];
+    t_sample *aRotTmp[3];
+    t_sample **aRotated;
+    int nRotatedIn;
+    t_saf_rotation rot;
+    t_headtracker tracker; // OSC head tracker, overrides the rotation while it runs
+    int trackerRotation;   // rotation switch of ambi_bin, restored when the tracker stops
+
+    int nListeners;     // -listeners N renders through shbin instead of ambi_bin, 0 otherwise
+    int lowLatency;     // -lowlatency runs shbin once per Pd block, without frame accumulation
+    float *listenerYpr; // yaw, pitch and roll of every listener
+    t_shbin_config shbinConfig;
+    t_shbin *shbin;
+    int shbinLength;
+    int shbinOrder; // order, sample rate and partition size of the latest design
+    int shbinSr;
+    int shbinFrameSize;
+    t_saf_designer designer;
+
+    t_saf_load load;
+    t_saf_idle idle;
+    t_clock *codecClock;
 } t_binaural_tilde;
 
 // ─────────────────────────────────────
-void *binaural_tilde_initcodec(void *x_void) {
-    t_binaural_tilde *x = (t_binaural_tilde *)x_void;
-    ambi_bin_initCodec(x->hAmbi);
-    const char *text = "[saf.binaural~] Decoder codec initialized!";
-    char *d = strdup(text);
-    pd_queue_mess(&pd_maininstance, &x->obj.te_g.g_pd, (void *)d, init_logcallback);
-    return NULL;
+// Settings that re-initialise ambi_bin, the others are copied by binaural_tilde_synccodec.
+typedef struct _binaural_tilde_codec {
+    int fs;
+    int order;
+    int method;
+    int enableMaxRE;
+    int preProc;
+    int enableDiffuseMatching;
+    int enableTruncationEQ;
+    int useDefaultHRIRs;
+    char sofaPath[MAXPDSTRING];
+} t_binaural_tilde_codec;
+
+// ─────────────────────────────────────
+static void binaural_tilde_getcodec(t_binaural_tilde *x, t_binaural_tilde_codec *c) {
+    memset(c, 0, sizeof(t_binaural_tilde_codec));
+    c->fs = (int)x->load.sr;
+    c->order = get_ambisonic_order(x->nIn) - x->load.level;
+    c->method = ambi_bin_getDecodingMethod(x->hAmbi);
+    c->enableMaxRE = ambi_bin_getEnableMaxRE(x->hAmbi);
+    c->preProc = ambi_bin_getHRIRsPreProc(x->hAmbi);
+    c->enableDiffuseMatching = ambi_bin_getEnableDiffuseMatching(x->hAmbi);
+    c->enableTruncationEQ = ambi_bin_getEnableTruncationEQ(x->hAmbi);
+    c->useDefaultHRIRs = ambi_bin_getUseDefaultHRIRsflag(x->hAmbi);
+    if (!c->useDefaultHRIRs) {
+        pd_snprintf(c->sofaPath, MAXPDSTRING, "%s", ambi_bin_getSofaFilePath(x->hAmbi));
+    }
+}
+
+// ─────────────────────────────────────
+static void *binaural_tilde_buildcodec(const void *args) {
+    const t_binaural_tilde_codec *c = (const t_binaural_tilde_codec *)args;
+    void *h;
+    ambi_bin_create(&h);
+    ambi_bin_init(h, c->fs);
+    ambi_bin_setInputOrderPreset(h, (SH_ORDERS)c->order);
+    ambi_bin_setDecodingMethod(h, (AMBI_BIN_DECODING_METHODS)c->method);
+    ambi_bin_setEnableMaxRE(h, c->enableMaxRE);
+    ambi_bin_setHRIRsPreProc(h, (AMBI_BIN_PREPROC)c->preProc);
+    ambi_bin_setEnableDiffuseMatching(h, c->enableDiffuseMatching);
+    ambi_bin_setEnableTruncationEQ(h, c->enableTruncationEQ);
+    if (!c->useDefaultHRIRs) {
+        ambi_bin_setSofaFilePath(h, c->sofaPath);
+    }
+    ambi_bin_setUseDefaultHRIRsflag(h, c->useDefaultHRIRs);
+    ambi_bin_initCodec(h);
+    if (ambi_bin_getCodecStatus(h) != CODEC_STATUS_INITIALISED) {
+        ambi_bin_destroy(&h);
+        return NULL;
+    }
+    return h;
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_discardcodec(void *result) {
+    ambi_bin_destroy(&result);
+}
+
+// ─────────────────────────────────────
+// Copies the settings ambi_bin applies without re-initialising, the flips go first because they
+// change how the angles are stored.
+static void binaural_tilde_synccodec(t_binaural_tilde *x, void *h) {
+    if (!h) {
+        return;
+    }
+    ambi_bin_setNormType(h, ambi_bin_getNormType(x->hAmbi));
+    ambi_bin_setFlipYaw(h, ambi_bin_getFlipYaw(x->hAmbi));
+    ambi_bin_setFlipPitch(h, ambi_bin_getFlipPitch(x->hAmbi));
+    ambi_bin_setFlipRoll(h, ambi_bin_getFlipRoll(x->hAmbi));
+    ambi_bin_setRPYflag(h, ambi_bin_getRPYflag(x->hAmbi));
+    ambi_bin_setEnableRotation(h, ambi_bin_getEnableRotation(x->hAmbi));
+    ambi_bin_setYaw(h, ambi_bin_getYaw(x->hAmbi));
+    ambi_bin_setPitch(h, ambi_bin_getPitch(x->hAmbi));
+    ambi_bin_setRoll(h, ambi_bin_getRoll(x->hAmbi));
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_installcodec(t_pd *obj, const void *args, void *result) {
+    t_binaural_tilde *x = (t_binaural_tilde *)obj;
+    (void)args;
+    if (!result) {
+        // the old codec keeps playing
+        pd_error(x, "[saf.binaural~] Could not initialise the decoder codec");
+        return;
+    }
+    binaural_tilde_synccodec(x, result);
+    if (!x->hCodec) {
+        x->hCodec = result;
+    } else {
+        // a codec still priming is dropped, the newer one primes from the start
+        if (x->hCodecNext) {
+            ambi_bin_destroy(&x->hCodecNext);
+        }
+        x->hCodecNext = result;
+        x->codecPriming = saf_idle_frames(ambi_bin_getProcessingDelay(), ambi_bin_getFrameSize());
+    }
+    logpost(x, 3, "[saf.binaural~] Decoder codec ready");
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_codec(t_binaural_tilde *x) {
+    // the old codec keeps playing until the new one is ready
+    t_binaural_tilde_codec c;
+    binaural_tilde_getcodec(x, &c);
+    x->codecOrder = c.order;
+    x->codecSr = c.fs;
+    logpost(x, 2, "[saf.binaural~] Initializing decoder codec...");
+    saf_designer_start(&x->codecDesigner, &c, sizeof(c));
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_dropcodec(t_binaural_tilde *x) {
+    if (x->hCodecOld) {
+        ambi_bin_destroy(&x->hCodecOld);
+    }
+}
+
+// ─────────────────────────────────────
+typedef struct _binaural_tilde_design {
+    t_shbin_config config;
+    int order;
+    int frameSize;
+    int nListeners;
+    int fs;
+    int flip[3];
+    int rpy;
+} t_binaural_tilde_design;
+
+// ─────────────────────────────────────
+static void *binaural_tilde_designfilters(const void *args) {
+    const t_binaural_tilde_design *d = (const t_binaural_tilde_design *)args;
+    t_shbin *r = shbin_new(&d->config, d->order, d->frameSize, d->nListeners, d->fs);
+    if (r) {
+        shbin_setflags(r, d->flip[0], d->flip[1], d->flip[2], d->rpy);
+    }
+    return r;
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_installfilters(t_pd *obj, const void *args, void *result) {
+    t_binaural_tilde *x = (t_binaural_tilde *)obj;
+    (void)args;
+    t_shbin *r = (t_shbin *)result;
+    if (!r) {
+        pd_error(x, "[saf.binaural~] Could not design the decoding filters");
+        return;
+    }
+    // the flips may have changed while the filters were designed
+    shbin_setflags(r, ambi_bin_getFlipYaw(x->hAmbi), ambi_bin_getFlipPitch(x->hAmbi),
+                   ambi_bin_getFlipRoll(x->hAmbi), ambi_bin_getRPYflag(x->hAmbi));
+    shbin_free(x->shbin);
+    x->shbin = r;
+    logpost(x, 3, "[saf.binaural~] Decoding filters ready, %d taps in %d partitions", r->length,
+            r->nParts);
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_discardfilters(void *result) {
+    shbin_free((t_shbin *)result);
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_design(t_binaural_tilde *x) {
+    // the old filters keep playing until the new ones are ready
+    t_binaural_tilde_design d;
+    d.config = x->shbinConfig;
+    d.order = get_ambisonic_order(x->nIn);
+    d.frameSize = x->nAmbiFrameSize;
+    d.nListeners = x->nListeners;
+    d.fs = (int)x->load.sr;
+    d.flip[0] = ambi_bin_getFlipYaw(x->hAmbi);
+    d.flip[1] = ambi_bin_getFlipPitch(x->hAmbi);
+    d.flip[2] = ambi_bin_getFlipRoll(x->hAmbi);
+    d.rpy = ambi_bin_getRPYflag(x->hAmbi);
+    x->shbinOrder = d.order;
+    x->shbinSr = d.fs;
+    x->shbinFrameSize = d.frameSize;
+    logpost(x, 2, "[saf.binaural~] Designing decoding filters for %d listeners...", x->nListeners);
+    saf_designer_start(&x->designer, &d, sizeof(d));
 }
 
 // ─────────────────────────────────────
 static void binaural_tilde_malloc(t_binaural_tilde *x) {
     if (x->aIns) {
-        for (int i = 0; i < x->nIn; i++) {
+        for (int i = 0; i < x->nPreviousIn; i++) {
             if (x->aIns[i]) {
                 freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
             }
@@ -58,10 +269,11 @@ static void binaural_tilde_malloc(t_binaural_tilde *x) {
                 freebytes(x->aInsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
             }
         }
-        freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+        freebytes(x->aIns, x->nPreviousIn * sizeof(t_sample *));
+        freebytes(x->aInsTmp, x->nPreviousIn * sizeof(t_sample *));
     }
     if (x->aOuts) {
-        for (int i = 0; i < x->nOut; i++) {
+        for (int i = 0; i < x->nPreviousOut; i++) {
             if (x->aOuts[i]) {
                 freebytes(x->aOuts[i], x->nAmbiFrameSize * sizeof(t_sample));
             }
@@ -69,7 +281,8 @@ static void binaural_tilde_malloc(t_binaural_tilde *x) {
                 freebytes(x->aOutsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
             }
         }
-        freebytes(x->aOuts, x->nOut * sizeof(t_sample *));
+        freebytes(x->aOuts, x->nPreviousOut * sizeof(t_sample *));
+        freebytes(x->aOutsTmp, x->nPreviousOut * sizeof(t_sample *));
     }
 
     // memory allocation
@@ -90,11 +303,46 @@ static void binaural_tilde_malloc(t_binaural_tilde *x) {
     x->nPreviousOut = x->nOut;
 }
 
+// ─────────────────────────────────────
+static void binaural_tilde_freerotation(t_binaural_tilde *x) {
+    if (!x->aRotated) {
+        return;
+    }
+    for (int a = 0; a < 3; a++) {
+        freebytes(x->aRot[a], x->nAmbiFrameSize * sizeof(t_sample));
+        freebytes(x->aRotTmp[a], x->nAmbiFrameSize * sizeof(t_sample));
+    }
+    for (int i = 0; i < x->nRotatedIn; i++) {
+        freebytes(x->aRotated[i], x->nAmbiFrameSize * sizeof(t_sample));
+    }
+    freebytes(x->aRotated, x->nRotatedIn * sizeof(t_sample *));
+    saf_rotation_free(&x->rot);
+    x->aRotated = NULL;
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_mallocrotation(t_binaural_tilde *x) {
+    binaural_tilde_freerotation(x);
+    saf_rotation_init(&x->rot, get_ambisonic_order(x->nIn));
+    for (int a = 0; a < 3; a++) {
+        x->aRot[a] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
+        x->aRotTmp[a] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
+    }
+    x->nRotatedIn = x->nIn;
+    x->aRotated = (t_sample **)getbytes(x->nRotatedIn * sizeof(t_sample *));
+    for (int i = 0; i < x->nRotatedIn; i++) {
+        x->aRotated[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
+    }
+}
+
 // ╭─────────────────────────────────────╮
 // │               Methods               │
 // ╰─────────────────────────────────────╯
 static void binaural_tilde_set(t_binaural_tilde *x, t_symbol *s, int argc, t_atom *argv) {
     const char *method = s->s_name;
+    t_shbin_config config = x->shbinConfig;
+    t_binaural_tilde_codec codec;
+    binaural_tilde_getcodec(x, &codec);
 
     if (strcmp(method, "sofafile") == 0) {
         char path[MAXPDSTRING];
@@ -106,6 +354,8 @@ static void binaural_tilde_set(t_binaural_tilde *x, t_symbol *s, int argc, t_ato
             pd_snprintf(completpath, MAXPDSTRING, "%s/%s", path, sofa_path->s_name);
             logpost(x, 2, "[saf.binaural~] Opening %s", completpath);
             ambi_bin_setSofaFilePath(x->hAmbi, completpath);
+            pd_snprintf(x->shbinConfig.sofaPath, MAXPDSTRING, "%s", completpath);
+            x->shbinConfig.useDefaultHRIRs = 0;
         } else {
             pd_error(x->glist, "[saf.binaural~] Could not open sofa file!");
         }
@@ -114,16 +364,26 @@ static void binaural_tilde_set(t_binaural_tilde *x, t_symbol *s, int argc, t_ato
     else if (strcmp(method, "use_default_hrirs") == 0) {
         t_float state = atom_getfloat(argv);
         ambi_bin_setUseDefaultHRIRsflag(x->hAmbi, state);
+        x->shbinConfig.useDefaultHRIRs = state != 0;
     }
 
     else if (strcmp(method, "decmethod") == 0) {
         int id = atom_getint(argv);
         ambi_bin_setDecodingMethod(x->hAmbi, (AMBI_BIN_DECODING_METHODS)id);
+        x->shbinConfig.method = id;
     }
 
     else if (strcmp(method, "max-rE") == 0) {
         int enable = atom_getint(argv);
         ambi_bin_setEnableMaxRE(x->hAmbi, enable);
+        x->shbinConfig.enableMaxRE = enable;
+    }
+
+    else if (x->nListeners &&
+             (strcmp(method, "hrirpreproc") == 0 || strcmp(method, "truncationeq") == 0)) {
+        // the shbin filters come from getBinauralAmbiDecoderFilters, which offers neither
+        pd_error(x, "[saf.binaural~] %s is not available with -listeners or -lowlatency", method);
+        return;
     }
 
     else if (strcmp(method, "hrirpreproc") == 0) {
@@ -134,11 +394,13 @@ static void binaural_tilde_set(t_binaural_tilde *x, t_symbol *s, int argc, t_ato
     else if (strcmp(method, "normtype") == 0) {
         int type = atom_getint(argv);
         ambi_bin_setNormType(x->hAmbi, type);
+        x->shbinConfig.normType = type;
     }
 
     else if (strcmp(method, "diffusematching") == 0) {
         int state = atom_getint(argv);
         ambi_bin_setEnableDiffuseMatching(x->hAmbi, state);
+        x->shbinConfig.enableDiffuseMatching = state;
     }
 
     else if (strcmp(method, "truncationeq") == 0) {
@@ -146,6 +408,53 @@ static void binaural_tilde_set(t_binaural_tilde *x, t_symbol *s, int argc, t_ato
         ambi_bin_setEnableTruncationEQ(x->hAmbi, state);
     }
 
+    else if (strcmp(method, "tracker") == 0) {
+        // tracker <port> [<address>], bound to the loopback interface unless an address is given
+        int port = argc > 0 ? atom_getint(argv) : 0;
+        const char *address = argc > 1 ? atom_getsymbol(argv + 1)->s_name : NULL;
+        int wasRunning = x->tracker.port != 0;
+        headtracker_stop(&x->tracker);
+        if (port <= 0) {
+            logpost(x, 2, "[saf.binaural~] Head tracker stopped");
+        } else if (port > 65535 || !headtracker_start(&x->tracker, port, address)) {
+            pd_error(x, "[saf.binaural~] Could not listen for the head tracker on %s port %d",
+                     address ? address : "loopback", port);
+        } else {
+            // the SH input is rotated before ambi_bin, as with -r
+            if (!wasRunning) {
+                x->trackerRotation = ambi_bin_getEnableRotation(x->hAmbi);
+            }
+            ambi_bin_setEnableRotation(x->hAmbi, 0);
+            if (!x->nListeners && !x->aRotated && x->nAmbiFrameSize > 0) {
+                binaural_tilde_mallocrotation(x);
+            }
+            logpost(x, 2, "[saf.binaural~] Listening for the head tracker on %s:%d",
+                    x->tracker.address, port);
+        }
+        if (wasRunning && !x->tracker.port && !x->headtracking) {
+            ambi_bin_setEnableRotation(x->hAmbi, x->trackerRotation);
+        }
+    }
+
+    else if (x->nListeners && !x->headtracking &&
+             (strcmp(method, "yaw") == 0 || strcmp(method, "pitch") == 0 ||
+              strcmp(method, "roll") == 0)) {
+        // shbin has no rotation switch, the angles steer the first listener
+        int a = strcmp(method, "yaw") == 0 ? 0 : strcmp(method, "pitch") == 0 ? 1 : 2;
+        x->listenerYpr[a] = atom_getfloat(argv);
+    }
+
+    else if (x->headtracking && (strcmp(method, "rotation") == 0 || strcmp(method, "yaw") == 0 ||
+                                 strcmp(method, "pitch") == 0 || strcmp(method, "roll") == 0)) {
+        pd_error(x, "[saf.binaural~] Rotation comes from the signal inlets (-r), %s ignored",
+                 method);
+    }
+
+    else if (x->tracker.port && (strcmp(method, "rotation") == 0 || strcmp(method, "yaw") == 0 ||
+                                 strcmp(method, "pitch") == 0 || strcmp(method, "roll") == 0)) {
+        pd_error(x, "[saf.binaural~] Rotation comes from the head tracker, %s ignored", method);
+    }
+
     else if (strcmp(method, "rotation") == 0) {
         int enable = atom_getint(argv);
         ambi_bin_setEnableRotation(x->hAmbi, enable);
@@ -162,16 +471,216 @@ static void binaural_tilde_set(t_binaural_tilde *x, t_symbol *s, int argc, t_ato
         ambi_bin_setRoll(x->hAmbi, roll);
     }
 
-    else if (strcmp(method, "fyaw") == 0) {
+    else if (strcmp(method, "flipyaw") == 0 || strcmp(method, "fyaw") == 0) {
         ambi_bin_setFlipYaw(x->hAmbi, atom_getint(argv));
-    } else if (strcmp(method, "fpitch") == 0) {
+    } else if (strcmp(method, "flippitch") == 0 || strcmp(method, "fpitch") == 0) {
         ambi_bin_setFlipPitch(x->hAmbi, atom_getint(argv));
-    } else if (strcmp(method, "froll") == 0) {
+    } else if (strcmp(method, "fliproll") == 0 || strcmp(method, "froll") == 0) {
         ambi_bin_setFlipRoll(x->hAmbi, atom_getint(argv));
+    } else if (strcmp(method, "rpyflag") == 0) {
+        ambi_bin_setRPYflag(x->hAmbi, atom_getint(argv));
+    }
+
+    if (x->aRotated) {
+        // the flips and the rotation order stay in ambi_bin, the signal rotation follows them
+        saf_rotation_setflags(&x->rot, ambi_bin_getFlipYaw(x->hAmbi),
+                              ambi_bin_getFlipPitch(x->hAmbi), ambi_bin_getFlipRoll(x->hAmbi),
+                              ambi_bin_getRPYflag(x->hAmbi));
+    }
+
+    if (x->nListeners) {
+        if (x->shbin) {
+            shbin_setflags(x->shbin, ambi_bin_getFlipYaw(x->hAmbi), ambi_bin_getFlipPitch(x->hAmbi),
+                           ambi_bin_getFlipRoll(x->hAmbi), ambi_bin_getRPYflag(x->hAmbi));
+        }
+        if (x->nAmbiFrameSize > 0 && memcmp(&config, &x->shbinConfig, sizeof(config)) != 0) {
+            binaural_tilde_design(x);
+        }
+        return;
+    }
+
+    binaural_tilde_synccodec(x, x->hCodec);
+    binaural_tilde_synccodec(x, x->hCodecNext);
+    t_binaural_tilde_codec next;
+    binaural_tilde_getcodec(x, &next);
+    if (x->codecSr > 0 && memcmp(&codec, &next, sizeof(codec)) != 0) {
+        binaural_tilde_codec(x);
+    }
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_listener(t_binaural_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    pd_assert(x, x->nListeners, "[saf.binaural~] 'listener' needs the -listeners flag");
+    pd_assert(x, !x->headtracking, "[saf.binaural~] Rotation comes from the signal inlet (-r)");
+    pd_assert(x, argc >= 4, "[saf.binaural~] Expected 'listener <index> <yaw> <pitch> <roll>'");
+    int k = atom_getint(argv) - 1;
+    pd_assert(x, k >= 0 && k < x->nListeners, "[saf.binaural~] Listener index out of range");
+    for (int a = 0; a < 3; a++) {
+        x->listenerYpr[3 * k + a] = atom_getfloat(argv + 1 + a);
+    }
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_applylevel(void *owner, int level) {
+    // the codec for the lower input order is built on another thread, the current one keeps
+    // playing and is crossfaded out once it is ready (see binaural_tilde_decode)
+    t_binaural_tilde *x = (t_binaural_tilde *)owner;
+    (void)level;
+    binaural_tilde_codec(x);
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_loadreport(t_binaural_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_stats(t_binaural_tilde *x) {
+    saf_load_stats(&x->load);
+    if (x->nListeners && x->shbin) {
+        logpost(x, 2, "[saf.binaural~] %d listeners, %d taps in %d partitions of %d samples%s",
+                x->nListeners, x->shbin->length, x->shbin->nParts, x->shbin->frameSize,
+                saf_designer_busy(&x->designer) ? ", new filters on the way" : "");
+        t_convolver *conv = x->shbin->conv;
+        if (conv && conv->tailSize) {
+            logpost(x, 2, "[saf.binaural~] tail of %d samples on a worker thread, %u misses",
+                    conv->tailSize, atomic_load(&conv->misses));
+        }
+    } else if (!x->nListeners && saf_designer_busy(&x->codecDesigner)) {
+        logpost(x, 2, "[saf.binaural~] new decoder codec on the way");
     }
+    if (x->tracker.port) {
+        float ypr[3] = {0.0f, 0.0f, 0.0f};
+        headtracker_read(&x->tracker, ypr);
+        logpost(x, 2, "[saf.binaural~] head tracker: %s:%d, %u packets, ypr %.1f %.1f %.1f",
+                x->tracker.address, x->tracker.port, atomic_load(&x->tracker.packets), ypr[0],
+                ypr[1], ypr[2]);
+    }
+}
 
-    if (ambi_bin_getCodecStatus(x->hAmbi) == CODEC_STATUS_NOT_INITIALISED) {
-        canvas_update_dsp();
+// ─────────────────────────────────────
+static void binaural_tilde_idle(t_binaural_tilde *x, t_floatarg f) {
+    // skip rendering once the input is silent and the STFT delay and HRTF tail have been flushed
+    x->idle.enable = f != 0;
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_degrade(t_binaural_tilde *x, t_floatarg f) {
+    saf_load_request(&x->load, (int)f);
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_processlisteners(t_binaural_tilde *x, t_sample **ins, t_sample **outs) {
+    if (x->tracker.port) {
+        headtracker_read(&x->tracker, x->listenerYpr); // the tracker steers the first listener
+    }
+    // the filters are swapped on the main thread (designer.h), never while a frame is rendered
+    t_shbin *r = x->shbin;
+    if (r && r->order == get_ambisonic_order(x->nIn) && r->frameSize == x->nAmbiFrameSize) {
+        if (r->length != x->shbinLength) {
+            x->shbinLength = r->length;
+            saf_idle_settail(&x->idle, saf_idle_frames(r->length, x->nAmbiFrameSize) + 2);
+        }
+        shbin_process(r, (const float *const *)ins, (float *const *)outs, x->listenerYpr);
+        return;
+    }
+    saf_idle_zero(outs, x->nOut, x->nAmbiFrameSize);
+}
+
+// ─────────────────────────────────────
+// Renders the frame with the current codec. A new codec runs on the same input until its STFT
+// delay is flushed, so both play the same signal during the crossfade frame. It costs a second
+// ambi_bin for those few frames.
+static void binaural_tilde_decode(t_binaural_tilde *x, t_sample **ins, t_sample **outs) {
+    int n = x->nAmbiFrameSize;
+    if (!x->hCodec) {
+        saf_idle_zero(outs, x->nOut, n);
+        return;
+    }
+    ambi_bin_process(x->hCodec, (const float *const *)ins, (float *const *)outs, x->nIn, x->nOut,
+                     n);
+    if (!x->hCodecNext) {
+        return;
+    }
+    ambi_bin_process(x->hCodecNext, (const float *const *)ins, (float *const *)x->aCodecOuts,
+                     x->nIn, x->nOut, n);
+    if (x->codecPriming-- > 0) {
+        return;
+    }
+    for (int ch = 0; ch < x->nOut; ch++) {
+        const t_sample *next = x->aCodecOuts[ch];
+        for (int i = 0; i < n; i++) {
+            outs[ch][i] += (t_sample)(i + 1) / (t_sample)n * (next[i] - outs[ch][i]);
+        }
+    }
+    // the replaced codec is destroyed by codecClock, outside of perform, unless the clock has not
+    // fired since the last swap
+    if (x->hCodecOld) {
+        ambi_bin_destroy(&x->hCodecOld);
+    }
+    x->hCodecOld = x->hCodec;
+    x->hCodec = x->hCodecNext;
+    x->hCodecNext = NULL;
+    clock_delay(x->codecClock, 0);
+}
+
+// ─────────────────────────────────────
+// rot holds the yaw, pitch and roll signals of the frame when head tracking is on. A running head
+// tracker replaces them with its latest orientation, held for the whole frame.
+static void binaural_tilde_process(t_binaural_tilde *x, t_sample **ins, t_sample **outs,
+                                   t_sample **rot) {
+    if (saf_idle_check(&x->idle, ins, x->nIn, x->nAmbiFrameSize)) {
+        saf_idle_zero(outs, x->nOut, x->nAmbiFrameSize);
+        saf_load_frame(&x->load, 1);
+        return;
+    }
+    saf_load_frame(&x->load, 0);
+    if (x->nListeners) {
+        binaural_tilde_processlisteners(x, ins, outs);
+        return;
+    }
+    if (x->tracker.port && x->aRotated) {
+        // the last orientation is held while nothing new can be read
+        float ypr[3];
+        memcpy(ypr, x->rot.angles, sizeof(ypr));
+        headtracker_read(&x->tracker, ypr);
+        for (int a = 0; a < 3; a++) {
+            for (int t = 0; t < x->nAmbiFrameSize; t++) {
+                rot[a][t] = ypr[a];
+            }
+        }
+    }
+    if ((x->headtracking || x->tracker.port) && x->aRotated) {
+        saf_rotation_process(&x->rot, ins, x->aRotated, rot, x->nAmbiFrameSize);
+        for (int ch = x->rot.nSH; ch < x->nIn; ch++) {
+            memcpy(x->aRotated[ch], ins[ch], x->nAmbiFrameSize * sizeof(t_sample));
+        }
+        ins = x->aRotated;
+    }
+    saf_load_swap(&x->load);
+    binaural_tilde_decode(x, ins, outs);
+}
+
+// ─────────────────────────────────────
+// Copies n samples of the yaw, pitch and roll signals to dst at offset, channels missing from a
+// multichannel rotation inlet are zero.
+static void binaural_tilde_copyrotation(t_binaural_tilde *x, t_sample **rot, t_sample **dst,
+                                        int offset, int n) {
+    for (int a = 0; a < 3; a++) {
+        if (a < x->nRotChans) {
+            memcpy(dst[a] + offset, rot[a], n * sizeof(t_sample));
+        } else {
+            memset(dst[a] + offset, 0, n * sizeof(t_sample));
+        }
+    }
+}
+
+// ─────────────────────────────────────
+// Reads the angles of every listener from the rotation inlet (3 channels per listener) at index.
+static void binaural_tilde_listenerangles(t_binaural_tilde *x, t_sample *rotIn, int n, int index) {
+    int nAngles = 3 * x->nListeners < x->nRotChans ? 3 * x->nListeners : x->nRotChans;
+    for (int i = 0; i < nAngles; i++) {
+        x->listenerYpr[i] = rotIn[i * n + index];
     }
 }
 
@@ -180,17 +689,24 @@ t_int *binaural_tilde_performmultichannel(t_int *w) {
     t_binaural_tilde *x = (t_binaural_tilde *)(w[1]);
     int n = (int)(w[2]);
     t_sample *ins = (t_sample *)(w[3]);
-    t_sample *outs = (t_sample *)(w[4]);
+    t_sample *rotIn = x->headtracking ? (t_sample *)(w[4]) : NULL;
+    t_sample *outs = (t_sample *)(w[4 + x->headtracking]);
+    saf_load_begin(&x->load);
 
     if (n < x->nAmbiFrameSize) {
         for (int ch = 0; ch < x->nIn; ch++) {
             memcpy(x->aIns[ch] + x->nInAccIndex, ins + (n * ch), n * sizeof(t_sample));
         }
+        if (x->headtracking && x->nListeners) {
+            binaural_tilde_listenerangles(x, rotIn, n, n - 1);
+        } else if (x->headtracking) {
+            t_sample *rot[3] = {rotIn, rotIn + n, rotIn + 2 * n};
+            binaural_tilde_copyrotation(x, rot, x->aRot, x->nInAccIndex, n);
+        }
         x->nInAccIndex += n;
 
         if (x->nInAccIndex == x->nAmbiFrameSize) {
-            ambi_bin_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                             x->nIn, x->nOut, x->nAmbiFrameSize);
+            binaural_tilde_process(x, x->aIns, x->aOuts, x->aRot);
             x->nInAccIndex = 0;
             x->nOutAccIndex = 0;
         }
@@ -210,110 +726,221 @@ t_int *binaural_tilde_performmultichannel(t_int *w) {
         for (int chunkIndex = 0; chunkIndex < chunks; chunkIndex++) {
             // Copia os dados de entrada para cada canal
             for (int ch = 0; ch < x->nIn; ch++) {
-                memcpy(x->aInsTmp[ch], (t_sample *)w[3] + ch * n + chunkIndex * x->nAmbiFrameSize,
+                memcpy(x->aInsTmp[ch], ins + ch * n + chunkIndex * x->nAmbiFrameSize,
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
+            if (x->headtracking && x->nListeners) {
+                int index = (chunkIndex + 1) * x->nAmbiFrameSize - 1;
+                binaural_tilde_listenerangles(x, rotIn, n, index);
+            } else if (x->headtracking) {
+                int offset = chunkIndex * x->nAmbiFrameSize;
+                t_sample *rot[3] = {rotIn + offset, rotIn + n + offset, rotIn + 2 * n + offset};
+                binaural_tilde_copyrotation(x, rot, x->aRotTmp, 0, x->nAmbiFrameSize);
+            }
             // Processa o bloco atual
-            ambi_bin_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                             (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
+            binaural_tilde_process(x, x->aInsTmp, x->aOutsTmp, x->aRotTmp);
 
-            t_sample *out = (t_sample *)(w[4]);
             for (int ch = 0; ch < x->nOut; ch++) {
-                memcpy(out + ch * n + chunkIndex * x->nAmbiFrameSize, x->aOutsTmp[ch],
+                memcpy(outs + ch * n + chunkIndex * x->nAmbiFrameSize, x->aOutsTmp[ch],
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
         }
     }
 
-    return (w + 5);
+    saf_load_end(&x->load, n);
+    return (w + 5 + x->headtracking);
+}
+
+// ─────────────────────────────────────
+// -lowlatency: w holds the input, rotation and output channels one pointer each, and every Pd
+// block is one shbin partition, so nothing is accumulated.
+t_int *binaural_tilde_performlowlatency(t_int *w) {
+    t_binaural_tilde *x = (t_binaural_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    t_sample **ins = (t_sample **)(w + 3);
+    t_sample **rot = (t_sample **)(w + 3 + x->nIn);
+    t_sample **outs = (t_sample **)(w + 3 + x->nIn + x->nRotChans);
+    saf_load_begin(&x->load);
+    for (int i = 0; i < x->nRotChans; i++) {
+        x->listenerYpr[i] = rot[i][n - 1];
+    }
+    binaural_tilde_process(x, ins, outs, NULL);
+    saf_load_end(&x->load, n);
+    return (w + 3 + x->nIn + x->nRotChans + x->nOut);
 }
 
 // ─────────────────────────────────────
 t_int *binaural_tilde_perform(t_int *w) {
     t_binaural_tilde *x = (t_binaural_tilde *)(w[1]);
     int n = (int)(w[2]);
+    int outStart = 3 + x->nIn + x->nRotIn;
+    saf_load_begin(&x->load);
 
     if (n < x->nAmbiFrameSize) {
         for (int ch = 0; ch < x->nIn; ch++) {
             memcpy(x->aIns[ch] + x->nInAccIndex, (t_sample *)w[3 + ch], n * sizeof(t_sample));
         }
+        if (x->headtracking) {
+            t_sample **rot = (t_sample **)(w + 3 + x->nIn);
+            binaural_tilde_copyrotation(x, rot, x->aRot, x->nInAccIndex, n);
+        }
         x->nInAccIndex += n;
         if (x->nInAccIndex == x->nAmbiFrameSize) {
-            ambi_bin_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                             x->nIn, x->nOut, x->nAmbiFrameSize);
+            binaural_tilde_process(x, x->aIns, x->aOuts, x->aRot);
             x->nInAccIndex = 0;
             x->nOutAccIndex = 0;
         }
         for (int ch = 0; ch < x->nOut; ch++) {
-            t_sample *out = (t_sample *)(w[3 + x->nIn + ch]);
+            t_sample *out = (t_sample *)(w[outStart + ch]);
             memcpy(out, x->aOuts[ch] + x->nOutAccIndex, n * sizeof(t_sample));
         }
         x->nOutAccIndex += n;
     } else {
         int chunks = n / x->nAmbiFrameSize;
         for (int chunkIndex = 0; chunkIndex < chunks; chunkIndex++) {
+            int offset = chunkIndex * x->nAmbiFrameSize;
             for (int ch = 0; ch < x->nIn; ch++) {
-                memcpy(x->aInsTmp[ch], (t_sample *)w[3 + ch] + (chunkIndex * x->nAmbiFrameSize),
+                memcpy(x->aInsTmp[ch], (t_sample *)w[3 + ch] + offset,
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
-            ambi_bin_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                             (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
+            if (x->headtracking) {
+                t_sample *rot[3];
+                for (int a = 0; a < 3; a++) {
+                    rot[a] = (t_sample *)w[3 + x->nIn + a] + offset;
+                }
+                binaural_tilde_copyrotation(x, rot, x->aRotTmp, 0, x->nAmbiFrameSize);
+            }
+            binaural_tilde_process(x, x->aInsTmp, x->aOutsTmp, x->aRotTmp);
             for (int ch = 0; ch < x->nOut; ch++) {
-                t_sample *out = (t_sample *)(w[3 + x->nIn + ch]);
-                memcpy(out + (chunkIndex * x->nAmbiFrameSize), x->aOutsTmp[ch],
-                       x->nAmbiFrameSize * sizeof(t_sample));
+                t_sample *out = (t_sample *)(w[outStart + ch]);
+                memcpy(out + offset, x->aOutsTmp[ch], x->nAmbiFrameSize * sizeof(t_sample));
             }
         }
     }
 
-    return (w + 3 + x->nIn + x->nOut);
+    saf_load_end(&x->load, n);
+    return (w + outStart + x->nOut);
+}
+
+// ─────────────────────────────────────
+static void binaural_tilde_dsplowlatency(t_binaural_tilde *x, t_signal **sp) {
+    // one pointer per channel, multichannel signals are split into their channels
+    int n = sp[0]->s_n;
+    int nAngles = x->headtracking ? 3 * x->nListeners : 0;
+    t_signal *rotSig = NULL;
+    t_signal *outSig;
+    if (x->multichannel) {
+        rotSig = x->headtracking ? sp[1] : NULL;
+        signal_setmultiout(&sp[1 + x->headtracking], x->nOut);
+        outSig = sp[1 + x->headtracking];
+        x->nRotChans = rotSig ? (rotSig->s_nchans < nAngles ? rotSig->s_nchans : nAngles) : 0;
+    } else {
+        for (int i = 0; i < x->nOut; i++) {
+            signal_setmultiout(&sp[x->nIn + x->nRotIn + i], 1);
+        }
+        outSig = NULL;
+        x->nRotChans = x->nRotIn;
+    }
+    if (x->nRotChans < nAngles) {
+        pd_error(x, "[saf.binaural~] Rotation inlet expects 3 channels (yaw, pitch, roll) per "
+                    "listener");
+    }
+
+    int sigvecsize = 2 + x->nIn + x->nRotChans + x->nOut;
+    t_int *sigvec = getbytes(sigvecsize * sizeof(t_int));
+    sigvec[0] = (t_int)x;
+    sigvec[1] = (t_int)n;
+    t_int *v = sigvec + 2;
+    for (int ch = 0; ch < x->nIn; ch++) {
+        *v++ = (t_int)(x->multichannel ? sp[0]->s_vec + ch * n : sp[ch]->s_vec);
+    }
+    for (int a = 0; a < x->nRotChans; a++) {
+        *v++ = (t_int)(x->multichannel ? rotSig->s_vec + a * n : sp[x->nIn + a]->s_vec);
+    }
+    for (int ch = 0; ch < x->nOut; ch++) {
+        *v++ = (t_int)(x->multichannel ? outSig->s_vec + ch * n
+                                       : sp[x->nIn + x->nRotIn + ch]->s_vec);
+    }
+    dsp_addv(binaural_tilde_performlowlatency, sigvecsize, sigvec);
+    freebytes(sigvec, sigvecsize * sizeof(t_int));
 }
 
 // ─────────────────────────────────────
 void binaural_tilde_dsp(t_binaural_tilde *x, t_signal **sp) {
     if (!x->multichannel && sp[0]->s_nchans > 1) {
-        for (int i = 0; i < x->nIn; i++) {
-            signal_setmultiout(&sp[x->nIn], 1);
-            dsp_add_zero(sp[i]->s_vec, sp[i]->s_n);
-        }
+        int outStart = x->nIn + x->nRotIn;
         for (int i = 0; i < x->nOut; i++) {
-            signal_setmultiout(&sp[x->nIn + i], 1);
-            dsp_add_zero(sp[x->nIn + i]->s_vec, sp[x->nIn + i]->s_n);
+            signal_setmultiout(&sp[outStart + i], 1);
+            dsp_add_zero(sp[outStart + i]->s_vec, sp[outStart + i]->s_n);
         }
         pd_error(x, "[saf.binaural~] Expected mono input. Use -m flag to multichannel");
         return;
     }
 
     // Set frame sizes and reset indices
-    x->nAmbiFrameSize = ambi_bin_getFrameSize();
+    x->nAmbiFrameSize = x->lowLatency ? sp[0]->s_n : ambi_bin_getFrameSize();
+    saf_idle_settail(&x->idle,
+                     saf_idle_frames(ambi_bin_getProcessingDelay(), x->nAmbiFrameSize) + 2);
+    x->shbinLength = 0; // the tail of -listeners is set once the filters are known
     x->nPdFrameSize = sp[0]->s_n;
     x->nOutAccIndex = 0;
     x->nInAccIndex = 0;
-    x->nIn = sp[0]->s_nchans;
+    if (x->multichannel) {
+        x->nIn = sp[0]->s_nchans;
+    }
+    x->load.sr = sp[0]->s_sr;
+    saf_load_setmaxlevel(&x->load, x->nListeners ? 0 : get_ambisonic_order(x->nIn) - 1);
+    if (x->load.level > x->load.maxLevel) {
+        x->load.level = x->load.maxLevel;
+    }
 
-    // add this in another thread
-    if (ambi_bin_getCodecStatus(x->hAmbi) == CODEC_STATUS_NOT_INITIALISED) {
-        ambi_bin_init(x->hAmbi, sys_getsr());
-        ambi_bin_setNormType(x->hAmbi, NORM_N3D);
-        ambi_bin_setInputOrderPreset(x->hAmbi, (SH_ORDERS)get_ambisonic_order(x->nIn));
-        logpost(x, 2, "[saf.binaural~] Initializing decoder codec...");
-        pthread_t initThread;
-        pthread_create(&initThread, NULL, binaural_tilde_initcodec, (void *)x);
-        pthread_detach(initThread);
+    if (x->nListeners) {
+        // the filters are designed for one order, sample rate and partition size
+        if (x->shbinOrder != get_ambisonic_order(x->nIn) || x->shbinSr != (int)x->load.sr ||
+            x->shbinFrameSize != x->nAmbiFrameSize) {
+            binaural_tilde_design(x);
+        }
+    } else if (x->codecOrder != get_ambisonic_order(x->nIn) - x->load.level ||
+               x->codecSr != (int)x->load.sr) {
+        // the codec is designed for one input order and sample rate
+        binaural_tilde_codec(x);
     }
 
-    if (x->nPreviousIn != x->nIn) {
+    if (x->nPreviousIn != x->nIn || !x->aIns) {
         binaural_tilde_malloc(x);
     }
+    if (!x->nListeners && (x->headtracking || x->tracker.port) &&
+        (!x->aRotated || x->nRotatedIn != x->nIn)) {
+        binaural_tilde_mallocrotation(x);
+        saf_rotation_setflags(&x->rot, ambi_bin_getFlipYaw(x->hAmbi),
+                              ambi_bin_getFlipPitch(x->hAmbi), ambi_bin_getFlipRoll(x->hAmbi),
+                              ambi_bin_getRPYflag(x->hAmbi));
+    }
+
+    if (x->lowLatency) {
+        binaural_tilde_dsplowlatency(x, sp);
+        return;
+    }
 
     // Initialize memory allocation for inputs and outputs
-    if (x->multichannel) {
-        signal_setmultiout(&sp[1], 2);
+    if (x->multichannel && x->headtracking) {
+        // yaw, pitch and roll as the 3 channels of the second inlet, 3 per listener
+        x->nRotChans = sp[1]->s_nchans;
+        if (x->nRotChans < 3 * (x->nListeners ? x->nListeners : 1)) {
+            pd_error(x, "[saf.binaural~] Rotation inlet expects 3 channels (yaw, pitch, roll) per "
+                        "listener");
+        }
+        signal_setmultiout(&sp[2], x->nOut);
+        dsp_add(binaural_tilde_performmultichannel, 5, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec,
+                sp[2]->s_vec);
+    } else if (x->multichannel) {
+        signal_setmultiout(&sp[1], x->nOut);
         dsp_add(binaural_tilde_performmultichannel, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
     } else {
-        int sum = x->nIn + x->nOut;
+        x->nRotChans = x->nRotIn;
+        int sum = x->nIn + x->nRotIn + x->nOut;
         int sigvecsize = sum + 2;
-        for (int i = x->nIn; i < sum; i++) {
+        for (int i = x->nIn + x->nRotIn; i < sum; i++) {
             signal_setmultiout(&sp[i], 1);
         }
         t_int *sigvec = getbytes(sigvecsize * sizeof(t_int));
@@ -332,29 +959,53 @@ void *binaural_tilde_new(t_symbol *s, int argc, t_atom *argv) {
     t_binaural_tilde *x = (t_binaural_tilde *)pd_new(binaural_tilde_class);
     x->glist = canvas_getcurrent(); // TODO: add HRIR reader
 
-    if (argc == 0) {
-        x->multichannel = 0;
-        x->nIn = 1;
-    } else {
-        if (argv[0].a_type == A_SYMBOL) {
-            if (strcmp(atom_getsymbol(argv)->s_name, "-m") != 0) {
-                pd_error(x, "[saf.decoder~] Expected '-m' in second argument. Multichannel mode "
-                            "will be activated anyway");
-            }
+    // saf.binaural~ [num_inputs | -m] [-r] [-listeners N] [-lowlatency], -r adds signal inlets
+    // for yaw, pitch and roll, -listeners renders N listeners to a 2N-channel multichannel outlet
+    // and -lowlatency renders through FIR filters partitioned at the Pd block size
+    x->multichannel = 0;
+    x->headtracking = 0;
+    x->nListeners = 0;
+    x->lowLatency = 0;
+    x->nIn = 1;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type != A_SYMBOL) {
+            x->nIn = atom_getint(argv + i);
+        } else if (strcmp(atom_getsymbol(argv + i)->s_name, "-r") == 0) {
+            x->headtracking = 1;
+        } else if (strcmp(atom_getsymbol(argv + i)->s_name, "-lowlatency") == 0) {
+            x->lowLatency = 1;
+        } else if (strcmp(atom_getsymbol(argv + i)->s_name, "-listeners") == 0) {
+            int n = i + 1 < argc ? atom_getint(argv + ++i) : 1;
+            x->nListeners = n < 1 ? 1 : n > SHBIN_MAX_LISTENERS ? SHBIN_MAX_LISTENERS : n;
             x->multichannel = 1;
         } else {
-            x->multichannel = 0;
-            x->nIn = atom_getint(argv);
+            if (strcmp(atom_getsymbol(argv + i)->s_name, "-m") != 0) {
+                pd_error(x, "[saf.binaural~] Expected '-m', '-r', '-listeners' or '-lowlatency' as "
+                            "flags. Multichannel mode will be activated anyway");
+            }
+            x->multichannel = 1;
         }
     }
 
-    x->nOut = 2;
+    if (x->lowLatency && !x->nListeners) {
+        x->nListeners = 1; // a single listener through shbin, with the usual inlets and outlets
+    }
+    x->nOut = x->nListeners ? 2 * x->nListeners : 2;
+    x->nRotIn = x->headtracking && !x->multichannel ? 3 : 0;
     ambi_bin_create(&x->hAmbi);
+    ambi_bin_setNormType(x->hAmbi, NORM_N3D);
+    if (x->headtracking) {
+        // the SH input is rotated before ambi_bin, its own rotation stays off
+        ambi_bin_setEnableRotation(x->hAmbi, 0);
+    }
 
     if (x->multichannel) {
+        if (x->headtracking) {
+            inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
+        }
         outlet_new(&x->obj, &s_signal);
     } else {
-        for (int i = 1; i < x->nIn; i++) {
+        for (int i = 1; i < x->nIn + x->nRotIn; i++) {
             inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
         }
 
@@ -364,11 +1015,63 @@ void *binaural_tilde_new(t_symbol *s, int argc, t_atom *argv) {
     }
     x->aIns = NULL;
     x->aOuts = NULL;
+    x->aRotated = NULL;
+
+    // x->hAmbi is never initialised, it only keeps the settings
+    x->shbinConfig.method = ambi_bin_getDecodingMethod(x->hAmbi);
+    x->shbinConfig.enableMaxRE = ambi_bin_getEnableMaxRE(x->hAmbi);
+    x->shbinConfig.enableDiffuseMatching = ambi_bin_getEnableDiffuseMatching(x->hAmbi);
+    x->shbinConfig.normType = NORM_N3D;
+    x->shbinConfig.useDefaultHRIRs = 1;
+    x->shbinConfig.sofaPath[0] = '\0';
+    x->shbin = NULL;
+    x->shbinOrder = -1;
+    x->shbinSr = 0;
+    saf_designer_init(&x->designer, &x->obj.ob_pd, binaural_tilde_designfilters,
+                      binaural_tilde_installfilters, binaural_tilde_discardfilters);
+    x->listenerYpr = x->nListeners ? (float *)getbytes(3 * x->nListeners * sizeof(float)) : NULL;
+    x->hCodec = NULL;
+    x->hCodecNext = NULL;
+    x->hCodecOld = NULL;
+    x->codecOrder = -1;
+    x->codecSr = 0;
+    for (int ear = 0; ear < NUM_EARS; ear++) {
+        x->aCodecOuts[ear] = x->nListeners
+                                 ? NULL
+                                 : (t_sample *)getbytes(ambi_bin_getFrameSize() * sizeof(t_sample));
+    }
+    saf_designer_init(&x->codecDesigner, &x->obj.ob_pd, binaural_tilde_buildcodec,
+                      binaural_tilde_installcodec, binaural_tilde_discardcodec);
+
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.binaural~", 0, binaural_tilde_applylevel);
+    saf_idle_init(&x->idle, 0);
+    x->codecClock = clock_new(x, (t_method)binaural_tilde_dropcodec);
     return x;
 }
 
 // ─────────────────────────────────────
 void binaural_tilde_free(t_binaural_tilde *x) {
+    saf_load_free(&x->load);
+    headtracker_stop(&x->tracker);
+    binaural_tilde_freerotation(x);
+    saf_designer_free(&x->designer);
+    saf_designer_free(&x->codecDesigner);
+    shbin_free(x->shbin);
+    if (x->listenerYpr) {
+        freebytes(x->listenerYpr, 3 * x->nListeners * sizeof(float));
+    }
+    clock_free(x->codecClock);
+    void *codecs[3] = {x->hCodec, x->hCodecNext, x->hCodecOld};
+    for (int i = 0; i < 3; i++) {
+        if (codecs[i]) {
+            ambi_bin_destroy(&codecs[i]);
+        }
+    }
+    for (int ear = 0; ear < NUM_EARS; ear++) {
+        if (x->aCodecOuts[ear]) {
+            freebytes(x->aCodecOuts[ear], ambi_bin_getFrameSize() * sizeof(t_sample));
+        }
+    }
     ambi_bin_destroy(&x->hAmbi);
     for (int i = 0; i < x->nIn; i++) {
         if (x->aIns) {
@@ -430,4 +1133,11 @@ void setup_saf0x2ebinaural_tilde(void) {
     class_addmethod(binaural_tilde_class, (t_method)binaural_tilde_set, gensym("flippitch"), A_GIMME, 0);
     class_addmethod(binaural_tilde_class, (t_method)binaural_tilde_set, gensym("fliproll"), A_GIMME, 0);
     class_addmethod(binaural_tilde_class, (t_method)binaural_tilde_set, gensym("rpyflag"), A_GIMME, 0);
+    class_addmethod(binaural_tilde_class, (t_method)binaural_tilde_set, gensym("tracker"), A_GIMME, 0);
+    class_addmethod(binaural_tilde_class, (t_method)binaural_tilde_listener, gensym("listener"), A_GIMME, 0);
+
+    class_addmethod(binaural_tilde_class, (t_method)binaural_tilde_idle, gensym("idle"), A_FLOAT, 0);
+    class_addmethod(binaural_tilde_class, (t_method)binaural_tilde_stats, gensym("stats"), 0);
+    class_addmethod(binaural_tilde_class, (t_method)binaural_tilde_loadreport, gensym("saf_loadreport"), 0);
+    class_addmethod(binaural_tilde_class, (t_method)binaural_tilde_degrade, gensym("saf_degrade"), A_FLOAT, 0);
 }
@@ -0,0 +1,382 @@
+#include <string.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include "silence.h"
+#include "convolver.h"
+
+// ─────────────────────────────────────
+// Partitions count samples of the filters, starting at offset, into parts of size samples. Without
+// h the filters are silent and can be replaced one by one.
+static void convolver_segment_init(t_convolver_segment *s, int nIn, int nOut, int diagonal,
+                                   const float *h, int stride, int offset, int count, int size) {
+    s->size = size;
+    s->nFFT = 2 * size;
+    s->nBins = size + 1;
+    s->nParts = (count + size - 1) / size;
+    s->nIn = nIn;
+    s->nOut = nOut;
+    s->diagonal = diagonal;
+    s->nPairs = diagonal ? nIn : nOut * nIn;
+    s->fdlPos = 0;
+    saf_rfft_create(&s->hFFT, s->nFFT);
+
+    int nBins = s->nBins;
+    s->H = (float_complex *)getbytes(s->nParts * s->nPairs * nBins * sizeof(float_complex));
+    s->used = (unsigned char *)getbytes(s->nPairs);
+    s->fdl = (float_complex *)getbytes(s->nParts * nIn * nBins * sizeof(float_complex));
+    s->window = (float *)getbytes(nIn * s->nFFT * sizeof(float));
+    s->acc = (float_complex *)getbytes(nBins * sizeof(float_complex));
+    s->time = (float *)getbytes(s->nFFT * sizeof(float));
+    s->quiet = (int *)getbytes(nIn * sizeof(int));
+    s->changed = (unsigned char *)getbytes(s->nPairs);
+    s->nChanged = 0;
+    if (!h) {
+        s->Hold = (float_complex *)getbytes(s->nParts * s->nPairs * nBins * sizeof(float_complex));
+        s->accOld = (float_complex *)getbytes(nBins * sizeof(float_complex));
+        s->timeOld = (float *)getbytes(s->nFFT * sizeof(float));
+        return;
+    }
+    for (int q = 0; q < s->nPairs; q++) {
+        const float *f = h + q * stride + offset;
+        for (int t = 0; t < count && !s->used[q]; t++) {
+            s->used[q] = f[t] != 0.0f;
+        }
+        if (!s->used[q]) {
+            continue;
+        }
+        for (int p = 0; p < s->nParts; p++) {
+            int n = count - p * size < size ? count - p * size : size;
+            memset(s->time, 0, s->nFFT * sizeof(float));
+            memcpy(s->time, f + p * size, n * sizeof(float));
+            saf_rfft_forward(s->hFFT, s->time, s->H + (p * s->nPairs + q) * nBins);
+        }
+    }
+}
+
+// ─────────────────────────────────────
+static void convolver_segment_free(t_convolver_segment *s) {
+    if (!s->hFFT) {
+        return;
+    }
+    int nBins = s->nBins;
+    freebytes(s->H, s->nParts * s->nPairs * nBins * sizeof(float_complex));
+    freebytes(s->used, s->nPairs);
+    freebytes(s->fdl, s->nParts * s->nIn * nBins * sizeof(float_complex));
+    freebytes(s->window, s->nIn * s->nFFT * sizeof(float));
+    freebytes(s->acc, nBins * sizeof(float_complex));
+    freebytes(s->time, s->nFFT * sizeof(float));
+    freebytes(s->quiet, s->nIn * sizeof(int));
+    freebytes(s->changed, s->nPairs);
+    if (s->Hold) {
+        freebytes(s->Hold, s->nParts * s->nPairs * nBins * sizeof(float_complex));
+        freebytes(s->accOld, nBins * sizeof(float_complex));
+        freebytes(s->timeOld, s->nFFT * sizeof(float));
+    }
+    saf_rfft_destroy(&s->hFFT);
+}
+
+// ─────────────────────────────────────
+// Accumulates the partitions of the pairs of output o into acc, and with old set only the pairs
+// replaced since the last block, their new filters into acc and their old ones into accOld. Returns
+// 1 if output o has a replaced pair.
+static int convolver_segment_accumulate(t_convolver_segment *s, int o, int pos, int old) {
+    int nBins = s->nBins;
+    int first = s->diagonal ? o : 0;
+    int last = s->diagonal ? o + 1 : s->nIn;
+    int fade = 0;
+    for (int p = 0; p < s->nParts; p++) {
+        int slot = (pos - p + s->nParts) % s->nParts;
+        for (int i = first; i < last; i++) {
+            int q = s->diagonal ? o : o * s->nIn + i;
+            if (s->quiet[i] > s->nParts) {
+                continue; // every partition of this input is silent
+            }
+            const float *x = (const float *)(s->fdl + (slot * s->nIn + i) * nBins);
+            int replaced = s->nChanged && s->changed[q];
+            fade |= replaced;
+            if (replaced != old || (!replaced && !s->used[q])) {
+                continue;
+            }
+            int offset = (p * s->nPairs + q) * nBins;
+            convolver_cmac((float *)s->acc, (const float *)(s->H + offset), x, nBins);
+            if (old) {
+                convolver_cmac((float *)s->accOld, (const float *)(s->Hold + offset), x, nBins);
+            }
+        }
+    }
+    return fade;
+}
+
+// ─────────────────────────────────────
+// Uniformly partitioned overlap-save of one partition, ins and outs hold size samples per channel
+// and may be the same buffers.
+static void convolver_segment_process(t_convolver_segment *s, const float *const *ins,
+                                      float *const *outs) {
+    int P = s->size;
+    int nBins = s->nBins;
+    int pos = s->fdlPos;
+    for (int i = 0; i < s->nIn; i++) {
+        float *w = s->window + i * s->nFFT;
+        memmove(w, w + P, P * sizeof(float));
+        memcpy(w + P, ins[i], P * sizeof(float));
+        int silent = saf_idle_channelsilent(ins[i], P, SAF_IDLE_THRESHOLD);
+        s->quiet[i] = silent ? (s->quiet[i] <= s->nParts ? s->quiet[i] + 1 : s->quiet[i]) : 0;
+        float_complex *X = s->fdl + (pos * s->nIn + i) * nBins;
+        if (s->quiet[i] >= 2) {
+            memset(X, 0, nBins * sizeof(float_complex)); // the whole window
+        } else {
+            saf_rfft_forward(s->hFFT, w, X);
+        }
+    }
+    for (int o = 0; o < s->nOut; o++) {
+        memset(s->acc, 0, nBins * sizeof(float_complex));
+        if (!convolver_segment_accumulate(s, o, pos, 0)) {
+            saf_rfft_backward(s->hFFT, s->acc, s->time);
+            memcpy(outs[o], s->time + P, P * sizeof(float));
+            continue;
+        }
+
+        // the old filters of the replaced pairs fade out over the block
+        memcpy(s->accOld, s->acc, nBins * sizeof(float_complex));
+        convolver_segment_accumulate(s, o, pos, 1);
+        saf_rfft_backward(s->hFFT, s->acc, s->time);
+        saf_rfft_backward(s->hFFT, s->accOld, s->timeOld);
+        const float *y = s->time + P;
+        const float *yOld = s->timeOld + P;
+        float step = 1.0f / (float)P;
+        float *out = outs[o];
+        for (int t = 0; t < P; t++) {
+            out[t] = yOld[t] + step * (float)(t + 1) * (y[t] - yOld[t]);
+        }
+    }
+    if (s->nChanged) {
+        memset(s->changed, 0, s->nPairs);
+        s->nChanged = 0;
+    }
+    s->fdlPos = (pos + 1) % s->nParts;
+}
+
+// ─────────────────────────────────────
+// A dropped block still moves the frequency-domain delay line of the tail, by one silent block.
+static void convolver_tailjob(t_convolver *c, int job) {
+    int b = job % CONVOLVER_TAIL_SLOTS;
+    const float *const *ins = atomic_load_explicit(&c->dropped[b], memory_order_relaxed)
+                                  ? c->tailQuiet
+                                  : (const float *const *)c->tailIn[b];
+    convolver_segment_process(&c->tail, ins, c->tailOut[b]);
+}
+
+// ─────────────────────────────────────
+static void *convolver_worker(void *arg) {
+    t_convolver *c = (t_convolver *)arg;
+    int job = 0;
+    for (;;) {
+        saf_wakeup_wait(&c->wakeup);
+        if (!atomic_load(&c->running)) {
+            break;
+        }
+        // a late worker catches up in order, the partitions of the tail need every input block
+        while (job < atomic_load_explicit(&c->posted, memory_order_acquire)) {
+            convolver_tailjob(c, job);
+            atomic_store_explicit(&c->done, ++job, memory_order_release);
+        }
+    }
+    return NULL;
+}
+
+// ─────────────────────────────────────
+static float **convolver_buffers(int nCh, int n) {
+    float **b = (float **)getbytes(nCh * sizeof(float *));
+    for (int ch = 0; ch < nCh; ch++) {
+        b[ch] = (float *)getbytes(n * sizeof(float));
+    }
+    return b;
+}
+
+// ─────────────────────────────────────
+static void convolver_freebuffers(float **b, int nCh, int n) {
+    for (int ch = 0; ch < nCh; ch++) {
+        freebytes(b[ch], n * sizeof(float));
+    }
+    freebytes(b, nCh * sizeof(float *));
+}
+
+// ─────────────────────────────────────
+static t_convolver *convolver_create(int nIn, int nOut, int diagonal, const float *h, int stride,
+                                     int length, int blockSize) {
+    t_convolver *c = (t_convolver *)getbytes(sizeof(t_convolver));
+    c->nIn = nIn;
+    c->nOut = nOut;
+    c->diagonal = diagonal;
+    c->variable = !h;
+    c->length = length;
+    c->blockSize = blockSize;
+
+    // the head covers the first three tail blocks, the worker then has one tail block of time plus
+    // one of slack
+    int tailSize = blockSize * CONVOLVER_TAIL_BLOCKS;
+    tailSize = tailSize > CONVOLVER_MAX_TAIL ? CONVOLVER_MAX_TAIL : tailSize;
+    tailSize = tailSize < blockSize ? blockSize : tailSize;
+    c->tailSize = h && length > 5 * tailSize ? tailSize : 0;
+    int headLength = c->tailSize ? 3 * c->tailSize : length;
+    convolver_segment_init(&c->head, nIn, nOut, diagonal, h, stride, 0, headLength, blockSize);
+    if (!c->tailSize) {
+        return c;
+    }
+
+    convolver_segment_init(&c->tail, nIn, nOut, diagonal, h, stride, headLength,
+                           length - headLength, c->tailSize);
+    for (int b = 0; b < CONVOLVER_TAIL_SLOTS; b++) {
+        c->tailIn[b] = convolver_buffers(nIn, c->tailSize);
+        c->tailOut[b] = convolver_buffers(nOut, c->tailSize);
+    }
+    c->tailZero = (float *)getbytes(c->tailSize * sizeof(float));
+    c->tailQuiet = (const float **)getbytes(nIn * sizeof(float *));
+    for (int i = 0; i < nIn; i++) {
+        c->tailQuiet[i] = c->tailZero;
+    }
+    for (int b = 0; b < CONVOLVER_TAIL_SLOTS; b++) {
+        atomic_init(&c->dropped[b], 0);
+    }
+    c->tailPos = 0;
+    c->job = 0;
+    c->tailReady = 0;
+    atomic_init(&c->posted, 0);
+    atomic_init(&c->done, 0);
+    atomic_init(&c->running, 1);
+    atomic_init(&c->misses, 0);
+    saf_wakeup_init(&c->wakeup);
+    c->threaded = pthread_create(&c->thread, NULL, convolver_worker, (void *)c) == 0;
+    if (!c->threaded) {
+        pd_error(NULL, "[saf] Failed to start the convolver thread, the tail runs inline");
+    }
+    return c;
+}
+
+// ─────────────────────────────────────
+t_convolver *convolver_new(int nIn, int nOut, const float *h, int stride, int length,
+                           int blockSize) {
+    return convolver_create(nIn, nOut, 0, h, stride, length, blockSize);
+}
+
+// ─────────────────────────────────────
+t_convolver *convolver_newdiagonal(int nCh, const float *h, int stride, int length,
+                                   int blockSize) {
+    return convolver_create(nCh, nCh, 1, h, stride, length, blockSize);
+}
+
+// ─────────────────────────────────────
+t_convolver *convolver_newvariable(int nIn, int nOut, int length, int blockSize) {
+    return convolver_create(nIn, nOut, 0, NULL, 0, length, blockSize);
+}
+
+// ─────────────────────────────────────
+void convolver_setfilter(t_convolver *c, int out, int in, const float *h, int length,
+                         int crossfade) {
+    t_convolver_segment *s = &c->head;
+    int P = s->size;
+    int nBins = s->nBins;
+    int q = out * s->nIn + in;
+    if (crossfade && !s->changed[q]) {
+        // a filter replaced twice within a block still fades from the one last played
+        for (int p = 0; p < s->nParts; p++) {
+            int offset = (p * s->nPairs + q) * nBins;
+            memcpy(s->Hold + offset, s->H + offset, nBins * sizeof(float_complex));
+        }
+        s->changed[q] = 1;
+        s->nChanged++;
+    }
+    length = length < c->length ? length : c->length;
+    s->used[q] = 0;
+    for (int t = 0; t < length && !s->used[q]; t++) {
+        s->used[q] = h[t] != 0.0f;
+    }
+    for (int p = 0; p < s->nParts; p++) {
+        int n = length - p * P < P ? length - p * P : P;
+        memset(s->time, 0, s->nFFT * sizeof(float));
+        if (n > 0) {
+            memcpy(s->time, h + p * P, n * sizeof(float));
+        }
+        saf_rfft_forward(s->hFFT, s->time, s->H + (p * s->nPairs + q) * nBins);
+    }
+}
+
+// ─────────────────────────────────────
+void convolver_free(t_convolver *c) {
+    if (!c) {
+        return;
+    }
+    if (c->tailSize) {
+        if (c->threaded) {
+            atomic_store(&c->running, 0);
+            saf_wakeup_post(&c->wakeup);
+            pthread_join(c->thread, NULL);
+        }
+        saf_wakeup_destroy(&c->wakeup);
+        freebytes(c->tailZero, c->tailSize * sizeof(float));
+        freebytes(c->tailQuiet, c->nIn * sizeof(float *));
+        for (int b = 0; b < CONVOLVER_TAIL_SLOTS; b++) {
+            convolver_freebuffers(c->tailIn[b], c->nIn, c->tailSize);
+            convolver_freebuffers(c->tailOut[b], c->nOut, c->tailSize);
+        }
+        convolver_segment_free(&c->tail);
+    }
+    convolver_segment_free(&c->head);
+    freebytes(c, sizeof(t_convolver));
+}
+
+// ─────────────────────────────────────
+// Convolves one block of blockSize samples, ins and outs may be the same buffers.
+void convolver_process(t_convolver *c, const float *const *ins, float *const *outs) {
+    int B = c->blockSize;
+    if (!c->tailSize) {
+        convolver_segment_process(&c->head, ins, outs);
+        return;
+    }
+
+    // tail block m is filled during block m and its output is added during block m + 3, from
+    // the slot that block m + 3 fills again. The worker may still be reading that slot for block
+    // m if it is late, block m + 3 is then dropped instead of overwriting it.
+    int b = c->job % CONVOLVER_TAIL_SLOTS;
+    if (c->tailPos == 0) {
+        int reused = c->job - CONVOLVER_TAIL_SLOTS;
+        int drop = reused >= 0 && atomic_load_explicit(&c->done, memory_order_acquire) <= reused;
+        atomic_store_explicit(&c->dropped[b], drop, memory_order_relaxed);
+    }
+    if (!atomic_load_explicit(&c->dropped[b], memory_order_relaxed)) {
+        for (int i = 0; i < c->nIn; i++) {
+            memcpy(c->tailIn[b][i] + c->tailPos, ins[i], B * sizeof(float));
+        }
+    }
+    convolver_segment_process(&c->head, ins, outs);
+    if (c->tailReady) {
+        for (int o = 0; o < c->nOut; o++) {
+            const float *z = c->tailOut[b][o] + c->tailPos;
+            float *out = outs[o];
+            for (int t = 0; t < B; t++) {
+                out[t] += z[t];
+            }
+        }
+    }
+
+    c->tailPos += B;
+    if (c->tailPos < c->tailSize) {
+        return;
+    }
+    c->tailPos = 0;
+    if (!c->threaded) {
+        convolver_tailjob(c, c->job);
+        atomic_store_explicit(&c->done, c->job + 1, memory_order_relaxed);
+    }
+    atomic_store_explicit(&c->posted, ++c->job, memory_order_release);
+    saf_wakeup_post(&c->wakeup);
+
+    // the next block plays the output of three tail blocks ago, or none if the worker is late
+    int needed = c->job - CONVOLVER_TAIL_SLOTS;
+    c->tailReady = needed >= 0 && atomic_load_explicit(&c->done, memory_order_acquire) > needed;
+    if (needed >= 0 && !c->tailReady) {
+        atomic_fetch_add(&c->misses, 1);
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef SAF_CONVOLVER_H
+#define SAF_CONVOLVER_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <m_pd.h>
+#include <saf.h>
+
+#include "wakeup.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CONVOLVER_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CONVOLVER_NEON
+#endif
+
+// ─────────────────────────────────────
+// Non-uniformly partitioned FIR matrix convolution (nOut x nIn filters) for long responses such
+// as BRIRs. The first 3 x tailSize samples of the filters are convolved on the audio thread with
+// partitions of one block, the rest with partitions of tailSize samples on a worker thread. Every
+// input is transformed once per partition and shared by all outputs, and filter pairs that are
+// all zero are skipped. A diagonal convolver holds one filter per channel, output k only sees
+// input k, and stores nIn instead of nOut x nIn spectra.
+//
+// A tail block is posted once its tailSize input samples are complete and its output is only
+// needed 2 x tailSize samples later, so the worker has one tail block of time for it plus one of
+// slack. The audio thread never waits for the worker: a tail block that is not back in time is
+// left out of the output and counted as a miss. An input slot is only refilled once the worker is
+// done with the block it held, otherwise the block being filled is dropped and the worker convolves
+// silence in its place, so the tail never mixes old and new input.
+//
+// A variable convolver has no tail and starts with silent filters. convolver_setfilter replaces
+// one filter at a time, and the next block crossfades from the output of the old filters to the
+// output of the new ones, computing both only for the replaced pairs. Inputs that have been silent
+// for longer than the filters are skipped in any convolver.
+#define CONVOLVER_TAIL_BLOCKS 16 // tailSize in blocks
+#define CONVOLVER_MAX_TAIL 8192
+#define CONVOLVER_TAIL_SLOTS 3 // tail blocks being filled, convolved and played
+
+typedef struct _convolver_segment {
+    int size; // partition size
+    int nFFT;
+    int nBins;
+    int nParts;
+    int nIn;
+    int nOut;
+    int diagonal;
+    int nPairs; // nOut x nIn, or nIn when diagonal
+    int fdlPos;
+    void *hFFT;
+    float_complex *H;       // nParts x nPairs x nBins
+    unsigned char *used;    // nPairs, pairs with a non-zero filter
+    float_complex *fdl;     // nParts x nIn x nBins
+    float *window;          // nIn x nFFT
+    float_complex *acc;     // nBins
+    float *time;            // nFFT
+    int *quiet;             // nIn, consecutive silent input blocks, up to nParts + 1
+    unsigned char *changed; // nPairs, filters replaced since the last block
+    int nChanged;           // number of them
+    float_complex *Hold;    // nParts x nPairs x nBins, filters of the last block, variable only
+    float_complex *accOld;  // nBins
+    float *timeOld;         // nFFT
+} t_convolver_segment;
+
+typedef struct _convolver {
+    int nIn;
+    int nOut;
+    int diagonal;
+    int variable;
+    int length;
+    int blockSize;
+    int tailSize; // 0 when the filters fit in the head
+    t_convolver_segment head;
+    t_convolver_segment tail;
+
+    float **tailIn[CONVOLVER_TAIL_SLOTS];  // nIn x tailSize, by job modulo the slots
+    float **tailOut[CONVOLVER_TAIL_SLOTS]; // nOut x tailSize
+    int tailPos;
+    int job;       // tail block being filled
+    int tailReady; // the tail output added during this block came back in time
+    int threaded;  // the worker thread is running, otherwise the tail is convolved inline
+    float *tailZero;                          // tailSize zeros
+    const float **tailQuiet;                  // nIn x tailZero, input of a dropped block
+    atomic_int dropped[CONVOLVER_TAIL_SLOTS]; // the block of the slot was not copied
+    atomic_int posted; // jobs handed to the worker
+    atomic_int done;   // jobs the worker has finished, in order
+    atomic_int running;
+    atomic_uint misses;
+    pthread_t thread;
+    t_saf_wakeup wakeup;
+} t_convolver;
+
+// ─────────────────────────────────────
+// acc += h * x over n complex bins, stored as interleaved re/im pairs, two bins per SSE vector.
+static inline void convolver_cmac(float *acc, const float *h, const float *x, int n) {
+    int i = 0;
+#if defined(CONVOLVER_SSE)
+    const __m128 sign = _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f);
+    for (; i + 4 <= 2 * n; i += 4) {
+        __m128 a = _mm_loadu_ps(h + i);
+        __m128 b = _mm_loadu_ps(x + i);
+        __m128 re = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 0, 0));   // hr0 hr0 hr1 hr1
+        __m128 im = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 1, 1));   // hi0 hi0 hi1 hi1
+        __m128 swap = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)); // xi0 xr0 xi1 xr1
+        __m128 y = _mm_add_ps(_mm_mul_ps(re, b), _mm_mul_ps(sign, _mm_mul_ps(im, swap)));
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), y));
+    }
+#elif defined(CONVOLVER_NEON)
+    for (; i + 8 <= 2 * n; i += 8) {
+        float32x4x2_t a = vld2q_f32(h + i);
+        float32x4x2_t b = vld2q_f32(x + i);
+        float32x4x2_t c = vld2q_f32(acc + i);
+        c.val[0] = vmlsq_f32(vmlaq_f32(c.val[0], a.val[0], b.val[0]), a.val[1], b.val[1]);
+        c.val[1] = vmlaq_f32(vmlaq_f32(c.val[1], a.val[0], b.val[1]), a.val[1], b.val[0]);
+        vst2q_f32(acc + i, c);
+    }
+#endif
+    for (; i < 2 * n; i += 2) {
+        acc[i] += h[i] * x[i] - h[i + 1] * x[i + 1];
+        acc[i + 1] += h[i] * x[i + 1] + h[i + 1] * x[i];
+    }
+}
+
+// ─────────────────────────────────────
+// h holds nOut x nIn filters of length samples, stride samples apart.
+t_convolver *convolver_new(int nIn, int nOut, const float *h, int stride, int length,
+                           int blockSize);
+// h holds one filter per channel.
+t_convolver *convolver_newdiagonal(int nCh, const float *h, int stride, int length,
+                                   int blockSize);
+// nOut x nIn silent filters of up to length samples, without a tail.
+t_convolver *convolver_newvariable(int nIn, int nOut, int length, int blockSize);
+// Replaces the filter from input in to output out of a variable convolver with length samples of
+// h, from the next block on. Without crossfade the new filter is used at once, as for a source
+// that has been silent.
+void convolver_setfilter(t_convolver *c, int out, int in, const float *h, int length,
+                         int crossfade);
+void convolver_free(t_convolver *c);
+void convolver_process(t_convolver *c, const float *const *ins, float *const *outs);
+
+#endif
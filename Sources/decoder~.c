@@ -1,27 +1,99 @@
 #include <string.h>
-#include <pthread.h>
 
 #include <m_pd.h>
 #include <g_canvas.h>
 #include <s_stuff.h>
 
 #include <ambi_dec.h>
+#include <saf.h>
+#include <saf_externals.h>
 #include "utilities.h"
+#include "governor.h"
+#include "silence.h"
+#include "designer.h"
+#include "delayline.h"
 
 static t_class *decoder_tilde_class;
 
+// ─────────────────────────────────────
+// Coefficients below threshold * max(|D|) are treated as structural zeros, and the CSR kernel is
+// used when the remaining density is below the density limit. Above ~1/3 the indexing overhead of
+// CSR is no longer paid back and SGEMM wins.
+#define DECODER_SPARSE_THRESHOLD 1e-3f
+#define DECODER_SPARSE_DENSITY 0.35f
+
+typedef enum {
+    DECODER_KERNEL_STFT = 0,
+    DECODER_KERNEL_DENSE,
+    DECODER_KERNEL_SPARSE,
+} DECODER_KERNEL;
+
+// ─────────────────────────────────────
+typedef struct _decoder_matrix {
+    int kernel;
+    int nSH;
+    int nOut;
+    int nnz;
+    float density;
+
+    float *dense;  // nOut x nSH
+    int *rowPtr;   // nOut + 1
+    int *colIdx;   // nnz
+    float *values; // nnz
+} t_decoder_matrix;
+
+// ─────────────────────────────────────
+// Everything ambi_dec decodes with. The object keeps the settings in its own ambi_dec handle, which
+// is never initialised, and every design builds its decoder from this copy.
+typedef struct _decoder_tilde_design {
+    int fs;
+    int nIn;
+    int nOut;
+    int nLS;
+    int masterOrder;
+    int order; // decoding order of every band, -1 when the bands differ
+    int binaural;
+    int method[2];
+    int maxRE[2];
+    int diffEQ[2];
+    float transitionFreq;
+    int normType;
+    int chOrder;
+    float lsDirs[2 * MAX_NUM_LOUDSPEAKERS];
+    int useDefaultHRIRs;
+    int preProc;
+    char sofaPath[MAXPDSTRING];
+    float sparseThreshold;
+    float sparseDensity;
+} t_decoder_tilde_design;
+
+// ─────────────────────────────────────
+// A design decodes either with the STFT codec of ambi_dec or, when every band uses the same
+// decoder, with one broadband matrix per order. The choice is made once per design.
+typedef struct _decoder_state {
+    int nIn;
+    int nOut;
+    int order; // the governor steps down from here
+    int nFrameSize;
+    void *codec;                 // STFT decoder, NULL with the matrices
+    t_decoder_matrix **matrices; // orders 1 to order
+    float *frame;                // nOut x nFrameSize
+    float *fadeFrame;            // nOut x nFrameSize
+} t_decoder_state;
+
 // ─────────────────────────────────────
 typedef struct _decoder_tilde {
     t_object obj;
     t_canvas *glist;
     t_sample sample;
 
-    void *hAmbi;
+    void *hAmbi; // settings only, never initialised
 
     t_sample **aIns;
     t_sample **aOuts;
     t_sample **aInsTmp;
     t_sample **aOutsTmp;
+    t_sample **aOutsNext;
 
     char sofa_file[MAXPDSTRING];
     int use_sofa;
@@ -40,6 +112,27 @@ typedef struct _decoder_tilde {
 
     int multichannel;
     int binaural;
+    int configured; // loudspeaker layout and master order set for the current outputs
+
+    float *delayLine; // nIn x delaySize, the input delayed by the STFT latency
+    float *delayed;   // nIn x nAmbiFrameSize
+    int delaySize;
+    int delayPos;
+
+    t_decoder_state *state;     // decodes the frames
+    t_decoder_state *stateNext; // runs next to state until its delay is flushed, then crossfades
+    t_decoder_state *stateOld;  // replaced, freed by stateClock
+    int priming;                // frames stateNext still runs before the crossfade
+    t_decoder_tilde_design design;
+    t_saf_designer designer;
+    t_clock *stateClock;
+    int decOrder; // order after the governor level
+    int decOrderPrevious;
+    float sparseThreshold;
+    float sparseDensity;
+
+    t_saf_load load;
+    t_saf_idle idle;
 } t_decoder_tilde;
 
 // ─────────────────────────────────────
@@ -55,6 +148,8 @@ static void decoder_tilde_malloc(t_decoder_tilde *x) {
         }
         freebytes(x->aIns, x->nPreviousIn * sizeof(t_sample *));
         freebytes(x->aInsTmp, x->nPreviousIn * sizeof(t_sample *));
+        freebytes(x->delayLine, x->nPreviousIn * x->delaySize * sizeof(float));
+        freebytes(x->delayed, x->nPreviousIn * x->nAmbiFrameSize * sizeof(float));
         x->aIns = NULL;
         x->aInsTmp = NULL;
     }
@@ -66,11 +161,16 @@ static void decoder_tilde_malloc(t_decoder_tilde *x) {
             if (x->aOutsTmp[i]) {
                 freebytes(x->aOutsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
             }
+            if (x->aOutsNext[i]) {
+                freebytes(x->aOutsNext[i], x->nAmbiFrameSize * sizeof(t_sample));
+            }
         }
         freebytes(x->aOuts, x->nPreviousOut * sizeof(t_sample *));
         freebytes(x->aOutsTmp, x->nPreviousOut * sizeof(t_sample *));
+        freebytes(x->aOutsNext, x->nPreviousOut * sizeof(t_sample *));
         x->aOuts = NULL;
         x->aOutsTmp = NULL;
+        x->aOutsNext = NULL;
     }
 
     // now allocate with the CURRENT x->nIn / x->nOut
@@ -78,6 +178,7 @@ static void decoder_tilde_malloc(t_decoder_tilde *x) {
     x->aInsTmp = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
     x->aOuts = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
     x->aOutsTmp = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
+    x->aOutsNext = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
 
     for (int i = 0; i < x->nIn; i++) {
         x->aIns[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
@@ -86,7 +187,15 @@ static void decoder_tilde_malloc(t_decoder_tilde *x) {
     for (int i = 0; i < x->nOut; i++) {
         x->aOuts[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
         x->aOutsTmp[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
+        x->aOutsNext[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
+    }
+    x->delaySize = 1;
+    while (x->delaySize < ambi_dec_getProcessingDelay() + x->nAmbiFrameSize) {
+        x->delaySize <<= 1;
     }
+    x->delayLine = (float *)getbytes(x->nIn * x->delaySize * sizeof(float));
+    x->delayed = (float *)getbytes(x->nIn * x->nAmbiFrameSize * sizeof(float));
+    x->delayPos = 0;
     x->nPreviousIn = x->nIn;
     x->nPreviousOut = x->nOut;
 }
@@ -123,28 +232,539 @@ static void decoder_tilde_configure_default_speakers(t_decoder_tilde *x) {
 }
 
 // ─────────────────────────────────────
-void *decoder_tilde_initcodec(void *x_void) {
-    t_decoder_tilde *x = (t_decoder_tilde *)x_void;
-    ambi_dec_initCodec(x->hAmbi);
-    const char *text = "[saf.decoder~] Decoder codec initialized!";
-    char *d = strdup(text);
-    pd_queue_mess(&pd_maininstance, &x->obj.te_g.g_pd, (void *)d, init_logcallback);
-    return NULL;
+static void decoder_tilde_freematrix(t_decoder_matrix *m) {
+    if (!m) {
+        return;
+    }
+    if (m->dense) {
+        freebytes(m->dense, m->nOut * m->nSH * sizeof(float));
+    }
+    if (m->rowPtr) {
+        freebytes(m->rowPtr, (m->nOut + 1) * sizeof(int));
+    }
+    if (m->colIdx) {
+        freebytes(m->colIdx, (m->nnz > 0 ? m->nnz : 1) * sizeof(int));
+    }
+    if (m->values) {
+        freebytes(m->values, (m->nnz > 0 ? m->nnz : 1) * sizeof(float));
+    }
+    freebytes(m, sizeof(t_decoder_matrix));
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_freestate(t_decoder_state *st) {
+    if (!st) {
+        return;
+    }
+    if (st->codec) {
+        ambi_dec_destroy(&st->codec);
+    }
+    if (st->matrices) {
+        for (int n = 0; n < st->order; n++) {
+            decoder_tilde_freematrix(st->matrices[n]);
+        }
+        freebytes(st->matrices, st->order * sizeof(t_decoder_matrix *));
+        freebytes(st->frame, st->nOut * st->nFrameSize * sizeof(float));
+        freebytes(st->fadeFrame, st->nOut * st->nFrameSize * sizeof(float));
+    }
+    freebytes(st, sizeof(t_decoder_state));
+}
+
+// ─────────────────────────────────────
+static LOUDSPEAKER_AMBI_DECODER_METHODS decoder_tilde_getmethod(int id) {
+    switch (id) {
+    case DECODING_METHOD_SAD:
+        return LOUDSPEAKER_DECODER_SAD;
+    case DECODING_METHOD_MMD:
+        return LOUDSPEAKER_DECODER_MMD;
+    case DECODING_METHOD_EPAD:
+        return LOUDSPEAKER_DECODER_EPAD;
+    case DECODING_METHOD_ALLRAD:
+    default:
+        return LOUDSPEAKER_DECODER_ALLRAD;
+    }
+}
+
+// ─────────────────────────────────────
+// Thresholds the dense nOut x nSH matrix of m and keeps it as CSR when it is sparse enough.
+static void decoder_tilde_sparsify(t_decoder_matrix *m, float threshold, float densityLimit) {
+    float maxAbs = 0.f;
+    for (int i = 0; i < m->nOut * m->nSH; i++) {
+        maxAbs = fabsf(m->dense[i]) > maxAbs ? fabsf(m->dense[i]) : maxAbs;
+    }
+    threshold *= maxAbs;
+    for (int i = 0; i < m->nOut * m->nSH; i++) {
+        if (fabsf(m->dense[i]) <= threshold) {
+            m->dense[i] = 0.f;
+        } else {
+            m->nnz++;
+        }
+    }
+    m->density = (float)m->nnz / (float)(m->nOut * m->nSH);
+    if (m->density >= densityLimit) {
+        m->kernel = DECODER_KERNEL_DENSE;
+        return;
+    }
+    int nnz = m->nnz > 0 ? m->nnz : 1;
+    m->rowPtr = (int *)getbytes((m->nOut + 1) * sizeof(int));
+    m->colIdx = (int *)getbytes(nnz * sizeof(int));
+    m->values = (float *)getbytes(nnz * sizeof(float));
+    int k = 0;
+    for (int i = 0; i < m->nOut; i++) {
+        m->rowPtr[i] = k;
+        for (int j = 0; j < m->nSH; j++) {
+            float v = m->dense[i * m->nSH + j];
+            if (v != 0.f) {
+                m->colIdx[k] = j;
+                m->values[k] = v;
+                k++;
+            }
+        }
+    }
+    m->rowPtr[m->nOut] = k;
+    freebytes(m->dense, m->nOut * m->nSH * sizeof(float));
+    m->dense = NULL;
+    m->kernel = DECODER_KERNEL_SPARSE;
+}
+
+// ─────────────────────────────────────
+// The decoder of order n as ambi_dec builds it: the order-n loudspeaker decoder, the max-rE
+// weights of order n, and the diffuse-field EQ that keeps the mean amplitude (or energy) sum of a
+// plane wave from every loudspeaker direction at 1, so that the orders stay equally loud.
+static t_decoder_matrix *decoder_tilde_ordermatrix(const t_decoder_tilde_design *d, int n,
+                                                   float *lsDirs) {
+    int nSH = (n + 1) * (n + 1);
+    int nLS = d->nLS;
+    float *D = (float *)getbytes(nLS * nSH * sizeof(float));
+    getLoudspeakerDecoderMtx(lsDirs, nLS, decoder_tilde_getmethod(d->method[0]), n, 0, D);
+    if (d->maxRE[0]) {
+        float *a = (float *)getbytes(nSH * nSH * sizeof(float));
+        getMaxREweights(n, 1, a);
+        for (int i = 0; i < nLS; i++) {
+            for (int j = 0; j < nSH; j++) {
+                D[i * nSH + j] *= a[j * nSH + j];
+            }
+        }
+        freebytes(a, nSH * nSH * sizeof(float));
+    }
+
+    float *Y = (float *)getbytes(nSH * nLS * sizeof(float));
+    getRSH(n, lsDirs, nLS, Y);
+    float sum = 0.f;
+    for (int w = 0; w < nLS; w++) {
+        for (int i = 0; i < nLS; i++) {
+            float g = 0.f;
+            for (int j = 0; j < nSH; j++) {
+                g += D[i * nSH + j] * Y[j * nLS + w];
+            }
+            sum += d->diffEQ[0] == ENERGY_PRESERVING ? g * g : g;
+        }
+    }
+    freebytes(Y, nSH * nLS * sizeof(float));
+    sum /= (float)nLS;
+    float norm = d->diffEQ[0] == ENERGY_PRESERVING ? 1.f / sqrtf(sum + 2.23e-6f)
+                                                   : 1.f / (sum + 2.23e-6f);
+
+    t_decoder_matrix *m = (t_decoder_matrix *)getbytes(sizeof(t_decoder_matrix));
+    m->nSH = nSH;
+    m->nOut = nLS;
+    m->dense = (float *)getbytes(nLS * nSH * sizeof(float));
+    for (int i = 0; i < nLS; i++) {
+        for (int j = 0; j < nSH; j++) {
+            float v = norm * D[i * nSH + j];
+            if (d->normType == NORM_SN3D) {
+                // saf_hoa returns N3D decoders, fold the SN3D -> N3D input scaling into the columns
+                v *= sqrtf(2.f * floorf(sqrtf((float)j)) + 1.f);
+            }
+            m->dense[i * nSH + j] = v;
+        }
+    }
+    freebytes(D, nLS * nSH * sizeof(float));
+    decoder_tilde_sparsify(m, d->sparseThreshold, d->sparseDensity);
+    return m;
+}
+
+// ─────────────────────────────────────
+static int decoder_tilde_broadband(const t_decoder_tilde_design *d) {
+    // ambi_dec decodes in the STFT domain with one decoder below and one above the transition
+    // frequency, each band at its own order. When both decoders are the same and every band
+    // uses the same order, every band uses the same real matrix, so the decode is a broadband
+    // nOut x nSH product that can run directly on the time-domain frame. Binaural output, FuMa
+    // inputs, mismatched decoders or mixed orders keep the STFT path.
+    if (d->binaural || d->order < 1) {
+        return 0;
+    }
+    if (d->method[0] != d->method[1] || d->maxRE[0] != d->maxRE[1] ||
+        d->diffEQ[0] != d->diffEQ[1]) {
+        return 0;
+    }
+    if (d->chOrder != CH_ACN || d->normType == NORM_FUMA) {
+        return 0;
+    }
+    int nSH = (d->order + 1) * (d->order + 1);
+    return nSH <= d->nIn && d->nLS == d->nOut && d->nLS >= 1;
+}
+
+// ─────────────────────────────────────
+// Applies the design to a new ambi_dec handle, the bands all decode at d->order.
+static void decoder_tilde_configure(void *h, const t_decoder_tilde_design *d) {
+    ambi_dec_setMasterDecOrder(h, d->masterOrder);
+    ambi_dec_setNumLoudspeakers(h, d->nLS);
+    for (int i = 0; i < d->nLS; i++) {
+        ambi_dec_setLoudspeakerAzi_deg(h, i, d->lsDirs[2 * i]);
+        ambi_dec_setLoudspeakerElev_deg(h, i, d->lsDirs[2 * i + 1]);
+    }
+    ambi_dec_setBinauraliseLSflag(h, d->binaural);
+    for (int b = 0; b < 2; b++) {
+        ambi_dec_setDecMethod(h, b, d->method[b]);
+        ambi_dec_setDecEnableMaxrE(h, b, d->maxRE[b]);
+        ambi_dec_setDecNormType(h, b, d->diffEQ[b]);
+    }
+    ambi_dec_setTransitionFreq(h, d->transitionFreq);
+    ambi_dec_setNormType(h, d->normType);
+    ambi_dec_setChOrder(h, d->chOrder);
+    if (d->binaural) {
+        if (!d->useDefaultHRIRs) {
+            ambi_dec_setSofaFilePath(h, d->sofaPath);
+        }
+        ambi_dec_setUseDefaultHRIRsflag(h, d->useDefaultHRIRs);
+        ambi_dec_setEnableHRIRsPreProc(h, d->preProc);
+    }
+    ambi_dec_setDecOrderAllBands(h, d->order > 0 ? d->order : d->masterOrder);
+}
+
+// ─────────────────────────────────────
+static void *decoder_tilde_build(const void *args) {
+    const t_decoder_tilde_design *d = (const t_decoder_tilde_design *)args;
+    t_decoder_state *st = (t_decoder_state *)getbytes(sizeof(t_decoder_state));
+    st->nIn = d->nIn;
+    st->nOut = d->nOut;
+    st->nFrameSize = ambi_dec_getFrameSize();
+    if (decoder_tilde_broadband(d)) {
+        float lsDirs[2 * MAX_NUM_LOUDSPEAKERS];
+        memcpy(lsDirs, d->lsDirs, 2 * d->nLS * sizeof(float));
+        st->order = d->order;
+        st->matrices = (t_decoder_matrix **)getbytes(st->order * sizeof(t_decoder_matrix *));
+        for (int n = 1; n <= st->order; n++) {
+            st->matrices[n - 1] = decoder_tilde_ordermatrix(d, n, lsDirs);
+        }
+        st->frame = (float *)getbytes(st->nOut * st->nFrameSize * sizeof(float));
+        st->fadeFrame = (float *)getbytes(st->nOut * st->nFrameSize * sizeof(float));
+        return st;
+    }
+
+    st->order = d->order > 0 ? d->order : d->masterOrder;
+    ambi_dec_create(&st->codec);
+    ambi_dec_init(st->codec, d->fs);
+    decoder_tilde_configure(st->codec, d);
+    ambi_dec_initCodec(st->codec);
+    if (ambi_dec_getCodecStatus(st->codec) != CODEC_STATUS_INITIALISED) {
+        decoder_tilde_freestate(st);
+        return NULL;
+    }
+    return st;
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_discard(void *result) {
+    decoder_tilde_freestate((t_decoder_state *)result);
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_kernellog(t_decoder_tilde *x, t_decoder_state *st, int level) {
+    if (st->matrices) {
+        t_decoder_matrix *m = st->matrices[st->order - 1];
+        logpost(x, level, "[saf.decoder~] kernel: %s | density %.1f%% | nnz %d of %d",
+                m->kernel == DECODER_KERNEL_SPARSE ? "sparse (CSR)" : "dense (SGEMM)",
+                m->density * 100.f, m->nnz, m->nSH * m->nOut);
+    } else {
+        logpost(x, level, "[saf.decoder~] kernel: stft");
+    }
+}
+
+// ─────────────────────────────────────
+static int decoder_tilde_levelorder(t_decoder_state *st, int level) {
+    int order = st->order - level;
+    return order < 1 ? 1 : order;
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_install(t_pd *obj, const void *args, void *result) {
+    t_decoder_tilde *x = (t_decoder_tilde *)obj;
+    (void)args;
+    t_decoder_state *st = (t_decoder_state *)result;
+    if (!st) {
+        // the old decoder keeps playing
+        pd_error(x, "[saf.decoder~] Could not initialise the decoder codec");
+        return;
+    }
+    if (st->codec) {
+        ambi_dec_setDecOrderAllBands(st->codec, decoder_tilde_levelorder(st, x->load.level));
+    }
+    // the old decoder clamps this order to its own until the crossfade
+    x->decOrder = decoder_tilde_levelorder(st, x->load.level);
+    x->decOrderPrevious = x->decOrder;
+    if (!x->state) {
+        x->state = st;
+    } else {
+        // a decoder still priming is dropped, the newer one primes from the start
+        decoder_tilde_freestate(x->stateNext);
+        x->stateNext = st;
+        // the matrices read the delayed input, only the STFT starts empty
+        x->priming = st->codec ? saf_idle_frames(ambi_dec_getProcessingDelay(), st->nFrameSize) : 0;
+    }
+    decoder_tilde_kernellog(x, st, 3);
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_getdesign(t_decoder_tilde *x, t_decoder_tilde_design *d) {
+    void *h = x->hAmbi;
+    memset(d, 0, sizeof(t_decoder_tilde_design));
+    d->fs = (int)x->load.sr;
+    d->nIn = x->nIn;
+    d->nOut = x->nOut;
+    d->nLS = ambi_dec_getNumLoudspeakers(h);
+    d->masterOrder = ambi_dec_getMasterDecOrder(h);
+    d->order = ambi_dec_getDecOrder(h, 0);
+    for (int band = 1; band < ambi_dec_getNumberOfBands(); band++) {
+        if (ambi_dec_getDecOrder(h, band) != d->order) {
+            d->order = -1;
+            break;
+        }
+    }
+    d->binaural = x->binaural || ambi_dec_getBinauraliseLSflag(h);
+    for (int b = 0; b < 2; b++) {
+        d->method[b] = ambi_dec_getDecMethod(h, b);
+        d->maxRE[b] = ambi_dec_getDecEnableMaxrE(h, b);
+        d->diffEQ[b] = ambi_dec_getDecNormType(h, b);
+    }
+    d->transitionFreq = ambi_dec_getTransitionFreq(h);
+    d->normType = ambi_dec_getNormType(h);
+    d->chOrder = ambi_dec_getChOrder(h);
+    for (int i = 0; i < d->nLS; i++) {
+        d->lsDirs[2 * i] = ambi_dec_getLoudspeakerAzi_deg(h, i);
+        d->lsDirs[2 * i + 1] = ambi_dec_getLoudspeakerElev_deg(h, i);
+    }
+    if (d->binaural) {
+        // the HRIRs only matter to the binaural decoder
+        d->useDefaultHRIRs = ambi_dec_getUseDefaultHRIRsflag(h);
+        d->preProc = ambi_dec_getEnableHRIRsPreProc(h);
+        if (!d->useDefaultHRIRs) {
+            pd_snprintf(d->sofaPath, MAXPDSTRING, "%s", ambi_dec_getSofaFilePath(h));
+        }
+    }
+    d->sparseThreshold = x->sparseThreshold;
+    d->sparseDensity = x->sparseDensity;
+    if (decoder_tilde_broadband(d)) {
+        d->transitionFreq = 0; // both bands use the same matrix
+    }
+}
+
+// ─────────────────────────────────────
+// Starts a new design when a setting the decoder depends on has changed, the old decoder keeps
+// playing until the new one is ready.
+static void decoder_tilde_redesign(t_decoder_tilde *x) {
+    if (!x->configured) {
+        return; // designed by the next dsp
+    }
+    t_decoder_tilde_design d;
+    decoder_tilde_getdesign(x, &d);
+    if (memcmp(&d, &x->design, sizeof(d)) == 0) {
+        return;
+    }
+    x->design = d;
+    logpost(x, 2, "[saf.decoder~] Initializing decoder codec...");
+    saf_designer_start(&x->designer, &d, sizeof(d));
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_dropstate(t_decoder_tilde *x) {
+    decoder_tilde_freestate(x->stateOld);
+    x->stateOld = NULL;
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_multiply(const t_decoder_matrix *m, const float *in, float *out, int nS) {
+    // out = D * in[0:nSH, :]
+    if (m->kernel == DECODER_KERNEL_DENSE) {
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, m->nOut, nS, m->nSH, 1.0f,
+                    m->dense, m->nSH, in, nS, 0.0f, out, nS);
+        return;
+    }
+    for (int i = 0; i < m->nOut; i++) {
+        float *row = out + i * nS;
+        memset(row, 0, nS * sizeof(float));
+        for (int k = m->rowPtr[i]; k < m->rowPtr[i + 1]; k++) {
+            const float v = m->values[k];
+            const float *src = in + m->colIdx[k] * nS;
+            for (int n = 0; n < nS; n++) {
+                row[n] += v * src[n];
+            }
+        }
+    }
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_matrixprocess(t_decoder_state *st, const float *in, float *const *outs,
+                                        int order, int orderPrevious) {
+    int nS = st->nFrameSize;
+    order = order > st->order ? st->order : order;
+    orderPrevious = orderPrevious > st->order ? st->order : orderPrevious;
+    decoder_tilde_multiply(st->matrices[order - 1], in, st->frame, nS);
+    if (order != orderPrevious) {
+        // order change requested by [saf.governor]: the decoder of the previous order is
+        // crossfaded to the new one over the frame
+        decoder_tilde_multiply(st->matrices[orderPrevious - 1], in, st->fadeFrame, nS);
+        for (int i = 0; i < st->nOut * nS; i++) {
+            float g = (float)(i % nS + 1) / (float)nS;
+            st->frame[i] = st->fadeFrame[i] + g * (st->frame[i] - st->fadeFrame[i]);
+        }
+    }
+    for (int ch = 0; ch < st->nOut; ch++) {
+        memcpy(outs[ch], st->frame + ch * nS, nS * sizeof(float));
+    }
+}
+
+// ─────────────────────────────────────
+// Delays the input by the STFT latency of ambi_dec into x->delayed, so that the matrices and the
+// STFT decoder output the same frame and can be crossfaded.
+static void decoder_tilde_delayinput(t_decoder_tilde *x, t_sample **ins) {
+    int nS = x->nAmbiFrameSize;
+    int mask = x->delaySize - 1;
+    int first = x->delaySize - x->delayPos < nS ? x->delaySize - x->delayPos : nS;
+    for (int ch = 0; ch < x->nIn; ch++) {
+        float *line = x->delayLine + ch * x->delaySize;
+        memcpy(line + x->delayPos, ins[ch], first * sizeof(float));
+        memcpy(line, ins[ch] + first, (nS - first) * sizeof(float));
+        saf_delay_window(line, mask, 1, NULL, x->delayPos - ambi_dec_getProcessingDelay(), nS,
+                         x->delayed + ch * nS);
+    }
+    x->delayPos = (x->delayPos + nS) & mask;
 }
 
+// ─────────────────────────────────────
+static void decoder_tilde_decode(t_decoder_tilde *x, t_decoder_state *st, t_sample **ins,
+                                 t_sample **outs) {
+    if (st->matrices) {
+        decoder_tilde_matrixprocess(st, x->delayed, (float *const *)outs, x->decOrder,
+                                    x->decOrderPrevious);
+        return;
+    }
+    ambi_dec_process(st->codec, (const float *const *)ins, (float *const *)outs, x->nIn, x->nOut,
+                     x->nAmbiFrameSize);
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_process(t_decoder_tilde *x, t_sample **ins, t_sample **outs) {
+    if (saf_idle_check(&x->idle, ins, x->nIn, x->nAmbiFrameSize)) {
+        saf_idle_zero(outs, x->nOut, x->nAmbiFrameSize);
+        saf_load_frame(&x->load, 1);
+        return;
+    }
+    saf_load_frame(&x->load, 0);
+    decoder_tilde_delayinput(x, ins);
+
+    // the decoders are swapped on the main thread (designer.h), never while a frame is decoded
+    t_decoder_state *st = x->state;
+    if (!st || st->nIn != x->nIn || st->nOut != x->nOut) {
+        saf_idle_zero(outs, x->nOut, x->nAmbiFrameSize);
+        return;
+    }
+    decoder_tilde_decode(x, st, ins, outs);
+    t_decoder_state *next = x->stateNext;
+    if (next && next->nIn == x->nIn && next->nOut == x->nOut) {
+        // the new decoder runs on the same input until its delay is flushed, then takes over
+        // within one frame
+        decoder_tilde_decode(x, next, ins, x->aOutsNext);
+        if (x->priming-- <= 0) {
+            int nS = x->nAmbiFrameSize;
+            for (int ch = 0; ch < x->nOut; ch++) {
+                for (int i = 0; i < nS; i++) {
+                    t_sample g = (t_sample)(i + 1) / (t_sample)nS;
+                    outs[ch][i] += g * (x->aOutsNext[ch][i] - outs[ch][i]);
+                }
+            }
+            decoder_tilde_freestate(x->stateOld); // only if stateClock has not fired yet
+            x->stateOld = st;
+            x->state = next;
+            x->stateNext = NULL;
+            clock_delay(x->stateClock, 0);
+        }
+    }
+    x->decOrderPrevious = x->decOrder;
+    if (st->codec) {
+        saf_load_fade(&x->load, outs, x->nOut, x->nAmbiFrameSize, 1);
+    }
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_applylevel(void *owner, int level) {
+    t_decoder_tilde *x = (t_decoder_tilde *)owner;
+    t_decoder_state *states[2] = {x->state, x->stateNext};
+    for (int i = 0; i < 2; i++) {
+        if (states[i] && states[i]->codec) {
+            ambi_dec_setDecOrderAllBands(states[i]->codec,
+                                         decoder_tilde_levelorder(states[i], level));
+        }
+    }
+    t_decoder_state *st = x->stateNext ? x->stateNext : x->state;
+    x->decOrder = st ? decoder_tilde_levelorder(st, level) : 1;
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_loadreport(t_decoder_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_stats(t_decoder_tilde *x) {
+    saf_load_stats(&x->load);
+    if (saf_designer_busy(&x->designer)) {
+        logpost(x, 2, "[saf.decoder~] new decoder on the way");
+    }
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_idle(t_decoder_tilde *x, t_floatarg f) {
+    // skip decoding once the input is silent and the STFT delay has been flushed
+    x->idle.enable = f != 0;
+}
+
+// ─────────────────────────────────────
+static void decoder_tilde_degrade(t_decoder_tilde *x, t_floatarg f) {
+    // [saf.governor] steps the decoding order down by `level` (never below 1st order). The
+    // broadband matrices crossfade to the lower order, the STFT decoder fades out and in.
+    int level = (int)f;
+    level = level < 0 ? 0 : level > x->load.maxLevel ? x->load.maxLevel : level;
+    if (x->state && x->state->matrices) {
+        x->load.level = level;
+        decoder_tilde_applylevel(x, level);
+    } else {
+        saf_load_request(&x->load, level);
+    }
+}
+
+
 // ╭─────────────────────────────────────╮
 // │               Methods               │
 // ╰─────────────────────────────────────╯
 static void decoder_tilde_get(t_decoder_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    pd_assert(x, argc >= 1, "[saf.decoder~] Expected 'get <method>'");
     const char *method = atom_getsymbol(argv)->s_name;
     if (strcmp(method, "speakers") == 0) {
         int speakers_size = ambi_dec_getNumLoudspeakers(x->hAmbi);
         logpost(x, 2, "[saf.decoder~] There are %d speakers in the array", speakers_size);
         for (int i = 0; i < speakers_size; i++) {
             int azi = ambi_dec_getLoudspeakerAzi_deg(x->hAmbi, i);
-            int ele = ambi_dec_getLoudspeakerAzi_deg(x->hAmbi, i);
+            int ele = ambi_dec_getLoudspeakerElev_deg(x->hAmbi, i);
             logpost(x, 2, "  index: %02d | azi %+04d | ele %+04d", i + 1, azi, ele);
         }
+    } else if (strcmp(method, "kernel") == 0) {
+        // Reports which kernel is decoding: the STFT decoder of ambi_dec, or the broadband
+        // decoding matrix as dense SGEMM or CSR sparse product.
+        if (x->state) {
+            decoder_tilde_kernellog(x, x->state, 2);
+        }
     }
 }
 
@@ -175,6 +795,7 @@ static void decoder_tilde_set(t_decoder_tilde *x, t_symbol *s, int argc, t_atom
         ambi_dec_setUseDefaultHRIRsflag(x->hAmbi, state);
     } else if (strcmp(method, "binaural") == 0) {
         x->binaural = atom_getfloat(argv);
+        x->configured = 0;
         if (x->binaural) {
             x->nOut = 2;
             ambi_dec_setBinauraliseLSflag(x->hAmbi, 1);
@@ -265,10 +886,26 @@ static void decoder_tilde_set(t_decoder_tilde *x, t_symbol *s, int argc, t_atom
         // frequencies.
         float freq = atom_getfloat(argv + 1);
         ambi_dec_setTransitionFreq(x->hAmbi, freq);
+    } else if (strcmp(method, "sparsethreshold") == 0) {
+        // The `sparsethreshold` method sets, relative to the largest coefficient, below which
+        // value a decoding matrix coefficient is considered zero when choosing the kernel.
+        float threshold = atom_getfloat(argv);
+        pd_assert(x, threshold >= 0 && threshold < 1,
+                  "[saf.decoder~] sparsethreshold must be between 0 and 1");
+        x->sparseThreshold = threshold;
+    } else if (strcmp(method, "sparsedensity") == 0) {
+        // The `sparsedensity` method sets the matrix density below which the CSR kernel is used
+        // instead of SGEMM. 0 always uses SGEMM, 1 always uses CSR.
+        float density = atom_getfloat(argv);
+        pd_assert(x, density >= 0 && density <= 1,
+                  "[saf.decoder~] sparsedensity must be between 0 and 1");
+        x->sparseDensity = density;
     }
-    if (ambi_dec_getCodecStatus(x->hAmbi) == CODEC_STATUS_NOT_INITIALISED) {
+    if (!x->configured) {
         canvas_update_dsp();
+        return;
     }
+    decoder_tilde_redesign(x);
 }
 
 // ╭─────────────────────────────────────╮
@@ -279,6 +916,7 @@ t_int *decoder_tilde_performmultichannel(t_int *w) {
     int n = (int)(w[2]);
     t_sample *ins = (t_sample *)(w[3]);
     t_sample *outs = (t_sample *)(w[4]);
+    saf_load_begin(&x->load);
 
     if (n < x->nAmbiFrameSize) {
         for (int ch = 0; ch < x->nIn; ch++) {
@@ -287,8 +925,7 @@ t_int *decoder_tilde_performmultichannel(t_int *w) {
         x->nInAccIndex += n;
 
         if (x->nInAccIndex == x->nAmbiFrameSize) {
-            ambi_dec_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                             x->nIn, x->nOut, x->nAmbiFrameSize);
+            decoder_tilde_process(x, x->aIns, x->aOuts);
             x->nInAccIndex = 0;
             x->nOutAccIndex = 0;
         }
@@ -312,8 +949,7 @@ t_int *decoder_tilde_performmultichannel(t_int *w) {
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
             // Processa o bloco atual
-            ambi_dec_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                             (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
+            decoder_tilde_process(x, x->aInsTmp, x->aOutsTmp);
 
             t_sample *out = (t_sample *)(w[4]);
             for (int ch = 0; ch < x->nOut; ch++) {
@@ -323,6 +959,7 @@ t_int *decoder_tilde_performmultichannel(t_int *w) {
         }
     }
 
+    saf_load_end(&x->load, n);
     return (w + 5);
 }
 
@@ -330,6 +967,7 @@ t_int *decoder_tilde_performmultichannel(t_int *w) {
 t_int *decoder_tilde_perform(t_int *w) {
     t_decoder_tilde *x = (t_decoder_tilde *)(w[1]);
     int n = (int)(w[2]);
+    saf_load_begin(&x->load);
 
     if (n < x->nAmbiFrameSize) {
         for (int ch = 0; ch < x->nIn; ch++) {
@@ -337,8 +975,7 @@ t_int *decoder_tilde_perform(t_int *w) {
         }
         x->nInAccIndex += n;
         if (x->nInAccIndex == x->nAmbiFrameSize) {
-            ambi_dec_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                             x->nIn, x->nOut, x->nAmbiFrameSize);
+            decoder_tilde_process(x, x->aIns, x->aOuts);
             x->nInAccIndex = 0;
             x->nOutAccIndex = 0;
         }
@@ -354,8 +991,7 @@ t_int *decoder_tilde_perform(t_int *w) {
                 memcpy(x->aInsTmp[ch], (t_sample *)w[3 + ch] + (chunkIndex * x->nAmbiFrameSize),
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
-            ambi_dec_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                             (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
+            decoder_tilde_process(x, x->aInsTmp, x->aOutsTmp);
             for (int ch = 0; ch < x->nOut; ch++) {
                 t_sample *out = (t_sample *)(w[3 + x->nIn + ch]);
                 memcpy(out + (chunkIndex * x->nAmbiFrameSize), x->aOutsTmp[ch],
@@ -364,6 +1000,7 @@ t_int *decoder_tilde_perform(t_int *w) {
         }
     }
 
+    saf_load_end(&x->load, n);
     return (w + 3 + x->nIn + x->nOut);
 }
 
@@ -383,6 +1020,9 @@ void decoder_tilde_dsp(t_decoder_tilde *x, t_signal **sp) {
     }
     x->nAmbiFrameSize = ambi_dec_getFrameSize();
     x->nPdFrameSize = sp[0]->s_n;
+    saf_idle_settail(&x->idle,
+                     saf_idle_frames(ambi_dec_getProcessingDelay(), x->nAmbiFrameSize) + 1);
+    x->load.sr = sp[0]->s_sr;
     x->nOutAccIndex = 0;
     x->nInAccIndex = 0;
     x->nIn = x->multichannel ? sp[0]->s_nchans : x->nIn;
@@ -396,7 +1036,7 @@ void decoder_tilde_dsp(t_decoder_tilde *x, t_signal **sp) {
     }
 
     int nOrder = get_ambisonic_order(x->nOut);
-    if (ambi_dec_getCodecStatus(x->hAmbi) == CODEC_STATUS_NOT_INITIALISED) {
+    if (!x->configured) {
         ambi_dec_setNormType(x->hAmbi, NORM_N3D);
         if (x->nOrder < 1 || x->binaural) {
             ambi_dec_setMasterDecOrder(x->hAmbi, 1);
@@ -418,21 +1058,25 @@ void decoder_tilde_dsp(t_decoder_tilde *x, t_signal **sp) {
 
         // decoder_tilde_configure_default_speakers(x);
 
-        ambi_dec_setDecMethod(x->hAmbi, DECODING_METHOD_SAD, 0);
-        ambi_dec_setDecMethod(x->hAmbi, DECODING_METHOD_SAD, 1);
+        ambi_dec_setDecMethod(x->hAmbi, 0, DECODING_METHOD_SAD);
+        ambi_dec_setDecMethod(x->hAmbi, 1, DECODING_METHOD_SAD);
 
-        logpost(x, 2, "[saf.decoder~] Initializing decoder codec...");
-        pthread_t initThread;
-        pthread_create(&initThread, NULL, decoder_tilde_initcodec, (void *)x);
-        pthread_detach(initThread);
+        int master = ambi_dec_getMasterDecOrder(x->hAmbi);
+        ambi_dec_setDecOrderAllBands(x->hAmbi, master);
+        saf_load_setmaxlevel(&x->load, master - 1);
+        x->decOrder = master;
+        x->decOrderPrevious = master;
+        x->load.level = 0;
+        x->configured = 1;
     }
 
-    if (x->nPreviousIn != x->nIn || x->nPreviousOut != x->nOut) {
+    if (x->nPreviousIn != x->nIn || x->nPreviousOut != x->nOut || !x->aIns) {
         decoder_tilde_malloc(x);
-        x->nPreviousIn = x->nIn;
-        x->nPreviousOut = x->nOut;
     }
 
+    // the decoder is designed for one layout, channel count and sample rate
+    decoder_tilde_redesign(x);
+
     // Initialize memory allocation for inputs and outputs
     if (x->multichannel) {
         if (x->binaural) {
@@ -494,7 +1138,6 @@ void *decoder_tilde_new(t_symbol *s, int argc, t_atom *argv) {
     x->nFlagSpeakers = x->nOut;
     ambi_dec_create(&x->hAmbi);
     ambi_dec_setNumLoudspeakers(x->hAmbi, x->nOut);
-    ambi_dec_init(x->hAmbi, sys_getsr());
 
     if (x->nOrder < 1) {
         x->nOut = 2;
@@ -515,13 +1158,37 @@ void *decoder_tilde_new(t_symbol *s, int argc, t_atom *argv) {
 
     x->aIns = NULL;
     x->aOuts = NULL;
+    x->aOutsNext = NULL;
+    x->delayLine = NULL;
+    x->configured = 0;
+
+    x->state = NULL;
+    x->stateNext = NULL;
+    x->stateOld = NULL;
+    memset(&x->design, 0, sizeof(x->design));
+    x->sparseThreshold = DECODER_SPARSE_THRESHOLD;
+    x->sparseDensity = DECODER_SPARSE_DENSITY;
+    saf_designer_init(&x->designer, &x->obj.ob_pd, decoder_tilde_build, decoder_tilde_install,
+                      decoder_tilde_discard);
+    x->stateClock = clock_new(x, (t_method)decoder_tilde_dropstate);
+
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.decoder~", 0, decoder_tilde_applylevel);
+    saf_idle_init(&x->idle, 0);
+    x->decOrder = 1;
+    x->decOrderPrevious = 1;
 
     return (void *)x;
 }
 
 // ─────────────────────────────────────
 void decoder_tilde_free(t_decoder_tilde *x) {
+    saf_designer_free(&x->designer);
+    clock_free(x->stateClock);
+    decoder_tilde_freestate(x->state);
+    decoder_tilde_freestate(x->stateNext);
+    decoder_tilde_freestate(x->stateOld);
     ambi_dec_destroy(&x->hAmbi);
+    saf_load_free(&x->load);
     for (int i = 0; i < x->nIn; i++) {
         if (x->aIns) {
             freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
@@ -551,6 +1218,16 @@ void decoder_tilde_free(t_decoder_tilde *x) {
     if (x->aOutsTmp) {
         freebytes(x->aOutsTmp, x->nOut * sizeof(t_sample *));
     }
+    if (x->aOutsNext) {
+        for (int i = 0; i < x->nOut; i++) {
+            freebytes(x->aOutsNext[i], x->nAmbiFrameSize * sizeof(t_sample));
+        }
+        freebytes(x->aOutsNext, x->nOut * sizeof(t_sample *));
+    }
+    if (x->delayLine) {
+        freebytes(x->delayLine, x->nIn * x->delaySize * sizeof(float));
+        freebytes(x->delayed, x->nIn * x->nAmbiFrameSize * sizeof(float));
+    }
 }
 
 // ─────────────────────────────────────
@@ -565,7 +1242,6 @@ void setup_saf0x2edecoder_tilde(void) {
 
     class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("sofafile"), A_GIMME, 0);
     class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("binaural"), A_GIMME, 0);
-    class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("decoder_order"), A_GIMME, 0);
     class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("speaker"), A_GIMME, 0);
     class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("hrirpreproc"), A_GIMME, 0);
     class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("ch_order"), A_GIMME, 0);
@@ -573,5 +1249,13 @@ void setup_saf0x2edecoder_tilde(void) {
     class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("decmethod"), A_GIMME, 0);
     class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("max-rE"), A_GIMME, 0);
     class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("transitionfreq"), A_GIMME, 0);
+    class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("sparsethreshold"), A_GIMME, 0);
+    class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_set, gensym("sparsedensity"), A_GIMME, 0);
+    class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_get, gensym("get"), A_GIMME, 0);
+    class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_idle, gensym("idle"), A_FLOAT, 0);
+    class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_stats, gensym("stats"), 0);
+
+    class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_loadreport, gensym("saf_loadreport"), 0);
+    class_addmethod(decoder_tilde_class, (t_method)decoder_tilde_degrade, gensym("saf_degrade"), A_FLOAT, 0);
 }
 
@@ -0,0 +1,84 @@
+#ifndef SAF_DELAYLINE_H
+#define SAF_DELAYLINE_H
+
+#include <string.h>
+
+// ─────────────────────────────────────
+// Block reads from a circular delay line with third-order Lagrange interpolation. The samples a
+// frame needs are first copied into a contiguous window (summing interleaved bands with their
+// gains on the way), so the interpolation itself never gathers from the line. A constant delay is
+// a 4-tap FIR over the window, a changing delay recomputes the taps for every sample so that
+// moving images get a smooth Doppler shift instead of steps.
+//
+// The delay ramps linearly from d0 to d1 over the frame and must stay >= 1 sample, the window must
+// hold nS + |d1 - d0| + SAF_DELAY_TAPS + 1 samples.
+#define SAF_DELAY_TAPS 4
+
+// ─────────────────────────────────────
+static inline void saf_delay_lagrange(float f, float *h) {
+    // taps at delays di - 1, di, di + 1, di + 2 for a delay of di + f
+    float fm1 = f - 1.0f;
+    float fm2 = f - 2.0f;
+    float fp1 = f + 1.0f;
+    h[0] = -f * fm1 * fm2 / 6.0f;
+    h[1] = fp1 * fm1 * fm2 / 2.0f;
+    h[2] = -fp1 * f * fm2 / 2.0f;
+    h[3] = fp1 * f * fm1 / 6.0f;
+}
+
+// ─────────────────────────────────────
+// Copies n samples of the line starting at start into w. With stride > 1 the line holds stride
+// interleaved bands per sample, which are summed weighted by g.
+static inline void saf_delay_window(const float *line, int mask, int stride, const float *g,
+                                    int start, int n, float *w) {
+    start &= mask;
+    if (stride == 1) {
+        int first = mask + 1 - start < n ? mask + 1 - start : n;
+        memcpy(w, line + start, first * sizeof(float));
+        memcpy(w + first, line, (n - first) * sizeof(float));
+        return;
+    }
+    for (int j = 0; j < n; j++) {
+        const float *row = line + ((start + j) & mask) * stride;
+        float acc = 0.0f;
+        for (int b = 0; b < stride; b++) {
+            acc += g[b] * row[b];
+        }
+        w[j] = acc;
+    }
+}
+
+// ─────────────────────────────────────
+// Reads nS samples ending at writePos + nS - 1 into out, with the delay going from d0 to d1 and
+// the gain from a0 to a1 over the frame.
+static inline void saf_delay_read(const float *line, int mask, int stride, const float *g,
+                                  int writePos, float d0, float d1, float a0, float a1, int nS,
+                                  float *w, float *out) {
+    float invS = 1.0f / (float)nS;
+    float da = (a1 - a0) * invS;
+    float h[SAF_DELAY_TAPS];
+    if (d0 == d1) {
+        int di = (int)d0;
+        saf_delay_lagrange(d0 - (float)di, h);
+        saf_delay_window(line, mask, stride, g, writePos - di - 2, nS + 3, w);
+        for (int t = 0; t < nS; t++) {
+            float y = h[0] * w[t + 3] + h[1] * w[t + 2] + h[2] * w[t + 1] + h[3] * w[t];
+            out[t] = (a0 + da * (float)(t + 1)) * y;
+        }
+        return;
+    }
+    float dd = (d1 - d0) * invS;
+    int diMax = (int)(d0 > d1 ? d0 : d1);
+    int diMin = (int)(d0 < d1 ? d0 : d1);
+    saf_delay_window(line, mask, stride, g, writePos - diMax - 2, nS + diMax - diMin + 3, w);
+    for (int t = 0; t < nS; t++) {
+        float d = d0 + dd * (float)(t + 1);
+        int di = (int)d;
+        saf_delay_lagrange(d - (float)di, h);
+        const float *x = w + t - di + diMax;
+        float y = h[0] * x[3] + h[1] * x[2] + h[2] * x[1] + h[3] * x[0];
+        out[t] = (a0 + da * (float)(t + 1)) * y;
+    }
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef SAF_DESIGNER_H
+#define SAF_DESIGNER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <m_pd.h>
+
+// ─────────────────────────────────────
+// Objects that build their filters away from Pd (SOFA loading, FIR design, ...) own a
+// t_saf_designer. saf_designer_start copies the arguments of a design and runs build on its own
+// thread. The result comes back to the main thread with pd_queue_mess, where install takes it
+// over, or discard frees it when a newer design was started meanwhile. Pd runs messages and DSP
+// on the same thread, so install swaps the state read by perform without any lock.
+//
+// A design thread only sees its job and a small context shared by reference counting, never the
+// object. saf_designer_free cancels the results still queued and lets running designs finish on
+// their own, their results are then discarded.
+typedef void *(*t_saf_design_build)(const void *args);
+typedef void (*t_saf_design_install)(t_pd *owner, const void *args, void *result);
+typedef void (*t_saf_design_discard)(void *result);
+
+typedef struct _saf_designer_shared {
+    pthread_mutex_t mutex;
+    atomic_int refs;
+    int cancelled;
+    t_saf_design_build build;
+    t_saf_design_install install;
+    t_saf_design_discard discard;
+} t_saf_designer_shared;
+
+typedef struct _saf_designer {
+    t_pd *owner;
+    t_saf_designer_shared *shared;
+    int request; // latest design, main thread only
+    int pending; // designs whose result has not come back yet
+} t_saf_designer;
+
+typedef struct _saf_design_job {
+    t_saf_designer_shared *shared;
+    t_saf_designer *designer; // only dereferenced on the main thread
+    t_pd *owner;
+    int request;
+    void *args;
+    size_t argsSize;
+    void *result;
+} t_saf_design_job;
+
+// ─────────────────────────────────────
+static inline void saf_designer_release(t_saf_designer_shared *s) {
+    if (atomic_fetch_sub(&s->refs, 1) == 1) {
+        pthread_mutex_destroy(&s->mutex);
+        freebytes(s, sizeof(t_saf_designer_shared));
+    }
+}
+
+// ─────────────────────────────────────
+static inline void saf_designer_freejob(t_saf_design_job *j) {
+    t_saf_designer_shared *s = j->shared;
+    if (j->result && s->discard) {
+        s->discard(j->result);
+    }
+    freebytes(j->args, j->argsSize);
+    freebytes(j, sizeof(t_saf_design_job));
+    saf_designer_release(s);
+}
+
+// ─────────────────────────────────────
+static inline void saf_designer_deliver(t_pd *obj, void *data) {
+    t_saf_design_job *j = (t_saf_design_job *)data;
+    if (obj) {
+        t_saf_designer *g = j->designer;
+        g->pending--;
+        if (j->request == g->request) {
+            j->shared->install(obj, j->args, j->result);
+            j->result = NULL;
+        }
+    }
+    // stale, or cancelled by saf_designer_free
+    saf_designer_freejob(j);
+}
+
+// ─────────────────────────────────────
+static inline void *saf_designer_thread(void *data) {
+    t_saf_design_job *j = (t_saf_design_job *)data;
+    t_saf_designer_shared *s = j->shared;
+    j->result = s->build(j->args);
+    pthread_mutex_lock(&s->mutex);
+    if (s->cancelled) {
+        pthread_mutex_unlock(&s->mutex);
+        saf_designer_freejob(j);
+        return NULL;
+    }
+    // queued under the mutex, so saf_designer_free cancels it or has not run yet
+    pd_queue_mess(&pd_maininstance, j->owner, j, saf_designer_deliver);
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+
+// ─────────────────────────────────────
+static inline void saf_designer_init(t_saf_designer *g, t_pd *owner, t_saf_design_build build,
+                                     t_saf_design_install install, t_saf_design_discard discard) {
+    t_saf_designer_shared *s = (t_saf_designer_shared *)getbytes(sizeof(t_saf_designer_shared));
+    pthread_mutex_init(&s->mutex, NULL);
+    atomic_init(&s->refs, 1);
+    s->cancelled = 0;
+    s->build = build;
+    s->install = install;
+    s->discard = discard;
+    g->owner = owner;
+    g->shared = s;
+    g->request = 0;
+    g->pending = 0;
+}
+
+// ─────────────────────────────────────
+// Copies argsSize bytes of args, the result of any design started before is dropped.
+static inline void saf_designer_start(t_saf_designer *g, const void *args, size_t argsSize) {
+    t_saf_design_job *j = (t_saf_design_job *)getbytes(sizeof(t_saf_design_job));
+    j->shared = g->shared;
+    j->designer = g;
+    j->owner = g->owner;
+    j->request = ++g->request;
+    j->args = getbytes(argsSize);
+    memcpy(j->args, args, argsSize);
+    j->argsSize = argsSize;
+    j->result = NULL;
+    atomic_fetch_add(&g->shared->refs, 1);
+    g->pending++;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, saf_designer_thread, (void *)j) != 0) {
+        pd_error(g->owner, "[saf] Failed to start the design thread");
+        g->pending--;
+        saf_designer_freejob(j);
+        return;
+    }
+    pthread_detach(thread);
+}
+
+// ─────────────────────────────────────
+static inline int saf_designer_busy(const t_saf_designer *g) {
+    return g->pending > 0;
+}
+
+// ─────────────────────────────────────
+static inline void saf_designer_free(t_saf_designer *g) {
+    t_saf_designer_shared *s = g->shared;
+    pthread_mutex_lock(&s->mutex);
+    s->cancelled = 1;
+    pthread_mutex_unlock(&s->mutex);
+    pd_queue_cancel(g->owner);
+    saf_designer_release(s);
+    g->shared = NULL;
+}
+
+#endif
@@ -4,6 +4,8 @@
 #include <g_canvas.h>
 
 #include "utilities.h"
+#include "governor.h"
+#include "silence.h"
 #include <ambi_enc.h>
 
 static t_class *encoder_tilde_class;
@@ -33,6 +35,9 @@ typedef struct _encoder_tilde {
     int nPreviousOut;
 
     int multichannel;
+
+    t_saf_load load;
+    t_saf_idle idle;
 } t_encoder_tilde;
 
 // ─────────────────────────────────────
@@ -78,6 +83,34 @@ static void encoder_tilde_malloc(t_encoder_tilde *x) {
     x->nPreviousOut = x->nOut;
 }
 
+// ─────────────────────────────────────
+static void encoder_tilde_process(t_encoder_tilde *x, t_sample **ins, t_sample **outs) {
+    if (saf_idle_check(&x->idle, ins, x->nIn, x->nAmbiFrameSize)) {
+        saf_idle_zero(outs, x->nOut, x->nAmbiFrameSize);
+        saf_load_frame(&x->load, 1);
+        return;
+    }
+    saf_load_frame(&x->load, 0);
+    ambi_enc_process(x->hAmbi, (const float *const *)ins, (float *const *)outs, x->nIn, x->nOut,
+                     x->nAmbiFrameSize);
+}
+
+// ─────────────────────────────────────
+static void encoder_tilde_loadreport(t_encoder_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void encoder_tilde_stats(t_encoder_tilde *x) {
+    saf_load_stats(&x->load);
+}
+
+// ─────────────────────────────────────
+static void encoder_tilde_idle(t_encoder_tilde *x, t_floatarg f) {
+    // skip encoding while all sources are silent
+    x->idle.enable = f != 0;
+}
+
 // ─────────────────────────────────────
 static void encoder_tilde_set(t_encoder_tilde *x, t_symbol *s, int argc, t_atom *argv) {
     const char *method = s->s_name;
@@ -128,6 +161,7 @@ t_int *encoder_tilde_performmultichannel(t_int *w) {
     t_sample *ins = (t_sample *)(w[3]);
     t_sample *outs = (t_sample *)(w[4]);
 
+    saf_load_begin(&x->load);
     if (n < x->nAmbiFrameSize) {
         for (int ch = 0; ch < x->nIn; ch++) {
             memcpy(x->aIns[ch] + x->nInAccIndex, ins + (n * ch), n * sizeof(t_sample));
@@ -136,8 +170,7 @@ t_int *encoder_tilde_performmultichannel(t_int *w) {
 
         // Process only if a full frame is ready
         if (x->nInAccIndex == x->nAmbiFrameSize) {
-            ambi_enc_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                             x->nIn, x->nOut, x->nAmbiFrameSize);
+            encoder_tilde_process(x, x->aIns, x->aOuts);
             x->nInAccIndex = 0;
             x->nOutAccIndex = 0; // Reset for the next frame
         }
@@ -162,8 +195,7 @@ t_int *encoder_tilde_performmultichannel(t_int *w) {
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
             // Processa o bloco atual
-            ambi_enc_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                             (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
+            encoder_tilde_process(x, x->aInsTmp, x->aOutsTmp);
 
             t_sample *out = (t_sample *)(w[4]);
             // Copia o resultado para os canais de saída com o offset correto
@@ -173,6 +205,7 @@ t_int *encoder_tilde_performmultichannel(t_int *w) {
             }
         }
     }
+    saf_load_end(&x->load, n);
 
     return (w + 5);
 }
@@ -182,14 +215,14 @@ t_int *encoder_tilde_perform(t_int *w) {
     t_encoder_tilde *x = (t_encoder_tilde *)(w[1]);
     int n = (int)(w[2]);
 
+    saf_load_begin(&x->load);
     if (n < x->nAmbiFrameSize) {
         for (int ch = 0; ch < x->nIn; ch++) {
             memcpy(x->aIns[ch] + x->nInAccIndex, (t_sample *)w[3 + ch], n * sizeof(t_sample));
         }
         x->nInAccIndex += n;
         if (x->nInAccIndex == x->nAmbiFrameSize) {
-            ambi_enc_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                             x->nIn, x->nOut, x->nAmbiFrameSize);
+            encoder_tilde_process(x, x->aIns, x->aOuts);
             x->nInAccIndex = 0;
             x->nOutAccIndex = 0;
         }
@@ -205,8 +238,7 @@ t_int *encoder_tilde_perform(t_int *w) {
                 memcpy(x->aInsTmp[ch], (t_sample *)w[3 + ch] + (chunkIndex * x->nAmbiFrameSize),
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
-            ambi_enc_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                             (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
+            encoder_tilde_process(x, x->aInsTmp, x->aOutsTmp);
             for (int ch = 0; ch < x->nOut; ch++) {
                 t_sample *out = (t_sample *)(w[3 + x->nIn + ch]);
                 memcpy(out + (chunkIndex * x->nAmbiFrameSize), x->aOutsTmp[ch],
@@ -214,6 +246,7 @@ t_int *encoder_tilde_perform(t_int *w) {
             }
         }
     }
+    saf_load_end(&x->load, n);
 
     return (w + 3 + x->nIn + x->nOut);
 }
@@ -229,6 +262,7 @@ void encoder_tilde_dsp(t_encoder_tilde *x, t_signal **sp) {
 
     x->nAmbiFrameSize = ambi_enc_getFrameSize();
     x->nPdFrameSize = sp[0]->s_n;
+    x->load.sr = sp[0]->s_sr;
     x->nOutAccIndex = 0;
     x->nInAccIndex = 0;
 
@@ -309,6 +343,9 @@ void *encoder_tilde_new(t_symbol *s, int argc, t_atom *argv) {
     x->nIn = num_sources;
     x->nOut = (order + 1) * (order + 1);
 
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.encoder~", 0, NULL);
+    saf_idle_init(&x->idle, 1);
+
     if (x->multichannel) {
         outlet_new(&x->obj, &s_signal);
     } else {
@@ -326,6 +363,7 @@ void *encoder_tilde_new(t_symbol *s, int argc, t_atom *argv) {
 // ─────────────────────────────────────
 void encoder_tilde_free(t_encoder_tilde *x) {
     ambi_enc_destroy(&x->hAmbi);
+    saf_load_free(&x->load);
     for (int i = 0; i < x->nIn; i++) {
         if (x->aIns) {
             freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
@@ -376,4 +414,8 @@ void setup_saf0x2eencoder_tilde(void) {
                     0);
     class_addmethod(encoder_tilde_class, (t_method)encoder_tilde_set, gensym("sourcegain"), A_GIMME,
                     0);
+    class_addmethod(encoder_tilde_class, (t_method)encoder_tilde_idle, gensym("idle"), A_FLOAT, 0);
+    class_addmethod(encoder_tilde_class, (t_method)encoder_tilde_stats, gensym("stats"), 0);
+    class_addmethod(encoder_tilde_class, (t_method)encoder_tilde_loadreport,
+                    gensym("saf_loadreport"), 0);
 }
@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include "firfile.h"
+
+#define SAF_WAV_PCM 1
+#define SAF_WAV_FLOAT 3
+#define SAF_WAV_EXTENSIBLE 0xFFFE
+
+// ─────────────────────────────────────
+static unsigned saf_firs_le(const unsigned char *b, int bytes) {
+    unsigned v = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        v = (v << 8) | b[i];
+    }
+    return v;
+}
+
+// ─────────────────────────────────────
+static float saf_firs_sample(const unsigned char *b, int format, int bytes) {
+    if (format == SAF_WAV_FLOAT && bytes == 4) {
+        float v;
+        unsigned u = saf_firs_le(b, 4);
+        memcpy(&v, &u, sizeof(v));
+        return v;
+    }
+    if (format == SAF_WAV_FLOAT) {
+        double v;
+        unsigned long long u = (unsigned long long)saf_firs_le(b + 4, 4) << 32 | saf_firs_le(b, 4);
+        memcpy(&v, &u, sizeof(v));
+        return (float)v;
+    }
+    // signed PCM, shifted up to 32 bits
+    int v = (int)(saf_firs_le(b, bytes) << (32 - 8 * bytes));
+    return (float)v / 2147483648.0f;
+}
+
+// ─────────────────────────────────────
+static int saf_firs_wav(t_saf_firs *f, const char *path, const char **error) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        *error = "Could not open the filter file";
+        return 0;
+    }
+    unsigned char head[12];
+    if (fread(head, 1, 12, fp) != 12 || memcmp(head, "RIFF", 4) || memcmp(head + 8, "WAVE", 4)) {
+        fclose(fp);
+        *error = "Not a WAV file";
+        return 0;
+    }
+
+    int format = 0, nCh = 0, bytes = 0;
+    unsigned char chunk[8];
+    while (fread(chunk, 1, 8, fp) == 8) {
+        unsigned size = saf_firs_le(chunk + 4, 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            unsigned char fmt[40] = {0};
+            unsigned n = size < sizeof(fmt) ? size : sizeof(fmt);
+            if (fread(fmt, 1, n, fp) != n) {
+                break;
+            }
+            format = (int)saf_firs_le(fmt, 2);
+            nCh = (int)saf_firs_le(fmt + 2, 2);
+            f->fs = (int)saf_firs_le(fmt + 4, 4);
+            bytes = (int)saf_firs_le(fmt + 14, 2) / 8;
+            if (format == SAF_WAV_EXTENSIBLE && n >= 26) {
+                format = (int)saf_firs_le(fmt + 24, 2);
+            }
+            fseek(fp, (long)(size - n + (size & 1)), SEEK_CUR);
+            continue;
+        }
+        if (memcmp(chunk, "data", 4) != 0) {
+            fseek(fp, (long)(size + (size & 1)), SEEK_CUR);
+            continue;
+        }
+
+        int pcm = format == SAF_WAV_PCM && bytes >= 2 && bytes <= 4;
+        int flt = format == SAF_WAV_FLOAT && (bytes == 4 || bytes == 8);
+        if (nCh < 1 || (!pcm && !flt)) {
+            fclose(fp);
+            *error = "Unsupported WAV format, use 16, 24 or 32 bit PCM or float";
+            return 0;
+        }
+        int frame = nCh * bytes;
+        size_t rawSize = (size_t)(size / frame) * frame;
+        unsigned char *raw = (unsigned char *)getbytes(rawSize);
+        int len = (int)(fread(raw, 1, rawSize, fp) / frame);
+        fclose(fp);
+        f->nRows = nCh;
+        f->nCols = 1;
+        f->len = len;
+        f->data = (float *)getbytes((size_t)nCh * len * sizeof(float));
+        for (int t = 0; t < len; t++) {
+            for (int ch = 0; ch < nCh; ch++) {
+                f->data[(size_t)ch * len + t] =
+                    saf_firs_sample(raw + (size_t)t * frame + ch * bytes, format, bytes);
+            }
+        }
+        freebytes(raw, rawSize);
+        if (len < 1) {
+            saf_firs_free(f);
+            *error = "The WAV file is empty";
+            return 0;
+        }
+        return 1;
+    }
+    fclose(fp);
+    *error = "No audio data in the WAV file";
+    return 0;
+}
+
+// ─────────────────────────────────────
+static int saf_firs_sofa(t_saf_firs *f, const char *path, const char **error) {
+    saf_sofa_container sofa;
+    if (saf_sofa_open(&sofa, (char *)path, SAF_SOFA_READER_OPTION_DEFAULT) != SAF_SOFA_OK) {
+        *error = "Could not read the SOFA file";
+        return 0;
+    }
+    // measurements x receivers in the file, receivers (outputs) first here
+    f->nRows = sofa.nReceivers;
+    f->nCols = sofa.nSources;
+    f->len = sofa.DataLengthIR;
+    f->fs = (int)sofa.DataSamplingRate;
+    f->data = (float *)getbytes((size_t)f->nRows * f->nCols * f->len * sizeof(float));
+    for (int m = 0; m < f->nCols; m++) {
+        for (int r = 0; r < f->nRows; r++) {
+            memcpy(f->data + ((size_t)r * f->nCols + m) * f->len,
+                   sofa.DataIR + ((size_t)m * f->nRows + r) * f->len, f->len * sizeof(float));
+        }
+    }
+    // a grid of room responses moves the listener, not the source
+    if (sofa.ListenerPosition && sofa.nListeners == f->nCols) {
+        f->positions = (float *)getbytes((size_t)f->nCols * 3 * sizeof(float));
+        memcpy(f->positions, sofa.ListenerPosition, (size_t)f->nCols * 3 * sizeof(float));
+    }
+    saf_sofa_close(&sofa);
+    return 1;
+}
+
+// ─────────────────────────────────────
+int saf_firs_load(t_saf_firs *f, const char *path, const char **error) {
+    f->data = NULL;
+    f->nRows = f->nCols = f->len = 0;
+    f->fs = 0;
+    f->positions = NULL;
+    const char *ext = strrchr(path, '.');
+    char lower[8] = {0};
+    for (int i = 0; ext && i < 7 && ext[i]; i++) {
+        lower[i] = (char)tolower((unsigned char)ext[i]);
+    }
+    if (strcmp(lower, ".sofa") == 0) {
+        return saf_firs_sofa(f, path, error);
+    }
+    return saf_firs_wav(f, path, error);
+}
+
+// ─────────────────────────────────────
+void saf_firs_free(t_saf_firs *f) {
+    if (f->data) {
+        freebytes(f->data, (size_t)f->nRows * f->nCols * f->len * sizeof(float));
+    }
+    if (f->positions) {
+        freebytes(f->positions, (size_t)f->nCols * 3 * sizeof(float));
+    }
+    f->data = NULL;
+    f->positions = NULL;
+}
@@ -0,0 +1,25 @@
+#ifndef SAF_FIRFILE_H
+#define SAF_FIRFILE_H
+
+#include <m_pd.h>
+
+// ─────────────────────────────────────
+// FIR matrix read from a WAV or SOFA file for [saf.matrixconv~], [saf.multiconv~] and
+// [saf.tvconv~], always off the audio thread. A WAV file has one row per channel and a single
+// column, the objects split the samples into several columns as the matrixconv of SAF does. A SOFA
+// file has one row per receiver and one column per measurement.
+typedef struct _saf_firs {
+    float *data; // nRows x nCols x len
+    int nRows;
+    int nCols;
+    int len;
+    int fs;
+    float *positions; // nCols x 3 listener positions of a SOFA file with one per measurement
+} t_saf_firs;
+
+// ─────────────────────────────────────
+// Returns 0 with *error set when the file cannot be read.
+int saf_firs_load(t_saf_firs *f, const char *path, const char **error);
+void saf_firs_free(t_saf_firs *f);
+
+#endif
@@ -0,0 +1,244 @@
+#include <string.h>
+
+#include <m_pd.h>
+
+#include "governor.h"
+#include "utilities.h"
+
+static t_class *saf_governor_class;
+
+// ─────────────────────────────────────
+typedef struct _saf_governor_entry {
+    t_symbol *id;
+    t_symbol *name;
+    t_float load;
+    int level;
+    int maxLevel;
+    t_float frames;
+    t_float skipped;
+} t_saf_governor_entry;
+
+// ─────────────────────────────────────
+typedef struct _saf_governor {
+    t_object obj;
+    t_clock *clock;
+    t_outlet *out;
+
+    t_saf_governor_entry *entries;
+    int nEntries;
+    int nAllocated;
+
+    t_float interval; // ms between load reports
+    t_float high;     // step down above this fraction of the block deadline
+    t_float low;      // step up below this fraction...
+    t_float hold;     // ...after this many ms without stepping
+    t_float load;
+    double lastStep;
+    int running;
+} t_saf_governor;
+
+// ─────────────────────────────────────
+static void saf_governor_step(t_saf_governor *x, t_saf_governor_entry *e, int level) {
+    if (!e->id->s_thing) {
+        return;
+    }
+    t_atom a[2];
+    SETFLOAT(&a[0], level);
+    pd_typedmess(e->id->s_thing, gensym("saf_degrade"), 1, a);
+    x->lastStep = clock_getlogicaltime();
+
+    SETSYMBOL(&a[0], e->name);
+    SETFLOAT(&a[1], level);
+    outlet_anything(x->out, gensym("step"), 2, a);
+    logpost(x, 3, "[saf.governor] load %.0f%%, %s to level %d", x->load * 100, e->name->s_name,
+            level);
+}
+
+// ─────────────────────────────────────
+static void saf_governor_tick(t_saf_governor *x) {
+    t_symbol *broadcast = gensym(SAF_LOAD_BROADCAST);
+    x->nEntries = 0;
+    if (broadcast->s_thing) {
+        pd_typedmess(broadcast->s_thing, gensym("saf_loadreport"), 0, NULL);
+    }
+
+    x->load = 0;
+    for (int i = 0; i < x->nEntries; i++) {
+        x->load += x->entries[i].load;
+    }
+    t_atom a;
+    SETFLOAT(&a, x->load);
+    outlet_anything(x->out, gensym("load"), 1, &a);
+
+    double since = clock_gettimesince(x->lastStep);
+    if (x->load > x->high && since >= x->interval) {
+        // heaviest instance that can still go down
+        t_saf_governor_entry *heaviest = NULL;
+        for (int i = 0; i < x->nEntries; i++) {
+            t_saf_governor_entry *e = &x->entries[i];
+            if (e->level < e->maxLevel && (!heaviest || e->load > heaviest->load)) {
+                heaviest = e;
+            }
+        }
+        if (heaviest) {
+            saf_governor_step(x, heaviest, heaviest->level + 1);
+        }
+    } else if (x->load < x->low && since >= x->hold) {
+        // most degraded instance first, the lightest one when tied
+        t_saf_governor_entry *degraded = NULL;
+        for (int i = 0; i < x->nEntries; i++) {
+            t_saf_governor_entry *e = &x->entries[i];
+            if (e->level > 0 &&
+                (!degraded || e->level > degraded->level ||
+                 (e->level == degraded->level && e->load < degraded->load))) {
+                degraded = e;
+            }
+        }
+        if (degraded) {
+            saf_governor_step(x, degraded, degraded->level - 1);
+        }
+    }
+
+    if (x->running) {
+        clock_delay(x->clock, x->interval);
+    }
+}
+
+// ╭─────────────────────────────────────╮
+// │               Methods               │
+// ╰─────────────────────────────────────╯
+static void saf_governor_load(t_saf_governor *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc < 5) {
+        return;
+    }
+    if (x->nEntries == x->nAllocated) {
+        int n = x->nAllocated ? x->nAllocated * 2 : 16;
+        x->entries = (t_saf_governor_entry *)resizebytes(
+            x->entries, x->nAllocated * sizeof(t_saf_governor_entry),
+            n * sizeof(t_saf_governor_entry));
+        x->nAllocated = n;
+    }
+    t_saf_governor_entry *e = &x->entries[x->nEntries++];
+    e->id = atom_getsymbol(argv);
+    e->name = atom_getsymbol(argv + 1);
+    e->load = atom_getfloat(argv + 2);
+    e->level = atom_getint(argv + 3);
+    e->maxLevel = atom_getint(argv + 4);
+    e->frames = argc >= 7 ? atom_getfloat(argv + 5) : 0;
+    e->skipped = argc >= 7 ? atom_getfloat(argv + 6) : 0;
+}
+
+// ─────────────────────────────────────
+static void saf_governor_float(t_saf_governor *x, t_floatarg f) {
+    x->running = f != 0;
+    if (x->running) {
+        clock_delay(x->clock, 0);
+    } else {
+        clock_unset(x->clock);
+    }
+}
+
+// ─────────────────────────────────────
+static void saf_governor_reset(t_saf_governor *x) {
+    // back to full quality everywhere
+    saf_governor_tick(x);
+    for (int i = 0; i < x->nEntries; i++) {
+        if (x->entries[i].level > 0) {
+            saf_governor_step(x, &x->entries[i], 0);
+        }
+    }
+}
+
+// ─────────────────────────────────────
+static void saf_governor_print(t_saf_governor *x) {
+    int running = x->running;
+    x->running = 0;
+    saf_governor_tick(x);
+    x->running = running;
+    logpost(x, 2, "[saf.governor] %d objects, total load %.1f%%", x->nEntries, x->load * 100);
+    for (int i = 0; i < x->nEntries; i++) {
+        t_saf_governor_entry *e = &x->entries[i];
+        logpost(x, 2, "  %-20s | load %5.1f%% | level %d of %d | idle %5.1f%%", e->name->s_name,
+                e->load * 100, e->level, e->maxLevel,
+                e->frames > 0 ? e->skipped / e->frames * 100 : 0);
+    }
+}
+
+// ─────────────────────────────────────
+static void saf_governor_set(t_saf_governor *x, t_symbol *s, int argc, t_atom *argv) {
+    const char *method = s->s_name;
+    t_float value = atom_getfloat(argv);
+    if (strcmp(method, "interval") == 0) {
+        // how often, in ms, the objects are asked for their load
+        pd_assert(x, value >= 10, "[saf.governor] interval must be >= 10 ms");
+        x->interval = value;
+    } else if (strcmp(method, "high") == 0) {
+        // fraction of the block deadline above which the heaviest object steps down
+        pd_assert(x, value > x->low && value <= 1, "[saf.governor] high must be > low and <= 1");
+        x->high = value;
+    } else if (strcmp(method, "low") == 0) {
+        // fraction of the block deadline below which degraded objects step back up
+        pd_assert(x, value >= 0 && value < x->high, "[saf.governor] low must be >= 0 and < high");
+        x->low = value;
+    } else if (strcmp(method, "hold") == 0) {
+        // how long, in ms, the headroom must last before stepping back up
+        pd_assert(x, value >= 0, "[saf.governor] hold must be >= 0");
+        x->hold = value;
+    }
+}
+
+// ─────────────────────────────────────
+static void *saf_governor_new(t_symbol *s, int argc, t_atom *argv) {
+    t_saf_governor *x = (t_saf_governor *)pd_new(saf_governor_class);
+    t_symbol *receive = gensym(SAF_GOVERNOR_RECEIVE);
+    if (receive->s_thing) {
+        pd_error(x, "[saf.governor] There is already a governor running, both will step objects");
+    }
+    pd_bind(&x->obj.ob_pd, receive);
+
+    x->clock = clock_new(x, (t_method)saf_governor_tick);
+    x->out = outlet_new(&x->obj, &s_anything);
+    x->entries = NULL;
+    x->nEntries = 0;
+    x->nAllocated = 0;
+    x->interval = 250;
+    x->high = (argc >= 1) ? atom_getfloat(argv) : 0.7;
+    x->low = (argc >= 2) ? atom_getfloat(argv + 1) : 0.4;
+    x->hold = 2000;
+    x->load = 0;
+    x->lastStep = clock_getlogicaltime();
+    x->running = 0;
+
+    if (x->high <= 0 || x->high > 1 || x->low < 0 || x->low >= x->high) {
+        pd_error(x, "[saf.governor] Invalid thresholds, using 0.7 and 0.4");
+        x->high = 0.7;
+        x->low = 0.4;
+    }
+    return x;
+}
+
+// ─────────────────────────────────────
+static void saf_governor_free(t_saf_governor *x) {
+    pd_unbind(&x->obj.ob_pd, gensym(SAF_GOVERNOR_RECEIVE));
+    clock_free(x->clock);
+    if (x->entries) {
+        freebytes(x->entries, x->nAllocated * sizeof(t_saf_governor_entry));
+    }
+}
+
+// ─────────────────────────────────────
+// clang-format off
+void saf_governor_setup(void) {
+    saf_governor_class = class_new(gensym("saf.governor"), (t_newmethod)saf_governor_new,
+                                   (t_method)saf_governor_free, sizeof(t_saf_governor),
+                                   CLASS_DEFAULT, A_GIMME, 0);
+
+    class_addfloat(saf_governor_class, (t_method)saf_governor_float);
+    class_addmethod(saf_governor_class, (t_method)saf_governor_load, gensym("load"), A_GIMME, 0);
+    class_addmethod(saf_governor_class, (t_method)saf_governor_reset, gensym("reset"), 0);
+    class_addmethod(saf_governor_class, (t_method)saf_governor_print, gensym("print"), 0);
+    class_addmethod(saf_governor_class, (t_method)saf_governor_set, gensym("interval"), A_GIMME, 0);
+    class_addmethod(saf_governor_class, (t_method)saf_governor_set, gensym("high"), A_GIMME, 0);
+    class_addmethod(saf_governor_class, (t_method)saf_governor_set, gensym("low"), A_GIMME, 0);
+    class_addmethod(saf_governor_class, (t_method)saf_governor_set, gensym("hold"), A_GIMME, 0);
+}
@@ -0,0 +1,194 @@
+#ifndef SAF_GOVERNOR_H
+#define SAF_GOVERNOR_H
+
+#include <stdio.h>
+#include <string.h>
+#include <m_pd.h>
+
+// ─────────────────────────────────────
+// Signal objects that can trade quality for CPU own a t_saf_load. It measures the time spent in
+// perform, answers the load reports of [saf.governor] and fades the output around the quality
+// steps requested by it. Pd runs messages and DSP on the same thread, so no locking is needed.
+#define SAF_LOAD_BROADCAST "__saf_load"
+#define SAF_GOVERNOR_RECEIVE "__saf_governor"
+
+enum {
+    SAF_FADE_NONE = 0,
+    SAF_FADE_OUT,
+    SAF_FADE_WAIT,
+    SAF_FADE_IN,
+};
+
+typedef void (*t_saf_applylevel)(void *owner, int level);
+
+typedef struct _saf_load {
+    t_pd *owner;
+    t_symbol *id;
+    t_symbol *name;
+    t_float sr;
+
+    double start;
+    double busy;
+    double elapsed;
+    double frames;
+    double skipped;
+
+    int level;
+    int maxLevel;
+    int pendingLevel;
+    int fade;
+    t_saf_applylevel apply;
+} t_saf_load;
+
+// ─────────────────────────────────────
+// Objects with no quality to trade pass maxLevel 0 and a NULL apply. They are never stepped down,
+// but their load is still measured and reported to [saf.governor].
+static inline void saf_load_init(t_saf_load *l, t_pd *owner, const char *name, int maxLevel,
+                                 t_saf_applylevel apply) {
+    char id[MAXPDSTRING];
+    snprintf(id, MAXPDSTRING, SAF_LOAD_BROADCAST "_%p", (void *)owner);
+    l->owner = owner;
+    l->id = gensym(id);
+    l->name = gensym(name);
+    l->sr = sys_getsr();
+    l->start = 0;
+    l->busy = 0;
+    l->elapsed = 0;
+    l->frames = 0;
+    l->skipped = 0;
+    l->level = 0;
+    l->maxLevel = maxLevel < 0 ? 0 : maxLevel;
+    l->pendingLevel = 0;
+    l->fade = SAF_FADE_NONE;
+    l->apply = apply;
+    pd_bind(owner, l->id);
+    pd_bind(owner, gensym(SAF_LOAD_BROADCAST));
+}
+
+// ─────────────────────────────────────
+static inline void saf_load_free(t_saf_load *l) {
+    pd_unbind(l->owner, l->id);
+    pd_unbind(l->owner, gensym(SAF_LOAD_BROADCAST));
+}
+
+// ─────────────────────────────────────
+static inline void saf_load_begin(t_saf_load *l) {
+    l->start = sys_getrealtime();
+}
+
+// ─────────────────────────────────────
+static inline void saf_load_end(t_saf_load *l, int n) {
+    l->busy += sys_getrealtime() - l->start;
+    l->elapsed += (double)n / (double)l->sr;
+}
+
+// ─────────────────────────────────────
+static inline t_float saf_load_get(t_saf_load *l) {
+    return l->elapsed > 0 ? (t_float)(l->busy / l->elapsed) : 0;
+}
+
+// ─────────────────────────────────────
+// Counts processed frames, skipped is set when the idle bypass (silence.h) skipped the frame.
+static inline void saf_load_frame(t_saf_load *l, int skipped) {
+    l->frames++;
+    if (skipped) {
+        l->skipped++;
+    }
+}
+
+// ─────────────────────────────────────
+static inline void saf_load_stats(t_saf_load *l) {
+    logpost(l->owner, 2, "[%s] load %.2f%%, %.0f of %.0f frames skipped (idle)", l->name->s_name,
+            saf_load_get(l) * 100, l->skipped, l->frames);
+}
+
+// ─────────────────────────────────────
+static inline void saf_load_report(t_saf_load *l) {
+    t_symbol *governor = gensym(SAF_GOVERNOR_RECEIVE);
+    if (governor->s_thing) {
+        t_atom a[7];
+        SETSYMBOL(&a[0], l->id);
+        SETSYMBOL(&a[1], l->name);
+        SETFLOAT(&a[2], saf_load_get(l));
+        SETFLOAT(&a[3], l->fade == SAF_FADE_NONE ? l->level : l->pendingLevel);
+        SETFLOAT(&a[4], l->maxLevel);
+        SETFLOAT(&a[5], l->frames);
+        SETFLOAT(&a[6], l->skipped);
+        pd_typedmess(governor->s_thing, gensym("load"), 7, a);
+    }
+    l->busy = 0;
+    l->elapsed = 0;
+}
+
+// ─────────────────────────────────────
+static inline void saf_load_setmaxlevel(t_saf_load *l, int maxLevel) {
+    l->maxLevel = maxLevel < 0 ? 0 : maxLevel;
+}
+
+// ─────────────────────────────────────
+// Requests a new level, it is applied by saf_load_fade once the output has faded out, or by
+// saf_load_swap on the next frame.
+static inline void saf_load_request(t_saf_load *l, int level) {
+    level = level < 0 ? 0 : level > l->maxLevel ? l->maxLevel : level;
+    if (level == (l->fade == SAF_FADE_NONE ? l->level : l->pendingLevel)) {
+        return;
+    }
+    l->pendingLevel = level;
+    if (l->fade == SAF_FADE_NONE || l->fade == SAF_FADE_IN) {
+        l->fade = SAF_FADE_OUT;
+    }
+}
+
+// ─────────────────────────────────────
+// Called on every processed frame by objects that crossfade to their new state themselves (e.g. a
+// codec re-initialised on another thread): applies the pending level without touching the output,
+// the object keeps rendering its old state until the new one is ready.
+static inline void saf_load_swap(t_saf_load *l) {
+    if (l->fade == SAF_FADE_NONE) {
+        return;
+    }
+    l->level = l->pendingLevel;
+    l->fade = SAF_FADE_NONE;
+    if (l->apply) {
+        l->apply(l->owner, l->level);
+    }
+}
+
+// ─────────────────────────────────────
+// Called on every processed frame. Fades the frame out, applies the pending level, waits until
+// the object reports it is ready again (e.g. codec re-initialised) and fades back in.
+static inline void saf_load_fade(t_saf_load *l, t_sample **outs, int nOut, int nS, int ready) {
+    if (l->fade == SAF_FADE_NONE) {
+        return;
+    }
+    if (l->fade == SAF_FADE_OUT) {
+        for (int ch = 0; ch < nOut; ch++) {
+            for (int i = 0; i < nS; i++) {
+                outs[ch][i] *= 1 - (t_sample)(i + 1) / (t_sample)nS;
+            }
+        }
+        l->level = l->pendingLevel;
+        if (l->apply) {
+            l->apply(l->owner, l->level);
+        }
+        l->fade = SAF_FADE_WAIT;
+        return;
+    }
+    if (l->fade == SAF_FADE_WAIT) {
+        if (!ready) {
+            for (int ch = 0; ch < nOut; ch++) {
+                memset(outs[ch], 0, nS * sizeof(t_sample));
+            }
+            return;
+        }
+        l->fade = SAF_FADE_IN;
+    }
+    for (int ch = 0; ch < nOut; ch++) {
+        for (int i = 0; i < nS; i++) {
+            outs[ch][i] *= (t_sample)i / (t_sample)nS;
+        }
+    }
+    l->fade = SAF_FADE_NONE;
+}
+
+#endif
@@ -0,0 +1,290 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include "hrirs.h"
+#include "hades.h"
+
+// ─────────────────────────────────────
+// A block is too late once the audio thread has started to play its output, its input is then
+// being overwritten as well.
+static int hadesbin_late(t_hadesbin *r, int job) {
+    return atomic_load_explicit(&r->posted, memory_order_acquire) >= job + HADESBIN_LATENCY_BLOCKS;
+}
+
+// ─────────────────────────────────────
+static void hadesbin_synthesise(t_hadesbin *r, int job) {
+    int b = job % HADESBIN_SLOTS;
+    float balance = atomic_load_explicit(&r->balance, memory_order_relaxed);
+    if (balance != r->applied) {
+        for (int band = 0; band < r->nBands; band++) {
+            r->bandBalance[band] = balance;
+        }
+        hades_synthesis_setStreamBalance(r->hSyn, r->bandBalance, r->nBands);
+        r->applied = balance;
+    }
+    hades_synthesis_apply(r->hSyn, r->hPCon[b], r->hSCon[b], NUM_EARS, r->block, r->out[b]);
+}
+
+// ─────────────────────────────────────
+static void hadesbin_destroy(t_hadesbin *r);
+
+static void hadesbin_release(t_hadesbin *r) {
+    if (atomic_fetch_sub(&r->refs, 1) == 1) {
+        hadesbin_destroy(r);
+    }
+}
+
+// ─────────────────────────────────────
+static void *hadesbin_analysis(void *arg) {
+    t_hadesbin *r = (t_hadesbin *)arg;
+    int job = 0;
+    for (;;) {
+        saf_wakeup_wait(&r->analysis.wakeup);
+        if (!atomic_load(&r->running)) {
+            break;
+        }
+        // the containers of a slot are refilled once the synthesis of its last block is done,
+        // the synthesis wakes this thread up after every block
+        while (job < atomic_load_explicit(&r->posted, memory_order_acquire) &&
+               job - HADESBIN_SLOTS <
+                   atomic_load_explicit(&r->synthesis.done, memory_order_acquire)) {
+            if (!hadesbin_late(r, job)) {
+                // the input of a dropped block was never copied, its slot may hold a newer one
+                int b = job % HADESBIN_SLOTS;
+                float **in = atomic_load_explicit(&r->dropped[b], memory_order_relaxed)
+                                 ? r->silence
+                                 : r->in[b];
+                hades_analysis_apply(r->hAna, in, r->nMics, r->block, r->hPCon[b], r->hSCon[b]);
+            }
+            atomic_store_explicit(&r->analysis.done, ++job, memory_order_release);
+            saf_wakeup_post(&r->synthesis.wakeup);
+        }
+    }
+    hadesbin_release(r);
+    return NULL;
+}
+
+// ─────────────────────────────────────
+static void *hadesbin_synthesis(void *arg) {
+    t_hadesbin *r = (t_hadesbin *)arg;
+    int job = 0;
+    for (;;) {
+        saf_wakeup_wait(&r->synthesis.wakeup);
+        if (!atomic_load(&r->running)) {
+            break;
+        }
+        while (job < atomic_load_explicit(&r->analysis.done, memory_order_acquire)) {
+            if (!hadesbin_late(r, job)) {
+                hadesbin_synthesise(r, job);
+            }
+            atomic_store_explicit(&r->synthesis.done, ++job, memory_order_release);
+            saf_wakeup_post(&r->analysis.wakeup);
+        }
+    }
+    hadesbin_release(r);
+    return NULL;
+}
+
+// ─────────────────────────────────────
+static void hadesbin_stage_init(t_hadesbin_stage *s) {
+    atomic_init(&s->done, 0);
+    saf_wakeup_init(&s->wakeup);
+}
+
+// ─────────────────────────────────────
+static int hadesbin_stage_start(t_hadesbin_stage *s, t_hadesbin *r, void *(*run)(void *)) {
+    if (pthread_create(&s->thread, NULL, run, (void *)r) != 0) {
+        return 0;
+    }
+    pthread_detach(s->thread);
+    return 1;
+}
+
+// ─────────────────────────────────────
+static float **hadesbin_buffers(int nCh, int n) {
+    float **b = (float **)getbytes(nCh * sizeof(float *));
+    for (int ch = 0; ch < nCh; ch++) {
+        b[ch] = (float *)getbytes(n * sizeof(float));
+    }
+    return b;
+}
+
+// ─────────────────────────────────────
+static void hadesbin_freebuffers(float **b, int nCh, int n) {
+    for (int ch = 0; ch < nCh; ch++) {
+        freebytes(b[ch], n * sizeof(float));
+    }
+    freebytes(b, nCh * sizeof(float *));
+}
+
+// ─────────────────────────────────────
+t_hadesbin *hadesbin_new(const t_hadesbin_config *c, int fs, const char **error) {
+    saf_sofa_container sofa;
+    if (c->arrayPath[0] == '\0' ||
+        saf_sofa_open(&sofa, (char *)c->arrayPath, SAF_SOFA_READER_OPTION_DEFAULT) !=
+            SAF_SOFA_OK) {
+        *error = "Could not read the array IRs, use 'set arraysofa <file>'";
+        return NULL;
+    }
+    if ((int)sofa.DataSamplingRate != fs) {
+        saf_sofa_close(&sofa);
+        *error = "The array IRs must have the sample rate of Pd";
+        return NULL;
+    }
+    int nMics = sofa.nReceivers;
+    if (c->refIndices[0] >= nMics || c->refIndices[1] >= nMics) {
+        saf_sofa_close(&sofa);
+        *error = "Reference microphone out of range, use 'set refmics <left> <right>'";
+        return NULL;
+    }
+    float *gridDirs = (float *)getbytes(sofa.nSources * 2 * sizeof(float));
+    for (int d = 0; d < sofa.nSources; d++) {
+        gridDirs[2 * d] = sofa.SourcePosition[3 * d];
+        gridDirs[2 * d + 1] = sofa.SourcePosition[3 * d + 1];
+    }
+
+    t_hadesbin *r = (t_hadesbin *)getbytes(sizeof(t_hadesbin));
+    r->nMics = nMics;
+    r->hop = c->hop;
+    r->block = c->block;
+    hades_analysis_create(&r->hAna, (float)fs, HADES_USE_AFSTFT_LD, r->hop, r->block, 1,
+                          sofa.DataIR, gridDirs, sofa.nSources, nMics, sofa.DataLengthIR,
+                          HADES_USE_COMEDIE, HADES_USE_MUSIC);
+    freebytes(gridDirs, sofa.nSources * 2 * sizeof(float));
+    saf_sofa_close(&sofa);
+    r->nBands = hades_analysis_getNbands(r->hAna);
+    r->delay = hades_analysis_getProcDelay(r->hAna);
+
+    t_saf_hrirs h;
+    saf_hrirs_load(&h, c->useDefaultHRIRs, c->sofaPath, fs);
+    hades_binaural_config bin;
+    bin.lHRIR = h.len;
+    bin.nHRIR = h.nDirs;
+    bin.hrir_fs = (float)fs;
+    bin.hrirs = h.hrirs;
+    bin.hrir_dirs_deg = h.dirs;
+    int refIndices[2] = {c->refIndices[0], c->refIndices[1]};
+    hades_synthesis_create(&r->hSyn, r->hAna, (HADES_BEAMFORMER_TYPE)c->beamformer, c->enableCM,
+                           refIndices, &bin, HADES_HRTF_INTERP_NEAREST);
+    saf_hrirs_free(&h);
+
+    for (int b = 0; b < HADESBIN_SLOTS; b++) {
+        hades_param_container_create(&r->hPCon[b], r->hAna);
+        hades_signal_container_create(&r->hSCon[b], r->hAna);
+        r->in[b] = hadesbin_buffers(nMics, r->block);
+        r->out[b] = hadesbin_buffers(NUM_EARS, r->block);
+        atomic_init(&r->dropped[b], 0);
+    }
+    r->silence = hadesbin_buffers(nMics, r->block);
+    r->bandBalance = (float *)getbytes(r->nBands * sizeof(float));
+    atomic_init(&r->balance, 1.0f);
+    r->applied = -1.0f;
+    atomic_init(&r->misses, 0);
+    r->pos = 0;
+    r->job = 0;
+    r->playing = 0;
+    atomic_init(&r->posted, 0);
+    atomic_init(&r->running, 1);
+    atomic_init(&r->refs, 2);
+    hadesbin_stage_init(&r->analysis);
+    hadesbin_stage_init(&r->synthesis);
+    int started = hadesbin_stage_start(&r->analysis, r, hadesbin_analysis);
+    started += started && hadesbin_stage_start(&r->synthesis, r, hadesbin_synthesis);
+    if (started < 2) {
+        // a worker that did start stops at once, the last reference frees the renderer
+        hadesbin_free(r);
+        for (int i = started; i < 2; i++) {
+            hadesbin_release(r);
+        }
+        *error = "Could not start the worker threads";
+        return NULL;
+    }
+    return r;
+}
+
+// ─────────────────────────────────────
+static void hadesbin_destroy(t_hadesbin *r) {
+    saf_wakeup_destroy(&r->analysis.wakeup);
+    saf_wakeup_destroy(&r->synthesis.wakeup);
+    for (int b = 0; b < HADESBIN_SLOTS; b++) {
+        hades_param_container_destroy(&r->hPCon[b]);
+        hades_signal_container_destroy(&r->hSCon[b]);
+        hadesbin_freebuffers(r->in[b], r->nMics, r->block);
+        hadesbin_freebuffers(r->out[b], NUM_EARS, r->block);
+    }
+    hadesbin_freebuffers(r->silence, r->nMics, r->block);
+    hades_synthesis_destroy(&r->hSyn);
+    hades_analysis_destroy(&r->hAna);
+    freebytes(r->bandBalance, r->nBands * sizeof(float));
+    freebytes(r, sizeof(t_hadesbin));
+}
+
+// ─────────────────────────────────────
+void hadesbin_free(t_hadesbin *r) {
+    if (!r) {
+        return;
+    }
+    // a worker may be in the middle of a block, the caller does not wait for it
+    atomic_store(&r->running, 0);
+    saf_wakeup_post(&r->analysis.wakeup);
+    saf_wakeup_post(&r->synthesis.wakeup);
+}
+
+// ─────────────────────────────────────
+void hadesbin_setbalance(t_hadesbin *r, float balance) {
+    // picked up by the synthesis thread before its next block
+    atomic_store_explicit(&r->balance, balance, memory_order_relaxed);
+}
+
+// ─────────────────────────────────────
+// Block k is analysed and synthesised during blocks k + 1 to k + 3 and played during block k + 4,
+// from the slot that block k + 4 fills again. Whether its synthesis is back is read before block
+// k + 4 is posted, a worker that sees the post skips the synthesis as too late.
+static void hadesbin_endblock(t_hadesbin *r) {
+    int next = r->job + 1 - HADESBIN_LATENCY_BLOCKS;
+    r->playing =
+        next >= 0 && atomic_load_explicit(&r->synthesis.done, memory_order_acquire) > next;
+    if (next >= 0 && !r->playing) {
+        atomic_fetch_add(&r->misses, 1);
+    }
+    atomic_store_explicit(&r->posted, ++r->job, memory_order_release);
+    saf_wakeup_post(&r->analysis.wakeup);
+}
+
+// ─────────────────────────────────────
+void hadesbin_process(t_hadesbin *r, const float *const *ins, float *const *outs, int n) {
+    int i = 0;
+    while (i < n) {
+        int count = n - i < r->block - r->pos ? n - i : r->block - r->pos;
+        int b = r->job % HADESBIN_SLOTS;
+        if (r->pos == 0) {
+            // the analysis may still be reading the block that last filled this slot, the new
+            // block is then dropped and analysed as silence
+            int reused = r->job - HADESBIN_SLOTS;
+            int drop = reused >= 0 &&
+                       atomic_load_explicit(&r->analysis.done, memory_order_acquire) <= reused;
+            atomic_store_explicit(&r->dropped[b], drop, memory_order_relaxed);
+        }
+        if (!atomic_load_explicit(&r->dropped[b], memory_order_relaxed)) {
+            for (int ch = 0; ch < r->nMics; ch++) {
+                memcpy(r->in[b][ch] + r->pos, ins[ch] + i, count * sizeof(float));
+            }
+        }
+        for (int ear = 0; ear < NUM_EARS; ear++) {
+            if (r->playing) {
+                memcpy(outs[ear] + i, r->out[b][ear] + r->pos, count * sizeof(float));
+            } else {
+                memset(outs[ear] + i, 0, count * sizeof(float));
+            }
+        }
+        r->pos += count;
+        i += count;
+        if (r->pos == r->block) {
+            r->pos = 0;
+            hadesbin_endblock(r);
+        }
+    }
+}
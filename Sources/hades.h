@@ -0,0 +1,87 @@
+#ifndef SAF_HADES_H
+#define SAF_HADES_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include <m_pd.h>
+#include <_common.h>
+#include <saf.h>
+
+#include "wakeup.h"
+
+// ─────────────────────────────────────
+// Parametric binaural renderer for microphone arrays used by [saf.hades~], built on the HADES
+// module of SAF. The analysis estimates, per band of the filterbank, the spatial covariance, the
+// diffuseness and the directions of the array signals, and stores them in a parameter container
+// next to the time-frequency signals. The synthesis then beamforms and spatialises the signals
+// with the HRTFs from that container, so nothing is estimated twice.
+//
+// Both stages are far too heavy for the audio thread and run on two worker threads, pipelined over
+// blocks of `block` samples: the analysis hands every block on to the synthesis and moves on to
+// the next one. The output of block k is played four blocks later, on top of the delay of the
+// filterbank, which leaves each stage one block of slack. The audio thread never waits for them,
+// a block whose synthesis is not back in time is played as silence and counted as a miss, and the
+// workers skip the blocks that are already too late. An input slot is only refilled once the
+// analysis is done with it, otherwise the new block is dropped and analysed as silence.
+#define HADESBIN_DEFAULT_HOP 128
+#define HADESBIN_DEFAULT_BLOCK 512
+#define HADESBIN_LATENCY_BLOCKS 4
+#define HADESBIN_SLOTS 4 // blocks being filled, analysed, synthesised and played
+
+typedef struct _hadesbin_config {
+    int useDefaultHRIRs;
+    char sofaPath[MAXPDSTRING];  // HRIRs
+    char arrayPath[MAXPDSTRING]; // array IRs, one receiver per microphone
+    int hop;                     // filterbank hop in samples
+    int block;                   // samples per analysis and synthesis call, a multiple of hop
+    int refIndices[2];           // microphones nearest to the left and right ear, from 0
+    int enableCM;                // covariance matching of the output
+    int beamformer;              // HADES_BEAMFORMER_TYPE
+} t_hadesbin_config;
+
+typedef struct _hadesbin_stage {
+    pthread_t thread;
+    t_saf_wakeup wakeup;
+    atomic_int done; // blocks finished or skipped, in order
+} t_hadesbin_stage;
+
+typedef struct _hadesbin {
+    int nMics;
+    int block;
+    int hop;
+    int nBands;
+    int delay; // filterbank delay in samples, not counting the pipeline
+    hades_analysis_handle hAna;
+    hades_synthesis_handle hSyn;
+    hades_param_container_handle hPCon[HADESBIN_SLOTS]; // by block modulo the slots
+    hades_signal_container_handle hSCon[HADESBIN_SLOTS];
+    float **in[HADESBIN_SLOTS];         // nMics x block
+    float **out[HADESBIN_SLOTS];        // NUM_EARS x block
+    atomic_int dropped[HADESBIN_SLOTS]; // the input of the slot was not copied
+    float **silence;                    // nMics x block zeros, analysed for a dropped block
+    int pos;
+    int job;     // block being filled
+    int playing; // the synthesis played during this block came back in time
+    atomic_int posted;  // blocks handed to the analysis
+    atomic_int running; // cleared by hadesbin_free
+    atomic_int refs;    // worker threads, the last one to stop frees the renderer
+    t_hadesbin_stage analysis;
+    t_hadesbin_stage synthesis;
+    atomic_uint misses;
+    _Atomic float balance; // set by the main thread
+    float applied;         // balance in bandBalance, synthesis thread only
+    float *bandBalance;    // nBands
+} t_hadesbin;
+
+// ─────────────────────────────────────
+// Returns NULL with *error set when the array IRs cannot be used.
+t_hadesbin *hadesbin_new(const t_hadesbin_config *c, int fs, const char **error);
+// Returns at once, the renderer is freed by its workers once they are done with their block.
+void hadesbin_free(t_hadesbin *r);
+// Balance between the direct (> 1) and diffuse (< 1) streams, 1 leaves both as analysed.
+void hadesbin_setbalance(t_hadesbin *r, float balance);
+// Blocks shorter than r->block are accumulated, longer ones must be a multiple of it.
+void hadesbin_process(t_hadesbin *r, const float *const *ins, float *const *outs, int n);
+
+#endif
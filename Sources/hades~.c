@@ -0,0 +1,364 @@
+#include <string.h>
+
+#include <m_pd.h>
+#include <g_canvas.h>
+#include <s_stuff.h>
+
+#include "utilities.h"
+#include "governor.h"
+#include "designer.h"
+#include "hades.h"
+
+static t_class *hades_tilde_class;
+
+// ─────────────────────────────────────
+typedef struct _hades_tilde {
+    t_object obj;
+    t_canvas *glist;
+    t_sample sample;
+
+    int nIn; // one input per microphone
+    int nOut;
+    int multichannel;
+    const t_sample **aIns;
+    t_sample *aOuts[NUM_EARS];
+
+    t_hadesbin_config config;
+    t_hadesbin *hades;
+    float balance;
+    int hadesSr; // sample rate of the latest design
+    t_saf_designer designer;
+
+    t_saf_load load;
+} t_hades_tilde;
+
+// ─────────────────────────────────────
+typedef struct _hades_tilde_design {
+    t_hadesbin_config config;
+    int fs;
+} t_hades_tilde_design;
+
+typedef struct _hades_tilde_renderer {
+    t_hadesbin *hades;
+    const char *error; // NULL when the design succeeded
+} t_hades_tilde_renderer;
+
+// ─────────────────────────────────────
+static void *hades_tilde_designrenderer(const void *args) {
+    const t_hades_tilde_design *d = (const t_hades_tilde_design *)args;
+    t_hades_tilde_renderer *r =
+        (t_hades_tilde_renderer *)getbytes(sizeof(t_hades_tilde_renderer));
+    r->hades = hadesbin_new(&d->config, d->fs, &r->error);
+    return r;
+}
+
+// ─────────────────────────────────────
+static void hades_tilde_discardrenderer(void *result) {
+    t_hades_tilde_renderer *r = (t_hades_tilde_renderer *)result;
+    hadesbin_free(r->hades);
+    freebytes(r, sizeof(t_hades_tilde_renderer));
+}
+
+// ─────────────────────────────────────
+static void hades_tilde_installrenderer(t_pd *obj, const void *args, void *result) {
+    t_hades_tilde *x = (t_hades_tilde *)obj;
+    t_hades_tilde_renderer *r = (t_hades_tilde_renderer *)result;
+    (void)args;
+    if (!r->hades) {
+        // the old renderer keeps playing
+        pd_error(x, "[saf.hades~] %s", r->error ? r->error : "Could not build the renderer");
+        hades_tilde_discardrenderer(r);
+        return;
+    }
+    t_hadesbin *h = r->hades;
+    hadesbin_setbalance(h, x->balance);
+    r->hades = x->hades;
+    x->hades = h;
+    hades_tilde_discardrenderer(r);
+    if (h->nMics != x->nIn) {
+        pd_error(x, "[saf.hades~] The array has %d microphones but the object %d inputs",
+                 h->nMics, x->nIn);
+    }
+    logpost(x, 3,
+            "[saf.hades~] Ready, %d microphones, %d bands, blocks of %d samples, latency %d "
+            "samples",
+            h->nMics, h->nBands, h->block, HADESBIN_LATENCY_BLOCKS * h->block + h->delay);
+}
+
+// ─────────────────────────────────────
+static void hades_tilde_design(t_hades_tilde *x) {
+    // the old renderer keeps playing until the new one is ready
+    t_hades_tilde_design d;
+    d.config = x->config;
+    d.fs = (int)x->load.sr;
+    x->hadesSr = d.fs;
+    logpost(x, 2, "[saf.hades~] Analysing the array IRs...");
+    saf_designer_start(&x->designer, &d, sizeof(d));
+}
+
+// ─────────────────────────────────────
+static int hades_tilde_openfile(t_hades_tilde *x, t_symbol *file, char *dest) {
+    char path[MAXPDSTRING];
+    char *bufptr;
+    int fd = canvas_open(x->glist, file->s_name, "", path, &bufptr, MAXPDSTRING, 1);
+    if (fd <= 1) {
+        pd_error(x->glist, "[saf.hades~] Could not open %s!", file->s_name);
+        return 0;
+    }
+    sys_close(fd);
+    pd_snprintf(dest, MAXPDSTRING, "%s/%s", path, file->s_name);
+    logpost(x, 2, "[saf.hades~] Opening %s", dest);
+    return 1;
+}
+
+// ╭─────────────────────────────────────╮
+// │               Methods               │
+// ╰─────────────────────────────────────╯
+static void hades_tilde_set(t_hades_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    pd_assert(x, argc >= 2, "[saf.hades~] Expected 'set <method> <value>'");
+    const char *method = atom_getsymbol(argv)->s_name;
+    if (strcmp(method, "arraysofa") == 0) {
+        // IRs of the microphone array, one receiver per microphone
+        if (!hades_tilde_openfile(x, atom_getsymbol(argv + 1), x->config.arrayPath)) {
+            return;
+        }
+    } else if (strcmp(method, "sofafile") == 0) {
+        if (!hades_tilde_openfile(x, atom_getsymbol(argv + 1), x->config.sofaPath)) {
+            return;
+        }
+        x->config.useDefaultHRIRs = 0;
+    } else if (strcmp(method, "defaultHRIR") == 0) {
+        x->config.useDefaultHRIRs = atom_getfloat(argv + 1) != 0;
+    } else if (strcmp(method, "hop") == 0) {
+        // hop of the filterbank, the block is kept a multiple of it
+        int hop = atom_getint(argv + 1);
+        pd_assert(x, hop >= 16 && (hop & (hop - 1)) == 0,
+                  "[saf.hades~] hop must be a power of two >= 16");
+        x->config.hop = hop;
+        x->config.block = x->config.block < hop ? hop : x->config.block / hop * hop;
+    } else if (strcmp(method, "block") == 0) {
+        // samples per analysis and synthesis call, larger blocks cost less per sample but add
+        // HADESBIN_LATENCY_BLOCKS times as much latency
+        int block = atom_getint(argv + 1);
+        pd_assert(x, block >= x->config.hop && block % x->config.hop == 0,
+                  "[saf.hades~] block must be a multiple of hop");
+        x->config.block = block;
+    } else if (strcmp(method, "refmics") == 0) {
+        pd_assert(x, argc >= 3, "[saf.hades~] Expected 'set refmics <left> <right>'");
+        x->config.refIndices[0] = atom_getint(argv + 1) - 1;
+        x->config.refIndices[1] = atom_getint(argv + 2) - 1;
+        pd_assert(x, x->config.refIndices[0] >= 0 && x->config.refIndices[1] >= 0,
+                  "[saf.hades~] Microphones are numbered from 1");
+    } else if (strcmp(method, "covmatching") == 0) {
+        x->config.enableCM = atom_getfloat(argv + 1) != 0;
+    } else if (strcmp(method, "beamformer") == 0) {
+        int type = atom_getint(argv + 1);
+        if (type < HADES_BEAMFORMER_NONE || type > HADES_BEAMFORMER_BMVDR) {
+            logpost(x, 1, "[saf.hades~] beamformer must be 0-2");
+            logpost(x, 2, "             none           = 0");
+            logpost(x, 2, "             filter and sum = 1");
+            logpost(x, 2, "             BMVDR          = 2");
+            return;
+        }
+        x->config.beamformer = type;
+    } else if (strcmp(method, "balance") == 0) {
+        // no redesign, the synthesis thread picks it up
+        x->balance = atom_getfloat(argv + 1);
+        if (x->hades) {
+            hadesbin_setbalance(x->hades, x->balance);
+        }
+        return;
+    } else {
+        pd_error(x, "[saf.hades~] Unknown set method: %s", method);
+        return;
+    }
+    if (x->hadesSr > 0 && x->config.arrayPath[0] != '\0') {
+        hades_tilde_design(x);
+    }
+}
+
+// ─────────────────────────────────────
+static void hades_tilde_loadreport(t_hades_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void hades_tilde_stats(t_hades_tilde *x) {
+    saf_load_stats(&x->load);
+    if (x->hades) {
+        logpost(x, 2, "[saf.hades~] %d microphones, %d blocks of %d samples, %u played late%s",
+                x->hades->nMics, x->hades->job, x->hades->block, atomic_load(&x->hades->misses),
+                saf_designer_busy(&x->designer) ? ", new renderer on the way" : "");
+    }
+}
+
+// ╭─────────────────────────────────────╮
+// │     Initialization and Perform      │
+// ╰─────────────────────────────────────╯
+static void hades_tilde_process(t_hades_tilde *x, int n) {
+    // the renderer is swapped on the main thread (designer.h), never while a block is rendered
+    t_hadesbin *r = x->hades;
+    if (r && r->nMics == x->nIn && (n < r->block || n % r->block == 0)) {
+        hadesbin_process(r, (const float *const *)x->aIns, (float *const *)x->aOuts, n);
+        return;
+    }
+    for (int ear = 0; ear < NUM_EARS; ear++) {
+        memset(x->aOuts[ear], 0, n * sizeof(t_sample));
+    }
+}
+
+// ─────────────────────────────────────
+t_int *hades_tilde_performmultichannel(t_int *w) {
+    t_hades_tilde *x = (t_hades_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    t_sample *ins = (t_sample *)(w[3]);
+    t_sample *outs = (t_sample *)(w[4]);
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nIn; ch++) {
+        x->aIns[ch] = ins + ch * n;
+    }
+    for (int ear = 0; ear < NUM_EARS; ear++) {
+        x->aOuts[ear] = outs + ear * n;
+    }
+    hades_tilde_process(x, n);
+    saf_load_end(&x->load, n);
+
+    return (w + 5);
+}
+
+// ─────────────────────────────────────
+t_int *hades_tilde_perform(t_int *w) {
+    t_hades_tilde *x = (t_hades_tilde *)(w[1]);
+    int n = (int)(w[2]);
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nIn; ch++) {
+        x->aIns[ch] = (t_sample *)w[3 + ch];
+    }
+    for (int ear = 0; ear < NUM_EARS; ear++) {
+        x->aOuts[ear] = (t_sample *)w[3 + x->nIn + ear];
+    }
+    hades_tilde_process(x, n);
+    saf_load_end(&x->load, n);
+
+    return (w + 3 + x->nIn + x->nOut);
+}
+
+// ─────────────────────────────────────
+void hades_tilde_dsp(t_hades_tilde *x, t_signal **sp) {
+    x->load.sr = sp[0]->s_sr;
+    if (x->multichannel) {
+        int nIn = sp[0]->s_nchans;
+        if (nIn != x->nIn) {
+            freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+            x->aIns = (const t_sample **)getbytes(nIn * sizeof(t_sample *));
+            x->nIn = nIn;
+        }
+    }
+
+    if ((int)x->load.sr != x->hadesSr) {
+        if (x->config.arrayPath[0] != '\0') {
+            hades_tilde_design(x);
+        } else {
+            x->hadesSr = (int)x->load.sr;
+            pd_error(x, "[saf.hades~] No array IRs yet, use 'set arraysofa <file>'");
+        }
+    }
+
+    if (x->multichannel) {
+        signal_setmultiout(&sp[1], x->nOut);
+        dsp_add(hades_tilde_performmultichannel, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
+    } else {
+        int sum = x->nIn + x->nOut;
+        int sigvecsize = sum + 2;
+        for (int i = x->nIn; i < sum; i++) {
+            signal_setmultiout(&sp[i], 1);
+        }
+        t_int *sigvec = getbytes(sigvecsize * sizeof(t_int));
+        sigvec[0] = (t_int)x;
+        sigvec[1] = (t_int)sp[0]->s_n;
+        for (int i = 0; i < sum; i++) {
+            sigvec[2 + i] = (t_int)sp[i]->s_vec;
+        }
+        dsp_addv(hades_tilde_perform, sigvecsize, sigvec);
+        freebytes(sigvec, sigvecsize * sizeof(t_int));
+    }
+}
+
+// ─────────────────────────────────────
+void *hades_tilde_new(t_symbol *s, int argc, t_atom *argv) {
+    t_hades_tilde *x = (t_hades_tilde *)pd_new(hades_tilde_class);
+    x->glist = canvas_getcurrent();
+
+    // [saf.hades~ <num_mics>] or [saf.hades~ -m], one input per microphone
+    int num_mics = 4;
+    x->multichannel = 0;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type == A_SYMBOL && strcmp(atom_getsymbol(argv + i)->s_name, "-m") == 0) {
+            x->multichannel = 1;
+        } else if (argv[i].a_type == A_FLOAT) {
+            num_mics = atom_getint(argv + i);
+        }
+    }
+    if (num_mics < 2) {
+        pd_error(x, "[saf.hades~] An array needs at least 2 microphones");
+        num_mics = 2;
+    }
+
+    x->nIn = num_mics;
+    x->nOut = NUM_EARS;
+    x->aIns = (const t_sample **)getbytes(x->nIn * sizeof(t_sample *));
+    x->config.useDefaultHRIRs = 1;
+    x->config.sofaPath[0] = '\0';
+    x->config.arrayPath[0] = '\0';
+    x->config.hop = HADESBIN_DEFAULT_HOP;
+    x->config.block = HADESBIN_DEFAULT_BLOCK;
+    x->config.refIndices[0] = 0;
+    x->config.refIndices[1] = 1;
+    x->config.enableCM = 1;
+    x->config.beamformer = HADES_BEAMFORMER_BMVDR;
+    x->balance = 1.0f;
+    x->hades = NULL;
+    x->hadesSr = 0;
+    saf_designer_init(&x->designer, &x->obj.ob_pd, hades_tilde_designrenderer,
+                      hades_tilde_installrenderer, hades_tilde_discardrenderer);
+
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.hades~", 0, NULL);
+
+    if (x->multichannel) {
+        outlet_new(&x->obj, &s_signal);
+    } else {
+        for (int i = 1; i < x->nIn; i++) {
+            inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
+        }
+        for (int i = 0; i < x->nOut; i++) {
+            outlet_new(&x->obj, &s_signal);
+        }
+    }
+
+    return (void *)x;
+}
+
+// ─────────────────────────────────────
+void hades_tilde_free(t_hades_tilde *x) {
+    saf_load_free(&x->load);
+    saf_designer_free(&x->designer);
+    hadesbin_free(x->hades);
+    freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+}
+
+// ─────────────────────────────────────
+// clang-format off
+void setup_saf0x2ehades_tilde(void) {
+    hades_tilde_class =
+        class_new(gensym("saf.hades~"), (t_newmethod)hades_tilde_new,
+                  (t_method)hades_tilde_free, sizeof(t_hades_tilde),
+                  CLASS_DEFAULT | CLASS_MULTICHANNEL, A_GIMME, 0);
+
+    CLASS_MAINSIGNALIN(hades_tilde_class, t_hades_tilde, sample);
+    class_addmethod(hades_tilde_class, (t_method)hades_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(hades_tilde_class, (t_method)hades_tilde_set, gensym("set"), A_GIMME, 0);
+    class_addmethod(hades_tilde_class, (t_method)hades_tilde_stats, gensym("stats"), 0);
+    class_addmethod(hades_tilde_class, (t_method)hades_tilde_loadreport, gensym("saf_loadreport"), 0);
+}
@@ -0,0 +1,270 @@
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define HEADTRACKER_INVALID INVALID_SOCKET
+#define headtracker_close closesocket
+#else
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#define HEADTRACKER_INVALID (-1)
+#define headtracker_close close
+#endif
+
+#include <m_pd.h>
+#include "headtracker.h"
+
+#define HEADTRACKER_RAD2DEG 57.29577951f
+#define HEADTRACKER_TIMEOUT_MS 100
+
+// ─────────────────────────────────────
+static uint32_t headtracker_be32(const char *p) {
+    const unsigned char *u = (const unsigned char *)p;
+    return ((uint32_t)u[0] << 24) | ((uint32_t)u[1] << 16) | ((uint32_t)u[2] << 8) | u[3];
+}
+
+// ─────────────────────────────────────
+// Length of the OSC string at p including its padding, or -1 if it is not terminated.
+static int headtracker_strlen(const char *p, int size) {
+    for (int i = 0; i < size; i++) {
+        if (p[i] == '\0') {
+            return (i + 4) & ~3;
+        }
+    }
+    return -1;
+}
+
+// ─────────────────────────────────────
+static int headtracker_endswith(const char *address, const char *name) {
+    size_t a = strlen(address);
+    size_t n = strlen(name);
+    return a >= n && strcmp(address + a - n, name) == 0 && (a == n || address[a - n - 1] == '/');
+}
+
+// ─────────────────────────────────────
+static void headtracker_publish(t_headtracker *h, const float *ypr, const int *mask) {
+    unsigned seq = atomic_load_explicit(&h->seq, memory_order_relaxed);
+    atomic_store_explicit(&h->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int a = 0; a < 3; a++) {
+        if (mask[a]) {
+            h->ypr[a] = ypr[a];
+        }
+    }
+    atomic_store_explicit(&h->seq, seq + 2, memory_order_release);
+    atomic_fetch_add_explicit(&h->packets, 1, memory_order_relaxed);
+}
+
+// ─────────────────────────────────────
+static void headtracker_quat2ypr(const float *q, float *ypr) {
+    float w = q[0], x = q[1], y = q[2], z = q[3];
+    float norm = sqrtf(w * w + x * x + y * y + z * z);
+    if (norm < 1e-9f) {
+        return;
+    }
+    w /= norm, x /= norm, y /= norm, z /= norm;
+    float s = 2.0f * (w * y - z * x);
+    s = s > 1.0f ? 1.0f : (s < -1.0f ? -1.0f : s);
+    ypr[0] = atan2f(2.0f * (w * z + x * y), 1.0f - 2.0f * (y * y + z * z)) * HEADTRACKER_RAD2DEG;
+    ypr[1] = asinf(s) * HEADTRACKER_RAD2DEG;
+    ypr[2] = atan2f(2.0f * (w * x + y * z), 1.0f - 2.0f * (x * x + y * y)) * HEADTRACKER_RAD2DEG;
+}
+
+// ─────────────────────────────────────
+static void headtracker_parse(t_headtracker *h, const char *buf, int size, int depth) {
+    if (size < 4 || (size & 3)) {
+        return;
+    }
+    if (size >= 16 && memcmp(buf, "#bundle", 8) == 0) {
+        if (depth > 4) {
+            return;
+        }
+        int pos = 16; // "#bundle" and the time tag
+        while (pos + 4 <= size) {
+            int len = (int)headtracker_be32(buf + pos);
+            pos += 4;
+            if (len <= 0 || len > size - pos) {
+                return;
+            }
+            headtracker_parse(h, buf + pos, len, depth + 1);
+            pos += len;
+        }
+        return;
+    }
+
+    int addrLen = headtracker_strlen(buf, size);
+    if (addrLen < 0 || addrLen >= size || buf[addrLen] != ',') {
+        return;
+    }
+    const char *tags = buf + addrLen + 1;
+    int tagLen = headtracker_strlen(buf + addrLen, size - addrLen);
+    if (tagLen < 0) {
+        return;
+    }
+    const char *arg = buf + addrLen + tagLen;
+    const char *end = buf + size;
+
+    float values[4];
+    int nValues = 0;
+    for (const char *t = tags; *t && nValues < 4; t++) {
+        if (*t == 'f' || *t == 'i') {
+            if (end - arg < 4) {
+                return;
+            }
+            uint32_t u = headtracker_be32(arg);
+            if (*t == 'f') {
+                float f;
+                memcpy(&f, &u, sizeof(f));
+                values[nValues++] = f;
+            } else {
+                values[nValues++] = (float)(int32_t)u;
+            }
+            arg += 4;
+        } else if (*t == 'd') {
+            if (end - arg < 8) {
+                return;
+            }
+            uint64_t u = ((uint64_t)headtracker_be32(arg) << 32) | headtracker_be32(arg + 4);
+            double d;
+            memcpy(&d, &u, sizeof(d));
+            values[nValues++] = (float)d;
+            arg += 8;
+        } else {
+            return;
+        }
+    }
+
+    float ypr[3] = {0.0f, 0.0f, 0.0f};
+    int mask[3] = {0, 0, 0};
+    if (headtracker_endswith(buf, "ypr") && nValues >= 3) {
+        memcpy(ypr, values, sizeof(ypr));
+        mask[0] = mask[1] = mask[2] = 1;
+    } else if (headtracker_endswith(buf, "yaw") && nValues >= 1) {
+        ypr[0] = values[0];
+        mask[0] = 1;
+    } else if (headtracker_endswith(buf, "pitch") && nValues >= 1) {
+        ypr[1] = values[0];
+        mask[1] = 1;
+    } else if (headtracker_endswith(buf, "roll") && nValues >= 1) {
+        ypr[2] = values[0];
+        mask[2] = 1;
+    } else if ((headtracker_endswith(buf, "quaternion") || headtracker_endswith(buf, "quaternions") ||
+                headtracker_endswith(buf, "quat")) &&
+               nValues >= 4) {
+        headtracker_quat2ypr(values, ypr);
+        mask[0] = mask[1] = mask[2] = 1;
+    } else {
+        return;
+    }
+    headtracker_publish(h, ypr, mask);
+}
+
+// ─────────────────────────────────────
+static void *headtracker_listen(void *arg) {
+    t_headtracker *h = (t_headtracker *)arg;
+    char buf[HEADTRACKER_MAX_PACKET];
+    while (atomic_load_explicit(&h->running, memory_order_acquire)) {
+        int size = (int)recv(h->sock, buf, sizeof(buf), 0);
+        if (size > 0) {
+            headtracker_parse(h, buf, size, 0);
+        }
+    }
+    return NULL;
+}
+
+// ─────────────────────────────────────
+int headtracker_start(t_headtracker *h, int port, const char *address) {
+    headtracker_stop(h);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    if (!address) {
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    } else if (strlen(address) >= HEADTRACKER_MAX_ADDRESS ||
+               inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+        return 0;
+    }
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        return 0;
+    }
+#endif
+    h->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (h->sock == HEADTRACKER_INVALID) {
+        return 0;
+    }
+
+    // the timeout lets the thread notice headtracker_stop without closing the socket under it
+#ifdef _WIN32
+    DWORD timeout = HEADTRACKER_TIMEOUT_MS;
+#else
+    struct timeval timeout = {0, HEADTRACKER_TIMEOUT_MS * 1000};
+#endif
+    setsockopt(h->sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+
+    if (bind(h->sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        headtracker_close(h->sock);
+        h->sock = HEADTRACKER_INVALID;
+        return 0;
+    }
+
+    atomic_store(&h->seq, 0);
+    atomic_store(&h->packets, 0);
+    h->ypr[0] = h->ypr[1] = h->ypr[2] = 0.0f;
+    h->port = port;
+    inet_ntop(AF_INET, &addr.sin_addr, h->address, HEADTRACKER_MAX_ADDRESS);
+    atomic_store_explicit(&h->running, 1, memory_order_release);
+    if (pthread_create(&h->thread, NULL, headtracker_listen, (void *)h) != 0) {
+        atomic_store(&h->running, 0);
+        headtracker_close(h->sock);
+        h->sock = HEADTRACKER_INVALID;
+        return 0;
+    }
+    return 1;
+}
+
+// ─────────────────────────────────────
+void headtracker_stop(t_headtracker *h) {
+    if (!atomic_load(&h->running)) {
+        return;
+    }
+    atomic_store_explicit(&h->running, 0, memory_order_release);
+    pthread_join(h->thread, NULL);
+    headtracker_close(h->sock);
+    h->sock = HEADTRACKER_INVALID;
+    h->port = 0;
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+// ─────────────────────────────────────
+// Copies the latest orientation into ypr, returns 0 while nothing has been received. Never blocks:
+// if the listener keeps writing, ypr is left as it was and 0 is returned.
+int headtracker_read(t_headtracker *h, float *ypr) {
+    if (!atomic_load_explicit(&h->packets, memory_order_relaxed)) {
+        return 0;
+    }
+    for (int tries = 0; tries < 4; tries++) {
+        unsigned seq = atomic_load_explicit(&h->seq, memory_order_acquire);
+        if (seq & 1) {
+            continue;
+        }
+        float copy[3];
+        memcpy(copy, h->ypr, sizeof(copy));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&h->seq, memory_order_relaxed) == seq) {
+            memcpy(ypr, copy, sizeof(copy));
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef SAF_HEADTRACKER_H
+#define SAF_HEADTRACKER_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+typedef SOCKET t_headtracker_socket;
+#else
+typedef int t_headtracker_socket;
+#endif
+
+// ─────────────────────────────────────
+// UDP listener for OSC head trackers used by [saf.binaural~]. A background thread parses the
+// packets and publishes the latest orientation through a seqlock, so perform can read it every
+// frame without locking and without going through the Pd scheduler. Accepted messages, matched on
+// the end of the address, all angles in degrees:
+//   .../ypr <yaw> <pitch> <roll>
+//   .../yaw <yaw>, .../pitch <pitch>, .../roll <roll>
+//   .../quaternion <w> <x> <y> <z> (also .../quaternions, .../quat)
+// Messages may be sent alone or inside bundles. The socket is bound to the loopback interface
+// unless another IPv4 address is given, 0.0.0.0 listens on all interfaces.
+#define HEADTRACKER_MAX_PACKET 1024
+#define HEADTRACKER_MAX_ADDRESS 16 // dotted IPv4 with its terminator
+
+typedef struct _headtracker {
+    atomic_uint seq; // odd while the listener writes
+    float ypr[3];
+    atomic_uint packets;
+    atomic_int running;
+    int port;
+    char address[HEADTRACKER_MAX_ADDRESS];
+    t_headtracker_socket sock;
+    pthread_t thread;
+} t_headtracker;
+
+// ─────────────────────────────────────
+// address may be NULL for the loopback interface.
+int headtracker_start(t_headtracker *h, int port, const char *address);
+void headtracker_stop(t_headtracker *h);
+int headtracker_read(t_headtracker *h, float *ypr);
+
+#endif
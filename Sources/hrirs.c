@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include "hrirs.h"
+
+// ─────────────────────────────────────
+void saf_hrirs_load(t_saf_hrirs *h, int useDefault, const char *sofaPath, int fs) {
+    saf_sofa_container sofa;
+    h->fromSofa = 0;
+    if (!useDefault && sofaPath[0] != '\0') {
+        if (saf_sofa_open(&sofa, (char *)sofaPath, SAF_SOFA_READER_OPTION_DEFAULT) ==
+            SAF_SOFA_OK) {
+            h->fromSofa = sofa.nReceivers == NUM_EARS;
+            if (!h->fromSofa) {
+                saf_sofa_close(&sofa);
+            }
+        }
+    }
+
+    const float *hrirs;
+    int hrirFs;
+    if (h->fromSofa) {
+        hrirs = sofa.DataIR;
+        h->nDirs = sofa.nSources;
+        h->len = sofa.DataLengthIR;
+        hrirFs = (int)sofa.DataSamplingRate;
+        h->dirs = (float *)getbytes(h->nDirs * 2 * sizeof(float));
+        for (int d = 0; d < h->nDirs; d++) {
+            h->dirs[2 * d] = sofa.SourcePosition[3 * d];
+            h->dirs[2 * d + 1] = sofa.SourcePosition[3 * d + 1];
+        }
+    } else {
+        hrirs = (const float *)__default_hrirs;
+        h->nDirs = __default_N_hrir_dirs;
+        h->len = __default_hrir_len;
+        hrirFs = __default_hrir_fs;
+        h->dirs = (float *)getbytes(h->nDirs * 2 * sizeof(float));
+        memcpy(h->dirs, __default_hrir_dirs_deg, h->nDirs * 2 * sizeof(float));
+    }
+
+    float *resampled = NULL;
+    if (hrirFs != fs) {
+        resampleHRIRs((float *)hrirs, h->nDirs, h->len, hrirFs, fs, 0, &resampled, &h->len);
+        hrirs = resampled;
+    }
+    int size = h->nDirs * NUM_EARS * h->len;
+    h->hrirs = (float *)getbytes(size * sizeof(float));
+    memcpy(h->hrirs, hrirs, size * sizeof(float));
+    free(resampled);
+    if (h->fromSofa) {
+        saf_sofa_close(&sofa);
+    }
+}
+
+// ─────────────────────────────────────
+void saf_hrirs_free(t_saf_hrirs *h) {
+    freebytes(h->hrirs, h->nDirs * NUM_EARS * h->len * sizeof(float));
+    freebytes(h->dirs, h->nDirs * 2 * sizeof(float));
+    h->hrirs = NULL;
+    h->dirs = NULL;
+}
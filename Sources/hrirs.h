@@ -0,0 +1,22 @@
+#ifndef SAF_HRIRS_H
+#define SAF_HRIRS_H
+
+#include <m_pd.h>
+#include <_common.h>
+
+// ─────────────────────────────────────
+// HRIR set shared by the binaural renderers: read from a SOFA file with two receivers or, failing
+// that, the default set of SAF, resampled to the rendering sample rate.
+typedef struct _saf_hrirs {
+    float *hrirs; // nDirs x NUM_EARS x len
+    float *dirs;  // nDirs x 2, azimuth and elevation in degrees
+    int nDirs;
+    int len;
+    int fromSofa;
+} t_saf_hrirs;
+
+// ─────────────────────────────────────
+void saf_hrirs_load(t_saf_hrirs *h, int useDefault, const char *sofaPath, int fs);
+void saf_hrirs_free(t_saf_hrirs *h);
+
+#endif
@@ -0,0 +1,421 @@
+#include <string.h>
+
+#include <m_pd.h>
+#include <g_canvas.h>
+#include <s_stuff.h>
+
+#include "utilities.h"
+#include "governor.h"
+#include "designer.h"
+#include "convolver.h"
+#include "firfile.h"
+
+// [saf.matrixconv~] convolves every input with a row of filters into every output,
+// [saf.multiconv~] is the same object with one filter per channel (a diagonal matrix). Both
+// externals are built from this file, each one only calls its own setup.
+static t_class *matrixconv_tilde_class;
+static t_class *multiconv_tilde_class;
+
+// ─────────────────────────────────────
+typedef struct _matrixconv_tilde {
+    t_object obj;
+    t_canvas *glist;
+    t_sample sample;
+    const char *name;
+
+    int diagonal; // [saf.multiconv~], the same channels in and out
+    int nIn;
+    int nOut; // from the filters with -m
+    int multichannel;
+    const t_sample **aIns;
+    t_sample **aOuts;
+    int nOutAlloc;
+    int blockSize;
+
+    char path[MAXPDSTRING];
+    t_convolver *conv;
+    int convIn; // inputs and block size of the latest design
+    int convBlock;
+    t_saf_designer designer;
+
+    t_saf_load load;
+} t_matrixconv_tilde;
+
+// ─────────────────────────────────────
+typedef struct _matrixconv_tilde_design {
+    char path[MAXPDSTRING];
+    int diagonal;
+    int nIn;
+    int nOut; // 0 to take the outputs from the file
+    int blockSize;
+} t_matrixconv_tilde_design;
+
+typedef struct _matrixconv_tilde_filters {
+    t_convolver *conv;
+    const char *error; // NULL when the design succeeded
+    int fs;            // sample rate of the filter file
+} t_matrixconv_tilde_filters;
+
+// ─────────────────────────────────────
+static t_convolver *matrixconv_tilde_newmatrix(const t_matrixconv_tilde_design *d,
+                                               const t_saf_firs *f, const char **error) {
+    // a WAV file holds the filters of all inputs one after the other, as for SAF's matrixconv
+    int nCols = f->nCols == 1 ? d->nIn : f->nCols;
+    int len = f->nCols == 1 ? f->len / d->nIn : f->len;
+    if (nCols != d->nIn) {
+        *error = "The SOFA file has one measurement per input, the number does not match";
+    } else if (d->nOut && f->nRows != d->nOut) {
+        *error = "The file has one channel (receiver) per output, the number does not match";
+    } else if (len < 1) {
+        *error = "The filters are shorter than the number of inputs";
+    } else if (f->nCols == 1 && f->len % d->nIn != 0) {
+        // len is also the stride between the filters, the rows would not line up
+        *error = "The length of the WAV file is not a multiple of the number of inputs";
+    } else {
+        return convolver_new(d->nIn, f->nRows, f->data, len, len, d->blockSize);
+    }
+    return NULL;
+}
+
+// ─────────────────────────────────────
+static t_convolver *matrixconv_tilde_newdiagonal(const t_matrixconv_tilde_design *d,
+                                                 const t_saf_firs *f, const char **error) {
+    // every channel (or receiver and measurement) of the file is a filter, a single one is
+    // shared by all channels
+    int nFilters = f->nRows * f->nCols;
+    if (nFilters == 1) {
+        float *h = (float *)getbytes((size_t)d->nIn * f->len * sizeof(float));
+        for (int ch = 0; ch < d->nIn; ch++) {
+            memcpy(h + (size_t)ch * f->len, f->data, f->len * sizeof(float));
+        }
+        t_convolver *c = convolver_newdiagonal(d->nIn, h, f->len, f->len, d->blockSize);
+        freebytes(h, (size_t)d->nIn * f->len * sizeof(float));
+        return c;
+    }
+    if (nFilters < d->nIn) {
+        *error = "The file has fewer filters than channels";
+        return NULL;
+    }
+    return convolver_newdiagonal(d->nIn, f->data, f->len, f->len, d->blockSize);
+}
+
+// ─────────────────────────────────────
+static void *matrixconv_tilde_designfilters(const void *args) {
+    const t_matrixconv_tilde_design *d = (const t_matrixconv_tilde_design *)args;
+    t_matrixconv_tilde_filters *r =
+        (t_matrixconv_tilde_filters *)getbytes(sizeof(t_matrixconv_tilde_filters));
+    t_saf_firs f;
+    if (saf_firs_load(&f, d->path, &r->error)) {
+        r->conv = d->diagonal ? matrixconv_tilde_newdiagonal(d, &f, &r->error)
+                              : matrixconv_tilde_newmatrix(d, &f, &r->error);
+        r->fs = f.fs;
+        saf_firs_free(&f);
+    }
+    return r;
+}
+
+// ─────────────────────────────────────
+static void matrixconv_tilde_discardfilters(void *result) {
+    t_matrixconv_tilde_filters *r = (t_matrixconv_tilde_filters *)result;
+    convolver_free(r->conv);
+    freebytes(r, sizeof(t_matrixconv_tilde_filters));
+}
+
+// ─────────────────────────────────────
+static void matrixconv_tilde_installfilters(t_pd *obj, const void *args, void *result) {
+    t_matrixconv_tilde *x = (t_matrixconv_tilde *)obj;
+    t_matrixconv_tilde_filters *r = (t_matrixconv_tilde_filters *)result;
+    (void)args;
+    if (!r->conv) {
+        // a file that cannot be used leaves the old filters playing
+        pd_error(x, "[%s] %s", x->name, r->error ? r->error : "Could not design the filters");
+        matrixconv_tilde_discardfilters(r);
+        return;
+    }
+    t_convolver *c = r->conv;
+    r->conv = x->conv;
+    x->conv = c;
+    if (x->diagonal) {
+        logpost(x, 3, "[%s] %d filters of %d samples loaded", x->name, c->nIn, c->length);
+    } else {
+        logpost(x, 3, "[%s] %d x %d filters of %d samples loaded", x->name, c->nOut, c->nIn,
+                c->length);
+    }
+    if (r->fs != (int)x->load.sr) {
+        logpost(x, 2, "[%s] The filters are at %d Hz, Pd runs at %d Hz", x->name, r->fs,
+                (int)x->load.sr);
+    }
+    matrixconv_tilde_discardfilters(r);
+    if (x->multichannel && !x->diagonal && c->nOut != x->nOut) {
+        x->nOut = c->nOut;
+        canvas_update_dsp(); // the outlet takes the channel count of the new filters
+    }
+}
+
+// ─────────────────────────────────────
+static void matrixconv_tilde_design(t_matrixconv_tilde *x) {
+    x->convIn = x->nIn;
+    x->convBlock = x->blockSize;
+    if (x->path[0] == '\0') {
+        return;
+    }
+    t_matrixconv_tilde_design d;
+    pd_snprintf(d.path, MAXPDSTRING, "%s", x->path);
+    d.diagonal = x->diagonal;
+    d.nIn = x->nIn;
+    d.nOut = x->multichannel || x->diagonal ? 0 : x->nOut;
+    d.blockSize = x->convBlock;
+    logpost(x, 2, "[%s] Loading %s...", x->name, x->path);
+    saf_designer_start(&x->designer, &d, sizeof(d));
+}
+
+// ╭─────────────────────────────────────╮
+// │               Methods               │
+// ╰─────────────────────────────────────╯
+static void matrixconv_tilde_set(t_matrixconv_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    if (argc < 2) {
+        pd_error(x, "[%s] Expected 'set <method> <value>'", x->name);
+        return;
+    }
+    const char *method = atom_getsymbol(argv)->s_name;
+    if (strcmp(method, "file") == 0) {
+        char dir[MAXPDSTRING];
+        char *name;
+        t_symbol *file = atom_getsymbol(argv + 1);
+        int fd = canvas_open(x->glist, file->s_name, "", dir, &name, MAXPDSTRING, 1);
+        if (fd < 0) {
+            pd_error(x, "[%s] Could not find %s", x->name, file->s_name);
+            return;
+        }
+        sys_close(fd);
+        pd_snprintf(x->path, MAXPDSTRING, "%s/%s", dir, name);
+    } else {
+        pd_error(x, "[%s] Unknown set method: %s", x->name, method);
+        return;
+    }
+    if (x->convBlock > 0) {
+        matrixconv_tilde_design(x);
+    }
+}
+
+// ─────────────────────────────────────
+static void matrixconv_tilde_loadreport(t_matrixconv_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void matrixconv_tilde_stats(t_matrixconv_tilde *x) {
+    saf_load_stats(&x->load);
+    t_convolver *c = x->conv;
+    if (!c) {
+        return;
+    }
+    unsigned late = c->tailSize ? atomic_load(&c->misses) : 0;
+    if (x->diagonal) {
+        logpost(x, 2, "[%s] %d channels, %d taps, %u late tail blocks", x->name, c->nIn,
+                c->length, late);
+        return;
+    }
+    int used = 0;
+    for (int q = 0; q < c->head.nPairs; q++) {
+        used += c->head.used[q];
+    }
+    logpost(x, 2,
+            "[%s] %d inputs, %d outputs, %d of %d filters non-zero, %d taps, %u late tail blocks",
+            x->name, c->nIn, c->nOut, used, c->head.nPairs, c->length, late);
+}
+
+// ╭─────────────────────────────────────╮
+// │     Initialization and Perform      │
+// ╰─────────────────────────────────────╯
+static void matrixconv_tilde_process(t_matrixconv_tilde *x, int n) {
+    // the filters are swapped on the main thread (designer.h), never while a block is convolved
+    t_convolver *c = x->conv;
+    if (c && c->nIn == x->nIn && c->nOut == x->nOut && c->blockSize == n) {
+        convolver_process(c, (const float *const *)x->aIns, (float *const *)x->aOuts);
+        return;
+    }
+    for (int ch = 0; ch < x->nOut; ch++) {
+        memset(x->aOuts[ch], 0, n * sizeof(t_sample));
+    }
+}
+
+// ─────────────────────────────────────
+t_int *matrixconv_tilde_performmultichannel(t_int *w) {
+    t_matrixconv_tilde *x = (t_matrixconv_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    t_sample *ins = (t_sample *)(w[3]);
+    t_sample *outs = (t_sample *)(w[4]);
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nIn; ch++) {
+        x->aIns[ch] = ins + ch * n;
+    }
+    for (int ch = 0; ch < x->nOut; ch++) {
+        x->aOuts[ch] = outs + ch * n;
+    }
+    matrixconv_tilde_process(x, n);
+    saf_load_end(&x->load, n);
+
+    return (w + 5);
+}
+
+// ─────────────────────────────────────
+t_int *matrixconv_tilde_perform(t_int *w) {
+    t_matrixconv_tilde *x = (t_matrixconv_tilde *)(w[1]);
+    int n = (int)(w[2]);
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nIn; ch++) {
+        x->aIns[ch] = (t_sample *)w[3 + ch];
+    }
+    for (int ch = 0; ch < x->nOut; ch++) {
+        x->aOuts[ch] = (t_sample *)w[3 + x->nIn + ch];
+    }
+    matrixconv_tilde_process(x, n);
+    saf_load_end(&x->load, n);
+
+    return (w + 3 + x->nIn + x->nOut);
+}
+
+// ─────────────────────────────────────
+void matrixconv_tilde_dsp(t_matrixconv_tilde *x, t_signal **sp) {
+    x->load.sr = sp[0]->s_sr;
+    x->blockSize = sp[0]->s_n;
+    if (x->multichannel) {
+        int nIn = sp[0]->s_nchans;
+        if (nIn != x->nIn) {
+            freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+            x->aIns = (const t_sample **)getbytes(nIn * sizeof(t_sample *));
+            x->nIn = nIn;
+        }
+        if (x->diagonal) {
+            x->nOut = x->nIn;
+        }
+        if (x->nOut != x->nOutAlloc) {
+            freebytes(x->aOuts, x->nOutAlloc * sizeof(t_sample *));
+            x->aOuts = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
+            x->nOutAlloc = x->nOut;
+        }
+    }
+
+    // partitions of one Pd block, the filters are transformed again when the block size changes
+    if (x->nIn != x->convIn || sp[0]->s_n != x->convBlock) {
+        matrixconv_tilde_design(x);
+    }
+
+    if (x->multichannel) {
+        signal_setmultiout(&sp[1], x->nOut);
+        dsp_add(matrixconv_tilde_performmultichannel, 4, x, sp[0]->s_n, sp[0]->s_vec,
+                sp[1]->s_vec);
+    } else {
+        int sum = x->nIn + x->nOut;
+        int sigvecsize = sum + 2;
+        for (int i = x->nIn; i < sum; i++) {
+            signal_setmultiout(&sp[i], 1);
+        }
+        t_int *sigvec = getbytes(sigvecsize * sizeof(t_int));
+        sigvec[0] = (t_int)x;
+        sigvec[1] = (t_int)sp[0]->s_n;
+        for (int i = 0; i < sum; i++) {
+            sigvec[2 + i] = (t_int)sp[i]->s_vec;
+        }
+        dsp_addv(matrixconv_tilde_perform, sigvecsize, sigvec);
+        freebytes(sigvec, sigvecsize * sizeof(t_int));
+    }
+}
+
+// ─────────────────────────────────────
+static void *matrixconv_tilde_create(t_class *c, int diagonal, int argc, t_atom *argv) {
+    t_matrixconv_tilde *x = (t_matrixconv_tilde *)pd_new(c);
+    x->glist = canvas_getcurrent();
+    x->name = class_getname(c);
+    x->diagonal = diagonal;
+
+    // [saf.matrixconv~ <inputs> <outputs>] or [saf.matrixconv~ -m], with -m the inputs follow
+    // the input channels and the outputs the filter file. [saf.multiconv~ <channels>] or
+    // [saf.multiconv~ -m] has one filter per channel.
+    int sizes[2] = {1, 1};
+    int nSizes = 0;
+    x->multichannel = 0;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type == A_SYMBOL && strcmp(atom_getsymbol(argv + i)->s_name, "-m") == 0) {
+            x->multichannel = 1;
+        } else if (argv[i].a_type == A_FLOAT && nSizes < 2) {
+            sizes[nSizes++] = atom_getint(argv + i);
+        }
+    }
+    x->nIn = sizes[0] < 1 ? 1 : sizes[0];
+    x->nOut = diagonal ? x->nIn : sizes[1] < 1 ? 1 : sizes[1];
+    x->nOutAlloc = x->nOut;
+    x->blockSize = 0;
+    x->aIns = (const t_sample **)getbytes(x->nIn * sizeof(t_sample *));
+    x->aOuts = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
+
+    x->path[0] = '\0';
+    x->conv = NULL;
+    x->convIn = 0;
+    x->convBlock = 0;
+    saf_designer_init(&x->designer, &x->obj.ob_pd, matrixconv_tilde_designfilters,
+                      matrixconv_tilde_installfilters, matrixconv_tilde_discardfilters);
+
+    saf_load_init(&x->load, &x->obj.ob_pd, x->name, 0, NULL);
+
+    if (x->multichannel) {
+        outlet_new(&x->obj, &s_signal);
+    } else {
+        for (int i = 1; i < x->nIn; i++) {
+            inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
+        }
+        for (int i = 0; i < x->nOut; i++) {
+            outlet_new(&x->obj, &s_signal);
+        }
+    }
+
+    return (void *)x;
+}
+
+// ─────────────────────────────────────
+void *matrixconv_tilde_new(t_symbol *s, int argc, t_atom *argv) {
+    (void)s;
+    return matrixconv_tilde_create(matrixconv_tilde_class, 0, argc, argv);
+}
+
+// ─────────────────────────────────────
+void *multiconv_tilde_new(t_symbol *s, int argc, t_atom *argv) {
+    (void)s;
+    return matrixconv_tilde_create(multiconv_tilde_class, 1, argc, argv);
+}
+
+// ─────────────────────────────────────
+void matrixconv_tilde_free(t_matrixconv_tilde *x) {
+    saf_load_free(&x->load);
+    saf_designer_free(&x->designer);
+    convolver_free(x->conv);
+    freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+    freebytes(x->aOuts, x->nOutAlloc * sizeof(t_sample *));
+}
+
+// ─────────────────────────────────────
+static t_class *matrixconv_tilde_newclass(const char *name, t_newmethod newmethod) {
+    t_class *c = class_new(gensym(name), newmethod, (t_method)matrixconv_tilde_free,
+                           sizeof(t_matrixconv_tilde), CLASS_DEFAULT | CLASS_MULTICHANNEL,
+                           A_GIMME, 0);
+    CLASS_MAINSIGNALIN(c, t_matrixconv_tilde, sample);
+    class_addmethod(c, (t_method)matrixconv_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(c, (t_method)matrixconv_tilde_set, gensym("set"), A_GIMME, 0);
+    class_addmethod(c, (t_method)matrixconv_tilde_stats, gensym("stats"), 0);
+    class_addmethod(c, (t_method)matrixconv_tilde_loadreport, gensym("saf_loadreport"), 0);
+    return c;
+}
+
+// ─────────────────────────────────────
+// clang-format off
+void setup_saf0x2ematrixconv_tilde(void) {
+    matrixconv_tilde_class = matrixconv_tilde_newclass("saf.matrixconv~", (t_newmethod)matrixconv_tilde_new);
+}
+
+// ─────────────────────────────────────
+void setup_saf0x2emulticonv_tilde(void) {
+    multiconv_tilde_class = matrixconv_tilde_newclass("saf.multiconv~", (t_newmethod)multiconv_tilde_new);
+}
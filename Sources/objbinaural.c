@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include "hrirs.h"
+#include "silence.h"
+#include "objbinaural.h"
+
+#define OBJBIN_PI 3.14159265f
+#define OBJBIN_NF_STEP 5.0f  // degrees between tabulated ear angles
+#define OBJBIN_NF_TAIL 1e-4f // the shelves are truncated once their pole has decayed to this
+#define OBJBIN_NF_MAX_TAIL 256
+
+// ─────────────────────────────────────
+// Multiplies n complex bins by exp(i * phi * k), a delay of -phi * nFFT / (2 * pi) samples.
+static void objbin_phase(float *h, int n, float phi) {
+    float stepRe = cosf(phi), stepIm = sinf(phi);
+    float re = 1.0f, im = 0.0f;
+    for (int k = 0; k < n; k++) {
+        float hr = h[2 * k], hi = h[2 * k + 1];
+        h[2 * k] = hr * re - hi * im;
+        h[2 * k + 1] = hr * im + hi * re;
+        float next = re * stepRe - im * stepIm;
+        im = re * stepIm + im * stepRe;
+        re = next;
+    }
+}
+
+// ─────────────────────────────────────
+// Multiplies the n bins of h by the DVF of a source at ear angle alpha (degrees) and inverse
+// distance u (0 at OBJBIN_NF_MAX, OBJBIN_NF_DISTANCES - 1 at OBJBIN_NF_MIN), interpolated between
+// the four surrounding tabulated responses.
+static void objbin_nearfield(const t_objbin *r, float *h, float alpha, float u) {
+    float v = alpha / OBJBIN_NF_STEP;
+    int a0 = (int)v;
+    a0 = a0 > OBJBIN_NF_ANGLES - 2 ? OBJBIN_NF_ANGLES - 2 : a0;
+    int d0 = (int)u;
+    d0 = d0 > OBJBIN_NF_DISTANCES - 2 ? OBJBIN_NF_DISTANCES - 2 : d0;
+    float fa = v - (float)a0, fd = u - (float)d0;
+    float w[4] = {(1.0f - fa) * (1.0f - fd), (1.0f - fa) * fd, fa * (1.0f - fd), fa * fd};
+    const float *t[4];
+    for (int i = 0; i < 4; i++) {
+        int row = (a0 + i / 2) * OBJBIN_NF_DISTANCES + d0 + i % 2;
+        t[i] = (const float *)(r->dvf + row * r->nBins);
+    }
+    for (int k = 0; k < 2 * r->nBins; k += 2) {
+        float re = w[0] * t[0][k] + w[1] * t[1][k] + w[2] * t[2][k] + w[3] * t[3][k];
+        float im =
+            w[0] * t[0][k + 1] + w[1] * t[1][k + 1] + w[2] * t[2][k + 1] + w[3] * t[3][k + 1];
+        float hr = h[k], hi = h[k + 1];
+        h[k] = hr * re - hi * im;
+        h[k + 1] = hr * im + hi * re;
+    }
+}
+
+// ─────────────────────────────────────
+// Interpolates the HRIRs of source s and hands them to the convolver.
+static void objbin_interp(t_objbin *r, int s, float azi, float ele, float dist, int crossfade) {
+    int nBins = r->nBins;
+    float a = fmodf(azi + 180.0f, 360.0f);
+    a = a < 0.0f ? a + 360.0f : a;
+    ele = ele > 90.0f ? 90.0f : (ele < -90.0f ? -90.0f : ele);
+    int aziIndex = (int)(a / OBJBIN_AZI_RES + 0.5f);
+    int eleIndex = (int)((ele + 90.0f) / OBJBIN_ELE_RES + 0.5f);
+    int row = eleIndex * r->nAzi + aziIndex;
+    const float *g = r->gains + 3 * row;
+    const int *d = r->idx + 3 * row;
+    float itd = g[0] * r->itds[d[0]] + g[1] * r->itds[d[1]] + g[2] * r->itds[d[2]];
+
+    // angle between the source and the left ear, the right ear sees its supplement
+    float alpha = 0.0f, u = -1.0f;
+    if (r->dvf && dist < OBJBIN_NF_MAX) {
+        float c = cosf(ele * OBJBIN_PI / 180.0f) * sinf(azi * OBJBIN_PI / 180.0f);
+        alpha = acosf(c > 1.0f ? 1.0f : (c < -1.0f ? -1.0f : c)) * 180.0f / OBJBIN_PI;
+        dist = dist < OBJBIN_NF_MIN ? OBJBIN_NF_MIN : dist;
+        u = (1.0f / dist - 1.0f / OBJBIN_NF_MAX) / (1.0f / OBJBIN_NF_MIN - 1.0f / OBJBIN_NF_MAX) *
+            (float)(OBJBIN_NF_DISTANCES - 1);
+    }
+
+    float *h = (float *)r->H;
+    for (int ear = 0; ear < NUM_EARS; ear++) {
+        memset(h, 0, nBins * sizeof(float_complex));
+        for (int i = 0; i < 3; i++) {
+            if (g[i] == 0.0f) {
+                continue;
+            }
+            const float *src = (const float *)(r->hrtfs + (d[i] * NUM_EARS + ear) * nBins);
+            for (int k = 0; k < 2 * nBins; k++) {
+                h[k] += g[i] * src[k];
+            }
+        }
+        // half of the ITD on each ear, undoing objbin_new
+        objbin_phase(h, nBins, (ear == 0 ? -1.0f : 1.0f) * OBJBIN_PI * itd / (float)r->nFFT);
+        if (u >= 0.0f) {
+            objbin_nearfield(r, h, ear == 0 ? alpha : 180.0f - alpha, u);
+        }
+        saf_rfft_backward(r->hFFT, r->H, r->time);
+        convolver_setfilter(r->conv, ear, s, r->time, r->filterSize, crossfade);
+    }
+    r->dirs[3 * s] = azi;
+    r->dirs[3 * s + 1] = ele;
+    r->dirs[3 * s + 2] = dist;
+}
+
+// ─────────────────────────────────────
+// Tabulates the DVF responses, normalised by the response at OBJBIN_NF_MAX so that sources do not
+// jump when they cross it. coeffs holds b0, b1 and a1 of every shelf.
+static void objbin_dvftable(t_objbin *r, const float *coeffs) {
+    int nBins = r->nBins;
+    r->dvf = (float_complex *)getbytes(OBJBIN_NF_ANGLES * OBJBIN_NF_DISTANCES * nBins *
+                                       sizeof(float_complex));
+    for (int row = 0; row < OBJBIN_NF_ANGLES * OBJBIN_NF_DISTANCES; row++) {
+        const float *c = coeffs + 3 * row;
+        float *t = (float *)(r->dvf + row * nBins);
+        for (int k = 0; k < nBins; k++) {
+            // (b0 + b1 z^-1) / (1 + a1 z^-1) at z = exp(i w)
+            float w = 2.0f * OBJBIN_PI * (float)k / (float)r->nFFT;
+            float zr = cosf(w), zi = -sinf(w);
+            float nr = c[0] + c[1] * zr, ni = c[1] * zi;
+            float dr = 1.0f + c[2] * zr, di = c[2] * zi;
+            float m = dr * dr + di * di;
+            t[2 * k] = (nr * dr + ni * di) / m;
+            t[2 * k + 1] = (ni * dr - nr * di) / m;
+        }
+    }
+    for (int a = 0; a < OBJBIN_NF_ANGLES; a++) {
+        float *ref = (float *)(r->dvf + a * OBJBIN_NF_DISTANCES * nBins);
+        for (int j = OBJBIN_NF_DISTANCES - 1; j >= 0; j--) {
+            float *t = (float *)(r->dvf + (a * OBJBIN_NF_DISTANCES + j) * nBins);
+            for (int k = 0; k < 2 * nBins; k += 2) {
+                float m = ref[k] * ref[k] + ref[k + 1] * ref[k + 1];
+                float re = (t[k] * ref[k] + t[k + 1] * ref[k + 1]) / m;
+                t[k + 1] = (t[k + 1] * ref[k] - t[k] * ref[k + 1]) / m;
+                t[k] = re;
+            }
+        }
+    }
+}
+
+// ─────────────────────────────────────
+t_objbin *objbin_new(const t_objbin_config *c, int nSrc, int blockSize, int fs) {
+    t_saf_hrirs h;
+    saf_hrirs_load(&h, c->useDefaultHRIRs, c->sofaPath, fs);
+
+    float *gtable = NULL;
+    int nTable = 0, nTriangles = 0;
+    generateVBAPgainTable3D(h.dirs, h.nDirs, OBJBIN_AZI_RES, OBJBIN_ELE_RES, 1, 0, 0.0f, &gtable,
+                            &nTable, &nTriangles);
+    if (!gtable || nTable == 0) {
+        saf_hrirs_free(&h);
+        return NULL;
+    }
+
+    t_objbin *r = (t_objbin *)getbytes(sizeof(t_objbin));
+    r->nSrc = nSrc;
+    r->length = h.len;
+    r->nDirs = h.nDirs;
+    r->nAzi = 360 / OBJBIN_AZI_RES + 1;
+    r->nTable = nTable;
+    r->gains = (float *)getbytes(nTable * 3 * sizeof(float));
+    r->idx = (int *)getbytes(nTable * 3 * sizeof(int));
+    compressVBAPgainTable3D(gtable, nTable, h.nDirs, r->gains, r->idx);
+    free(gtable);
+    for (int row = 0; row < nTable; row++) {
+        float *g = r->gains + 3 * row;
+        float sum = g[0] + g[1] + g[2];
+        for (int i = 0; i < 3 && sum > 0.0f; i++) {
+            g[i] /= sum;
+        }
+    }
+
+    // removing half of the ITD moves the HRIRs by up to maxShift samples either way, the filters
+    // leave room for it so that the interpolated HRIRs do not wrap around
+    r->itds = (float *)getbytes(h.nDirs * sizeof(float));
+    estimateITDs(h.hrirs, h.nDirs, h.len, fs, r->itds);
+    float maxShift = 0.0f;
+    for (int d = 0; d < h.nDirs; d++) {
+        r->itds[d] *= (float)fs;
+        maxShift = fabsf(r->itds[d]) / 2.0f > maxShift ? fabsf(r->itds[d]) / 2.0f : maxShift;
+    }
+
+    // the shelves are designed first, their decay also has to fit in the filters
+    float *coeffs = NULL;
+    float maxPole = 0.0f;
+    if (c->nearField) {
+        coeffs = (float *)getbytes(OBJBIN_NF_ANGLES * OBJBIN_NF_DISTANCES * 3 * sizeof(float));
+        for (int a = 0; a < OBJBIN_NF_ANGLES; a++) {
+            for (int j = 0; j < OBJBIN_NF_DISTANCES; j++) {
+                float inv = 1.0f / OBJBIN_NF_MAX + (1.0f / OBJBIN_NF_MIN - 1.0f / OBJBIN_NF_MAX) *
+                                                       (float)j / (float)(OBJBIN_NF_DISTANCES - 1);
+                float rho = 1.0f / inv / OBJBIN_HEAD_RADIUS;
+                float b[2], ab[2];
+                calcDVFCoeffs((float)a * OBJBIN_NF_STEP, rho, (float)fs, b, ab);
+                float *co = coeffs + 3 * (a * OBJBIN_NF_DISTANCES + j);
+                co[0] = b[0] / ab[0];
+                co[1] = b[1] / ab[0];
+                co[2] = ab[1] / ab[0];
+                maxPole = fabsf(co[2]) > maxPole ? fabsf(co[2]) : maxPole;
+            }
+        }
+    }
+    int tail = 0;
+    if (maxPole >= OBJBIN_NF_TAIL) {
+        tail = (int)ceilf(logf(OBJBIN_NF_TAIL) / logf(maxPole));
+        tail = tail > OBJBIN_NF_MAX_TAIL ? OBJBIN_NF_MAX_TAIL : tail;
+    }
+
+    r->filterSize = 1;
+    while (r->filterSize < h.len + (int)ceilf(maxShift) + 1 + tail) {
+        r->filterSize <<= 1;
+    }
+    r->nFFT = 2 * r->filterSize;
+    r->nBins = r->filterSize + 1;
+    saf_rfft_create(&r->hFFT, r->nFFT);
+    if (coeffs) {
+        objbin_dvftable(r, coeffs);
+        freebytes(coeffs, OBJBIN_NF_ANGLES * OBJBIN_NF_DISTANCES * 3 * sizeof(float));
+    }
+
+    int nBins = r->nBins;
+    r->hrtfs = (float_complex *)getbytes(h.nDirs * NUM_EARS * nBins * sizeof(float_complex));
+    r->time = (float *)getbytes(r->nFFT * sizeof(float));
+    for (int d = 0; d < h.nDirs; d++) {
+        for (int ear = 0; ear < NUM_EARS; ear++) {
+            float_complex *H = r->hrtfs + (d * NUM_EARS + ear) * nBins;
+            memset(r->time, 0, r->nFFT * sizeof(float));
+            memcpy(r->time, h.hrirs + (d * NUM_EARS + ear) * h.len, h.len * sizeof(float));
+            saf_rfft_forward(r->hFFT, r->time, H);
+            float phi = (ear == 0 ? 1.0f : -1.0f) * OBJBIN_PI * r->itds[d] / (float)r->nFFT;
+            objbin_phase((float *)H, nBins, phi);
+        }
+    }
+    saf_hrirs_free(&h);
+
+    r->blockSize = blockSize;
+    r->dirs = (float *)getbytes(nSrc * 3 * sizeof(float));
+    r->set = (unsigned char *)getbytes(nSrc);
+    r->H = (float_complex *)getbytes(nBins * sizeof(float_complex));
+    r->conv = convolver_newvariable(nSrc, NUM_EARS, r->filterSize, blockSize);
+    return r;
+}
+
+// ─────────────────────────────────────
+void objbin_free(t_objbin *r) {
+    if (!r) {
+        return;
+    }
+    int nSrc = r->nSrc;
+    int nBins = r->nBins;
+    freebytes(r->hrtfs, r->nDirs * NUM_EARS * nBins * sizeof(float_complex));
+    freebytes(r->itds, r->nDirs * sizeof(float));
+    freebytes(r->gains, r->nTable * 3 * sizeof(float));
+    freebytes(r->idx, r->nTable * 3 * sizeof(int));
+    if (r->dvf) {
+        freebytes(r->dvf, OBJBIN_NF_ANGLES * OBJBIN_NF_DISTANCES * nBins * sizeof(float_complex));
+    }
+    freebytes(r->dirs, nSrc * 3 * sizeof(float));
+    freebytes(r->set, nSrc);
+    freebytes(r->H, nBins * sizeof(float_complex));
+    freebytes(r->time, r->nFFT * sizeof(float));
+    convolver_free(r->conv);
+    saf_rfft_destroy(&r->hFFT);
+    freebytes(r, sizeof(t_objbin));
+}
+
+// ─────────────────────────────────────
+int objbin_quiet(const t_objbin *r, int s) {
+    return r->conv->head.quiet[s] > r->conv->head.nParts;
+}
+
+// ─────────────────────────────────────
+void objbin_process(t_objbin *r, const float *const *ins, float *const *outs, const float *dirs,
+                    const float *dists) {
+    for (int s = 0; s < r->nSrc; s++) {
+        float dist = dists ? dists[s] : OBJBIN_NF_MAX;
+        if (!r->set[s] || dirs[2 * s] != r->dirs[3 * s] || dirs[2 * s + 1] != r->dirs[3 * s + 1] ||
+            dist != r->dirs[3 * s + 2]) {
+            // a silent source has nothing to crossfade
+            int crossfade = r->set[s] && !objbin_quiet(r, s);
+            objbin_interp(r, s, dirs[2 * s], dirs[2 * s + 1], dist, crossfade);
+            r->set[s] = 1;
+        }
+    }
+    convolver_process(r->conv, ins, outs);
+}
@@ -0,0 +1,80 @@
+#ifndef SAF_OBJBINAURAL_H
+#define SAF_OBJBINAURAL_H
+
+#include <m_pd.h>
+#include <_common.h>
+#include <saf.h>
+
+#include "convolver.h"
+
+// ─────────────────────────────────────
+// Object-based binaural renderer used by [saf.binauraliser~]. Every source gets its own HRTF pair,
+// interpolated from the three HRTFs of the VBAP triangle around it. The gains and indices of the
+// triangles are tabulated once per HRIR set on the same 2 x 5 degree grid as the binauraliser of
+// SAF, so moving a source costs a table lookup and the sum of three spectra per ear. The HRTFs are
+// stored with their ITD removed and the interpolated ITD is put back as a linear phase, otherwise
+// summing three HRTFs with different delays would comb filter.
+//
+// The interpolated HRIRs of every source are convolved on a variable t_convolver (convolver.h),
+// uniformly partitioned by the Pd block, so the renderer adds no latency of its own. Every source
+// is transformed once per block and shared by both ears, the sources are summed in the frequency
+// domain with one inverse FFT per ear, and sources that have been silent for longer than the HRIRs
+// are skipped. A moved source gets new filters, crossfaded by the convolver over one block, which
+// costs one inverse FFT of the interpolated HRTFs and the partitions of the new HRIR per ear.
+//
+// With nearField set, sources closer than OBJBIN_NF_MAX also get the distance variation function
+// (DVF) that SAF's binauraliser_nf applies, a first-order shelf per ear that depends on the angle
+// between the source and the ear and on the distance. Instead of designing the shelves whenever a
+// source moves, their frequency responses are tabulated once per design on a grid of ear angles
+// and inverse distances, shared by all sources and both ears. A moving near source then costs the
+// bilinear interpolation of four tabulated responses per ear on top of the HRTF interpolation.
+#define OBJBIN_MAX_SOURCES 256
+#define OBJBIN_AZI_RES 2 // degrees
+#define OBJBIN_ELE_RES 5
+#define OBJBIN_HEAD_RADIUS 0.09096f // metres, as in the DVF model of SAF
+#define OBJBIN_NF_MIN 0.15f         // closest distance in metres, closer sources are clamped
+#define OBJBIN_NF_MAX 3.0f          // far field from here on
+#define OBJBIN_NF_ANGLES 37         // ear angles 0 to 180 degrees in 5 degree steps
+#define OBJBIN_NF_DISTANCES 32      // steps of 1 / distance between OBJBIN_NF_MAX and OBJBIN_NF_MIN
+
+typedef struct _objbin_config {
+    int useDefaultHRIRs;
+    int nearField;
+    char sofaPath[MAXPDSTRING];
+} t_objbin_config;
+
+typedef struct _objbin {
+    int nSrc;
+    int blockSize;
+    int filterSize; // the interpolated HRIRs, shifted by their ITD, fit in it
+    int nFFT;       // 2 x filterSize
+    int nBins;
+    int length; // HRIR length in samples
+    int nDirs;
+    int nAzi;
+    int nTable;
+    void *hFFT;
+    float_complex *hrtfs; // nDirs x NUM_EARS x nBins, ITD removed
+    float *itds;          // nDirs, in samples
+    float *gains;         // nTable x 3
+    int *idx;             // nTable x 3
+    float_complex *dvf;   // OBJBIN_NF_ANGLES x OBJBIN_NF_DISTANCES x nBins, NULL in the far field
+
+    float *dirs;        // nSrc x 3, azimuth, elevation and distance of the current filters
+    unsigned char *set; // the filters have been interpolated once
+    float_complex *H;   // nBins, interpolated HRTF
+    float *time;        // nFFT
+    t_convolver *conv;  // NUM_EARS x nSrc filters of filterSize samples
+} t_objbin;
+
+// ─────────────────────────────────────
+t_objbin *objbin_new(const t_objbin_config *c, int nSrc, int blockSize, int fs);
+void objbin_free(t_objbin *r);
+// Renders one block of blockSize samples. dirs holds the azimuth and elevation of every source in
+// degrees, dists their distance in metres and may be NULL without nearField.
+void objbin_process(t_objbin *r, const float *const *ins, float *const *outs, const float *dirs,
+                    const float *dists);
+// Sources that are skipped because they have been silent for longer than the HRIRs.
+int objbin_quiet(const t_objbin *r, int s);
+
+#endif
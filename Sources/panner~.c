@@ -4,6 +4,8 @@
 #include <g_canvas.h>
 
 #include "utilities.h"
+#include "governor.h"
+#include "silence.h"
 #include <panner.h>
 
 static t_class *panner_tilde_class;
@@ -33,6 +35,9 @@ typedef struct _panner_tilde {
     int nPreviousOut;
 
     int multichannel;
+
+    t_saf_load load;
+    t_saf_idle idle;
 } t_panner_tilde;
 
 // ─────────────────────────────────────
@@ -110,6 +115,34 @@ static void panner_tilde_set(t_panner_tilde *x, t_symbol *s, int argc, t_atom *a
     }
 }
 
+// ─────────────────────────────────────
+static void panner_tilde_process(t_panner_tilde *x, t_sample **ins, t_sample **outs) {
+    if (saf_idle_check(&x->idle, ins, x->nIn, x->nAmbiFrameSize)) {
+        saf_idle_zero(outs, x->nOut, x->nAmbiFrameSize);
+        saf_load_frame(&x->load, 1);
+        return;
+    }
+    saf_load_frame(&x->load, 0);
+    panner_process(x->hAmbi, (const float *const *)ins, (float *const *)outs, x->nIn, x->nOut,
+                   x->nAmbiFrameSize);
+}
+
+// ─────────────────────────────────────
+static void panner_tilde_loadreport(t_panner_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void panner_tilde_stats(t_panner_tilde *x) {
+    saf_load_stats(&x->load);
+}
+
+// ─────────────────────────────────────
+static void panner_tilde_idle(t_panner_tilde *x, t_floatarg f) {
+    // skip panning once all sources are silent and the STFT delay has been flushed
+    x->idle.enable = f != 0;
+}
+
 // ─────────────────────────────────────
 t_int *panner_tilde_performmultichannel(t_int *w) {
     t_panner_tilde *x = (t_panner_tilde *)(w[1]);
@@ -117,6 +150,7 @@ t_int *panner_tilde_performmultichannel(t_int *w) {
     t_sample *ins = (t_sample *)(w[3]);
     t_sample *outs = (t_sample *)(w[4]);
 
+    saf_load_begin(&x->load);
     if (n < x->nAmbiFrameSize) {
         for (int ch = 0; ch < x->nIn; ch++) {
             memcpy(x->aIns[ch] + x->nInAccIndex, ins + (n * ch), n * sizeof(t_sample));
@@ -125,8 +159,7 @@ t_int *panner_tilde_performmultichannel(t_int *w) {
 
         // Process only if a full frame is ready
         if (x->nInAccIndex == x->nAmbiFrameSize) {
-            panner_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                           x->nIn, x->nOut, x->nAmbiFrameSize);
+            panner_tilde_process(x, x->aIns, x->aOuts);
             x->nInAccIndex = 0;
             x->nOutAccIndex = 0; // Reset for the next frame
         }
@@ -151,8 +184,7 @@ t_int *panner_tilde_performmultichannel(t_int *w) {
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
             // Processa o bloco atual
-            panner_process(x->hAmbi, (const float *const *)x->aInsTmp, (float *const *)x->aOutsTmp,
-                           x->nIn, x->nOut, x->nAmbiFrameSize);
+            panner_tilde_process(x, x->aInsTmp, x->aOutsTmp);
 
             t_sample *out = (t_sample *)(w[4]);
             // Copia o resultado para os canais de saída com o offset correto
@@ -162,6 +194,7 @@ t_int *panner_tilde_performmultichannel(t_int *w) {
             }
         }
     }
+    saf_load_end(&x->load, n);
 
     return (w + 5);
 }
@@ -171,14 +204,14 @@ t_int *panner_tilde_perform(t_int *w) {
     t_panner_tilde *x = (t_panner_tilde *)(w[1]);
     int n = (int)(w[2]);
 
+    saf_load_begin(&x->load);
     if (n < x->nAmbiFrameSize) {
         for (int ch = 0; ch < x->nIn; ch++) {
             memcpy(x->aIns[ch] + x->nInAccIndex, (t_sample *)w[3 + ch], n * sizeof(t_sample));
         }
         x->nInAccIndex += n;
         if (x->nInAccIndex == x->nAmbiFrameSize) {
-            panner_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                           x->nIn, x->nOut, x->nAmbiFrameSize);
+            panner_tilde_process(x, x->aIns, x->aOuts);
             x->nInAccIndex = 0;
             x->nOutAccIndex = 0;
         }
@@ -194,8 +227,7 @@ t_int *panner_tilde_perform(t_int *w) {
                 memcpy(x->aInsTmp[ch], (t_sample *)w[3 + ch] + (chunkIndex * x->nAmbiFrameSize),
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
-            panner_process(x->hAmbi, (const float *const *)x->aInsTmp, (float *const *)x->aOutsTmp,
-                           x->nIn, x->nOut, x->nAmbiFrameSize);
+            panner_tilde_process(x, x->aInsTmp, x->aOutsTmp);
             for (int ch = 0; ch < x->nOut; ch++) {
                 t_sample *out = (t_sample *)(w[3 + x->nIn + ch]);
                 memcpy(out + (chunkIndex * x->nAmbiFrameSize), x->aOutsTmp[ch],
@@ -203,6 +235,7 @@ t_int *panner_tilde_perform(t_int *w) {
             }
         }
     }
+    saf_load_end(&x->load, n);
 
     return (w + 3 + x->nIn + x->nOut);
 }
@@ -218,6 +251,9 @@ void panner_tilde_dsp(t_panner_tilde *x, t_signal **sp) {
 
     x->nAmbiFrameSize = panner_getFrameSize();
     x->nPdFrameSize = sp[0]->s_n;
+    x->load.sr = sp[0]->s_sr;
+    saf_idle_settail(&x->idle,
+                     saf_idle_frames(panner_getProcessingDelay(), x->nAmbiFrameSize) + 1);
     x->nOutAccIndex = 0;
     x->nInAccIndex = 0;
 
@@ -299,6 +335,9 @@ void *panner_tilde_new(t_symbol *s, int argc, t_atom *argv) {
     x->nIn = num_sources;
     x->nOut = num_speakers;
 
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.panner~", 0, NULL);
+    saf_idle_init(&x->idle, 0);
+
     if (x->multichannel) {
         outlet_new(&x->obj, &s_signal);
     } else {
@@ -316,6 +355,7 @@ void *panner_tilde_new(t_symbol *s, int argc, t_atom *argv) {
 // ─────────────────────────────────────
 void panner_tilde_free(t_panner_tilde *x) {
     panner_destroy(&x->hAmbi);
+    saf_load_free(&x->load);
     for (int i = 0; i < x->nIn; i++) {
         if (x->aIns) {
             freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
@@ -361,4 +401,7 @@ void setup_saf0x2epanner_tilde(void) {
     class_addmethod(panner_tilde_class, (t_method)panner_tilde_set, gensym("speaker"), A_GIMME, 0);
     class_addmethod(panner_tilde_class, (t_method)panner_tilde_set, gensym("dtt"), A_GIMME, 0);
     class_addmethod(panner_tilde_class, (t_method)panner_tilde_set, gensym("spread"), A_GIMME, 0);
+    class_addmethod(panner_tilde_class, (t_method)panner_tilde_idle, gensym("idle"), A_FLOAT, 0);
+    class_addmethod(panner_tilde_class, (t_method)panner_tilde_stats, gensym("stats"), 0);
+    class_addmethod(panner_tilde_class, (t_method)panner_tilde_loadreport, gensym("saf_loadreport"), 0);
 }
@@ -1,11 +1,16 @@
 #include <string.h>
 #include <math.h>
-#include <pthread.h>
 
 #include <m_pd.h>
 #include <g_canvas.h>
 
-#include <pitch_shifter.h>
+#include "utilities.h"
+#include "governor.h"
+#include "designer.h"
+#include "pvshift.h"
+
+#define PITCHSHIFTER_DEFAULT_FFT 2048
+#define PITCHSHIFTER_DEFAULT_OSAMP 4
 
 static t_class *pitchshifter_tilde_class;
 
@@ -14,88 +19,191 @@ typedef struct _pitchshifter_tilde {
     t_object obj;
     t_sample sample;
 
-    void *hAmbi;
-    unsigned hAmbiInit;
-
-    t_sample **aIns;
+    int nOrder;
+    int nIn; // (order + 1)^2 in and out, or the input channels with -m
+    int multichannel;
+    const t_sample **aIns;
     t_sample **aOuts;
-    t_sample **aInsTmp;
-    t_sample **aOutsTmp;
 
-    int nAmbiFrameSize;
-    int nPdFrameSize;
-    int nInAccIndex;
-    int nOutAccIndex;
+    float factor;
+    int fftSize;
+    int osamp;
+    t_pvshift *pvshift;
+    int pvshiftCh; // channels of the latest design
+    t_saf_designer designer;
+    t_pvshift *pvshiftOld; // previous state, still playing while the new one warms up
+    int pvshiftFade;
+    int pvshiftWarm; // samples run through the new state
+    t_sample **aTmp; // nTmp x blockSize, output of the new state during the crossfade
+    int nTmp;
+    int blockSize;
+    t_clock *freeClock;
+
+    t_saf_load load;
+} t_pitchshifter_tilde;
 
-    int nOrder;
-    int nIn;
-    int nOut;
-    int nPreviousIn;
-    int nPreviousOut;
+// ─────────────────────────────────────
+typedef struct _pitchshifter_tilde_design {
+    int nCh;
+    int fftSize;
+    int osamp;
+} t_pitchshifter_tilde_design;
 
-    int multichannel;
-} t_pitchshifter_tilde;
+// ─────────────────────────────────────
+static void *pitchshifter_tilde_designpvshift(const void *args) {
+    const t_pitchshifter_tilde_design *d = (const t_pitchshifter_tilde_design *)args;
+    return pvshift_new(d->nCh, d->fftSize, d->osamp);
+}
 
 // ─────────────────────────────────────
-static void pitchshifter_tilde_malloc(t_pitchshifter_tilde *x) {
-    if (x->aIns) {
-        for (int i = 0; i < x->nIn; i++) {
-            if (x->aIns[i]) {
-                freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
-            }
-            if (x->aInsTmp[i]) {
-                freebytes(x->aInsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
-            }
-        }
-        freebytes(x->aIns, x->nIn * sizeof(t_sample *));
-    }
-    if (x->aOuts) {
-        for (int i = 0; i < x->nOut; i++) {
-            if (x->aOuts[i]) {
-                freebytes(x->aOuts[i], x->nAmbiFrameSize * sizeof(t_sample));
-            }
-            if (x->aOutsTmp[i]) {
-                freebytes(x->aOutsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
-            }
-        }
-        freebytes(x->aOuts, x->nOut * sizeof(t_sample *));
-    }
+static void pitchshifter_tilde_discardpvshift(void *result) {
+    pvshift_free((t_pvshift *)result);
+}
 
-    // memory allocation
-    x->aIns = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
-    x->aInsTmp = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
-    x->aOuts = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
-    x->aOutsTmp = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
+// ─────────────────────────────────────
+static void pitchshifter_tilde_freeold(t_pitchshifter_tilde *x) {
+    // the clock runs on the main thread, perform has already let go of the old state
+    if (!x->pvshiftFade) {
+        pvshift_free(x->pvshiftOld);
+        x->pvshiftOld = NULL;
+    }
+}
 
-    for (int i = 0; i < x->nIn; i++) {
-        x->aIns[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
-        x->aInsTmp[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
+// ─────────────────────────────────────
+static void pitchshifter_tilde_installpvshift(t_pd *obj, const void *args, void *result) {
+    t_pitchshifter_tilde *x = (t_pitchshifter_tilde *)obj;
+    t_pvshift *p = (t_pvshift *)result;
+    (void)args;
+    if (!p) {
+        pd_error(x, "[saf.pitchshifter~] Could not allocate the phase vocoder");
+        return;
     }
-    for (int i = 0; i < x->nOut; i++) {
-        x->aOuts[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
-        x->aOutsTmp[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
+    // the old state keeps playing until the new one has filled its FIFOs, then they are
+    // crossfaded over one hop of the new state
+    pvshift_free(x->pvshiftOld);
+    x->pvshiftOld = NULL;
+    x->pvshiftFade = 0;
+    if (x->pvshift && x->pvshift->nCh == p->nCh && x->nTmp == p->nCh) {
+        x->pvshiftOld = x->pvshift;
+        x->pvshiftFade = 1;
+        x->pvshiftWarm = 0;
+    } else {
+        pvshift_free(x->pvshift);
     }
-    x->nPreviousIn = x->nIn;
-    x->nPreviousOut = x->nOut;
+    x->pvshift = p;
+    logpost(x, 3, "[saf.pitchshifter~] FFT of %d, oversampling %d, latency of %d samples",
+            p->fftSize, p->osamp, p->fftSize);
+}
+
+// ─────────────────────────────────────
+static void pitchshifter_tilde_design(t_pitchshifter_tilde *x) {
+    t_pitchshifter_tilde_design d;
+    d.nCh = x->nIn;
+    d.fftSize = x->fftSize;
+    d.osamp = x->osamp;
+    x->pvshiftCh = d.nCh;
+    saf_designer_start(&x->designer, &d, sizeof(d));
+}
+
+// ╭─────────────────────────────────────╮
+// │               Methods               │
+// ╰─────────────────────────────────────╯
+static int pitchshifter_tilde_pow2(int n) {
+    return n > 0 && (n & (n - 1)) == 0;
 }
 
 // ─────────────────────────────────────
 static void pitchshifter_tilde_set(t_pitchshifter_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    pd_assert(x, argc >= 2, "[saf.pitchshifter~] Expected 'set <method> <value>'");
     const char *method = atom_getsymbol(argv)->s_name;
-
     if (strcmp(method, "cents") == 0) {
-        float cents = atom_getfloat(argv + 1);
-        float factor = pow(2, cents / 1200.0);
-        post("factor is %f", factor);
-        pitch_shifter_setPitchShiftFactor(x->hAmbi, factor);
+        x->factor = powf(2.0f, atom_getfloat(argv + 1) / 1200.0f);
+        return;
     } else if (strcmp(method, "factor") == 0) {
         float factor = atom_getfloat(argv + 1);
-        pitch_shifter_setPitchShiftFactor(x->hAmbi, factor);
+        pd_assert(x, factor > 0, "[saf.pitchshifter~] Factor must be greater than 0");
+        x->factor = factor;
+        return;
     } else if (strcmp(method, "osamp") == 0) {
-        float osamp = atom_getfloat(argv + 1);
-        pitch_shifter_setOSampOption(x->hAmbi, osamp);
+        int osamp = atom_getint(argv + 1);
+        pd_assert(x, pitchshifter_tilde_pow2(osamp) && osamp >= PVSHIFT_MIN_OSAMP,
+                  "[saf.pitchshifter~] Oversampling must be a power of 2, at least 4");
+        pd_assert(x, osamp <= x->fftSize / 16,
+                  "[saf.pitchshifter~] Oversampling too high for the FFT size");
+        x->osamp = osamp;
     } else if (strcmp(method, "fftsize") == 0) {
-        // TODO: NEED TO REALLOC MEMORY THE FFT SIZE
+        int fftSize = atom_getint(argv + 1);
+        pd_assert(x,
+                  pitchshifter_tilde_pow2(fftSize) && fftSize >= PVSHIFT_MIN_FFT &&
+                      fftSize <= PVSHIFT_MAX_FFT,
+                  "[saf.pitchshifter~] FFT size must be a power of 2 from 256 to 16384");
+        pd_assert(x, x->osamp <= fftSize / 16,
+                  "[saf.pitchshifter~] FFT size too small for the oversampling");
+        x->fftSize = fftSize;
+    } else {
+        pd_error(x, "[saf.pitchshifter~] Unknown set method: %s", method);
+        return;
+    }
+    if (x->pvshiftCh > 0) {
+        pitchshifter_tilde_design(x);
+    }
+}
+
+// ─────────────────────────────────────
+static void pitchshifter_tilde_loadreport(t_pitchshifter_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void pitchshifter_tilde_stats(t_pitchshifter_tilde *x) {
+    saf_load_stats(&x->load);
+    if (x->pvshift) {
+        logpost(x, 2,
+                "[saf.pitchshifter~] %d channels, factor %.4f, FFT of %d, oversampling %d, "
+                "latency of %d samples",
+                x->pvshift->nCh, x->factor, x->pvshift->fftSize, x->pvshift->osamp,
+                x->pvshift->fftSize);
+    }
+}
+
+// ╭─────────────────────────────────────╮
+// │     Initialization and Perform      │
+// ╰─────────────────────────────────────╯
+static void pitchshifter_tilde_crossfade(t_pitchshifter_tilde *x, int n) {
+    t_pvshift *p = x->pvshift;
+    // the new state first, outs may share the buffers of ins
+    pvshift_process(p, (const float *const *)x->aIns, (float *const *)x->aTmp, n, x->factor);
+    pvshift_process(x->pvshiftOld, (const float *const *)x->aIns, (float *const *)x->aOuts, n,
+                    x->factor);
+    int start = p->fftSize - x->pvshiftWarm;
+    for (int ch = 0; ch < x->nIn; ch++) {
+        for (int i = start < 0 ? 0 : start; i < n; i++) {
+            float g = (float)(x->pvshiftWarm + i - p->fftSize) / (float)p->step;
+            g = g > 1.0f ? 1.0f : g;
+            x->aOuts[ch][i] += g * (x->aTmp[ch][i] - x->aOuts[ch][i]);
+        }
+    }
+    x->pvshiftWarm += n;
+    if (x->pvshiftWarm >= p->fftSize + p->step) {
+        x->pvshiftFade = 0;
+        clock_delay(x->freeClock, 0);
+    }
+}
+
+// ─────────────────────────────────────
+static void pitchshifter_tilde_process(t_pitchshifter_tilde *x, int n) {
+    // the state is swapped on the main thread (designer.h), never while a block is processed
+    t_pvshift *p = x->pvshift;
+    if (p && p->nCh == x->nIn) {
+        if (x->pvshiftFade && x->nTmp == x->nIn && x->blockSize == n) {
+            pitchshifter_tilde_crossfade(x, n);
+            return;
+        }
+        pvshift_process(p, (const float *const *)x->aIns, (float *const *)x->aOuts, n, x->factor);
+        return;
+    }
+    for (int ch = 0; ch < x->nIn; ch++) {
+        memset(x->aOuts[ch], 0, n * sizeof(t_sample));
     }
 }
 
@@ -106,51 +214,13 @@ t_int *pitchshifter_tilde_performmultichannel(t_int *w) {
     t_sample *ins = (t_sample *)(w[3]);
     t_sample *outs = (t_sample *)(w[4]);
 
-    if (n < x->nAmbiFrameSize) {
-        for (int ch = 0; ch < x->nIn; ch++) {
-            memcpy(x->aIns[ch] + x->nInAccIndex, ins + (n * ch), n * sizeof(t_sample));
-        }
-        x->nInAccIndex += n;
-
-        // Process only if a full frame is ready
-        if (x->nInAccIndex == x->nAmbiFrameSize) {
-            pitch_shifter_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                                  x->nIn, x->nOut, x->nAmbiFrameSize);
-            x->nInAccIndex = 0;
-            x->nOutAccIndex = 0; // Reset for the next frame
-        }
-
-        if (x->nOutAccIndex + n <= x->nAmbiFrameSize) {
-            // Copy valid processed data
-            for (int ch = 0; ch < x->nOut; ch++) {
-                memcpy(outs + (n * ch), x->aOuts[ch] + x->nOutAccIndex, n * sizeof(t_sample));
-            }
-            x->nOutAccIndex += n;
-        } else {
-            for (int ch = 0; ch < x->nOut; ch++) {
-                memset(outs + (n * ch), 0, n * sizeof(t_sample));
-            }
-        }
-    } else {
-        int chunks = n / x->nAmbiFrameSize;
-        for (int chunkIndex = 0; chunkIndex < chunks; chunkIndex++) {
-            // Copia os dados de entrada para cada canal
-            for (int ch = 0; ch < x->nIn; ch++) {
-                memcpy(x->aInsTmp[ch], (t_sample *)w[3] + ch * n + chunkIndex * x->nAmbiFrameSize,
-                       x->nAmbiFrameSize * sizeof(t_sample));
-            }
-            // Processa o bloco atual
-            pitch_shifter_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                                  (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
-
-            t_sample *out = (t_sample *)(w[4]);
-            // Copia o resultado para os canais de saída com o offset correto
-            for (int ch = 0; ch < x->nOut; ch++) {
-                memcpy(out + ch * n + chunkIndex * x->nAmbiFrameSize, x->aOutsTmp[ch],
-                       x->nAmbiFrameSize * sizeof(t_sample));
-            }
-        }
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nIn; ch++) {
+        x->aIns[ch] = ins + ch * n;
+        x->aOuts[ch] = outs + ch * n;
     }
+    pitchshifter_tilde_process(x, n);
+    saf_load_end(&x->load, n);
 
     return (w + 5);
 }
@@ -160,76 +230,62 @@ t_int *pitchshifter_tilde_perform(t_int *w) {
     t_pitchshifter_tilde *x = (t_pitchshifter_tilde *)(w[1]);
     int n = (int)(w[2]);
 
-    if (n < x->nAmbiFrameSize) {
-        for (int ch = 0; ch < x->nIn; ch++) {
-            memcpy(x->aIns[ch] + x->nInAccIndex, (t_sample *)w[3 + ch], n * sizeof(t_sample));
-        }
-        x->nInAccIndex += n;
-        if (x->nInAccIndex == x->nAmbiFrameSize) {
-            pitch_shifter_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                                  x->nIn, x->nOut, x->nAmbiFrameSize);
-            x->nInAccIndex = 0;
-            x->nOutAccIndex = 0;
-        }
-        for (int ch = 0; ch < x->nOut; ch++) {
-            t_sample *out = (t_sample *)(w[3 + x->nIn + ch]);
-            memcpy(out, x->aOuts[ch] + x->nOutAccIndex, n * sizeof(t_sample));
-        }
-        x->nOutAccIndex += n;
-    } else {
-        int chunks = n / x->nAmbiFrameSize;
-        for (int chunkIndex = 0; chunkIndex < chunks; chunkIndex++) {
-            for (int ch = 0; ch < x->nIn; ch++) {
-                memcpy(x->aInsTmp[ch], (t_sample *)w[3 + ch] + (chunkIndex * x->nAmbiFrameSize),
-                       x->nAmbiFrameSize * sizeof(t_sample));
-            }
-            pitch_shifter_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                                  (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
-            for (int ch = 0; ch < x->nOut; ch++) {
-                t_sample *out = (t_sample *)(w[3 + x->nIn + ch]);
-                memcpy(out + (chunkIndex * x->nAmbiFrameSize), x->aOutsTmp[ch],
-                       x->nAmbiFrameSize * sizeof(t_sample));
-            }
-        }
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nIn; ch++) {
+        x->aIns[ch] = (t_sample *)w[3 + ch];
+        x->aOuts[ch] = (t_sample *)w[3 + x->nIn + ch];
     }
+    pitchshifter_tilde_process(x, n);
+    saf_load_end(&x->load, n);
 
-    return (w + 3 + x->nIn + x->nOut);
+    return (w + 3 + 2 * x->nIn);
 }
 
 // ─────────────────────────────────────
-void pitchshifter_tilde_dsp(t_pitchshifter_tilde *x, t_signal **sp) {
-    // Set frame sizes and reset indices
-    x->nAmbiFrameSize = pitch_shifter_getFrameSize();
-    x->nPdFrameSize = sp[0]->s_n;
-    x->nOutAccIndex = 0;
-    x->nInAccIndex = 0;
-    int sum = x->nIn + x->nOut;
-    int sigvecsize = sum + 2;
-
-    // Initialize the ambisonic pitchshifter
-    if (!x->hAmbiInit) {
-        pitch_shifter_init(x->hAmbi, sys_getsr());
-        x->hAmbiInit = 1;
+static void pitchshifter_tilde_freetmp(t_pitchshifter_tilde *x) {
+    for (int ch = 0; ch < x->nTmp; ch++) {
+        freebytes(x->aTmp[ch], x->blockSize * sizeof(t_sample));
+    }
+    if (x->aTmp) {
+        freebytes(x->aTmp, x->nTmp * sizeof(t_sample *));
     }
+    x->aTmp = NULL;
+    x->nTmp = 0;
+}
 
+// ─────────────────────────────────────
+void pitchshifter_tilde_dsp(t_pitchshifter_tilde *x, t_signal **sp) {
+    x->load.sr = sp[0]->s_sr;
     if (x->multichannel) {
-        x->nIn = sp[0]->s_nchans;
-        pitch_shifter_setNumChannels(x->hAmbi, x->nIn);
+        int nIn = sp[0]->s_nchans;
+        if (nIn != x->nIn) {
+            freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+            freebytes(x->aOuts, x->nIn * sizeof(t_sample *));
+            x->aIns = (const t_sample **)getbytes(nIn * sizeof(t_sample *));
+            x->aOuts = (t_sample **)getbytes(nIn * sizeof(t_sample *));
+            x->nIn = nIn;
+        }
     }
-
-    if (x->nPreviousIn != x->nIn || x->nPreviousOut != x->nOut) {
-        pitchshifter_tilde_malloc(x);
+    if (x->nIn != x->nTmp || sp[0]->s_n != x->blockSize) {
+        pitchshifter_tilde_freetmp(x);
+        x->aTmp = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
+        for (int ch = 0; ch < x->nIn; ch++) {
+            x->aTmp[ch] = (t_sample *)getbytes(sp[0]->s_n * sizeof(t_sample));
+        }
+        x->nTmp = x->nIn;
+        x->blockSize = sp[0]->s_n;
+    }
+    if (x->nIn != x->pvshiftCh) {
+        pitchshifter_tilde_design(x);
     }
 
-    pitch_shifter_initCodec(x->hAmbi);
-
-    // add perform method
     if (x->multichannel) {
-        x->nIn = sp[0]->s_nchans;
-        signal_setmultiout(&sp[1], x->nOut);
+        signal_setmultiout(&sp[1], x->nIn);
         dsp_add(pitchshifter_tilde_performmultichannel, 4, x, sp[0]->s_n, sp[0]->s_vec,
                 sp[1]->s_vec);
     } else {
+        int sum = 2 * x->nIn;
+        int sigvecsize = sum + 2;
         for (int i = x->nIn; i < sum; i++) {
             signal_setmultiout(&sp[i], 1);
         }
@@ -247,26 +303,39 @@ void pitchshifter_tilde_dsp(t_pitchshifter_tilde *x, t_signal **sp) {
 // ─────────────────────────────────────
 void *pitchshifter_tilde_new(t_symbol *s, int argc, t_atom *argv) {
     t_pitchshifter_tilde *x = (t_pitchshifter_tilde *)pd_new(pitchshifter_tilde_class);
-    int order = (argc >= 1) ? atom_getint(argv) : 1;
-    int num_sources = (argc >= 2) ? atom_getint(argv + 1) : 1;
-    x->multichannel = (argc >= 3) ? strcmp(atom_getsymbol(argv + 2)->s_name, "-m") == 0 : 0;
-    if (argc < 2) {
-        pd_error(x, "[saf.pitchshifter~] Wrong number of arguments, use [saf.pitchshifter~ "
-                    "<speakers_count> "
-                    "<sources>");
-        return NULL;
-    }
 
-    order = order < 1 ? 1 : order;
-    num_sources = num_sources < 1 ? 1 : num_sources;
-    x->hAmbiInit = 0;
+    // [saf.pitchshifter~ <order>] or [saf.pitchshifter~ -m], the same channels in and out
+    int order = 1;
+    x->multichannel = 0;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type == A_SYMBOL && strcmp(atom_getsymbol(argv + i)->s_name, "-m") == 0) {
+            x->multichannel = 1;
+        } else if (argv[i].a_type == A_FLOAT) {
+            order = atom_getint(argv + i);
+        }
+    }
+    order = order < 0 ? 0 : order;
 
-    pitch_shifter_create(&x->hAmbi);
-    pitch_shifter_setNumChannels(x->hAmbi, num_sources);
     x->nOrder = order;
-    x->nIn = num_sources;
-    x->nOut = (order + 1) * (order + 1);
-    x->nInAccIndex = 0;
+    x->nIn = (order + 1) * (order + 1);
+    x->aIns = (const t_sample **)getbytes(x->nIn * sizeof(t_sample *));
+    x->aOuts = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
+    x->factor = 1.0f;
+    x->fftSize = PITCHSHIFTER_DEFAULT_FFT;
+    x->osamp = PITCHSHIFTER_DEFAULT_OSAMP;
+    x->pvshift = NULL;
+    x->pvshiftCh = 0;
+    x->pvshiftOld = NULL;
+    x->pvshiftFade = 0;
+    x->pvshiftWarm = 0;
+    x->aTmp = NULL;
+    x->nTmp = 0;
+    x->blockSize = 0;
+    x->freeClock = clock_new(x, (t_method)pitchshifter_tilde_freeold);
+    saf_designer_init(&x->designer, &x->obj.ob_pd, pitchshifter_tilde_designpvshift,
+                      pitchshifter_tilde_installpvshift, pitchshifter_tilde_discardpvshift);
+
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.pitchshifter~", 0, NULL);
 
     if (x->multichannel) {
         outlet_new(&x->obj, &s_signal);
@@ -274,7 +343,7 @@ void *pitchshifter_tilde_new(t_symbol *s, int argc, t_atom *argv) {
         for (int i = 1; i < x->nIn; i++) {
             inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
         }
-        for (int i = 0; i < x->nOut; i++) {
+        for (int i = 0; i < x->nIn; i++) {
             outlet_new(&x->obj, &s_signal);
         }
     }
@@ -284,39 +353,18 @@ void *pitchshifter_tilde_new(t_symbol *s, int argc, t_atom *argv) {
 
 // ─────────────────────────────────────
 void pitchshifter_tilde_free(t_pitchshifter_tilde *x) {
-    pitch_shifter_destroy(&x->hAmbi);
-    for (int i = 0; i < x->nIn; i++) {
-        if (x->aIns) {
-            freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
-        }
-        if (x->aInsTmp) {
-            freebytes(x->aInsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
-        }
-    }
-    for (int i = 0; i < x->nOut; i++) {
-        if (x->aOuts) {
-            freebytes(x->aOuts[i], x->nAmbiFrameSize * sizeof(t_sample));
-        }
-        if (x->aOutsTmp) {
-            freebytes(x->aOutsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
-        }
-    }
-
-    if (x->aIns) {
-        freebytes(x->aIns, x->nIn * sizeof(t_sample *));
-    }
-    if (x->aInsTmp) {
-        freebytes(x->aInsTmp, x->nIn * sizeof(t_sample *));
-    }
-    if (x->aOuts) {
-        freebytes(x->aOuts, x->nOut * sizeof(t_sample *));
-    }
-    if (x->aOutsTmp) {
-        freebytes(x->aOutsTmp, x->nOut * sizeof(t_sample *));
-    }
+    saf_load_free(&x->load);
+    saf_designer_free(&x->designer);
+    clock_free(x->freeClock);
+    pvshift_free(x->pvshift);
+    pvshift_free(x->pvshiftOld);
+    pitchshifter_tilde_freetmp(x);
+    freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+    freebytes(x->aOuts, x->nIn * sizeof(t_sample *));
 }
 
 // ─────────────────────────────────────
+// clang-format off
 void setup_saf0x2epitchshifter_tilde(void) {
     pitchshifter_tilde_class =
         class_new(gensym("saf.pitchshifter~"), (t_newmethod)pitchshifter_tilde_new,
@@ -324,8 +372,8 @@ void setup_saf0x2epitchshifter_tilde(void) {
                   CLASS_DEFAULT | CLASS_MULTICHANNEL, A_GIMME, 0);
 
     CLASS_MAINSIGNALIN(pitchshifter_tilde_class, t_pitchshifter_tilde, sample);
-    class_addmethod(pitchshifter_tilde_class, (t_method)pitchshifter_tilde_dsp, gensym("dsp"),
-                    A_CANT, 0);
-    class_addmethod(pitchshifter_tilde_class, (t_method)pitchshifter_tilde_set, gensym("set"),
-                    A_GIMME, 0);
+    class_addmethod(pitchshifter_tilde_class, (t_method)pitchshifter_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(pitchshifter_tilde_class, (t_method)pitchshifter_tilde_set, gensym("set"), A_GIMME, 0);
+    class_addmethod(pitchshifter_tilde_class, (t_method)pitchshifter_tilde_stats, gensym("stats"), 0);
+    class_addmethod(pitchshifter_tilde_class, (t_method)pitchshifter_tilde_loadreport, gensym("saf_loadreport"), 0);
 }
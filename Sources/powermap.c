@@ -0,0 +1,86 @@
+#include <math.h>
+#include <string.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include <saf_externals.h>
+#include "powermap.h"
+
+// ─────────────────────────────────────
+t_powermap *powermap_new(int order, float resolution, int normType) {
+    t_powermap *p = (t_powermap *)getbytes(sizeof(t_powermap));
+    resolution = resolution < POWERMAP_MIN_RESOLUTION ? POWERMAP_MIN_RESOLUTION : resolution;
+    resolution = resolution > POWERMAP_MAX_RESOLUTION ? POWERMAP_MAX_RESOLUTION : resolution;
+    p->order = order;
+    p->nSH = (order + 1) * (order + 1);
+    p->width = (int)(360.0f / resolution + 0.5f);
+    p->height = (int)(180.0f / resolution + 0.5f) + 1;
+    p->nDirs = p->width * p->height;
+    int nSH = p->nSH;
+    int nDirs = p->nDirs;
+    p->W = (float *)getbytes(nSH * nDirs * sizeof(float));
+    p->C = (float *)getbytes(nSH * nSH * sizeof(float));
+    p->A = (float *)getbytes(nSH * nDirs * sizeof(float));
+
+    float *dirs = (float *)getbytes(nDirs * 2 * sizeof(float));
+    float azStep = 360.0f / p->width;
+    float elStep = 180.0f / (p->height - 1);
+    for (int e = 0; e < p->height; e++) {
+        for (int a = 0; a < p->width; a++) {
+            dirs[2 * (e * p->width + a)] = 180.0f - a * azStep;
+            dirs[2 * (e * p->width + a) + 1] = 90.0f - e * elStep;
+        }
+    }
+    getRSH(order, dirs, nDirs, p->W);
+    freebytes(dirs, nDirs * 2 * sizeof(float));
+
+    // getRSH is N3D, an SN3D input is scaled back up per order inside the weights. A plane wave
+    // sums to nSH on its own direction, the weights are normalised by it.
+    for (int n = 0; n <= order; n++) {
+        float g = normType == POWERMAP_SN3D ? sqrtf(2.0f * n + 1.0f) : 1.0f;
+        g /= (float)nSH;
+        for (int i = n * n; i < (n + 1) * (n + 1); i++) {
+            float *w = p->W + i * nDirs;
+            for (int d = 0; d < nDirs; d++) {
+                w[d] *= g;
+            }
+        }
+    }
+    return p;
+}
+
+// ─────────────────────────────────────
+void powermap_free(t_powermap *p) {
+    if (!p) {
+        return;
+    }
+    freebytes(p->W, p->nSH * p->nDirs * sizeof(float));
+    freebytes(p->C, p->nSH * p->nSH * sizeof(float));
+    freebytes(p->A, p->nSH * p->nDirs * sizeof(float));
+    freebytes(p, sizeof(t_powermap));
+}
+
+// ─────────────────────────────────────
+void powermap_accumulate(t_powermap *p, const float *X, int n, float avg) {
+    // C = avg C + (1 - avg) X X^T / n
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, p->nSH, p->nSH, n, (1.0f - avg) / n, X, n,
+                X, n, avg, p->C, p->nSH);
+}
+
+// ─────────────────────────────────────
+void powermap_compute(t_powermap *p, float *map) {
+    int nSH = p->nSH;
+    int nDirs = p->nDirs;
+    // the power of beam d is w_d^T C w_d, for all directions at once the column sums of W .* (C W)
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, nSH, nDirs, nSH, 1.0f, p->C, nSH, p->W,
+                nDirs, 0.0f, p->A, nDirs);
+    memset(map, 0, nDirs * sizeof(float));
+    for (int i = 0; i < nSH; i++) {
+        const float *w = p->W + i * nDirs;
+        const float *a = p->A + i * nDirs;
+        for (int d = 0; d < nDirs; d++) {
+            map[d] += w[d] * a[d];
+        }
+    }
+}
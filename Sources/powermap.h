@@ -0,0 +1,40 @@
+#ifndef SAF_POWERMAP_H
+#define SAF_POWERMAP_H
+
+#include <m_pd.h>
+
+// ─────────────────────────────────────
+// Sound-field energy map for [saf.powermap~]: the power of a plane-wave decomposition (PWD) beam
+// steered at every direction of an equirectangular grid, as the PWD mode of SAF's powermap. Each
+// hop updates a recursively averaged SH covariance matrix with one SGEMM. A map is then one SGEMM
+// of the covariance with the steering matrix, precomputed for the whole grid, followed by a
+// column-wise dot product, instead of one quadratic form per direction.
+//
+// Rows run from elevation 90 down to -90 degrees and columns from azimuth 180 degrees down in
+// steps of 360 / width, -180 is the first column again. A unit plane wave gives 1 in its
+// direction.
+#define POWERMAP_MIN_RESOLUTION 1.0f // degrees
+#define POWERMAP_MAX_RESOLUTION 45.0f
+
+enum { POWERMAP_N3D = 1, POWERMAP_SN3D };
+
+typedef struct _powermap {
+    int order;
+    int nSH;
+    int width;  // azimuths
+    int height; // elevations
+    int nDirs;
+    float *W; // nSH x nDirs, PWD beam weights for the input normalisation
+    float *C; // nSH x nSH, averaged covariance
+    float *A; // nSH x nDirs, C W
+} t_powermap;
+
+// ─────────────────────────────────────
+t_powermap *powermap_new(int order, float resolution, int normType);
+void powermap_free(t_powermap *p);
+// X holds nSH channels of n samples, avg is the weight of the old covariance.
+void powermap_accumulate(t_powermap *p, const float *X, int n, float avg);
+// map holds nDirs energies, row by row.
+void powermap_compute(t_powermap *p, float *map);
+
+#endif
@@ -0,0 +1,529 @@
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <m_pd.h>
+#include <g_canvas.h>
+
+#include "utilities.h"
+#include "governor.h"
+#include "powermap.h"
+#include "wakeup.h"
+
+// ─────────────────────────────────────
+// As in [saf.sldoa~], perform only copies the input into a single-producer single-consumer ring
+// of hops. A worker thread folds every hop into the covariance of Sources/powermap.c and, at the
+// control rate, computes the map and hands it to the main thread with pd_queue_mess, which sends
+// it as one list or writes it into an array. When the worker falls behind, perform drops the
+// newest hops instead of waiting.
+#define POWERMAP_RING_FRAMES 8
+#define POWERMAP_DEFAULT_HOP 1024
+#define POWERMAP_MIN_HOP 64
+#define POWERMAP_MAX_HOP 16384
+#define POWERMAP_DEFAULT_RATE 20 // maps per second
+#define POWERMAP_DEFAULT_AVG 250 // ms
+#define POWERMAP_DEFAULT_RESOLUTION 10.0f
+
+static t_class *powermap_tilde_class;
+
+// ─────────────────────────────────────
+// Written by messages and dsp, applied by the worker between two hops.
+typedef struct _powermap_tilde_settings {
+    float sr;
+    int order;
+    float resolution; // degrees
+    int normType;
+    float avg;  // ms
+    float rate; // Hz
+} t_powermap_tilde_settings;
+
+typedef struct _powermap_tilde {
+    t_object obj;
+    t_sample sample;
+    t_outlet *outMap;
+    t_symbol *array; // written instead of the outlet when set
+
+    int nIn;
+    int multichannel;
+    int hop;
+    int nInAccIndex;
+    const t_sample **aIns;
+
+    // perform writes the hop at ringWrite, the worker reads the one at ringRead
+    float *ring; // POWERMAP_RING_FRAMES x ringIn x ringHop
+    int ringIn;
+    int ringHop;
+    int ringFull; // the hop being accumulated is dropped
+    atomic_uint ringWrite;
+    atomic_uint ringRead;
+    atomic_uint analysed;
+    atomic_uint dropped;
+
+    pthread_t worker;
+    pthread_mutex_t mutex; // settings
+    t_saf_wakeup wakeup;   // posted for every hop, setting and stop
+    atomic_int running;
+    atomic_int dirty;
+    t_powermap_tilde_settings settings;
+    t_powermap *pm; // only used by the worker
+
+    // written by the worker, sent to the outlet by the main thread
+    pthread_mutex_t resultMutex;
+    atomic_int queued;
+    int nDirs;
+    int width;
+    int height;
+    float *map;    // nDirs
+    t_atom *atoms; // nDirs
+
+    t_saf_load load;
+} t_powermap_tilde;
+
+// ╭─────────────────────────────────────╮
+// │             Worker Thread           │
+// ╰─────────────────────────────────────╯
+static void powermap_tilde_output(t_pd *obj, void *data) {
+    (void)data;
+    if (!obj) {
+        return; // cancelled by powermap_tilde_free
+    }
+    t_powermap_tilde *x = (t_powermap_tilde *)obj;
+    atomic_store(&x->queued, 0);
+
+    if (x->array) {
+        t_garray *a = (t_garray *)pd_findbyclass(x->array, garray_class);
+        if (!a) {
+            pd_error(x, "[saf.powermap~] %s: no such array", x->array->s_name);
+            x->array = NULL;
+            return;
+        }
+        int size;
+        t_word *vec;
+        pthread_mutex_lock(&x->resultMutex);
+        if (garray_getfloatwords(a, &size, &vec) && size != x->nDirs) {
+            garray_resize_long(a, x->nDirs);
+        }
+        if (garray_getfloatwords(a, &size, &vec)) {
+            for (int d = 0; d < x->nDirs && d < size; d++) {
+                vec[d].w_float = x->map[d];
+            }
+        }
+        pthread_mutex_unlock(&x->resultMutex);
+        garray_redraw(a);
+        return;
+    }
+
+    pthread_mutex_lock(&x->resultMutex);
+    int n = x->nDirs;
+    for (int d = 0; d < n; d++) {
+        SETFLOAT(&x->atoms[d], x->map[d]);
+    }
+    pthread_mutex_unlock(&x->resultMutex);
+    outlet_list(x->outMap, &s_list, n, x->atoms);
+}
+
+// ─────────────────────────────────────
+static void powermap_tilde_publish(t_powermap_tilde *x) {
+    t_powermap *pm = x->pm;
+    pthread_mutex_lock(&x->resultMutex);
+    if (pm->nDirs != x->nDirs) {
+        if (x->map) {
+            freebytes(x->map, x->nDirs * sizeof(float));
+            freebytes(x->atoms, x->nDirs * sizeof(t_atom));
+        }
+        x->map = (float *)getbytes(pm->nDirs * sizeof(float));
+        x->atoms = (t_atom *)getbytes(pm->nDirs * sizeof(t_atom));
+        x->nDirs = pm->nDirs;
+    }
+    x->width = pm->width;
+    x->height = pm->height;
+    powermap_compute(pm, x->map);
+    pthread_mutex_unlock(&x->resultMutex);
+
+    // the main thread may lag behind, it always sends the latest map
+    if (!atomic_exchange(&x->queued, 1)) {
+        pd_queue_mess(&pd_maininstance, &x->obj.te_g.g_pd, NULL, powermap_tilde_output);
+    }
+}
+
+// ─────────────────────────────────────
+static void powermap_tilde_apply(t_powermap_tilde *x, t_powermap_tilde_settings *cur,
+                                 const t_powermap_tilde_settings *s) {
+    // a new grid or normalisation starts from an empty covariance
+    if (!x->pm || s->order != cur->order || s->resolution != cur->resolution ||
+        s->normType != cur->normType) {
+        powermap_free(x->pm);
+        x->pm = powermap_new(s->order, s->resolution, s->normType);
+    }
+    *cur = *s;
+}
+
+// ─────────────────────────────────────
+static void *powermap_tilde_worker(void *arg) {
+    t_powermap_tilde *x = (t_powermap_tilde *)arg;
+    int P = x->ringHop;
+    int nIn = x->ringIn;
+    t_powermap_tilde_settings cur;
+    memset(&cur, 0, sizeof(cur));
+    float avg = 0.0f;
+    int interval = 1;
+    int frames = 0;
+
+    while (atomic_load(&x->running)) {
+        if (atomic_exchange(&x->dirty, 0)) {
+            t_powermap_tilde_settings s;
+            pthread_mutex_lock(&x->mutex);
+            s = x->settings;
+            pthread_mutex_unlock(&x->mutex);
+            powermap_tilde_apply(x, &cur, &s);
+            avg = cur.avg > 0 ? expf(-(float)P / (cur.avg * 0.001f * cur.sr)) : 0.0f;
+            interval = (int)(cur.sr / (cur.rate * (float)P) + 0.5f);
+            interval = interval < 1 ? 1 : interval;
+        }
+
+        unsigned r = atomic_load_explicit(&x->ringRead, memory_order_relaxed);
+        if (r == atomic_load_explicit(&x->ringWrite, memory_order_acquire)) {
+            // a hop posted since the check is remembered by the wakeup
+            saf_wakeup_wait(&x->wakeup);
+            continue;
+        }
+        // the first nSH channels of a hop are contiguous, the covariance reads them in place
+        const float *slot = x->ring + (r % POWERMAP_RING_FRAMES) * nIn * P;
+        powermap_accumulate(x->pm, slot, P, avg);
+        atomic_store_explicit(&x->ringRead, r + 1, memory_order_release);
+        atomic_fetch_add(&x->analysed, 1);
+
+        if (++frames >= interval) {
+            frames = 0;
+            powermap_tilde_publish(x);
+        }
+    }
+    return NULL;
+}
+
+// ─────────────────────────────────────
+static void powermap_tilde_start(t_powermap_tilde *x) {
+    atomic_store(&x->running, 1);
+    atomic_store(&x->dirty, 1);
+    if (pthread_create(&x->worker, NULL, powermap_tilde_worker, (void *)x) != 0) {
+        atomic_store(&x->running, 0);
+        pd_error(x, "[saf.powermap~] Failed to start the analysis thread");
+    }
+}
+
+// ─────────────────────────────────────
+static void powermap_tilde_stop(t_powermap_tilde *x) {
+    if (!atomic_load(&x->running)) {
+        return;
+    }
+    atomic_store(&x->running, 0);
+    saf_wakeup_post(&x->wakeup);
+    pthread_join(x->worker, NULL);
+}
+
+// ─────────────────────────────────────
+static void powermap_tilde_update(t_powermap_tilde *x) {
+    atomic_store(&x->dirty, 1);
+    saf_wakeup_post(&x->wakeup);
+}
+
+// ─────────────────────────────────────
+// The ring is only resized while the worker is stopped.
+static void powermap_tilde_resize(t_powermap_tilde *x, int nIn, int hop) {
+    powermap_tilde_stop(x);
+    if (x->ring) {
+        freebytes(x->ring, POWERMAP_RING_FRAMES * x->ringIn * x->ringHop * sizeof(float));
+        freebytes(x->aIns, x->ringIn * sizeof(t_sample *));
+    }
+    x->ring = (float *)getbytes(POWERMAP_RING_FRAMES * nIn * hop * sizeof(float));
+    x->aIns = (const t_sample **)getbytes(nIn * sizeof(t_sample *));
+    x->ringIn = nIn;
+    x->ringHop = hop;
+    atomic_store(&x->ringWrite, 0);
+    atomic_store(&x->ringRead, 0);
+    x->nInAccIndex = 0;
+    powermap_tilde_start(x);
+}
+
+// ╭─────────────────────────────────────╮
+// │               Methods               │
+// ╰─────────────────────────────────────╯
+static void powermap_tilde_set(t_powermap_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    const char *method = s->s_name;
+    pd_assert(x, argc >= 1, "[saf.powermap~] Expected a value");
+    float f = atom_getfloat(argv);
+    if (strcmp(method, "hop") == 0) {
+        int hop = (int)f;
+        if (hop < POWERMAP_MIN_HOP || hop > POWERMAP_MAX_HOP) {
+            pd_error(x, "[saf.powermap~] hop must be between %d and %d samples", POWERMAP_MIN_HOP,
+                     POWERMAP_MAX_HOP);
+            return;
+        }
+        x->hop = hop;
+        if (x->ring && hop != x->ringHop) {
+            powermap_tilde_resize(x, x->ringIn, hop);
+        }
+        return;
+    }
+    pthread_mutex_lock(&x->mutex);
+    if (strcmp(method, "rate") == 0) {
+        // maps per second, the covariance is still updated on every hop
+        x->settings.rate = f > 0 ? f : POWERMAP_DEFAULT_RATE;
+    } else if (strcmp(method, "avg") == 0) {
+        // averaging of the covariance, in ms
+        x->settings.avg = f < 0 ? 0 : f;
+    } else if (strcmp(method, "resolution") == 0) {
+        // grid spacing in degrees
+        f = f < POWERMAP_MIN_RESOLUTION ? POWERMAP_MIN_RESOLUTION : f;
+        x->settings.resolution = f > POWERMAP_MAX_RESOLUTION ? POWERMAP_MAX_RESOLUTION : f;
+    } else if (strcmp(method, "normtype") == 0) {
+        if (f < POWERMAP_N3D || f > POWERMAP_SN3D) {
+            pthread_mutex_unlock(&x->mutex);
+            logpost(x, 1, "[saf.powermap~] norm_type must be 1-2");
+            logpost(x, 2, "                N3D  = 1");
+            logpost(x, 2, "                SN3D = 2");
+            return;
+        }
+        x->settings.normType = (int)f;
+    }
+    pthread_mutex_unlock(&x->mutex);
+    powermap_tilde_update(x);
+}
+
+// ─────────────────────────────────────
+static void powermap_tilde_array(t_powermap_tilde *x, t_symbol *s) {
+    // an empty symbol goes back to the outlet
+    x->array = s == &s_ ? NULL : s;
+}
+
+// ─────────────────────────────────────
+static void powermap_tilde_loadreport(t_powermap_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void powermap_tilde_stats(t_powermap_tilde *x) {
+    saf_load_stats(&x->load);
+    pthread_mutex_lock(&x->resultMutex);
+    int width = x->width;
+    int height = x->height;
+    pthread_mutex_unlock(&x->resultMutex);
+    logpost(x, 2,
+            "[saf.powermap~] %d x %d grid, %u hops analysed, %u dropped while the worker was busy",
+            width, height, atomic_load(&x->analysed), atomic_load(&x->dropped));
+}
+
+// ╭─────────────────────────────────────╮
+// │     Initialization and Perform      │
+// ╰─────────────────────────────────────╯
+static void powermap_tilde_push(t_powermap_tilde *x, int n) {
+    int P = x->ringHop;
+    int nIn = x->ringIn;
+    int i = 0;
+    while (i < n) {
+        unsigned w = atomic_load_explicit(&x->ringWrite, memory_order_relaxed);
+        if (x->nInAccIndex == 0) {
+            unsigned r = atomic_load_explicit(&x->ringRead, memory_order_acquire);
+            x->ringFull = w - r >= POWERMAP_RING_FRAMES;
+        }
+        int count = n - i < P - x->nInAccIndex ? n - i : P - x->nInAccIndex;
+        if (!x->ringFull) {
+            float *slot = x->ring + (w % POWERMAP_RING_FRAMES) * nIn * P;
+            for (int ch = 0; ch < nIn; ch++) {
+                memcpy(slot + ch * P + x->nInAccIndex, x->aIns[ch] + i, count * sizeof(t_sample));
+            }
+        }
+        x->nInAccIndex += count;
+        i += count;
+        if (x->nInAccIndex == P) {
+            x->nInAccIndex = 0;
+            if (x->ringFull) {
+                atomic_fetch_add_explicit(&x->dropped, 1, memory_order_relaxed);
+            } else {
+                atomic_store_explicit(&x->ringWrite, w + 1, memory_order_release);
+                saf_wakeup_post(&x->wakeup);
+            }
+        }
+    }
+}
+
+// ─────────────────────────────────────
+t_int *powermap_tilde_performmultichannel(t_int *w) {
+    t_powermap_tilde *x = (t_powermap_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    t_sample *ins = (t_sample *)(w[3]);
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->ringIn; ch++) {
+        x->aIns[ch] = ins + ch * n;
+    }
+    powermap_tilde_push(x, n);
+    saf_load_end(&x->load, n);
+
+    return (w + 4);
+}
+
+// ─────────────────────────────────────
+t_int *powermap_tilde_perform(t_int *w) {
+    t_powermap_tilde *x = (t_powermap_tilde *)(w[1]);
+    int n = (int)(w[2]);
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->ringIn; ch++) {
+        x->aIns[ch] = (t_sample *)w[3 + ch];
+    }
+    powermap_tilde_push(x, n);
+    saf_load_end(&x->load, n);
+
+    return (w + 3 + x->nIn);
+}
+
+// ─────────────────────────────────────
+void powermap_tilde_dsp(t_powermap_tilde *x, t_signal **sp) {
+    x->load.sr = sp[0]->s_sr;
+    int nIn = x->multichannel ? sp[0]->s_nchans : x->nIn;
+    if (nIn > MAX_NUM_SH_SIGNALS) {
+        pd_error(x, "[saf.powermap~] %d channels, only the first %d are analysed", nIn,
+                 MAX_NUM_SH_SIGNALS);
+        nIn = MAX_NUM_SH_SIGNALS;
+    }
+
+    // channels beyond the last complete order are ignored
+    pthread_mutex_lock(&x->mutex);
+    x->settings.sr = sp[0]->s_sr;
+    x->settings.order = get_ambisonic_order(nIn);
+    x->settings.order = x->settings.order < 0 ? 0 : x->settings.order;
+    pthread_mutex_unlock(&x->mutex);
+
+    if (nIn != x->ringIn || x->hop != x->ringHop) {
+        powermap_tilde_resize(x, nIn, x->hop);
+    } else {
+        powermap_tilde_update(x);
+    }
+
+    if (sp[0]->s_nchans > 1 && !x->multichannel) {
+        pd_error(x,
+                 "[saf.powermap~] Multichannel mode is off, but input is multichannel, use '-m' "
+                 "flag");
+    }
+
+    if (x->multichannel) {
+        dsp_add(powermap_tilde_performmultichannel, 3, x, sp[0]->s_n, sp[0]->s_vec);
+    } else {
+        int sigvecsize = x->nIn + 2;
+        t_int *sigvec = getbytes(sigvecsize * sizeof(t_int));
+        sigvec[0] = (t_int)x;
+        sigvec[1] = (t_int)sp[0]->s_n;
+        for (int i = 0; i < x->nIn; i++) {
+            sigvec[2 + i] = (t_int)sp[i]->s_vec;
+        }
+        dsp_addv(powermap_tilde_perform, sigvecsize, sigvec);
+        freebytes(sigvec, sigvecsize * sizeof(t_int));
+    }
+}
+
+// ─────────────────────────────────────
+void *powermap_tilde_new(t_symbol *s, int argc, t_atom *argv) {
+    t_powermap_tilde *x = (t_powermap_tilde *)pd_new(powermap_tilde_class);
+
+    // [saf.powermap~ <ambisonic_order>] or [saf.powermap~ -m], the order then follows the
+    // channels
+    int order = 1;
+    x->multichannel = 0;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type == A_SYMBOL && strcmp(atom_getsymbol(argv + i)->s_name, "-m") == 0) {
+            x->multichannel = 1;
+        } else if (argv[i].a_type == A_FLOAT) {
+            order = atom_getint(argv + i);
+        }
+    }
+    if (order < 1 || order > MAX_SH_ORDER) {
+        pd_error(x, "[saf.powermap~] Ambisonic order must be between 1 and %d", MAX_SH_ORDER);
+        order = order < 1 ? 1 : MAX_SH_ORDER;
+    }
+
+    x->nIn = (order + 1) * (order + 1);
+    x->hop = POWERMAP_DEFAULT_HOP;
+    x->array = NULL;
+    x->nInAccIndex = 0;
+    x->aIns = NULL;
+    x->ring = NULL;
+    x->ringIn = 0;
+    x->ringHop = 0;
+    x->ringFull = 0;
+    atomic_init(&x->ringWrite, 0);
+    atomic_init(&x->ringRead, 0);
+    atomic_init(&x->analysed, 0);
+    atomic_init(&x->dropped, 0);
+    atomic_init(&x->running, 0);
+    atomic_init(&x->dirty, 0);
+    atomic_init(&x->queued, 0);
+    pthread_mutex_init(&x->mutex, NULL);
+    saf_wakeup_init(&x->wakeup);
+    pthread_mutex_init(&x->resultMutex, NULL);
+    x->pm = NULL;
+    x->nDirs = 0;
+    x->width = 0;
+    x->height = 0;
+    x->map = NULL;
+    x->atoms = NULL;
+
+    x->settings.sr = 0; // set by dsp before the worker starts
+    x->settings.order = order;
+    x->settings.resolution = POWERMAP_DEFAULT_RESOLUTION;
+    x->settings.normType = POWERMAP_SN3D;
+    x->settings.avg = POWERMAP_DEFAULT_AVG;
+    x->settings.rate = POWERMAP_DEFAULT_RATE;
+
+    // nothing to degrade, the analysis does not run on the audio thread
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.powermap~", 0, NULL);
+
+    if (!x->multichannel) {
+        for (int i = 1; i < x->nIn; i++) {
+            inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
+        }
+    }
+    x->outMap = outlet_new(&x->obj, &s_list);
+
+    return x;
+}
+
+// ─────────────────────────────────────
+void powermap_tilde_free(t_powermap_tilde *x) {
+    powermap_tilde_stop(x);
+    pd_queue_cancel(&x->obj.ob_pd);
+    saf_load_free(&x->load);
+    powermap_free(x->pm);
+    if (x->ring) {
+        freebytes(x->ring, POWERMAP_RING_FRAMES * x->ringIn * x->ringHop * sizeof(float));
+        freebytes(x->aIns, x->ringIn * sizeof(t_sample *));
+    }
+    if (x->map) {
+        freebytes(x->map, x->nDirs * sizeof(float));
+        freebytes(x->atoms, x->nDirs * sizeof(t_atom));
+    }
+    pthread_mutex_destroy(&x->mutex);
+    saf_wakeup_destroy(&x->wakeup);
+    pthread_mutex_destroy(&x->resultMutex);
+}
+
+// ─────────────────────────────────────
+// clang-format off
+void setup_saf0x2epowermap_tilde(void) {
+    powermap_tilde_class =
+        class_new(gensym("saf.powermap~"), (t_newmethod)powermap_tilde_new,
+                  (t_method)powermap_tilde_free, sizeof(t_powermap_tilde),
+                  CLASS_DEFAULT | CLASS_MULTICHANNEL, A_GIMME, 0);
+
+    CLASS_MAINSIGNALIN(powermap_tilde_class, t_powermap_tilde, sample);
+    class_addmethod(powermap_tilde_class, (t_method)powermap_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(powermap_tilde_class, (t_method)powermap_tilde_set, gensym("rate"), A_GIMME, 0);
+    class_addmethod(powermap_tilde_class, (t_method)powermap_tilde_set, gensym("hop"), A_GIMME, 0);
+    class_addmethod(powermap_tilde_class, (t_method)powermap_tilde_set, gensym("avg"), A_GIMME, 0);
+    class_addmethod(powermap_tilde_class, (t_method)powermap_tilde_set, gensym("resolution"), A_GIMME, 0);
+    class_addmethod(powermap_tilde_class, (t_method)powermap_tilde_set, gensym("normtype"), A_GIMME, 0);
+    class_addmethod(powermap_tilde_class, (t_method)powermap_tilde_array, gensym("array"), A_DEFSYM, 0);
+    class_addmethod(powermap_tilde_class, (t_method)powermap_tilde_stats, gensym("stats"), 0);
+    class_addmethod(powermap_tilde_class, (t_method)powermap_tilde_loadreport, gensym("saf_loadreport"), 0);
+}
@@ -0,0 +1,329 @@
+#include <string.h>
+#include <math.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include "pvshift.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PVSHIFT_SSE
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PVSHIFT_NEON
+#endif
+
+#define PVSHIFT_PI 3.14159265358979f
+#define PVSHIFT_LANES 4
+
+// ╭─────────────────────────────────────╮
+// │         Four Channel Vectors        │
+// ╰─────────────────────────────────────╯
+#if defined(PVSHIFT_SSE)
+typedef __m128 t_pv4;
+static inline t_pv4 pv_set(float a) { return _mm_set1_ps(a); }
+static inline t_pv4 pv_load(const float *p) { return _mm_loadu_ps(p); }
+static inline void pv_store(float *p, t_pv4 a) { _mm_storeu_ps(p, a); }
+static inline t_pv4 pv_add(t_pv4 a, t_pv4 b) { return _mm_add_ps(a, b); }
+static inline t_pv4 pv_sub(t_pv4 a, t_pv4 b) { return _mm_sub_ps(a, b); }
+static inline t_pv4 pv_mul(t_pv4 a, t_pv4 b) { return _mm_mul_ps(a, b); }
+static inline t_pv4 pv_div(t_pv4 a, t_pv4 b) { return _mm_div_ps(a, b); }
+static inline t_pv4 pv_sqrt(t_pv4 a) { return _mm_sqrt_ps(a); }
+static inline t_pv4 pv_min(t_pv4 a, t_pv4 b) { return _mm_min_ps(a, b); }
+static inline t_pv4 pv_max(t_pv4 a, t_pv4 b) { return _mm_max_ps(a, b); }
+static inline t_pv4 pv_abs(t_pv4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline t_pv4 pv_round(t_pv4 a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a)); }
+// a < b ? t : f
+static inline t_pv4 pv_iflt(t_pv4 a, t_pv4 b, t_pv4 t, t_pv4 f) {
+    __m128 m = _mm_cmplt_ps(a, b);
+    return _mm_or_ps(_mm_and_ps(m, t), _mm_andnot_ps(m, f));
+}
+#elif defined(PVSHIFT_NEON)
+typedef float32x4_t t_pv4;
+static inline t_pv4 pv_set(float a) { return vdupq_n_f32(a); }
+static inline t_pv4 pv_load(const float *p) { return vld1q_f32(p); }
+static inline void pv_store(float *p, t_pv4 a) { vst1q_f32(p, a); }
+static inline t_pv4 pv_add(t_pv4 a, t_pv4 b) { return vaddq_f32(a, b); }
+static inline t_pv4 pv_sub(t_pv4 a, t_pv4 b) { return vsubq_f32(a, b); }
+static inline t_pv4 pv_mul(t_pv4 a, t_pv4 b) { return vmulq_f32(a, b); }
+static inline t_pv4 pv_div(t_pv4 a, t_pv4 b) { return vdivq_f32(a, b); }
+static inline t_pv4 pv_sqrt(t_pv4 a) { return vsqrtq_f32(a); }
+static inline t_pv4 pv_min(t_pv4 a, t_pv4 b) { return vminq_f32(a, b); }
+static inline t_pv4 pv_max(t_pv4 a, t_pv4 b) { return vmaxq_f32(a, b); }
+static inline t_pv4 pv_abs(t_pv4 a) { return vabsq_f32(a); }
+static inline t_pv4 pv_round(t_pv4 a) { return vrndnq_f32(a); }
+static inline t_pv4 pv_iflt(t_pv4 a, t_pv4 b, t_pv4 t, t_pv4 f) {
+    return vbslq_f32(vcltq_f32(a, b), t, f);
+}
+#else
+typedef struct {
+    float v[PVSHIFT_LANES];
+} t_pv4;
+#define PV_MAP(expr)                                                                               \
+    t_pv4 r;                                                                                       \
+    for (int l = 0; l < PVSHIFT_LANES; l++) {                                                      \
+        r.v[l] = expr;                                                                             \
+    }                                                                                              \
+    return r
+static inline t_pv4 pv_set(float a) { PV_MAP(a); }
+static inline t_pv4 pv_load(const float *p) { PV_MAP(p[l]); }
+static inline void pv_store(float *p, t_pv4 a) { memcpy(p, a.v, sizeof(a.v)); }
+static inline t_pv4 pv_add(t_pv4 a, t_pv4 b) { PV_MAP(a.v[l] + b.v[l]); }
+static inline t_pv4 pv_sub(t_pv4 a, t_pv4 b) { PV_MAP(a.v[l] - b.v[l]); }
+static inline t_pv4 pv_mul(t_pv4 a, t_pv4 b) { PV_MAP(a.v[l] * b.v[l]); }
+static inline t_pv4 pv_div(t_pv4 a, t_pv4 b) { PV_MAP(a.v[l] / b.v[l]); }
+static inline t_pv4 pv_sqrt(t_pv4 a) { PV_MAP(sqrtf(a.v[l])); }
+static inline t_pv4 pv_min(t_pv4 a, t_pv4 b) { PV_MAP(a.v[l] < b.v[l] ? a.v[l] : b.v[l]); }
+static inline t_pv4 pv_max(t_pv4 a, t_pv4 b) { PV_MAP(a.v[l] > b.v[l] ? a.v[l] : b.v[l]); }
+static inline t_pv4 pv_abs(t_pv4 a) { PV_MAP(fabsf(a.v[l])); }
+static inline t_pv4 pv_round(t_pv4 a) { PV_MAP(nearbyintf(a.v[l])); }
+static inline t_pv4 pv_iflt(t_pv4 a, t_pv4 b, t_pv4 t, t_pv4 f) {
+    PV_MAP(a.v[l] < b.v[l] ? t.v[l] : f.v[l]);
+}
+#endif
+
+// ─────────────────────────────────────
+// Phase wrapped to [-pi, pi].
+static inline t_pv4 pv_wrap(t_pv4 a) {
+    t_pv4 turns = pv_round(pv_mul(a, pv_set(0.5f / PVSHIFT_PI)));
+    return pv_sub(a, pv_mul(turns, pv_set(2.0f * PVSHIFT_PI)));
+}
+
+// ─────────────────────────────────────
+// Branchless atan2, the error is below 1e-5 rad.
+static inline t_pv4 pv_atan2(t_pv4 y, t_pv4 x) {
+    t_pv4 zero = pv_set(0.0f);
+    t_pv4 ax = pv_abs(x);
+    t_pv4 ay = pv_abs(y);
+    t_pv4 a = pv_div(pv_min(ax, ay), pv_max(pv_max(ax, ay), pv_set(1e-30f)));
+    t_pv4 s = pv_mul(a, a);
+    t_pv4 p = pv_add(pv_mul(pv_set(-0.0464964749f), s), pv_set(0.15931422f));
+    p = pv_sub(pv_mul(p, s), pv_set(0.327622764f));
+    t_pv4 r = pv_add(pv_mul(pv_mul(p, s), a), a);
+    r = pv_iflt(ax, ay, pv_sub(pv_set(0.5f * PVSHIFT_PI), r), r);
+    r = pv_iflt(x, zero, pv_sub(pv_set(PVSHIFT_PI), r), r);
+    return pv_iflt(y, zero, pv_sub(zero, r), r);
+}
+
+// ─────────────────────────────────────
+// Sine and cosine of a wrapped phase, reduced to a quarter turn, the error is below 1e-6.
+static inline void pv_sincos(t_pv4 x, t_pv4 *sn, t_pv4 *cs) {
+    t_pv4 q = pv_round(pv_mul(x, pv_set(2.0f / PVSHIFT_PI)));
+    t_pv4 r = pv_sub(pv_sub(x, pv_mul(q, pv_set(1.5703125f))), pv_mul(q, pv_set(4.83826795e-4f)));
+    t_pv4 r2 = pv_mul(r, r);
+    t_pv4 s = pv_add(pv_set(1.0f / 120.0f), pv_mul(r2, pv_set(-1.0f / 5040.0f)));
+    s = pv_add(pv_set(-1.0f / 6.0f), pv_mul(r2, s));
+    s = pv_add(r, pv_mul(pv_mul(r, r2), s));
+    t_pv4 c = pv_add(pv_set(-1.0f / 720.0f), pv_mul(r2, pv_set(1.0f / 40320.0f)));
+    c = pv_add(pv_set(1.0f / 24.0f), pv_mul(r2, c));
+    c = pv_add(pv_set(-0.5f), pv_mul(r2, c));
+    c = pv_add(pv_set(1.0f), pv_mul(r2, c));
+
+    // quadrant 0 to 3, odd ones swap sine and cosine
+    t_pv4 quad = pv_sub(q, pv_mul(pv_set(4.0f), pv_round(pv_sub(pv_mul(q, pv_set(0.25f)),
+                                                                pv_set(0.375f)))));
+    t_pv4 odd = pv_sub(quad, pv_mul(pv_set(2.0f), pv_round(pv_sub(pv_mul(quad, pv_set(0.5f)),
+                                                                  pv_set(0.25f)))));
+    t_pv4 half = pv_set(0.5f);
+    t_pv4 s1 = pv_iflt(odd, half, s, c);
+    t_pv4 c1 = pv_iflt(odd, half, c, s);
+    t_pv4 zero = pv_set(0.0f);
+    *sn = pv_iflt(quad, pv_set(1.5f), s1, pv_sub(zero, s1));
+    *cs = pv_iflt(pv_abs(pv_sub(quad, pv_set(1.5f))), pv_set(1.0f), pv_sub(zero, c1), c1);
+}
+
+// ╭─────────────────────────────────────╮
+// │            Phase Vocoder            │
+// ╰─────────────────────────────────────╯
+// True frequency of every bin, in bins, from the phase advance since the last frame.
+static void pvshift_analyse(t_pvshift *p) {
+    float expct = 2.0f * PVSHIFT_PI / (float)p->osamp;
+    t_pv4 osampTurns = pv_set((float)p->osamp / (2.0f * PVSHIFT_PI));
+    for (int k = 0; k < p->nBins; k++) {
+        t_pv4 expected = pv_set((float)k * expct);
+        t_pv4 bin = pv_set((float)k);
+        for (int c = 0; c < p->nPad; c += PVSHIFT_LANES) {
+            int i = k * p->nPad + c;
+            t_pv4 re = pv_load(p->re + i);
+            t_pv4 im = pv_load(p->im + i);
+            t_pv4 phase = pv_atan2(im, re);
+            t_pv4 delta = pv_sub(pv_sub(phase, pv_load(p->lastPhase + i)), expected);
+            pv_store(p->lastPhase + i, phase);
+            pv_store(p->magn + i, pv_sqrt(pv_add(pv_mul(re, re), pv_mul(im, im))));
+            pv_store(p->freq + i, pv_add(bin, pv_mul(pv_wrap(delta), osampTurns)));
+        }
+    }
+}
+
+// ─────────────────────────────────────
+// Bins move to k * factor, the same move for every channel.
+static void pvshift_move(t_pvshift *p, float factor) {
+    size_t bytes = p->nBins * p->nPad * sizeof(float);
+    memset(p->synMagn, 0, bytes);
+    memset(p->synFreq, 0, bytes);
+    t_pv4 f = pv_set(factor);
+    for (int k = 0; k < p->nBins; k++) {
+        int index = (int)((float)k * factor);
+        if (index >= p->nBins) {
+            break;
+        }
+        for (int c = 0; c < p->nPad; c += PVSHIFT_LANES) {
+            int from = k * p->nPad + c;
+            int to = index * p->nPad + c;
+            pv_store(p->synMagn + to, pv_add(pv_load(p->synMagn + to), pv_load(p->magn + from)));
+            pv_store(p->synFreq + to, pv_mul(pv_load(p->freq + from), f));
+        }
+    }
+}
+
+// ─────────────────────────────────────
+// Accumulates the phase of the moved bins and rebuilds the spectra.
+static void pvshift_synthesise(t_pvshift *p) {
+    float expct = 2.0f * PVSHIFT_PI / (float)p->osamp;
+    t_pv4 turnsPerBin = pv_set(expct);
+    for (int k = 0; k < p->nBins; k++) {
+        t_pv4 bin = pv_set((float)k);
+        t_pv4 expected = pv_set((float)k * expct);
+        for (int c = 0; c < p->nPad; c += PVSHIFT_LANES) {
+            int i = k * p->nPad + c;
+            t_pv4 delta = pv_sub(pv_load(p->synFreq + i), bin);
+            delta = pv_add(pv_mul(delta, turnsPerBin), expected);
+            // wrapped every frame, so the reduction of pv_sincos stays exact
+            t_pv4 phase = pv_wrap(pv_add(pv_load(p->sumPhase + i), delta));
+            pv_store(p->sumPhase + i, phase);
+            t_pv4 sn, cs;
+            pv_sincos(phase, &sn, &cs);
+            t_pv4 magn = pv_load(p->synMagn + i);
+            pv_store(p->re + i, pv_mul(magn, cs));
+            pv_store(p->im + i, pv_mul(magn, sn));
+        }
+    }
+}
+
+// ─────────────────────────────────────
+static void pvshift_frame(t_pvshift *p, float factor) {
+    int N = p->fftSize;
+    float *spec = (float *)p->spec; // interleaved re/im
+    for (int ch = 0; ch < p->nCh; ch++) {
+        const float *in = p->inFifo + ch * N;
+        for (int t = 0; t < N; t++) {
+            p->time[t] = p->window[t] * in[t];
+        }
+        saf_rfft_forward(p->hFFT, p->time, p->spec);
+        for (int k = 0; k < p->nBins; k++) {
+            p->re[k * p->nPad + ch] = spec[2 * k];
+            p->im[k * p->nPad + ch] = spec[2 * k + 1];
+        }
+    }
+
+    pvshift_analyse(p);
+    pvshift_move(p, factor);
+    pvshift_synthesise(p);
+
+    // the squared Hann windows of osamp overlapping frames add up to 3 / 8 * osamp
+    float gain = 1.0f / (0.375f * (float)p->osamp);
+    for (int ch = 0; ch < p->nCh; ch++) {
+        for (int k = 0; k < p->nBins; k++) {
+            spec[2 * k] = p->re[k * p->nPad + ch];
+            spec[2 * k + 1] = p->im[k * p->nPad + ch];
+        }
+        saf_rfft_backward(p->hFFT, p->spec, p->time);
+        float *acc = p->accum + ch * N;
+        for (int t = 0; t < N; t++) {
+            acc[t] += gain * p->window[t] * p->time[t];
+        }
+        memcpy(p->outFifo + ch * p->step, acc, p->step * sizeof(float));
+        memmove(acc, acc + p->step, p->overlap * sizeof(float));
+        memset(acc + p->overlap, 0, p->step * sizeof(float));
+
+        float *in = p->inFifo + ch * N;
+        memmove(in, in + p->step, p->overlap * sizeof(float));
+    }
+}
+
+// ─────────────────────────────────────
+void pvshift_process(t_pvshift *p, const float *const *ins, float *const *outs, int n,
+                     float factor) {
+    int i = 0;
+    while (i < n) {
+        int count = n - i < p->fftSize - p->rover ? n - i : p->fftSize - p->rover;
+        // all inputs first, an output may share its buffer with another input
+        for (int ch = 0; ch < p->nCh; ch++) {
+            memcpy(p->inFifo + ch * p->fftSize + p->rover, ins[ch] + i, count * sizeof(float));
+        }
+        for (int ch = 0; ch < p->nCh; ch++) {
+            memcpy(outs[ch] + i, p->outFifo + ch * p->step + p->rover - p->overlap,
+                   count * sizeof(float));
+        }
+        p->rover += count;
+        i += count;
+        if (p->rover == p->fftSize) {
+            p->rover = p->overlap;
+            pvshift_frame(p, factor);
+        }
+    }
+}
+
+// ╭─────────────────────────────────────╮
+// │          Allocation and Free        │
+// ╰─────────────────────────────────────╯
+static float *pvshift_alloc(int n) {
+    return (float *)getbytes(n * sizeof(float)); // zeroed
+}
+
+// ─────────────────────────────────────
+t_pvshift *pvshift_new(int nCh, int fftSize, int osamp) {
+    t_pvshift *p = (t_pvshift *)getbytes(sizeof(t_pvshift));
+    p->nCh = nCh;
+    p->nPad = (nCh + PVSHIFT_LANES - 1) / PVSHIFT_LANES * PVSHIFT_LANES;
+    p->fftSize = fftSize;
+    p->osamp = osamp;
+    p->step = fftSize / osamp;
+    p->nBins = fftSize / 2 + 1;
+    p->overlap = fftSize - p->step;
+    p->rover = p->overlap;
+    saf_rfft_create(&p->hFFT, fftSize);
+
+    p->window = pvshift_alloc(fftSize);
+    for (int t = 0; t < fftSize; t++) {
+        p->window[t] = 0.5f - 0.5f * cosf(2.0f * PVSHIFT_PI * (float)t / (float)fftSize);
+    }
+    p->inFifo = pvshift_alloc(nCh * fftSize);
+    p->outFifo = pvshift_alloc(nCh * p->step);
+    p->accum = pvshift_alloc(nCh * fftSize);
+    p->time = pvshift_alloc(fftSize);
+    p->spec = (float_complex *)pvshift_alloc(2 * p->nBins);
+    int nVec = p->nBins * p->nPad;
+    p->re = pvshift_alloc(nVec);
+    p->im = pvshift_alloc(nVec);
+    p->lastPhase = pvshift_alloc(nVec);
+    p->sumPhase = pvshift_alloc(nVec);
+    p->magn = pvshift_alloc(nVec);
+    p->freq = pvshift_alloc(nVec);
+    p->synMagn = pvshift_alloc(nVec);
+    p->synFreq = pvshift_alloc(nVec);
+    return p;
+}
+
+// ─────────────────────────────────────
+void pvshift_free(t_pvshift *p) {
+    if (!p) {
+        return;
+    }
+    int N = p->fftSize;
+    int nVec = p->nBins * p->nPad;
+    saf_rfft_destroy(&p->hFFT);
+    freebytes(p->window, N * sizeof(float));
+    freebytes(p->inFifo, p->nCh * N * sizeof(float));
+    freebytes(p->outFifo, p->nCh * p->step * sizeof(float));
+    freebytes(p->accum, p->nCh * N * sizeof(float));
+    freebytes(p->time, N * sizeof(float));
+    freebytes(p->spec, 2 * p->nBins * sizeof(float));
+    float *vecs[] = {p->re,   p->im,   p->lastPhase, p->sumPhase,
+                     p->magn, p->freq, p->synMagn,   p->synFreq};
+    for (size_t v = 0; v < sizeof(vecs) / sizeof(vecs[0]); v++) {
+        freebytes(vecs[v], nVec * sizeof(float));
+    }
+    freebytes(p, sizeof(t_pvshift));
+}
@@ -0,0 +1,53 @@
+#ifndef SAF_PVSHIFT_H
+#define SAF_PVSHIFT_H
+
+#include <m_pd.h>
+#include <saf.h>
+
+// ─────────────────────────────────────
+// Phase-vocoder pitch shifter used by [saf.pitchshifter~], the algorithm of smbPitchShift that the
+// pitch_shifter of SAF runs once per channel. Here the bins of all channels are processed together:
+// after the per-channel FFTs the spectra are stored bin by bin with the channels side by side, so
+// the phase analysis, the move of the bins and the phase synthesis run on four channels per SIMD
+// vector, and the bin moves, which depend on the shift factor only, are computed once per frame.
+//
+// The state depends on the FFT size and the oversampling, [saf.pitchshifter~] builds a new one off
+// the audio thread when they change.
+#define PVSHIFT_MIN_FFT 256
+#define PVSHIFT_MAX_FFT 16384
+#define PVSHIFT_MIN_OSAMP 4 // Hann windows on both sides only add up to a constant from 4 on
+
+typedef struct _pvshift {
+    int nCh;
+    int nPad; // nCh rounded up to a multiple of 4
+    int fftSize;
+    int osamp;
+    int step;
+    int nBins;
+    int overlap; // fftSize - step
+    int rover;
+    void *hFFT;
+    float *window;        // fftSize
+    float *inFifo;        // nCh x fftSize
+    float *outFifo;       // nCh x step
+    float *accum;         // nCh x fftSize
+    float *time;          // fftSize
+    float_complex *spec;  // nBins
+    float *re;            // nBins x nPad, the channels of a bin side by side
+    float *im;
+    float *lastPhase;
+    float *sumPhase;
+    float *magn;          // analysis, then synthesis
+    float *freq;          // in bins
+    float *synMagn;
+    float *synFreq;
+} t_pvshift;
+
+// ─────────────────────────────────────
+t_pvshift *pvshift_new(int nCh, int fftSize, int osamp);
+void pvshift_free(t_pvshift *p);
+// Any block size, the output is fftSize samples behind the input.
+void pvshift_process(t_pvshift *p, const float *const *ins, float *const *outs, int n,
+                     float factor);
+
+#endif
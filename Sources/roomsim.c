@@ -0,0 +1,1058 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include <saf_externals.h>
+#include "roomsim.h"
+#include "delayline.h"
+
+#define ROOMSIM_RAD2DEG 57.29577951f
+
+// ─────────────────────────────────────
+static int roomsim_nextpow2(int n) {
+    int p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// ─────────────────────────────────────
+// Longest delay a whole frame can be read at without reaching the samples written this frame.
+static int roomsim_maxdelay(t_roomsim *r) {
+    return r->lineSize - r->frameSize - SAF_DELAY_TAPS;
+}
+
+// ─────────────────────────────────────
+static float roomsim_clip(float f, float max) {
+    return f < 0 ? 0 : f > max ? max : f;
+}
+
+// ─────────────────────────────────────
+// Copies the history of a circular line into a longer one. The write position stays where it is
+// and every sample keeps its age, so the reads carry on as if the line had always been that long.
+static void roomsim_copyring(const float *line, int size, float *dst, int newSize, int stride,
+                             int writePos) {
+    for (int age = 1; age <= size; age++) {
+        memcpy(dst + ((writePos - age) & (newSize - 1)) * stride,
+               line + ((writePos - age) & (size - 1)) * stride, stride * sizeof(float));
+    }
+}
+
+// ╭─────────────────────────────────────╮
+// │               Lattice               │
+// ╰─────────────────────────────────────╯
+static void roomsim_lattice_free(t_roomsim_lattice *l) {
+    int n = l->nImages;
+    if (n == 0) {
+        return;
+    }
+    freebytes(l->k, n * 3 * sizeof(int));
+    freebytes(l->hits, n * ROOMSIM_NUM_WALLS * sizeof(int));
+    freebytes(l->signX, n * sizeof(float));
+    freebytes(l->signY, n * sizeof(float));
+    freebytes(l->signZ, n * sizeof(float));
+    freebytes(l->offX, n * sizeof(float));
+    freebytes(l->offY, n * sizeof(float));
+    freebytes(l->offZ, n * sizeof(float));
+    freebytes(l->gain, n * ROOMSIM_NUM_BANDS * sizeof(float));
+    freebytes(l->gainPrev, n * ROOMSIM_NUM_BANDS * sizeof(float));
+    freebytes(l->peak, n * sizeof(float));
+    l->nImages = 0;
+}
+
+// ─────────────────────────────────────
+static int roomsim_lattice_count(int maxOrder, int *nUpToOrder) {
+    int n = 0;
+    for (int o = 0; o <= maxOrder; o++) {
+        for (int kx = -o; kx <= o; kx++) {
+            int rx = o - abs(kx);
+            for (int ky = -rx; ky <= rx; ky++) {
+                n += (rx - abs(ky)) == 0 ? 1 : 2;
+            }
+        }
+        nUpToOrder[o] = n;
+    }
+    return n;
+}
+
+// ─────────────────────────────────────
+// Images are enumerated by reflection order |kx| + |ky| + |kz|, so lowering the order only means
+// using fewer of them. Along one axis, image k of a source at s in a room of length L is at
+// k * L + s when k is even and (k + 1) * L - s when k is odd.
+static void roomsim_lattice_build(t_roomsim_lattice *l, int maxOrder) {
+    roomsim_lattice_free(l);
+    int n = roomsim_lattice_count(maxOrder, l->nUpToOrder);
+    l->maxOrder = maxOrder;
+    l->nImages = n;
+    l->k = (int *)getbytes(n * 3 * sizeof(int));
+    l->hits = (int *)getbytes(n * ROOMSIM_NUM_WALLS * sizeof(int));
+    l->signX = (float *)getbytes(n * sizeof(float));
+    l->signY = (float *)getbytes(n * sizeof(float));
+    l->signZ = (float *)getbytes(n * sizeof(float));
+    l->offX = (float *)getbytes(n * sizeof(float));
+    l->offY = (float *)getbytes(n * sizeof(float));
+    l->offZ = (float *)getbytes(n * sizeof(float));
+    l->gain = (float *)getbytes(n * ROOMSIM_NUM_BANDS * sizeof(float));
+    l->gainPrev = (float *)getbytes(n * ROOMSIM_NUM_BANDS * sizeof(float));
+    l->peak = (float *)getbytes(n * sizeof(float));
+
+    int i = 0;
+    for (int o = 0; o <= maxOrder; o++) {
+        for (int kx = -o; kx <= o; kx++) {
+            int rx = o - abs(kx);
+            for (int ky = -rx; ky <= rx; ky++) {
+                int rz = rx - abs(ky);
+                for (int kz = -rz; kz <= rz; kz += (rz == 0 ? 1 : 2 * rz)) {
+                    int k[3] = {kx, ky, kz};
+                    for (int a = 0; a < 3; a++) {
+                        int m = abs(k[a]);
+                        int far = k[a] > 0 ? (m + 1) / 2 : m / 2; // wall at L
+                        int near = k[a] > 0 ? m / 2 : (m + 1) / 2; // wall at 0
+                        l->k[i * 3 + a] = k[a];
+                        l->hits[i * ROOMSIM_NUM_WALLS + 2 * a] = far;
+                        l->hits[i * ROOMSIM_NUM_WALLS + 2 * a + 1] = near;
+                    }
+                    l->signX[i] = (kx & 1) ? -1 : 1;
+                    l->signY[i] = (ky & 1) ? -1 : 1;
+                    l->signZ[i] = (kz & 1) ? -1 : 1;
+                    i++;
+                }
+            }
+        }
+    }
+}
+
+// ─────────────────────────────────────
+static void roomsim_lattice_setroom(t_roomsim_lattice *l, const float *room) {
+    for (int i = 0; i < l->nImages; i++) {
+        float *off[3] = {&l->offX[i], &l->offY[i], &l->offZ[i]};
+        for (int a = 0; a < 3; a++) {
+            int k = l->k[i * 3 + a];
+            *off[a] = (float)((k & 1) ? k + 1 : k) * room[a];
+        }
+    }
+}
+
+// ─────────────────────────────────────
+static void roomsim_lattice_setabsorption(t_roomsim_lattice *l,
+                                          float absorption[][ROOMSIM_NUM_BANDS]) {
+    float beta[ROOMSIM_NUM_WALLS][ROOMSIM_NUM_BANDS];
+    for (int w = 0; w < ROOMSIM_NUM_WALLS; w++) {
+        for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+            beta[w][b] = sqrtf(1.0f - absorption[w][b]);
+        }
+    }
+    for (int i = 0; i < l->nImages; i++) {
+        float *g = l->gain + i * ROOMSIM_NUM_BANDS;
+        for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+            g[b] = 1.0f;
+        }
+        for (int w = 0; w < ROOMSIM_NUM_WALLS; w++) {
+            for (int h = 0; h < l->hits[i * ROOMSIM_NUM_WALLS + w]; h++) {
+                for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+                    g[b] *= beta[w][b];
+                }
+            }
+        }
+        l->peak[i] = 0.0f;
+        for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+            l->peak[i] = g[b] > l->peak[i] ? g[b] : l->peak[i];
+        }
+    }
+}
+
+// ╭─────────────────────────────────────╮
+// │             Filterbank              │
+// ╰─────────────────────────────────────╯
+// Butterworth lowpasses one octave apart, crossing over between the band centres.
+static void roomsim_filterbank_set(t_roomsim_filterbank *fb, float sr) {
+    for (int b = 0; b < ROOMSIM_NUM_BANDS - 1; b++) {
+        float fc = 62.5f * (float)(1 << b) * sqrtf(2.0f);
+        fc = fc > 0.45f * sr ? 0.45f * sr : fc;
+        float w0 = 2.0f * 3.14159265f * fc / sr;
+        float alpha = sinf(w0) / sqrtf(2.0f);
+        float cosw = cosf(w0);
+        float a0 = 1.0f + alpha;
+        fb->b0[b] = (1.0f - cosw) / 2.0f / a0;
+        fb->b1[b] = (1.0f - cosw) / a0;
+        fb->b2[b] = fb->b0[b];
+        fb->a1[b] = -2.0f * cosw / a0;
+        fb->a2[b] = (1.0f - alpha) / a0;
+    }
+    int last = ROOMSIM_NUM_BANDS - 1;
+    fb->b0[last] = 1.0f;
+    fb->b1[last] = fb->b2[last] = fb->a1[last] = fb->a2[last] = 0.0f;
+}
+
+// ─────────────────────────────────────
+// Writes one frame of a source into its band-interleaved delay line. All lowpasses run on the same
+// input sample, so the inner loops have a fixed length and are vectorised by the compiler.
+static void roomsim_filterbank_split(const t_roomsim_filterbank *fb, t_roomsim_source *src,
+                                     const float *in, int writePos, int mask, int nS) {
+    float z1[ROOMSIM_NUM_BANDS], z2[ROOMSIM_NUM_BANDS], lp[ROOMSIM_NUM_BANDS + 1];
+    memcpy(z1, src->z1, sizeof(z1));
+    memcpy(z2, src->z2, sizeof(z2));
+    lp[0] = 0.0f;
+    for (int t = 0; t < nS; t++) {
+        float x = in[t];
+        for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+            float y = fb->b0[b] * x + z1[b];
+            z1[b] = fb->b1[b] * x - fb->a1[b] * y + z2[b];
+            z2[b] = fb->b2[b] * x - fb->a2[b] * y;
+            lp[b + 1] = y;
+        }
+        float *dst = src->line + ((writePos + t) & mask) * ROOMSIM_NUM_BANDS;
+        for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+            dst[b] = lp[b + 1] - lp[b];
+        }
+    }
+    // flush the decaying states before they turn denormal
+    for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+        src->z1[b] = fabsf(z1[b]) < 1e-15f ? 0.0f : z1[b];
+        src->z2[b] = fabsf(z2[b]) < 1e-15f ? 0.0f : z2[b];
+    }
+}
+
+// ╭─────────────────────────────────────╮
+// │              Late tail              │
+// ╰─────────────────────────────────────╯
+static int roomsim_isprime(int n) {
+    if (n < 2) {
+        return 0;
+    }
+    for (int d = 2; d * d <= n; d++) {
+        if (n % d == 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// ─────────────────────────────────────
+static float roomsim_meanfreepath(t_roomsim *r) {
+    float x = r->room[0], y = r->room[1], z = r->room[2];
+    return 4.0f * x * y * z / (2.0f * (x * y + x * z + y * z));
+}
+
+// ─────────────────────────────────────
+static void roomsim_fdn_init(t_roomsim_fdn *f) {
+    // Sylvester Hadamard matrix scaled to be orthogonal, the lines alone never lose energy
+    float scale = 1.0f / sqrtf((float)ROOMSIM_FDN_LINES);
+    for (int i = 0; i < ROOMSIM_FDN_LINES; i++) {
+        for (int j = 0; j < ROOMSIM_FDN_LINES; j++) {
+            int bits = i & j, parity = 0;
+            while (bits) {
+                parity ^= bits & 1;
+                bits >>= 1;
+            }
+            f->H[i * ROOMSIM_FDN_LINES + j] = parity ? -scale : scale;
+        }
+        f->inSign[i] = (i & 1) ? -1.0f : 1.0f;
+    }
+}
+
+// ─────────────────────────────────────
+// Line directions are spread over the sphere on a Fibonacci lattice.
+static void roomsim_fdn_setdirs(t_roomsim *r) {
+    t_roomsim_fdn *f = &r->fdn;
+    float dirs[ROOMSIM_FDN_LINES * 2];
+    float golden = 3.14159265f * (3.0f - sqrtf(5.0f));
+    for (int j = 0; j < ROOMSIM_FDN_LINES; j++) {
+        float z = 1.0f - (2.0f * j + 1.0f) / (float)ROOMSIM_FDN_LINES;
+        dirs[2 * j] = fmodf(golden * j, 2.0f * 3.14159265f) * ROOMSIM_RAD2DEG;
+        dirs[2 * j + 1] = asinf(z) * ROOMSIM_RAD2DEG;
+    }
+    getRSH_recur(r->order, dirs, ROOMSIM_FDN_LINES, f->Y);
+    float scale = 1.0f / sqrtf((float)ROOMSIM_FDN_LINES);
+    for (int sh = 0; sh < r->nSH; sh++) {
+        for (int j = 0; j < ROOMSIM_FDN_LINES; j++) {
+            f->Y[sh * ROOMSIM_FDN_LINES + j] *= r->norm[sh] * scale;
+        }
+    }
+}
+
+// ─────────────────────────────────────
+// Line lengths are primes spread over one to three mean free paths, never shorter than a frame.
+// Running lines are only ever made longer, so a new room keeps the tail that is playing.
+static void roomsim_fdn_setlengths(t_roomsim *r) {
+    t_roomsim_fdn *f = &r->fdn;
+    float base = roomsim_meanfreepath(r) / ROOMSIM_SPEED_OF_SOUND * r->sr;
+    base = base < r->frameSize ? (float)r->frameSize : base;
+    int longest = 0;
+    for (int j = 0; j < ROOMSIM_FDN_LINES; j++) {
+        int len = (int)(base * powf(3.0f, (float)j / (float)(ROOMSIM_FDN_LINES - 1)));
+        while (!roomsim_isprime(len)) {
+            len++;
+        }
+        f->length[j] = len;
+        longest = len > longest ? len : longest;
+    }
+    int size = roomsim_nextpow2(longest + r->frameSize);
+    if (f->lines && size > f->lineSize) {
+        float *lines = (float *)getbytes(ROOMSIM_FDN_LINES * size * sizeof(float));
+        for (int j = 0; j < ROOMSIM_FDN_LINES; j++) {
+            roomsim_copyring(f->lines + j * f->lineSize, f->lineSize, lines + j * size, size, 1,
+                             f->writePos);
+        }
+        freebytes(f->lines, ROOMSIM_FDN_LINES * f->lineSize * sizeof(float));
+        f->lines = lines;
+    }
+    if (!f->lines || size > f->lineSize) {
+        f->lineSize = size;
+        f->lineMask = size - 1;
+    }
+}
+
+// ─────────────────────────────────────
+static void roomsim_fdn_free(t_roomsim *r) {
+    t_roomsim_fdn *f = &r->fdn;
+    if (!f->lines) {
+        return;
+    }
+    freebytes(f->lines, ROOMSIM_FDN_LINES * f->lineSize * sizeof(float));
+    freebytes(f->in, r->frameSize * sizeof(float));
+    freebytes(f->taps, ROOMSIM_FDN_LINES * r->frameSize * sizeof(float));
+    freebytes(f->feedback, ROOMSIM_FDN_LINES * r->frameSize * sizeof(float));
+    f->lines = NULL;
+}
+
+// ─────────────────────────────────────
+static void roomsim_fdn_alloc(t_roomsim *r) {
+    t_roomsim_fdn *f = &r->fdn;
+    roomsim_fdn_setlengths(r);
+    if (!f->enable) {
+        return;
+    }
+    f->writePos = 0;
+    f->lines = (float *)getbytes(ROOMSIM_FDN_LINES * f->lineSize * sizeof(float));
+    f->in = (float *)getbytes(r->frameSize * sizeof(float));
+    f->taps = (float *)getbytes(ROOMSIM_FDN_LINES * r->frameSize * sizeof(float));
+    f->feedback = (float *)getbytes(ROOMSIM_FDN_LINES * r->frameSize * sizeof(float));
+}
+
+// ─────────────────────────────────────
+// Sabine RT60 of the room, the decay of each line and where the tail starts. The tail is fed once
+// the reflections simulated by the image sources are over, with the level the images of the next
+// order would have had.
+static void roomsim_fdn_update(t_roomsim *r) {
+    t_roomsim_fdn *f = &r->fdn;
+    float x = r->room[0], y = r->room[1], z = r->room[2];
+    float area[ROOMSIM_NUM_WALLS] = {y * z, y * z, x * z, x * z, x * y, x * y};
+    float absorption = 0, beta = 0;
+    for (int w = 0; w < ROOMSIM_NUM_WALLS; w++) {
+        // the network decays at the same rate in all bands, the mid bands (500 Hz, 1 kHz) set it
+        float mid = 0.5f * (r->absorption[w][3] + r->absorption[w][4]);
+        absorption += area[w] * mid;
+        beta += sqrtf(1.0f - mid) / ROOMSIM_NUM_WALLS;
+    }
+    float rt60 = absorption > 0 ? 0.161f * x * y * z / absorption : ROOMSIM_MAX_RT60;
+    f->rt60 = rt60 > ROOMSIM_MAX_RT60 ? ROOMSIM_MAX_RT60 : rt60;
+    for (int j = 0; j < ROOMSIM_FDN_LINES; j++) {
+        f->decay[j] = powf(10.0f, -3.0f * f->length[j] / (f->rt60 * r->sr));
+    }
+
+    int order = r->reflections ? r->reflectionOrder : 0;
+    order = (order > r->maxReflectionOrder ? r->maxReflectionOrder : order) + 1;
+    float dist = order * roomsim_meanfreepath(r);
+    int preDelay = (int)(dist / ROOMSIM_SPEED_OF_SOUND * r->sr);
+    int maxDelay = roomsim_maxdelay(r);
+    f->preDelay = preDelay < 1 ? 1 : preDelay > maxDelay ? maxDelay : preDelay;
+    int count = 4 * order * order + 2; // images of that order
+    f->inGain = sqrtf((float)count) * powf(beta, (float)order) / (dist > 1.0f ? dist : 1.0f);
+}
+
+// ─────────────────────────────────────
+// All sources are summed into the network, which is shared by all receivers.
+static void roomsim_fdn_process(t_roomsim *r, int nS) {
+    t_roomsim_fdn *f = &r->fdn;
+    memset(f->in, 0, nS * sizeof(float));
+    for (int s = 0; s < r->nSources; s++) {
+        const float *line = r->sources[s].line;
+        int start = r->writePos - f->preDelay;
+        for (int t = 0; t < nS; t++) {
+            const float *bands = line + ((start + t) & r->lineMask) * r->nBands;
+            for (int b = 0; b < r->nBands; b++) {
+                f->in[t] += bands[b];
+            }
+        }
+    }
+
+    for (int j = 0; j < ROOMSIM_FDN_LINES; j++) {
+        const float *line = f->lines + j * f->lineSize;
+        float *tap = f->taps + j * nS;
+        int start = (f->writePos - f->length[j]) & f->lineMask;
+        int first = f->lineSize - start < nS ? f->lineSize - start : nS;
+        memcpy(tap, line + start, first * sizeof(float));
+        memcpy(tap + first, line, (nS - first) * sizeof(float));
+        float g = f->decay[j];
+        for (int t = 0; t < nS; t++) {
+            tap[t] *= g;
+        }
+    }
+    cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, ROOMSIM_FDN_LINES, nS,
+                ROOMSIM_FDN_LINES, 1.0f, f->H, ROOMSIM_FDN_LINES, f->taps, nS, 0.0f, f->feedback,
+                nS);
+    for (int j = 0; j < ROOMSIM_FDN_LINES; j++) {
+        float *line = f->lines + j * f->lineSize;
+        const float *feedback = f->feedback + j * nS;
+        float b = f->inSign[j] * f->inGain;
+        for (int t = 0; t < nS; t++) {
+            line[(f->writePos + t) & f->lineMask] = feedback[t] + b * f->in[t];
+        }
+    }
+    f->writePos = (f->writePos + nS) & f->lineMask;
+
+    for (int rcv = 0; rcv < r->nReceivers; rcv++) {
+        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, r->nSH, nS, ROOMSIM_FDN_LINES,
+                    1.0f, f->Y, ROOMSIM_FDN_LINES, f->taps, nS, 1.0f,
+                    r->out + rcv * r->nSH * nS, nS);
+    }
+}
+
+// ╭─────────────────────────────────────╮
+// │               Sources               │
+// ╰─────────────────────────────────────╯
+static void roomsim_path_free(t_roomsim_path *p, int nImages, int nSH) {
+    if (!p->delay) {
+        return;
+    }
+    freebytes(p->delay, nImages * sizeof(float));
+    freebytes(p->amp, nImages * sizeof(float));
+    freebytes(p->delayStart, nImages * sizeof(float));
+    freebytes(p->ampStart, nImages * sizeof(float));
+    freebytes(p->Y, nSH * nImages * sizeof(float));
+    freebytes(p->kept, nImages * sizeof(int));
+    p->delay = NULL;
+}
+
+// ─────────────────────────────────────
+static void roomsim_path_alloc(t_roomsim_path *p, int nImages, int nSH) {
+    p->valid = 0;
+    p->moved = 1;
+    p->delay = (float *)getbytes(nImages * sizeof(float));
+    p->amp = (float *)getbytes(nImages * sizeof(float));
+    p->delayStart = (float *)getbytes(nImages * sizeof(float));
+    p->ampStart = (float *)getbytes(nImages * sizeof(float));
+    p->Y = (float *)getbytes(nSH * nImages * sizeof(float));
+    p->kept = (int *)getbytes(nImages * sizeof(int));
+    p->nKept = 0;
+    p->nActive = 0;
+    p->fading = 0;
+    p->order = 0;
+}
+
+// ─────────────────────────────────────
+static void roomsim_freebuffers(t_roomsim *r) {
+    int nImages = r->lattice.nImages;
+    for (int s = 0; s < r->nSources; s++) {
+        t_roomsim_source *src = &r->sources[s];
+        if (!src->line) {
+            continue;
+        }
+        for (int rcv = 0; rcv < r->nReceivers; rcv++) {
+            roomsim_path_free(&src->paths[rcv], nImages, r->nSH);
+        }
+        freebytes(src->paths, r->nReceivers * sizeof(t_roomsim_path));
+        freebytes(src->line, r->lineSize * r->nBands * sizeof(float));
+        freebytes(src->imgX, nImages * sizeof(float));
+        freebytes(src->imgY, nImages * sizeof(float));
+        freebytes(src->imgZ, nImages * sizeof(float));
+        src->line = NULL;
+    }
+    if (r->imgSig) {
+        freebytes(r->imgSig, nImages * r->frameSize * sizeof(float));
+        freebytes(r->window, ROOMSIM_WINDOWSIZE(r->frameSize) * sizeof(float));
+        freebytes(r->fade, r->frameSize * sizeof(float));
+        freebytes(r->dirs, nImages * 2 * sizeof(float));
+        freebytes(r->out, r->nReceivers * r->nSH * r->frameSize * sizeof(float));
+        r->imgSig = NULL;
+    }
+    roomsim_fdn_free(r);
+}
+
+// ─────────────────────────────────────
+// Delay lines must hold the longest image path of the lattice plus one frame.
+static int roomsim_linesize(t_roomsim *r) {
+    float diag = sqrtf(r->room[0] * r->room[0] + r->room[1] * r->room[1] +
+                       r->room[2] * r->room[2]);
+    float maxDist = (2 * r->lattice.maxOrder + 2) * diag;
+    int maxDelay = (int)ceilf(maxDist / ROOMSIM_SPEED_OF_SOUND * r->sr);
+    return roomsim_nextpow2(maxDelay + r->frameSize + 4);
+}
+
+// ─────────────────────────────────────
+static void roomsim_allocbuffers(t_roomsim *r) {
+    int nImages = r->lattice.nImages;
+    r->lineSize = roomsim_linesize(r);
+    r->lineMask = r->lineSize - 1;
+    r->writePos = 0;
+    for (int s = 0; s < r->nSources; s++) {
+        t_roomsim_source *src = &r->sources[s];
+        src->paths = (t_roomsim_path *)getbytes(r->nReceivers * sizeof(t_roomsim_path));
+        for (int rcv = 0; rcv < r->nReceivers; rcv++) {
+            roomsim_path_alloc(&src->paths[rcv], nImages, r->nSH);
+        }
+        src->line = (float *)getbytes(r->lineSize * r->nBands * sizeof(float));
+        memset(src->z1, 0, sizeof(src->z1));
+        memset(src->z2, 0, sizeof(src->z2));
+        src->imgX = (float *)getbytes(nImages * sizeof(float));
+        src->imgY = (float *)getbytes(nImages * sizeof(float));
+        src->imgZ = (float *)getbytes(nImages * sizeof(float));
+        src->moved = 1;
+    }
+    r->imgSig = (float *)getbytes(nImages * r->frameSize * sizeof(float));
+    r->window = (float *)getbytes(ROOMSIM_WINDOWSIZE(r->frameSize) * sizeof(float));
+    r->fade = (float *)getbytes(r->frameSize * sizeof(float));
+    r->dirs = (float *)getbytes(nImages * 2 * sizeof(float));
+    r->out = (float *)getbytes(r->nReceivers * r->nSH * r->frameSize * sizeof(float));
+    roomsim_filterbank_set(&r->filterbank, r->sr);
+    roomsim_fdn_alloc(r);
+    roomsim_fdn_update(r);
+}
+
+// ─────────────────────────────────────
+// A larger room or a higher maximum order may need longer lines, which take over the history of
+// the current ones.
+static void roomsim_growlines(t_roomsim *r) {
+    int size = roomsim_linesize(r);
+    if (size <= r->lineSize) {
+        return;
+    }
+    for (int s = 0; s < r->nSources; s++) {
+        t_roomsim_source *src = &r->sources[s];
+        float *line = (float *)getbytes(size * r->nBands * sizeof(float));
+        roomsim_copyring(src->line, r->lineSize, line, size, r->nBands, r->writePos);
+        freebytes(src->line, r->lineSize * r->nBands * sizeof(float));
+        src->line = line;
+    }
+    r->lineSize = size;
+    r->lineMask = size - 1;
+}
+
+// ─────────────────────────────────────
+// Images are enumerated by reflection order, so a larger lattice starts with the images of the
+// smaller one and the images already playing keep their state.
+static void roomsim_growimages(t_roomsim *r, int oldN) {
+    int n = r->lattice.nImages;
+    size_t from = oldN * sizeof(float), to = n * sizeof(float);
+    for (int s = 0; s < r->nSources; s++) {
+        t_roomsim_source *src = &r->sources[s];
+        src->imgX = (float *)resizebytes(src->imgX, from, to);
+        src->imgY = (float *)resizebytes(src->imgY, from, to);
+        src->imgZ = (float *)resizebytes(src->imgZ, from, to);
+        for (int rcv = 0; rcv < r->nReceivers; rcv++) {
+            t_roomsim_path *p = &src->paths[rcv];
+            p->delay = (float *)resizebytes(p->delay, from, to);
+            p->amp = (float *)resizebytes(p->amp, from, to);
+            p->delayStart = (float *)resizebytes(p->delayStart, from, to);
+            p->ampStart = (float *)resizebytes(p->ampStart, from, to);
+            p->Y = (float *)resizebytes(p->Y, r->nSH * from, r->nSH * to);
+            p->kept = (int *)resizebytes(p->kept, oldN * sizeof(int), n * sizeof(int));
+        }
+    }
+    r->imgSig = (float *)resizebytes(r->imgSig, r->frameSize * from, r->frameSize * to);
+    r->dirs = (float *)resizebytes(r->dirs, 2 * from, 2 * to);
+}
+
+// ─────────────────────────────────────
+// The first wall that absorbs differently across bands turns the lines into band-interleaved
+// ones. Their history is spread evenly over the bands and the amplitudes hand the broadband
+// reflection gain over to the band gains, so the frame in flight keeps its level.
+static void roomsim_splitlines(t_roomsim *r) {
+    t_roomsim_lattice *l = &r->lattice;
+    for (int s = 0; s < r->nSources; s++) {
+        t_roomsim_source *src = &r->sources[s];
+        float *line = (float *)getbytes(r->lineSize * ROOMSIM_NUM_BANDS * sizeof(float));
+        for (int j = 0; j < r->lineSize; j++) {
+            for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+                line[j * ROOMSIM_NUM_BANDS + b] = src->line[j] / ROOMSIM_NUM_BANDS;
+            }
+        }
+        freebytes(src->line, r->lineSize * sizeof(float));
+        src->line = line;
+        memset(src->z1, 0, sizeof(src->z1));
+        memset(src->z2, 0, sizeof(src->z2));
+        for (int rcv = 0; rcv < r->nReceivers; rcv++) {
+            t_roomsim_path *p = &src->paths[rcv];
+            for (int i = 0; i < l->nImages; i++) {
+                float g = l->gainPrev[i * ROOMSIM_NUM_BANDS];
+                p->ampStart[i] = g > 0 ? p->ampStart[i] / g : 0.0f;
+            }
+        }
+    }
+    r->nBands = ROOMSIM_NUM_BANDS;
+}
+
+// ─────────────────────────────────────
+static int roomsim_activeorder(t_roomsim *r) {
+    int order = r->reflections ? r->reflectionOrder : 0;
+    return order > r->maxReflectionOrder ? r->maxReflectionOrder : order;
+}
+
+// ─────────────────────────────────────
+static int roomsim_numactive(t_roomsim *r) {
+    return r->lattice.nUpToOrder[roomsim_activeorder(r)];
+}
+
+// ─────────────────────────────────────
+// Image positions of one source, shared by all receivers.
+static void roomsim_updateimages(t_roomsim *r, t_roomsim_source *src) {
+    t_roomsim_lattice *l = &r->lattice;
+    int n = roomsim_numactive(r);
+    float sx = src->pos[0], sy = src->pos[1], sz = src->pos[2];
+    for (int i = 0; i < n; i++) {
+        src->imgX[i] = l->signX[i] * sx + l->offX[i];
+        src->imgY[i] = l->signY[i] * sy + l->offY[i];
+        src->imgZ[i] = l->signZ[i] * sz + l->offZ[i];
+    }
+    for (int rcv = 0; rcv < r->nReceivers; rcv++) {
+        src->paths[rcv].moved = 1;
+    }
+}
+
+// ─────────────────────────────────────
+// Recomputes delays, gains and directions of the active images of one source as seen from one
+// receiver. Images are visited order by order. Those arriving below the cull threshold are left
+// out of the read and the SGEMM, and once a whole order is culled the higher ones are skipped too,
+// so near sources keep the full reflection order and far ones stop early. Images further away than
+// the delay line holds are culled as well, they would wrap around it and read stale samples.
+//
+// An image that was heard in the last frame is not dropped at once when it gets culled or falls
+// above the active order. It stays at its delay and fades out over the next frame, and the update
+// after that frame leaves it out.
+static void roomsim_updatepath(t_roomsim *r, t_roomsim_source *src, int rcv) {
+    t_roomsim_lattice *l = &r->lattice;
+    t_roomsim_path *p = &src->paths[rcv];
+    int n = roomsim_numactive(r);
+    int maxOrder = roomsim_activeorder(r);
+    const float *receiver = r->receivers + rcv * 3;
+    float rx = receiver[0], ry = receiver[1], rz = receiver[2];
+    float toSamples = r->sr / ROOMSIM_SPEED_OF_SOUND;
+    float maxDelay = (float)roomsim_maxdelay(r);
+    float *dirs = r->dirs;
+
+    // images above the active ones may still be fading out from the last update
+    int end = p->valid && p->nActive > n ? p->nActive : n;
+    int nKept = 0;
+    int fading = 0;
+    int stop = 0;
+    int i = 0;
+    p->order = -1;
+    for (int o = 0; o <= l->maxOrder && i < end; o++) {
+        int active = !stop && o <= maxOrder;
+        int audible = 0;
+        for (; i < l->nUpToOrder[o] && i < end; i++) {
+            if (!active && p->ampStart[i] == 0.0f) {
+                continue;
+            }
+            float px = src->imgX[i] - rx;
+            float py = src->imgY[i] - ry;
+            float pz = src->imgZ[i] - rz;
+            float dxy = sqrtf(px * px + py * py);
+            float dist = sqrtf(dxy * dxy + pz * pz);
+            float atten = 1.0f / (dist > 1.0f ? dist : 1.0f);
+            // Lagrange interpolation reads one sample ahead of the delay
+            float delay = dist * toSamples > 1.0f ? dist * toSamples : 1.0f;
+            if (active && l->peak[i] * atten >= r->cullGain && delay <= maxDelay) {
+                p->delay[i] = delay;
+                // with bands, the reflection gains are applied while reading the delay line
+                p->amp[i] = (r->nBands > 1 ? 1.0f : l->gain[i * ROOMSIM_NUM_BANDS]) * atten;
+                if (!p->valid || p->ampStart[i] == 0.0f) {
+                    // (re)entering images fade in from where they are
+                    p->delayStart[i] = p->delay[i];
+                }
+                if (!p->valid) {
+                    p->ampStart[i] = p->amp[i];
+                }
+                audible++;
+            } else if (p->ampStart[i] != 0.0f) {
+                p->delay[i] = p->delayStart[i];
+                p->amp[i] = 0.0f;
+                fading = 1;
+            } else {
+                continue;
+            }
+            p->kept[nKept] = i;
+            dirs[2 * nKept] = atan2f(py, px) * ROOMSIM_RAD2DEG;
+            dirs[2 * nKept + 1] = atan2f(pz, dxy) * ROOMSIM_RAD2DEG;
+            nKept++;
+        }
+        if (active && audible == 0 && o > 0) {
+            stop = 1;
+        } else if (active) {
+            p->order = o;
+        }
+    }
+    p->nKept = nKept;
+    p->nActive = n;
+    p->fading = fading;
+    p->valid = 1;
+    if (nKept > 0) {
+        getRSH_recur(r->order, dirs, nKept, p->Y);
+        for (int sh = 0; sh < r->nSH; sh++) {
+            float *row = p->Y + sh * nKept;
+            for (int k = 0; k < nKept; k++) {
+                row[k] *= r->norm[sh];
+            }
+        }
+    }
+    r->updates++;
+}
+
+// ─────────────────────────────────────
+static void roomsim_moveall(t_roomsim *r) {
+    for (int s = 0; s < r->nSources; s++) {
+        r->sources[s].moved = 1;
+    }
+}
+
+// ─────────────────────────────────────
+// Reads the images of one source from its delay line (delayline.h). The delay and gain of each
+// image ramp over the frame from the last frame's values. The delay moves by at most
+// ROOMSIM_MAX_DOPPLER samples per sample, so a jump in position becomes a short glide over the
+// next frames instead of a click. Band gains are applied while reading, so when they change the
+// image is read twice and crossfades from the old gains to the new ones.
+static void roomsim_readimages(t_roomsim *r, t_roomsim_source *src, t_roomsim_path *p, int nS) {
+    float maxStep = ROOMSIM_MAX_DOPPLER * (float)nS;
+    int fade = r->nBands > 1 && r->gainFade;
+    for (int k = 0; k < p->nKept; k++) {
+        int i = p->kept[k];
+        const float *g = r->nBands > 1 ? r->lattice.gain + i * ROOMSIM_NUM_BANDS : NULL;
+        float *out = r->imgSig + k * nS;
+        float d0 = p->delayStart[i];
+        float d1 = p->delay[i];
+        d1 = d1 > d0 + maxStep ? d0 + maxStep : d1 < d0 - maxStep ? d0 - maxStep : d1;
+        if (fade) {
+            const float *gPrev = r->lattice.gainPrev + i * ROOMSIM_NUM_BANDS;
+            saf_delay_read(src->line, r->lineMask, r->nBands, gPrev, r->writePos, d0, d1,
+                           p->ampStart[i], 0.0f, nS, r->window, out);
+            saf_delay_read(src->line, r->lineMask, r->nBands, g, r->writePos, d0, d1, 0.0f,
+                           p->amp[i], nS, r->window, r->fade);
+            for (int t = 0; t < nS; t++) {
+                out[t] += r->fade[t];
+            }
+        } else {
+            saf_delay_read(src->line, r->lineMask, r->nBands, g, r->writePos, d0, d1,
+                           p->ampStart[i], p->amp[i], nS, r->window, out);
+        }
+        p->delayStart[i] = d1;
+        p->ampStart[i] = p->amp[i];
+    }
+}
+
+// ╭─────────────────────────────────────╮
+// │               Public                │
+// ╰─────────────────────────────────────╯
+t_roomsim *roomsim_new(int nSources, int nReceivers, int order, float sr, int frameSize) {
+    t_roomsim *r = (t_roomsim *)getbytes(sizeof(t_roomsim));
+    r->sr = sr;
+    r->frameSize = frameSize;
+    r->order = order;
+    r->nSH = (order + 1) * (order + 1);
+    r->room[0] = r->room[1] = r->room[2] = 5.0f;
+    for (int w = 0; w < ROOMSIM_NUM_WALLS; w++) {
+        for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+            r->absorption[w][b] = 0.3f;
+        }
+    }
+    r->nBands = 1;
+    r->nReceivers = nReceivers;
+    r->receivers = (float *)getbytes(nReceivers * 3 * sizeof(float));
+    for (int i = 0; i < nReceivers * 3; i++) {
+        r->receivers[i] = 2.5f;
+    }
+    r->reflections = 0;
+    r->reflectionOrder = 3;
+    r->maxReflectionOrder = 3;
+    roomsim_fdn_init(&r->fdn);
+    roomsim_setnormtype(r, NORM_SN3D);
+
+    r->nSources = nSources;
+    r->sources = (t_roomsim_source *)getbytes(nSources * sizeof(t_roomsim_source));
+    for (int s = 0; s < nSources; s++) {
+        r->sources[s].pos[0] = r->sources[s].pos[1] = r->sources[s].pos[2] = 1.0f;
+    }
+    roomsim_lattice_build(&r->lattice, r->reflectionOrder);
+    roomsim_lattice_setroom(&r->lattice, r->room);
+    roomsim_lattice_setabsorption(&r->lattice, r->absorption);
+    roomsim_allocbuffers(r);
+    return r;
+}
+
+// ─────────────────────────────────────
+void roomsim_free(t_roomsim *r) {
+    roomsim_freebuffers(r);
+    roomsim_lattice_free(&r->lattice);
+    freebytes(r->sources, r->nSources * sizeof(t_roomsim_source));
+    freebytes(r->receivers, r->nReceivers * 3 * sizeof(float));
+    freebytes(r, sizeof(t_roomsim));
+}
+
+// ─────────────────────────────────────
+void roomsim_setsamplerate(t_roomsim *r, float sr, int frameSize) {
+    if (sr == r->sr && frameSize == r->frameSize) {
+        return;
+    }
+    roomsim_freebuffers(r);
+    r->sr = sr;
+    r->frameSize = frameSize;
+    roomsim_allocbuffers(r);
+}
+
+// ─────────────────────────────────────
+void roomsim_setnumsources(t_roomsim *r, int nSources) {
+    if (nSources == r->nSources) {
+        return;
+    }
+    roomsim_freebuffers(r);
+    r->sources = (t_roomsim_source *)resizebytes(r->sources,
+                                                 r->nSources * sizeof(t_roomsim_source),
+                                                 nSources * sizeof(t_roomsim_source));
+    for (int s = r->nSources; s < nSources; s++) {
+        r->sources[s].pos[0] = r->sources[s].pos[1] = r->sources[s].pos[2] = 1.0f;
+    }
+    r->nSources = nSources;
+    roomsim_allocbuffers(r);
+}
+
+// ─────────────────────────────────────
+void roomsim_setnormtype(t_roomsim *r, int normType) {
+    // getRSH returns N3D, SN3D divides each order by sqrt(2n + 1). FuMa is only defined up to
+    // first order, where it is SN3D with W attenuated by 3 dB.
+    r->normType = normType;
+    for (int n = 0; n <= r->order; n++) {
+        float scale = normType == NORM_N3D ? 1.0f : 1.0f / sqrtf(2.0f * n + 1.0f);
+        for (int m = -n; m <= n; m++) {
+            r->norm[n * n + n + m] = scale;
+        }
+    }
+    if (normType == NORM_FUMA) {
+        r->norm[0] = 1.0f / sqrtf(2.0f);
+    }
+    roomsim_fdn_setdirs(r);
+    roomsim_moveall(r);
+}
+
+// ─────────────────────────────────────
+void roomsim_setroom(t_roomsim *r, float x, float y, float z) {
+    r->room[0] = x;
+    r->room[1] = y;
+    r->room[2] = z;
+    // sources and receivers left outside a smaller room are moved onto its walls
+    for (int s = 0; s < r->nSources; s++) {
+        t_roomsim_source *src = &r->sources[s];
+        for (int a = 0; a < 3; a++) {
+            src->pos[a] = roomsim_clip(src->pos[a], r->room[a]);
+            src->next[a] = roomsim_clip(src->next[a], r->room[a]);
+        }
+    }
+    for (int i = 0; i < r->nReceivers * 3; i++) {
+        r->receivers[i] = roomsim_clip(r->receivers[i], r->room[i % 3]);
+    }
+    roomsim_lattice_setroom(&r->lattice, r->room);
+    roomsim_growlines(r);
+    roomsim_fdn_setlengths(r);
+    roomsim_fdn_update(r);
+    roomsim_moveall(r);
+}
+
+// ─────────────────────────────────────
+void roomsim_setabsorption(t_roomsim *r, int wall, const float *absorption) {
+    // absorption holds one coefficient per band, the band-interleaved delay lines are used from
+    // the first wall that is not flat on
+    memcpy(r->absorption[wall], absorption, ROOMSIM_NUM_BANDS * sizeof(float));
+    int nBands = 1;
+    for (int w = 0; w < ROOMSIM_NUM_WALLS; w++) {
+        for (int b = 1; b < ROOMSIM_NUM_BANDS; b++) {
+            if (r->absorption[w][b] != r->absorption[w][0]) {
+                nBands = ROOMSIM_NUM_BANDS;
+            }
+        }
+    }
+    t_roomsim_lattice *l = &r->lattice;
+    if (!r->gainFade) {
+        // the gains heard in the last frame, the next one crossfades from them
+        memcpy(l->gainPrev, l->gain, l->nImages * ROOMSIM_NUM_BANDS * sizeof(float));
+        r->gainFade = 1;
+    }
+    if (nBands > r->nBands) {
+        roomsim_splitlines(r);
+    }
+    roomsim_lattice_setabsorption(l, r->absorption);
+    roomsim_fdn_update(r);
+    roomsim_moveall(r);
+}
+
+// ─────────────────────────────────────
+void roomsim_setmaxreflectionorder(t_roomsim *r, int maxOrder) {
+    maxOrder = maxOrder > ROOMSIM_MAX_REFLECTION_ORDER ? ROOMSIM_MAX_REFLECTION_ORDER : maxOrder;
+    if (maxOrder == r->maxReflectionOrder) {
+        return;
+    }
+    r->maxReflectionOrder = maxOrder;
+    if (maxOrder > r->lattice.maxOrder) {
+        // a lower order only uses fewer images of the lattice, it is rebuilt for a higher one
+        t_roomsim_lattice old = r->lattice;
+        t_roomsim_lattice *l = &r->lattice;
+        memset(l, 0, sizeof(t_roomsim_lattice));
+        roomsim_lattice_build(l, maxOrder);
+        roomsim_lattice_setroom(l, r->room);
+        roomsim_lattice_setabsorption(l, r->absorption);
+        memcpy(l->gainPrev, l->gain, l->nImages * ROOMSIM_NUM_BANDS * sizeof(float));
+        if (r->gainFade) {
+            memcpy(l->gainPrev, old.gainPrev, old.nImages * ROOMSIM_NUM_BANDS * sizeof(float));
+        }
+        roomsim_growimages(r, old.nImages);
+        roomsim_lattice_free(&old);
+        roomsim_growlines(r);
+    }
+    roomsim_fdn_update(r);
+    roomsim_moveall(r);
+}
+
+// ─────────────────────────────────────
+void roomsim_setreflectionorder(t_roomsim *r, int order) {
+    r->reflectionOrder = order < 0 ? 0 : order;
+    roomsim_fdn_update(r);
+    roomsim_moveall(r);
+}
+
+// ─────────────────────────────────────
+void roomsim_setreflections(t_roomsim *r, int enable) {
+    r->reflections = enable != 0;
+    roomsim_fdn_update(r);
+    roomsim_moveall(r);
+}
+
+// ─────────────────────────────────────
+void roomsim_setsource(t_roomsim *r, int index, float x, float y, float z) {
+    // only the last position received before the next frame is used
+    t_roomsim_source *src = &r->sources[index];
+    src->next[0] = x;
+    src->next[1] = y;
+    src->next[2] = z;
+    src->pending = 1;
+    src->moved = 1;
+}
+
+// ─────────────────────────────────────
+void roomsim_setreceiver(t_roomsim *r, int index, float x, float y, float z) {
+    // image positions stay, only the paths to this receiver are recomputed
+    float *receiver = r->receivers + index * 3;
+    receiver[0] = x;
+    receiver[1] = y;
+    receiver[2] = z;
+    for (int s = 0; s < r->nSources; s++) {
+        r->sources[s].paths[index].moved = 1;
+    }
+}
+
+// ─────────────────────────────────────
+void roomsim_setlate(t_roomsim *r, int enable) {
+    enable = enable != 0;
+    if (enable == r->fdn.enable) {
+        return;
+    }
+    roomsim_fdn_free(r);
+    r->fdn.enable = enable;
+    roomsim_fdn_alloc(r);
+    roomsim_fdn_update(r);
+}
+
+// ─────────────────────────────────────
+void roomsim_setcull(t_roomsim *r, float gain) {
+    r->cullGain = gain < 0 ? 0 : gain;
+    roomsim_moveall(r);
+}
+
+// ─────────────────────────────────────
+int roomsim_inside(t_roomsim *r, float x, float y, float z) {
+    return x >= 0 && x <= r->room[0] && y >= 0 && y <= r->room[1] && z >= 0 && z <= r->room[2];
+}
+
+// ─────────────────────────────────────
+int roomsim_getnumkept(t_roomsim *r) {
+    int n = 0;
+    for (int s = 0; s < r->nSources; s++) {
+        for (int rcv = 0; rcv < r->nReceivers; rcv++) {
+            n += r->sources[s].paths[rcv].nKept;
+        }
+    }
+    return n;
+}
+
+// ─────────────────────────────────────
+int roomsim_getnumimages(t_roomsim *r) {
+    return roomsim_numactive(r);
+}
+
+// ─────────────────────────────────────
+int roomsim_gettail(t_roomsim *r) {
+    // an image of order N is at most (2N + 1) room diagonals away from the receiver
+    int order = r->reflections ? r->reflectionOrder : 0;
+    float diag = sqrtf(r->room[0] * r->room[0] + r->room[1] * r->room[1] +
+                       r->room[2] * r->room[2]);
+    int tail = (int)ceilf((2 * order + 1) * diag / ROOMSIM_SPEED_OF_SOUND * r->sr);
+    if (r->fdn.enable) {
+        // a full-scale input needs two RT60s to fall below the idle threshold (-120 dB)
+        int late = r->fdn.preDelay + (int)ceilf(2.0f * r->fdn.rt60 * r->sr);
+        tail = late > tail ? late : tail;
+    }
+    return tail;
+}
+
+// ─────────────────────────────────────
+float roomsim_getrt60(t_roomsim *r) {
+    return r->fdn.rt60;
+}
+
+// ─────────────────────────────────────
+void roomsim_process(t_roomsim *r, const float *const *ins, float *const *outs, int nS) {
+    int nSH = r->nSH;
+    memset(r->out, 0, r->nReceivers * nSH * nS * sizeof(float));
+    for (int s = 0; s < r->nSources; s++) {
+        t_roomsim_source *src = &r->sources[s];
+        if (r->nBands > 1) {
+            roomsim_filterbank_split(&r->filterbank, src, ins[s], r->writePos, r->lineMask, nS);
+        } else {
+            for (int t = 0; t < nS; t++) {
+                src->line[(r->writePos + t) & r->lineMask] = ins[s][t];
+            }
+        }
+        if (src->moved) {
+            if (src->pending) {
+                memcpy(src->pos, src->next, sizeof(src->pos));
+                src->pending = 0;
+            }
+            roomsim_updateimages(r, src);
+            src->moved = 0;
+        }
+        for (int rcv = 0; rcv < r->nReceivers; rcv++) {
+            t_roomsim_path *p = &src->paths[rcv];
+            if (p->moved) {
+                roomsim_updatepath(r, src, rcv);
+                p->moved = 0;
+            }
+            if (p->nKept == 0) {
+                continue;
+            }
+            roomsim_readimages(r, src, p, nS);
+            cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, nSH, nS, p->nKept, 1.0f, p->Y,
+                        p->nKept, r->imgSig, nS, 1.0f, r->out + rcv * nSH * nS, nS);
+            // the images that faded out are dropped by the next update
+            p->moved |= p->fading;
+        }
+    }
+    if (r->fdn.enable) {
+        roomsim_fdn_process(r, nS);
+    }
+    r->writePos = (r->writePos + nS) & r->lineMask;
+    r->gainFade = 0;
+    for (int ch = 0; ch < r->nReceivers * nSH; ch++) {
+        memcpy(outs[ch], r->out + ch * nS, nS * sizeof(float));
+    }
+}
@@ -0,0 +1,201 @@
+#ifndef SAF_ROOMSIM_H
+#define SAF_ROOMSIM_H
+
+#include <m_pd.h>
+#include <_common.h>
+
+// ─────────────────────────────────────
+// Shoebox image-source engine used by [saf.roomsim~]. The image lattice only depends on the room
+// dimensions and the maximum reflection order, so it is built once per room. Moving a source or
+// a receiver only recomputes the delays, gains and directions of the affected images, and all
+// moves received between two frames are applied once, at the start of the next frame. Image
+// positions belong to the source and are shared by every receiver, only the distance, delay and
+// direction step is repeated per receiver.
+//
+// The rendering itself is not shared: an image reaches each receiver with its own delay, so every
+// receiver reads each kept image from the delay line and encodes it with its own SGEMM, and the
+// cost of the early reflections grows linearly with the number of receivers. Only the source side
+// (band split, delay lines, image positions and the late tail network) is paid once.
+//
+// In hybrid mode (`late 1`) the image sources only cover the early reflections and a feedback
+// delay network takes over after them. Its RT60 follows Sabine's formula from the room dimensions
+// and the wall absorption, and each of its lines is encoded from a fixed direction, so every
+// receiver gets the same diffuse tail.
+//
+// When a wall absorbs differently across octave bands, every source is split once by a
+// complementary filterbank into a band-interleaved delay line. An image read then fetches all
+// bands at once and weights them by the reflection gains of the image, so the bands are summed
+// back before the SH encoding.
+//
+// With a cull threshold, images whose arrival gain (wall reflections and distance) falls below it
+// are skipped per source and receiver, which also lowers the reflection order of far sources.
+// Culled images fade out over one frame before they are skipped.
+//
+// Changing the room, the absorption or the maximum reflection order never clears the delay lines.
+// The lines and the lattice only grow, keeping their history, and every image glides to its new
+// delay and gain, so these messages can be sent while sound is playing.
+#define ROOMSIM_FRAMESIZE 128
+#define ROOMSIM_SPEED_OF_SOUND 343.0f
+#define ROOMSIM_MAX_REFLECTION_ORDER 12
+#define ROOMSIM_MAX_DOPPLER 0.5f // largest delay change per sample, must stay below 1
+#define ROOMSIM_WINDOWSIZE(frameSize) (2 * (frameSize) + 8)
+#define ROOMSIM_NUM_BANDS 8 // octave bands from 63 Hz to 8 kHz
+#define ROOMSIM_FDN_LINES 16
+#define ROOMSIM_MAX_RT60 30.0f
+
+enum {
+    ROOMSIM_WALL_POS_X = 0,
+    ROOMSIM_WALL_NEG_X,
+    ROOMSIM_WALL_POS_Y,
+    ROOMSIM_WALL_NEG_Y,
+    ROOMSIM_WALL_POS_Z,
+    ROOMSIM_WALL_NEG_Z,
+    ROOMSIM_NUM_WALLS
+};
+
+// ─────────────────────────────────────
+typedef struct _roomsim_lattice {
+    int maxOrder;
+    int nImages;
+    int nUpToOrder[ROOMSIM_MAX_REFLECTION_ORDER + 1]; // images are sorted by reflection order
+
+    int *k;       // nImages x 3, image index along each axis
+    int *hits;    // nImages x ROOMSIM_NUM_WALLS, reflections on each wall
+    float *signX; // image coordinate = sign * source coordinate + offset
+    float *signY;
+    float *signZ;
+    float *offX;
+    float *offY;
+    float *offZ;
+    float *gain;     // nImages x ROOMSIM_NUM_BANDS, product of the wall reflection coefficients
+    float *gainPrev; // nImages x ROOMSIM_NUM_BANDS, gains of the last frame
+    float *peak;     // nImages, largest band gain
+} t_roomsim_lattice;
+
+// ─────────────────────────────────────
+typedef struct _roomsim_path {
+    int valid;
+    int moved;
+    float *delay;      // nImages, in samples, at the end of the frame
+    float *amp;        // nImages
+    float *delayStart; // nImages, at the start of the frame
+    float *ampStart;   // nImages
+    float *Y;          // nSH x nKept
+    int *kept;         // nImages, images above the cull threshold
+    int nKept;
+    int nActive; // images the last update went through
+    int fading;  // some kept images fade out in the next frame and are dropped after it
+    int order;   // highest reflection order with a kept image
+} t_roomsim_path;
+
+// ─────────────────────────────────────
+typedef struct _roomsim_source {
+    float pos[3];
+    float next[3];
+    int pending; // a new position arrived since the last frame
+    int moved;   // the image positions must be recomputed before the next frame
+    float *line; // lineSize x nBands
+    float z1[ROOMSIM_NUM_BANDS];
+    float z2[ROOMSIM_NUM_BANDS];
+    float *imgX; // nImages, image positions
+    float *imgY;
+    float *imgZ;
+    t_roomsim_path *paths; // nReceivers
+} t_roomsim_source;
+
+// ─────────────────────────────────────
+// Band b of the filterbank is lowpass b minus lowpass b - 1, the last lowpass lets everything
+// through, so the bands always sum back to the input.
+typedef struct _roomsim_filterbank {
+    float b0[ROOMSIM_NUM_BANDS];
+    float b1[ROOMSIM_NUM_BANDS];
+    float b2[ROOMSIM_NUM_BANDS];
+    float a1[ROOMSIM_NUM_BANDS];
+    float a2[ROOMSIM_NUM_BANDS];
+} t_roomsim_filterbank;
+
+// ─────────────────────────────────────
+// The shortest line is at least one frame long, so a whole frame can be read from every line
+// before any of them is written and the feedback matrix is applied with one SGEMM per frame.
+typedef struct _roomsim_fdn {
+    int enable;
+    int lineSize;
+    int lineMask;
+    int writePos;
+    int length[ROOMSIM_FDN_LINES];
+    float decay[ROOMSIM_FDN_LINES]; // gain per pass through each line
+    float inSign[ROOMSIM_FDN_LINES];
+    float H[ROOMSIM_FDN_LINES * ROOMSIM_FDN_LINES];  // Hadamard feedback matrix
+    float Y[MAX_NUM_SH_SIGNALS * ROOMSIM_FDN_LINES]; // nSH x lines, direction of each line
+    float *lines;    // lines x lineSize
+    float *in;       // frameSize
+    float *taps;     // lines x frameSize
+    float *feedback; // lines x frameSize
+    float rt60;
+    float inGain;
+    int preDelay; // samples between the source and the start of the tail
+} t_roomsim_fdn;
+
+// ─────────────────────────────────────
+typedef struct _roomsim {
+    float sr;
+    int frameSize;
+    int order;
+    int nSH;
+    int normType;
+    float norm[MAX_NUM_SH_SIGNALS];
+
+    float room[3];
+    float absorption[ROOMSIM_NUM_WALLS][ROOMSIM_NUM_BANDS];
+    int nBands;   // 1 until some wall absorbs differently across bands
+    int gainFade; // the reflection gains changed since the last frame
+    int nReceivers;
+    float *receivers; // nReceivers x 3
+    int reflections;
+    int reflectionOrder;
+    int maxReflectionOrder; // the lattice may be built for a higher one
+    float cullGain;         // images arriving below this gain are skipped, 0 keeps all
+
+    t_roomsim_lattice lattice;
+    t_roomsim_filterbank filterbank;
+    t_roomsim_fdn fdn;
+    int nSources;
+    t_roomsim_source *sources;
+    int lineSize;
+    int lineMask;
+    int writePos;
+
+    float *imgSig; // nImages x frameSize
+    float *window; // delay line samples read by one image
+    float *fade;   // frameSize, image read with the new reflection gains
+    float *dirs;   // nImages x 2, azimuth/elevation in degrees
+    float *out;    // nReceivers x nSH x frameSize
+
+    double updates;
+} t_roomsim;
+
+// ─────────────────────────────────────
+t_roomsim *roomsim_new(int nSources, int nReceivers, int order, float sr, int frameSize);
+void roomsim_free(t_roomsim *r);
+
+void roomsim_setsamplerate(t_roomsim *r, float sr, int frameSize);
+void roomsim_setnumsources(t_roomsim *r, int nSources);
+void roomsim_setnormtype(t_roomsim *r, int normType);
+void roomsim_setroom(t_roomsim *r, float x, float y, float z);
+void roomsim_setabsorption(t_roomsim *r, int wall, const float *absorption);
+void roomsim_setmaxreflectionorder(t_roomsim *r, int maxOrder);
+void roomsim_setreflectionorder(t_roomsim *r, int order);
+void roomsim_setreflections(t_roomsim *r, int enable);
+void roomsim_setsource(t_roomsim *r, int index, float x, float y, float z);
+void roomsim_setreceiver(t_roomsim *r, int index, float x, float y, float z);
+void roomsim_setlate(t_roomsim *r, int enable);
+void roomsim_setcull(t_roomsim *r, float gain);
+
+int roomsim_inside(t_roomsim *r, float x, float y, float z);
+int roomsim_getnumimages(t_roomsim *r);
+int roomsim_getnumkept(t_roomsim *r);
+int roomsim_gettail(t_roomsim *r);
+float roomsim_getrt60(t_roomsim *r);
+void roomsim_process(t_roomsim *r, const float *const *ins, float *const *outs, int nS);
+
+#endif
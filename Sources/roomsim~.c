@@ -1,10 +1,13 @@
 #include <string.h>
+#include <math.h>
 
 #include <m_pd.h>
 #include <g_canvas.h>
 
-#include <ambi_roomsim.h>
+#include "roomsim.h"
 #include "utilities.h"
+#include "governor.h"
+#include "silence.h"
 
 static t_class *ambiroom_tilde_class;
 
@@ -13,8 +16,7 @@ typedef struct _ambi_roomsim {
     t_object obj;
     t_sample sample;
 
-    void *hAmbi;
-    unsigned hAmbiInit;
+    t_roomsim *room;
 
     t_sample **aIns;
     t_sample **aOuts;
@@ -27,6 +29,8 @@ typedef struct _ambi_roomsim {
     int nOutAccIndex;
 
     int nReceivers;
+    int nSH;
+    int nMaxReflectionOrder;
     int nOrder;
     int nIn;
     int nOut;
@@ -34,6 +38,9 @@ typedef struct _ambi_roomsim {
     int nPreviousOut;
 
     int multichannel;
+
+    t_saf_load load;
+    t_saf_idle idle;
 } t_ambi_roomsim_tilde;
 
 // ─────────────────────────────────────
@@ -95,85 +102,193 @@ static void ambiroom_tilde_malloc(t_ambi_roomsim_tilde *x) {
     x->nPreviousOut = x->nOut;
 }
 
+// ─────────────────────────────────────
+static void ambiroom_tilde_idletail(t_ambi_roomsim_tilde *x) {
+    // once the input has been silent for the longest image path every reflection has arrived
+    saf_idle_settail(&x->idle, saf_idle_frames(roomsim_gettail(x->room), ROOMSIM_FRAMESIZE) + 1);
+}
+
 // ╭─────────────────────────────────────╮
 // │               Methods               │
 // ╰─────────────────────────────────────╯
 static void ambiroom_tilde_set(t_ambi_roomsim_tilde *x, t_symbol *s, int argc, t_atom *argv) {
     const char *method = s->s_name;
+    pd_assert(x, argc >= 1, "[saf.roomsim~] Expected a value");
 
     // Positions
     if (strcmp(method, "source") == 0) {
-        float index = atom_getfloat(argv) - 1;
+        // Moves are only applied at the start of the next frame, so a fast stream of `source`
+        // messages costs one image update per frame.
+        pd_assert(x, argc >= 4, "[saf.roomsim~] source needs an index and x, y, z");
+        int index = atom_getint(argv) - 1;
         float pos_x = atom_getfloat(argv + 1);
         float pos_y = atom_getfloat(argv + 2);
         float pos_z = atom_getfloat(argv + 3);
-        ambi_roomsim_setSourceX(x->hAmbi, index, pos_x);
-        ambi_roomsim_setSourceY(x->hAmbi, index, pos_y);
-        ambi_roomsim_setSourceZ(x->hAmbi, index, pos_z);
+        pd_assert(x, index >= 0 && index < x->room->nSources,
+                  "[saf.roomsim~] Source index out of range");
+        pd_assert(x, roomsim_inside(x->room, pos_x, pos_y, pos_z),
+                  "[saf.roomsim~] Source must be inside the room");
+        roomsim_setsource(x->room, index, pos_x, pos_y, pos_z);
     } else if (strcmp(method, "receiver") == 0) {
-        float index = atom_getfloat(argv) - 1;
+        pd_assert(x, argc >= 4, "[saf.roomsim~] receiver needs an index and x, y, z");
+        int index = atom_getint(argv) - 1;
         float pos_x = atom_getfloat(argv + 1);
         float pos_y = atom_getfloat(argv + 2);
         float pos_z = atom_getfloat(argv + 3);
-        ambi_roomsim_setReceiverX(x->hAmbi, index, pos_x);
-        ambi_roomsim_setReceiverY(x->hAmbi, index, pos_y);
-        ambi_roomsim_setReceiverZ(x->hAmbi, index, pos_z);
-        ambi_roomsim_setNumReceivers(x->hAmbi, x->nReceivers);
+        pd_assert(x, index >= 0 && index < x->nReceivers,
+                  "[saf.roomsim~] Receiver index out of range");
+        pd_assert(x, roomsim_inside(x->room, pos_x, pos_y, pos_z),
+                  "[saf.roomsim~] Receiver must be inside the room");
+        roomsim_setreceiver(x->room, index, pos_x, pos_y, pos_z);
     } else if (strcmp(method, "roomdim") == 0) {
+        // the image lattice is rebuilt only here, source and receiver moves reuse it
+        pd_assert(x, argc >= 3, "[saf.roomsim~] roomdim needs x, y, z");
         float x_pos = atom_getfloat(argv);
         float y_pos = atom_getfloat(argv + 1);
         float z_pos = atom_getfloat(argv + 2);
-        ambi_roomsim_setRoomDimX(x->hAmbi, x_pos);
-        ambi_roomsim_setRoomDimY(x->hAmbi, y_pos);
-        ambi_roomsim_setRoomDimZ(x->hAmbi, z_pos);
-        x->hAmbiInit = 0;
-        canvas_update_dsp();
+        pd_assert(x, x_pos > 0 && y_pos > 0 && z_pos > 0,
+                  "[saf.roomsim~] Room dimensions must be > 0");
+        roomsim_setroom(x->room, x_pos, y_pos, z_pos);
     } else if (strcmp(method, "reflections") == 0) {
         // IMS Image Source Method,
-        int enableIMS = atom_getint(argv + 1);
-        ambi_roomsim_setEnableIMSflag(x->hAmbi, enableIMS);
-    } else if (strcmp(method, "maxreflectionorder") == 0) {
-        int maxReflectionOrder = atom_getint(argv + 1);
-        pd_assert(x, maxReflectionOrder > 0, "[saf.roomsim~] Max reflection order must be > 0");
+        int enableIMS = atom_getint(argv);
+        roomsim_setreflections(x->room, enableIMS);
+    } else if (strcmp(method, "late") == 0) {
+        // hybrid mode, the images stop at the reflection order and a feedback delay network
+        // continues with the RT60 of the room, 2 or 3 orders are usually enough
+        int enableLate = atom_getint(argv);
+        roomsim_setlate(x->room, enableLate);
+    } else if (strcmp(method, "cull") == 0) {
+        // cull <dB>, images arriving below this level are skipped and far sources stop at a
+        // lower reflection order, 0 keeps every image
+        float db = atom_getfloat(argv);
+        pd_assert(x, db <= 0, "[saf.roomsim~] Cull threshold must be <= 0 dB");
+        roomsim_setcull(x->room, db < 0 ? powf(10.0f, db / 20.0f) : 0.0f);
+    } else if (strcmp(method, "maxreflectionorder") == 0 ||
+               strcmp(method, "maxreflectionsorder") == 0) {
+        int maxReflectionOrder = atom_getint(argv);
+        pd_assert(x, maxReflectionOrder > 0 && maxReflectionOrder <= ROOMSIM_MAX_REFLECTION_ORDER,
+                  "[saf.roomsim~] Max reflection order must be between 1 and 12");
         if (maxReflectionOrder > 7) {
-            logpost(x, 2, "[saf.roomsim~] Numbers higher then 7 is a very high reflection order");
+            logpost(x, 2, "[saf.roomsim~] Numbers higher then 7 is a very high reflection order, "
+                          "use 'late 1' for a long tail");
         }
-        ambi_roomsim_setMaxReflectionOrder(x->hAmbi, maxReflectionOrder);
+        x->nMaxReflectionOrder = maxReflectionOrder;
+        saf_load_setmaxlevel(&x->load, maxReflectionOrder - 1);
+        x->load.level = x->load.level > x->load.maxLevel ? x->load.maxLevel : x->load.level;
+        roomsim_setmaxreflectionorder(x->room, maxReflectionOrder);
+        roomsim_setreflectionorder(x->room, maxReflectionOrder - x->load.level);
     } else if (strcmp(method, "wallabscoeff") == 0) {
-        // set ambi_roomsim_setWallAbsCoeff
-        // set wallabscoeff <+x> <-x> <+y> <-y> <+z> <-z>
-        float coeffx_plus = atom_getfloat(argv);
-        float coeffx_minus = atom_getfloat(argv + 1);
-        float coeffy_plus = atom_getfloat(argv + 2);
-        float coeffy_minus = atom_getfloat(argv + 3);
-        float coeffz_plus = atom_getfloat(argv + 4);
-        float coeffz_minus = atom_getfloat(argv + 5);
-        pd_assert(x, coeffx_plus >= 0, "[saf.roomsim~] First value must be positive or 0");
-        pd_assert(x, coeffx_minus < 0, "[saf.roomsim~] Second value must be negative");
-        pd_assert(x, coeffy_plus >= 0, "[saf.roomsim~] Third value must be positive or 0");
-        pd_assert(x, coeffy_minus < 0, "[saf.roomsim~] Fourth value must be negative");
-        pd_assert(x, coeffz_plus >= 0, "[saf.roomsim~] Fifth value must be positive or 0");
-        pd_assert(x, coeffz_minus < 0, "[saf.roomsim~] Sixth value must be negative");
-
-        ambi_roomsim_setWallAbsCoeff(x->hAmbi, 0, 0, coeffx_plus);
-        ambi_roomsim_setWallAbsCoeff(x->hAmbi, 0, 1, coeffx_minus);
-        ambi_roomsim_setWallAbsCoeff(x->hAmbi, 1, 0, coeffy_plus);
-        ambi_roomsim_setWallAbsCoeff(x->hAmbi, 1, 1, coeffy_minus);
-        ambi_roomsim_setWallAbsCoeff(x->hAmbi, 2, 0, coeffz_plus);
-        ambi_roomsim_setWallAbsCoeff(x->hAmbi, 2, 1, coeffz_minus);
+        // wallabscoeff <+x> <-x> <+y> <-y> <+z> <-z>, one broadband coefficient per wall, or
+        // wallabscoeff <wall> <63> <125> <250> <500> <1k> <2k> <4k> <8k>, octave bands of one
+        // wall (1 to 6, same order). Coefficients are between 0 and 1.
+        pd_assert(x, argc == ROOMSIM_NUM_WALLS || argc == ROOMSIM_NUM_BANDS + 1,
+                  "[saf.roomsim~] wallabscoeff needs 6 walls or a wall and 8 bands");
+        int first = argc == ROOMSIM_NUM_WALLS ? 0 : 1;
+        for (int i = first; i < argc; i++) {
+            float coeff = atom_getfloat(argv + i);
+            pd_assert(x, coeff >= 0 && coeff <= 1,
+                      "[saf.roomsim~] Absorption coefficients must be between 0 and 1");
+        }
+        float bands[ROOMSIM_NUM_BANDS];
+        if (argc == ROOMSIM_NUM_WALLS) {
+            for (int w = 0; w < ROOMSIM_NUM_WALLS; w++) {
+                for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+                    bands[b] = atom_getfloat(argv + w);
+                }
+                roomsim_setabsorption(x->room, w, bands);
+            }
+        } else {
+            int wall = atom_getint(argv) - 1;
+            pd_assert(x, wall >= 0 && wall < ROOMSIM_NUM_WALLS,
+                      "[saf.roomsim~] Wall index must be between 1 and 6");
+            for (int b = 0; b < ROOMSIM_NUM_BANDS; b++) {
+                bands[b] = atom_getfloat(argv + b + 1);
+            }
+            roomsim_setabsorption(x->room, wall, bands);
+        }
     } else if (strcmp(method, "normtype") == 0) {
         int normType = atom_getint(argv) + 1;
         switch (normType) {
         case NORM_N3D:
-            ambi_roomsim_setNormType(x->hAmbi, NORM_N3D);
         case NORM_SN3D:
-            ambi_roomsim_setNormType(x->hAmbi, NORM_SN3D);
+            roomsim_setnormtype(x->room, normType);
+            break;
         case NORM_FUMA:
-            ambi_roomsim_setNormType(x->hAmbi, NORM_FUMA);
+            pd_assert(x, x->nOrder == 1, "[saf.roomsim~] FuMa is only defined for first order");
+            roomsim_setnormtype(x->room, normType);
+            break;
         default:
-            pd_error(x, "[saf.roomsim~] Unknown normtype: %s", method);
+            pd_error(x, "[saf.roomsim~] Unknown normtype: %d", normType - 1);
+        }
+    }
+    ambiroom_tilde_idletail(x);
+}
+
+// ─────────────────────────────────────
+static void ambiroom_tilde_applylevel(void *owner, int level) {
+    t_ambi_roomsim_tilde *x = (t_ambi_roomsim_tilde *)owner;
+    roomsim_setreflectionorder(x->room, x->nMaxReflectionOrder - level);
+    ambiroom_tilde_idletail(x);
+}
+
+// ─────────────────────────────────────
+static void ambiroom_tilde_loadreport(t_ambi_roomsim_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void ambiroom_tilde_stats(t_ambi_roomsim_tilde *x) {
+    saf_load_stats(&x->load);
+    t_roomsim *r = x->room;
+    int nTotal = r->nSources * r->nReceivers * roomsim_getnumimages(r);
+    int nKept = roomsim_getnumkept(r);
+    logpost(x, 2, "[saf.roomsim~] %d images per source, %d bands, %.0f image updates",
+            roomsim_getnumimages(r), r->nBands, r->updates);
+    logpost(x, 2, "[saf.roomsim~] %d of %d images processed (%.1f%% culled)", nKept, nTotal,
+            nTotal > 0 ? 100.0f * (nTotal - nKept) / nTotal : 0.0f);
+    for (int s = 0; s < r->nSources; s++) {
+        for (int rcv = 0; rcv < r->nReceivers; rcv++) {
+            t_roomsim_path *p = &r->sources[s].paths[rcv];
+            logpost(x, 3, "  source %d, receiver %d: order %d, %d images", s + 1, rcv + 1,
+                    p->order, p->nKept);
         }
     }
+    if (r->fdn.enable) {
+        logpost(x, 2, "[saf.roomsim~] late tail from %.1f ms, RT60 %.2f s",
+                r->fdn.preDelay * 1000.0f / r->sr, roomsim_getrt60(r));
+    }
+}
+
+// ─────────────────────────────────────
+static void ambiroom_tilde_idle(t_ambi_roomsim_tilde *x, t_floatarg f) {
+    // skip the simulation once the sources are silent and the longest reflection has arrived
+    x->idle.enable = f != 0;
+}
+
+// ─────────────────────────────────────
+static void ambiroom_tilde_degrade(t_ambi_roomsim_tilde *x, t_floatarg f) {
+    // [saf.governor] lowers the reflection order by `level`, the output fades out and in around
+    // the change
+    saf_load_request(&x->load, (int)f);
+}
+
+// ─────────────────────────────────────
+static void ambiroom_tilde_process(t_ambi_roomsim_tilde *x, t_sample **ins, t_sample **outs) {
+    if (saf_idle_check(&x->idle, ins, x->nIn, x->nAmbiFrameSize)) {
+        saf_idle_zero(outs, x->nOut, x->nAmbiFrameSize);
+        saf_load_frame(&x->load, 1);
+        return;
+    }
+    saf_load_frame(&x->load, 0);
+    roomsim_process(x->room, (const float *const *)ins, (float *const *)outs, x->nAmbiFrameSize);
+    saf_load_fade(&x->load, outs, x->nOut, x->nAmbiFrameSize, 1);
+}
+
+// ─────────────────────────────────────
+// In multichannel mode each receiver has its own outlet with nSH channels.
+static inline t_sample *ambiroom_tilde_mcout(t_ambi_roomsim_tilde *x, t_int *w, int n, int ch) {
+    return (t_sample *)(w[4 + ch / x->nSH]) + n * (ch % x->nSH);
 }
 
 // ─────────────────────────────────────
@@ -181,7 +296,7 @@ t_int *ambiroom_tilde_performmultichannel(t_int *w) {
     t_ambi_roomsim_tilde *x = (t_ambi_roomsim_tilde *)(w[1]);
     int n = (int)(w[2]);
     t_sample *ins = (t_sample *)(w[3]);
-    t_sample *outs = (t_sample *)(w[4]);
+    saf_load_begin(&x->load);
 
     if (n < x->nAmbiFrameSize) {
         for (int ch = 0; ch < x->nIn; ch++) {
@@ -191,8 +306,7 @@ t_int *ambiroom_tilde_performmultichannel(t_int *w) {
 
         // Process only if a full frame is ready
         if (x->nInAccIndex == x->nAmbiFrameSize) {
-            ambi_roomsim_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                                 x->nIn, x->nOut, x->nAmbiFrameSize);
+            ambiroom_tilde_process(x, x->aIns, x->aOuts);
             x->nInAccIndex = 0;
             x->nOutAccIndex = 0; // Reset for the next frame
         }
@@ -200,12 +314,13 @@ t_int *ambiroom_tilde_performmultichannel(t_int *w) {
         if (x->nOutAccIndex + n <= x->nAmbiFrameSize) {
             // Copy valid processed data
             for (int ch = 0; ch < x->nOut; ch++) {
-                memcpy(outs + (n * ch), x->aOuts[ch] + x->nOutAccIndex, n * sizeof(t_sample));
+                memcpy(ambiroom_tilde_mcout(x, w, n, ch), x->aOuts[ch] + x->nOutAccIndex,
+                       n * sizeof(t_sample));
             }
             x->nOutAccIndex += n;
         } else {
             for (int ch = 0; ch < x->nOut; ch++) {
-                memset(outs + (n * ch), 0, n * sizeof(t_sample));
+                memset(ambiroom_tilde_mcout(x, w, n, ch), 0, n * sizeof(t_sample));
             }
         }
     } else {
@@ -217,25 +332,25 @@ t_int *ambiroom_tilde_performmultichannel(t_int *w) {
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
             // Processa o bloco atual
-            ambi_roomsim_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                                 (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
+            ambiroom_tilde_process(x, x->aInsTmp, x->aOutsTmp);
 
-            t_sample *out = (t_sample *)(w[4]);
             // Copia o resultado para os canais de saída com o offset correto
             for (int ch = 0; ch < x->nOut; ch++) {
-                memcpy(out + ch * n + chunkIndex * x->nAmbiFrameSize, x->aOutsTmp[ch],
-                       x->nAmbiFrameSize * sizeof(t_sample));
+                memcpy(ambiroom_tilde_mcout(x, w, n, ch) + chunkIndex * x->nAmbiFrameSize,
+                       x->aOutsTmp[ch], x->nAmbiFrameSize * sizeof(t_sample));
             }
         }
     }
 
-    return (w + 5);
+    saf_load_end(&x->load, n);
+    return (w + 4 + x->nReceivers);
 }
 
 // ─────────────────────────────────────
 t_int *ambiroom_tilde_perform(t_int *w) {
     t_ambi_roomsim_tilde *x = (t_ambi_roomsim_tilde *)(w[1]);
     int n = (int)(w[2]);
+    saf_load_begin(&x->load);
 
     if (n < x->nAmbiFrameSize) {
         for (int ch = 0; ch < x->nIn; ch++) {
@@ -243,8 +358,7 @@ t_int *ambiroom_tilde_perform(t_int *w) {
         }
         x->nInAccIndex += n;
         if (x->nInAccIndex == x->nAmbiFrameSize) {
-            ambi_roomsim_process(x->hAmbi, (const float *const *)x->aIns, (float *const *)x->aOuts,
-                                 x->nIn, x->nOut, x->nAmbiFrameSize);
+            ambiroom_tilde_process(x, x->aIns, x->aOuts);
             x->nInAccIndex = 0;
             x->nOutAccIndex = 0;
         }
@@ -260,8 +374,7 @@ t_int *ambiroom_tilde_perform(t_int *w) {
                 memcpy(x->aInsTmp[ch], (t_sample *)w[3 + ch] + (chunkIndex * x->nAmbiFrameSize),
                        x->nAmbiFrameSize * sizeof(t_sample));
             }
-            ambi_roomsim_process(x->hAmbi, (const float *const *)x->aInsTmp,
-                                 (float *const *)x->aOutsTmp, x->nIn, x->nOut, x->nAmbiFrameSize);
+            ambiroom_tilde_process(x, x->aInsTmp, x->aOutsTmp);
             for (int ch = 0; ch < x->nOut; ch++) {
                 t_sample *out = (t_sample *)(w[3 + x->nIn + ch]);
                 memcpy(out + (chunkIndex * x->nAmbiFrameSize), x->aOutsTmp[ch],
@@ -270,6 +383,7 @@ t_int *ambiroom_tilde_perform(t_int *w) {
         }
     }
 
+    saf_load_end(&x->load, n);
     return (w + 3 + x->nIn + x->nOut);
 }
 
@@ -277,47 +391,42 @@ t_int *ambiroom_tilde_perform(t_int *w) {
 void ambiroom_tilde_dsp(t_ambi_roomsim_tilde *x, t_signal **sp) {
     // This is a mess! Help is you see a better way.
 
-    // ambi_roomsim_getFrameSize has fixed frameSize, for encoder is 64 for
-    // decoder is 128. In the perform method sometimes I need to accumulate samples sometimes I
-    // need to process 2 or more times to avoid change how ambi_roomsim_ works. I think that in
-    // this way is more safe, once that these functions are tested in the main repo. But maybe
-    // worse to implement the own set of functions.
+    // ROOMSIM_FRAMESIZE is fixed. In the perform method sometimes I need to accumulate samples
+    // sometimes I need to process 2 or more times.
 
     x->nPdFrameSize = sp[0]->s_n;
-    x->nIn = sp[0]->s_nchans;
+    x->nIn = x->multichannel ? sp[0]->s_nchans : x->nIn;
+    x->load.sr = sp[0]->s_sr;
     x->nOutAccIndex = 0;
     x->nInAccIndex = 0;
     int sum = x->nIn + x->nOut;
     int sigvecsize = sum + 2;
 
     // Set frame sizes and reset indices
-    x->nAmbiFrameSize = ambi_roomsim_getFrameSize();
-
-    // Initialize the ambisonic encoder
-    if (!x->hAmbiInit) {
-        ambi_roomsim_init(x->hAmbi, sys_getsr());
-        ambi_roomsim_setOutputOrder(x->hAmbi, (SH_ORDERS)x->nOrder);
-        if (ambi_roomsim_getNSHrequired(x->hAmbi) < x->nOut) {
-            pd_error(x, "[saf.encoder~] Number of output signals is too low for the %d order.",
-                     x->nOrder);
-            return;
-        }
-        x->hAmbiInit = 1;
-    }
+    x->nAmbiFrameSize = ROOMSIM_FRAMESIZE;
+    roomsim_setsamplerate(x->room, sp[0]->s_sr, x->nAmbiFrameSize);
+    ambiroom_tilde_idletail(x);
 
-    if (x->nPreviousIn != x->nIn) {
-        printf("before free\n");
+    if (x->nPreviousIn != x->nIn || !x->aIns) {
         ambiroom_tilde_malloc(x);
-        ambi_roomsim_setNumSources(x->hAmbi, x->nIn);
-        printf("after free\n");
+        roomsim_setnumsources(x->room, x->nIn);
         x->nPreviousIn = x->nIn;
     }
 
     // add perform method
     if (x->multichannel) {
         x->nIn = sp[0]->s_nchans;
-        signal_setmultiout(&sp[1], x->nOut);
-        dsp_add(ambiroom_tilde_performmultichannel, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
+        int mcvecsize = 3 + x->nReceivers;
+        t_int *mcvec = getbytes(mcvecsize * sizeof(t_int));
+        mcvec[0] = (t_int)x;
+        mcvec[1] = (t_int)sp[0]->s_n;
+        mcvec[2] = (t_int)sp[0]->s_vec;
+        for (int i = 0; i < x->nReceivers; i++) {
+            signal_setmultiout(&sp[1 + i], x->nSH);
+            mcvec[3 + i] = (t_int)sp[1 + i]->s_vec;
+        }
+        dsp_addv(ambiroom_tilde_performmultichannel, mcvecsize, mcvec);
+        freebytes(mcvec, mcvecsize * sizeof(t_int));
     } else {
         for (int i = x->nIn; i < sum; i++) {
             signal_setmultiout(&sp[i], 1);
@@ -337,8 +446,8 @@ void ambiroom_tilde_dsp(t_ambi_roomsim_tilde *x, t_signal **sp) {
 void *ambiroom_tilde_new(t_symbol *s, int argc, t_atom *argv) {
     if (argc < 2) {
         pd_error(NULL, "[saf.roomsim~] Wrong number of arguments, use [saf.roomsim~ "
-                       "<num_sources> <ambisonic_order>] or [saf.roomsim~ -m <ambisonic_order>] "
-                       "for multichannel input");
+                       "<num_sources> <ambisonic_order> <num_receivers>] or [saf.roomsim~ -m "
+                       "<ambisonic_order> <num_receivers>] for multichannel input");
 
         return NULL;
     }
@@ -346,41 +455,42 @@ void *ambiroom_tilde_new(t_symbol *s, int argc, t_atom *argv) {
     t_ambi_roomsim_tilde *x = (t_ambi_roomsim_tilde *)pd_new(ambiroom_tilde_class);
     int order = 1;
     int num_sources = 4;
+    int num_receivers = 1;
     if (argv[0].a_type == A_SYMBOL) {
         if (strcmp(atom_getsymbol(argv)->s_name, "-m") != 0) {
             pd_error(x, "[saf.roomsim~] Expected '-m' in second argument.");
             return NULL;
         }
         order = (argc >= 1) ? atom_getint(argv + 1) : 1;
+        num_receivers = (argc >= 3) ? atom_getint(argv + 2) : 1;
         x->multichannel = 1;
     } else {
         num_sources = (argc >= 1) ? atom_getint(argv) : 1;
         order = (argc >= 2) ? atom_getint(argv + 1) : 1;
+        num_receivers = (argc >= 3) ? atom_getint(argv + 2) : 1;
         x->multichannel = 0;
     }
 
-    x->hAmbiInit = 0;
+    order = order < 1 ? 1 : order > MAX_SH_ORDER ? MAX_SH_ORDER : order;
+    num_sources = num_sources < 1 ? 1 : num_sources;
+    num_receivers = num_receivers < 1 ? 1 : num_receivers;
     x->nOrder = order;
+    x->nSH = (order + 1) * (order + 1);
     x->nIn = num_sources;
-    x->nOut = (order + 1) * (order + 1);
+    x->nReceivers = num_receivers;
+    x->nOut = x->nReceivers * x->nSH; // receiver by receiver
     x->nInAccIndex = 0;
-    x->nReceivers = 1;
-
-    ambi_roomsim_create(&x->hAmbi);
-    ambi_roomsim_setEnableIMSflag(x->hAmbi, 0);
-    ambi_roomsim_setNumReceivers(x->hAmbi, x->nReceivers);
-    ambi_roomsim_setOutputOrder(x->hAmbi, x->nOrder);
+    x->nMaxReflectionOrder = 3;
 
-    ambi_roomsim_setReceiverX(x->hAmbi, 0, 2.5);
-    ambi_roomsim_setReceiverY(x->hAmbi, 0, 2.5);
-    ambi_roomsim_setReceiverZ(x->hAmbi, 0, 2.5);
-
-    ambi_roomsim_setRoomDimX(x->hAmbi, 5);
-    ambi_roomsim_setRoomDimY(x->hAmbi, 5);
-    ambi_roomsim_setRoomDimZ(x->hAmbi, 5);
+    // 5 x 5 x 5 m room, receivers in the centre, reflections off until `reflections 1`
+    x->room = roomsim_new(x->nIn, x->nReceivers, x->nOrder, sys_getsr(), ROOMSIM_FRAMESIZE);
+    roomsim_setmaxreflectionorder(x->room, x->nMaxReflectionOrder);
+    roomsim_setreflectionorder(x->room, x->nMaxReflectionOrder);
 
     if (x->multichannel) {
-        outlet_new(&x->obj, &s_signal);
+        for (int i = 0; i < x->nReceivers; i++) {
+            outlet_new(&x->obj, &s_signal);
+        }
     } else {
         for (int i = 1; i < x->nIn; i++) {
             inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
@@ -390,12 +500,18 @@ void *ambiroom_tilde_new(t_symbol *s, int argc, t_atom *argv) {
         }
     }
 
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.roomsim~", x->nMaxReflectionOrder - 1,
+                  ambiroom_tilde_applylevel);
+    saf_idle_init(&x->idle, 0);
+    ambiroom_tilde_idletail(x);
+
     return x;
 }
 
 // ─────────────────────────────────────
 void ambiroom_tilde_free(t_ambi_roomsim_tilde *x) {
-    ambi_roomsim_destroy(&x->hAmbi);
+    saf_load_free(&x->load);
+    roomsim_free(x->room);
     for (int i = 0; i < x->nIn; i++) {
         if (x->aIns) {
             freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
@@ -445,8 +561,16 @@ void setup_saf0x2eroomsim_tilde(void) {
     class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_set, gensym("roomdim"), A_GIMME, 0);
     class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_set, gensym("receiver"), A_GIMME, 0);
     class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_set, gensym("reflections"), A_GIMME, 0);
+    class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_set, gensym("late"), A_GIMME, 0);
+    class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_set, gensym("cull"), A_GIMME, 0);
+    class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_set, gensym("maxreflectionorder"), A_GIMME, 0);
     class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_set, gensym("maxreflectionsorder"), A_GIMME, 0);
     class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_set, gensym("wallabscoeff"), A_GIMME, 0);
     class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_set, gensym("normtype"), A_GIMME, 0);
 
+    class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_idle, gensym("idle"), A_FLOAT, 0);
+    class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_stats, gensym("stats"), 0);
+    class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_loadreport, gensym("saf_loadreport"), 0);
+    class_addmethod(ambiroom_tilde_class, (t_method)ambiroom_tilde_degrade, gensym("saf_degrade"), A_FLOAT, 0);
+
 }
@@ -0,0 +1,349 @@
+#include <string.h>
+#include <math.h>
+
+#include <m_pd.h>
+#include <g_canvas.h>
+
+#include "utilities.h"
+#include "governor.h"
+#include "rotation.h"
+
+#define ROTATOR_DEFAULT_RAMP_MS 20.0f
+
+static t_class *rotator_tilde_class;
+
+// ─────────────────────────────────────
+typedef struct _rotator_tilde {
+    t_object obj;
+    t_sample sample;
+
+    int nOrder;
+    int nIn; // the same channels in and out, channels above the order pass through
+    int multichannel;
+    int signalAngles; // -r, yaw, pitch and roll come from signal inlets
+    int nRotChans;
+    t_sample **aIns;
+    t_sample **aOuts;
+    t_sample *aAngles[3];
+
+    // angles from messages, ramped to the target over rampMs
+    float target[3];
+    float current[3];
+    float inc[3];
+    int rampLeft[3];
+    float rampMs;
+    t_sample *aRamp[3];
+    int nRampSize;
+
+    t_saf_rotation rot;
+    t_saf_load load;
+} t_rotator_tilde;
+
+// ╭─────────────────────────────────────╮
+// │               Methods               │
+// ╰─────────────────────────────────────╯
+static void rotator_tilde_settarget(t_rotator_tilde *x, int a, float angle) {
+    // the shortest way round, the rotation repeats every 360 degrees
+    float delta = fmodf(angle - x->current[a], 360.0f);
+    delta = delta > 180.0f ? delta - 360.0f : delta < -180.0f ? delta + 360.0f : delta;
+    int samples = (int)(x->rampMs * 0.001f * x->load.sr);
+    if (samples < 1) {
+        x->current[a] = x->target[a] = x->current[a] + delta;
+        x->rampLeft[a] = 0;
+        return;
+    }
+    x->target[a] = x->current[a] + delta;
+    x->inc[a] = delta / (float)samples;
+    x->rampLeft[a] = samples;
+}
+
+// ─────────────────────────────────────
+static void rotator_tilde_set(t_rotator_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    const char *method = s->s_name;
+    if (strcmp(method, "set") == 0) {
+        pd_assert(x, argc >= 2, "[saf.rotator~] Expected 'set <method> <value>'");
+        method = atom_getsymbol(argv)->s_name;
+        argc--;
+        argv++;
+    }
+    pd_assert(x, argc >= 1, "[saf.rotator~] Missing value");
+
+    if (x->signalAngles && x->nRotChans >= 3 &&
+        (strcmp(method, "yaw") == 0 || strcmp(method, "pitch") == 0 ||
+         strcmp(method, "roll") == 0 || strcmp(method, "ypr") == 0)) {
+        pd_error(x, "[saf.rotator~] Rotation comes from the signal inlets (-r), %s ignored",
+                 method);
+    } else if (strcmp(method, "yaw") == 0) {
+        rotator_tilde_settarget(x, 0, atom_getfloat(argv));
+    } else if (strcmp(method, "pitch") == 0) {
+        rotator_tilde_settarget(x, 1, atom_getfloat(argv));
+    } else if (strcmp(method, "roll") == 0) {
+        rotator_tilde_settarget(x, 2, atom_getfloat(argv));
+    } else if (strcmp(method, "ypr") == 0) {
+        pd_assert(x, argc >= 3, "[saf.rotator~] Expected 'ypr <yaw> <pitch> <roll>'");
+        for (int a = 0; a < 3; a++) {
+            rotator_tilde_settarget(x, a, atom_getfloat(argv + a));
+        }
+    } else if (strcmp(method, "ramp") == 0) {
+        float ms = atom_getfloat(argv);
+        x->rampMs = ms < 0 ? 0 : ms;
+    } else if (strcmp(method, "flipyaw") == 0) {
+        saf_rotation_setflags(&x->rot, atom_getint(argv) != 0, x->rot.flip[1], x->rot.flip[2],
+                              x->rot.rpy);
+    } else if (strcmp(method, "flippitch") == 0) {
+        saf_rotation_setflags(&x->rot, x->rot.flip[0], atom_getint(argv) != 0, x->rot.flip[2],
+                              x->rot.rpy);
+    } else if (strcmp(method, "fliproll") == 0) {
+        saf_rotation_setflags(&x->rot, x->rot.flip[0], x->rot.flip[1], atom_getint(argv) != 0,
+                              x->rot.rpy);
+    } else if (strcmp(method, "rpyflag") == 0) {
+        saf_rotation_setflags(&x->rot, x->rot.flip[0], x->rot.flip[1], x->rot.flip[2],
+                              atom_getint(argv) != 0);
+    } else {
+        pd_error(x, "[saf.rotator~] Unknown method: %s", method);
+    }
+}
+
+// ─────────────────────────────────────
+static void rotator_tilde_loadreport(t_rotator_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void rotator_tilde_stats(t_rotator_tilde *x) {
+    saf_load_stats(&x->load);
+    int order = x->rot.order;
+    int macs = (order + 1) * (2 * order + 1) * (2 * order + 3) / 3;
+    logpost(x, 2,
+            "[saf.rotator~] Order %d, yaw %.1f, pitch %.1f, roll %.1f, %d multiply-adds per "
+            "sample (%d for the full matrix)",
+            order, x->rot.angles[0], x->rot.angles[1], x->rot.angles[2], macs,
+            x->rot.nSH * x->rot.nSH);
+}
+
+// ╭─────────────────────────────────────╮
+// │     Initialization and Perform      │
+// ╰─────────────────────────────────────╯
+static void rotator_tilde_ramp(t_rotator_tilde *x, int n) {
+    for (int a = 0; a < 3; a++) {
+        t_sample *out = x->aRamp[a];
+        int t = 0;
+        for (; t < n && x->rampLeft[a] > 0; t++) {
+            x->current[a] += x->inc[a];
+            if (--x->rampLeft[a] == 0) {
+                x->current[a] = x->target[a];
+            }
+            out[t] = x->current[a];
+        }
+        for (; t < n; t++) {
+            out[t] = x->current[a];
+        }
+    }
+}
+
+// ─────────────────────────────────────
+static void rotator_tilde_process(t_rotator_tilde *x, int n) {
+    rotator_tilde_ramp(x, n);
+    for (int a = x->nRotChans; a < 3; a++) {
+        x->aAngles[a] = x->aRamp[a];
+    }
+    int nSH = x->rot.nSH < x->nIn ? x->rot.nSH : x->nIn;
+    if (nSH == x->rot.nSH) {
+        saf_rotation_process(&x->rot, x->aIns, x->aOuts, x->aAngles, n);
+    }
+    for (int ch = nSH; ch < x->nIn; ch++) {
+        memmove(x->aOuts[ch], x->aIns[ch], n * sizeof(t_sample));
+    }
+}
+
+// ─────────────────────────────────────
+t_int *rotator_tilde_performmultichannel(t_int *w) {
+    t_rotator_tilde *x = (t_rotator_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    t_sample *ins = (t_sample *)(w[3]);
+    t_sample *rot = (t_sample *)(w[4]);
+    t_sample *outs = (t_sample *)(w[5]);
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nIn; ch++) {
+        x->aIns[ch] = ins + ch * n;
+        x->aOuts[ch] = outs + ch * n;
+    }
+    for (int a = 0; a < x->nRotChans; a++) {
+        x->aAngles[a] = rot + a * n;
+    }
+    rotator_tilde_process(x, n);
+    saf_load_end(&x->load, n);
+
+    return (w + 6);
+}
+
+// ─────────────────────────────────────
+t_int *rotator_tilde_perform(t_int *w) {
+    t_rotator_tilde *x = (t_rotator_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    int nRotIn = x->signalAngles ? 3 : 0;
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nIn; ch++) {
+        x->aIns[ch] = (t_sample *)w[3 + ch];
+        x->aOuts[ch] = (t_sample *)w[3 + x->nIn + nRotIn + ch];
+    }
+    for (int a = 0; a < x->nRotChans; a++) {
+        x->aAngles[a] = (t_sample *)w[3 + x->nIn + a];
+    }
+    rotator_tilde_process(x, n);
+    saf_load_end(&x->load, n);
+
+    return (w + 3 + 2 * x->nIn + nRotIn);
+}
+
+// ─────────────────────────────────────
+void rotator_tilde_dsp(t_rotator_tilde *x, t_signal **sp) {
+    int n = sp[0]->s_n;
+    x->load.sr = sp[0]->s_sr;
+    if (x->multichannel) {
+        int nIn = sp[0]->s_nchans;
+        if (nIn != x->nIn) {
+            freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+            freebytes(x->aOuts, x->nIn * sizeof(t_sample *));
+            x->aIns = (t_sample **)getbytes(nIn * sizeof(t_sample *));
+            x->aOuts = (t_sample **)getbytes(nIn * sizeof(t_sample *));
+            x->nIn = nIn;
+        }
+        int order = get_ambisonic_order(nIn);
+        if (order != x->rot.order) {
+            int flip[3] = {x->rot.flip[0], x->rot.flip[1], x->rot.flip[2]};
+            int rpy = x->rot.rpy;
+            saf_rotation_free(&x->rot);
+            saf_rotation_init(&x->rot, order);
+            saf_rotation_setflags(&x->rot, flip[0], flip[1], flip[2], rpy);
+            x->nOrder = order;
+        }
+    }
+    if (n != x->nRampSize) {
+        for (int a = 0; a < 3; a++) {
+            freebytes(x->aRamp[a], x->nRampSize * sizeof(t_sample));
+            x->aRamp[a] = (t_sample *)getbytes(n * sizeof(t_sample));
+        }
+        x->nRampSize = n;
+    }
+
+    if (x->multichannel) {
+        x->nRotChans = x->signalAngles ? (sp[1]->s_nchans < 3 ? sp[1]->s_nchans : 3) : 0;
+        if (x->signalAngles && x->nRotChans < 3) {
+            pd_error(x, "[saf.rotator~] Rotation inlet expects 3 channels (yaw, pitch, roll), the "
+                        "missing ones follow the messages");
+        }
+        signal_setmultiout(&sp[1 + x->signalAngles], x->nIn);
+        dsp_add(rotator_tilde_performmultichannel, 5, x, n, sp[0]->s_vec,
+                x->signalAngles ? sp[1]->s_vec : NULL, sp[1 + x->signalAngles]->s_vec);
+    } else {
+        int nRotIn = x->signalAngles ? 3 : 0;
+        x->nRotChans = nRotIn;
+        int sum = 2 * x->nIn + nRotIn;
+        int sigvecsize = sum + 2;
+        for (int i = x->nIn + nRotIn; i < sum; i++) {
+            signal_setmultiout(&sp[i], 1);
+        }
+        t_int *sigvec = getbytes(sigvecsize * sizeof(t_int));
+        sigvec[0] = (t_int)x;
+        sigvec[1] = (t_int)n;
+        for (int i = 0; i < sum; i++) {
+            sigvec[2 + i] = (t_int)sp[i]->s_vec;
+        }
+        dsp_addv(rotator_tilde_perform, sigvecsize, sigvec);
+        freebytes(sigvec, sigvecsize * sizeof(t_int));
+    }
+}
+
+// ─────────────────────────────────────
+void *rotator_tilde_new(t_symbol *s, int argc, t_atom *argv) {
+    t_rotator_tilde *x = (t_rotator_tilde *)pd_new(rotator_tilde_class);
+
+    // [saf.rotator~ <order> [-r]] or [saf.rotator~ -m [-r]], -r adds signal inlets for yaw, pitch
+    // and roll (the second inlet with 3 channels with -m), otherwise the angles come from
+    // messages and are ramped
+    int order = 1;
+    x->multichannel = 0;
+    x->signalAngles = 0;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type == A_FLOAT) {
+            order = atom_getint(argv + i);
+        } else if (strcmp(atom_getsymbol(argv + i)->s_name, "-m") == 0) {
+            x->multichannel = 1;
+        } else if (strcmp(atom_getsymbol(argv + i)->s_name, "-r") == 0) {
+            x->signalAngles = 1;
+        }
+    }
+    order = order < 0 ? 0 : order;
+
+    x->nOrder = order;
+    x->nIn = (order + 1) * (order + 1);
+    x->nRotChans = x->signalAngles ? 3 : 0;
+    x->aIns = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
+    x->aOuts = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
+    for (int a = 0; a < 3; a++) {
+        x->target[a] = x->current[a] = x->inc[a] = 0.0f;
+        x->rampLeft[a] = 0;
+        x->aRamp[a] = NULL;
+    }
+    x->nRampSize = 0;
+    x->rampMs = ROTATOR_DEFAULT_RAMP_MS;
+    x->rot.M = NULL;
+    saf_rotation_init(&x->rot, order);
+
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.rotator~", 0, NULL);
+    x->load.sr = sys_getsr();
+
+    if (x->multichannel) {
+        if (x->signalAngles) {
+            inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
+        }
+        outlet_new(&x->obj, &s_signal);
+    } else {
+        for (int i = 1; i < x->nIn + x->nRotChans; i++) {
+            inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
+        }
+        for (int i = 0; i < x->nIn; i++) {
+            outlet_new(&x->obj, &s_signal);
+        }
+    }
+
+    return (void *)x;
+}
+
+// ─────────────────────────────────────
+void rotator_tilde_free(t_rotator_tilde *x) {
+    saf_load_free(&x->load);
+    saf_rotation_free(&x->rot);
+    for (int a = 0; a < 3; a++) {
+        freebytes(x->aRamp[a], x->nRampSize * sizeof(t_sample));
+    }
+    freebytes(x->aIns, x->nIn * sizeof(t_sample *));
+    freebytes(x->aOuts, x->nIn * sizeof(t_sample *));
+}
+
+// ─────────────────────────────────────
+// clang-format off
+void setup_saf0x2erotator_tilde(void) {
+    rotator_tilde_class =
+        class_new(gensym("saf.rotator~"), (t_newmethod)rotator_tilde_new,
+                  (t_method)rotator_tilde_free, sizeof(t_rotator_tilde),
+                  CLASS_DEFAULT | CLASS_MULTICHANNEL, A_GIMME, 0);
+
+    CLASS_MAINSIGNALIN(rotator_tilde_class, t_rotator_tilde, sample);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_set, gensym("set"), A_GIMME, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_set, gensym("yaw"), A_GIMME, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_set, gensym("pitch"), A_GIMME, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_set, gensym("roll"), A_GIMME, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_set, gensym("ypr"), A_GIMME, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_set, gensym("ramp"), A_GIMME, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_set, gensym("flipyaw"), A_GIMME, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_set, gensym("flippitch"), A_GIMME, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_set, gensym("fliproll"), A_GIMME, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_set, gensym("rpyflag"), A_GIMME, 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_stats, gensym("stats"), 0);
+    class_addmethod(rotator_tilde_class, (t_method)rotator_tilde_loadreport, gensym("saf_loadreport"), 0);
+}
@@ -5,6 +5,9 @@
 
 static t_class *saf_libclass;
 
+void saf_governor_setup(void);
+void saf_tracker_setup(void);
+
 typedef struct _saf {
     t_object x_obj;
 } t_saf;
@@ -23,6 +26,9 @@ void saf_setup(void) {
     saf_libclass =
         class_new(gensym("saf"), (t_newmethod)saf_new, 0, sizeof(t_saf), CLASS_NOINLET, 0);
 
+    saf_governor_setup();
+    saf_tracker_setup();
+
     t_canvas *cnv = canvas_getcurrent();
     const char *requiredLibs[] = {"pdlua"};
 
@@ -0,0 +1,382 @@
+#include <string.h>
+#include <math.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include <ambi_bin.h>
+#include "hrirs.h"
+#include "shbinaural.h"
+
+#define SHBIN_TRIM_THRESHOLD 1e-5f // -100 dB below the filter peak
+
+// ─────────────────────────────────────
+static BINAURAL_AMBI_DECODER_METHODS shbin_method(int method) {
+    switch (method) {
+    case DECODING_METHOD_LSDIFFEQ:
+        return BINAURAL_DECODER_LSDIFFEQ;
+    case DECODING_METHOD_SPR:
+        return BINAURAL_DECODER_SPR;
+    case DECODING_METHOD_TA:
+        return BINAURAL_DECODER_TA;
+    case DECODING_METHOD_MAGLS:
+        return BINAURAL_DECODER_MAGLS;
+    default:
+        return BINAURAL_DECODER_LS;
+    }
+}
+
+// ─────────────────────────────────────
+// Designs the decoding filters, NUM_EARS x nSH x *stride samples. *length is the number of samples
+// left once the silent end of the filters is trimmed.
+static float *shbin_design(const t_shbin_config *c, int order, int fs, int *stride, int *length) {
+    int nSH = (order + 1) * (order + 1);
+    t_saf_hrirs h;
+    saf_hrirs_load(&h, c->useDefaultHRIRs, c->sofaPath, fs);
+    float *hrirs = h.hrirs;
+    int nDirs = h.nDirs;
+    int hrirLen = h.len;
+
+    int fftSize = 1;
+    while (fftSize < 2 * hrirLen) {
+        fftSize <<= 1;
+    }
+    int nBins = fftSize / 2 + 1;
+    float *itds = (float *)getbytes(nDirs * sizeof(float));
+    float_complex *hrtfs =
+        (float_complex *)getbytes(nBins * NUM_EARS * nDirs * sizeof(float_complex));
+    float *filters = (float *)getbytes(NUM_EARS * nSH * fftSize * sizeof(float));
+    estimateITDs(hrirs, nDirs, hrirLen, fs, itds);
+    HRIRs2HRTFs(hrirs, nDirs, hrirLen, fftSize, hrtfs);
+    getBinauralAmbiDecoderFilters(hrtfs, h.dirs, nDirs, fftSize, (float)fs, shbin_method(c->method),
+                                  order, itds, NULL, c->enableDiffuseMatching, c->enableMaxRE,
+                                  filters);
+
+    // the filters expect N3D, SN3D input is scaled up by sqrt(2n + 1) on the way
+    if (c->normType == NORM_SN3D) {
+        for (int ear = 0; ear < NUM_EARS; ear++) {
+            for (int ch = 0; ch < nSH; ch++) {
+                int n = (int)sqrtf((float)ch); // ACN channel ch has order n, n^2 <= ch
+                float g = sqrtf(2.0f * (float)n + 1.0f);
+                float *h = filters + (ear * nSH + ch) * fftSize;
+                for (int t = 0; t < fftSize; t++) {
+                    h[t] *= g;
+                }
+            }
+        }
+    }
+
+    float peak = 0.0f;
+    for (int i = 0; i < NUM_EARS * nSH * fftSize; i++) {
+        peak = fabsf(filters[i]) > peak ? fabsf(filters[i]) : peak;
+    }
+    *length = 1;
+    for (int i = 0; i < NUM_EARS * nSH * fftSize; i++) {
+        if (fabsf(filters[i]) > peak * SHBIN_TRIM_THRESHOLD && i % fftSize + 1 > *length) {
+            *length = i % fftSize + 1;
+        }
+    }
+    *stride = fftSize;
+
+    freebytes(itds, nDirs * sizeof(float));
+    freebytes(hrtfs, nBins * NUM_EARS * nDirs * sizeof(float_complex));
+    saf_hrirs_free(&h);
+    return filters;
+}
+
+// ─────────────────────────────────────
+t_shbin *shbin_new(const t_shbin_config *c, int order, int frameSize, int nListeners, int fs) {
+    int stride, length;
+    float *filters = shbin_design(c, order, fs, &stride, &length);
+    if (!filters) {
+        return NULL;
+    }
+
+    t_shbin *r = (t_shbin *)getbytes(sizeof(t_shbin));
+    r->order = order;
+    r->nSH = (order + 1) * (order + 1);
+    r->frameSize = frameSize;
+    r->nFFT = 2 * frameSize;
+    r->nBins = frameSize + 1;
+    r->length = length;
+    r->nParts = (length + frameSize - 1) / frameSize;
+    r->nListeners = nListeners;
+    r->fdlPos = 0;
+
+    int nSH = r->nSH;
+    int nBins = r->nBins;
+    r->listeners = (t_shbin_listener *)getbytes(nListeners * sizeof(t_shbin_listener));
+    if (nListeners == 1) {
+        // nothing to share, the input is rotated in the time domain and the filters, possibly
+        // seconds of BRIR, go through the non-uniform convolver
+        saf_rotation_init(&r->listeners[0].rot, order);
+        r->conv = convolver_new(nSH, NUM_EARS, filters, stride, length, frameSize);
+        r->nParts = r->conv->head.nParts + r->conv->tail.nParts;
+        r->rotated = (t_sample **)getbytes(nSH * sizeof(t_sample *));
+        for (int ch = 0; ch < nSH; ch++) {
+            r->rotated[ch] = (t_sample *)getbytes(frameSize * sizeof(t_sample));
+        }
+        for (int a = 0; a < 3; a++) {
+            r->angles[a] = (t_sample *)getbytes(frameSize * sizeof(t_sample));
+        }
+        freebytes(filters, NUM_EARS * nSH * stride * sizeof(float));
+        return r;
+    }
+
+    saf_rfft_create(&r->hFFT, r->nFFT);
+    r->H = (float_complex *)getbytes(r->nParts * NUM_EARS * nSH * nBins * sizeof(float_complex));
+    r->window = (float *)getbytes(nSH * r->nFFT * sizeof(float));
+    r->X = (float_complex *)getbytes(nSH * nBins * sizeof(float_complex));
+    r->fade = (float_complex *)getbytes(3 * nSH * nBins * sizeof(float_complex));
+    r->Y = (float_complex *)getbytes(nSH * nBins * sizeof(float_complex));
+    r->time = (float *)getbytes(r->nFFT * sizeof(float));
+    for (int p = 0; p < r->nParts; p++) {
+        int n = length - p * frameSize < frameSize ? length - p * frameSize : frameSize;
+        for (int ear = 0; ear < NUM_EARS; ear++) {
+            for (int ch = 0; ch < nSH; ch++) {
+                memset(r->time, 0, r->nFFT * sizeof(float));
+                memcpy(r->time, filters + (ear * nSH + ch) * stride + p * frameSize,
+                       n * sizeof(float));
+                saf_rfft_forward(r->hFFT, r->time,
+                                 r->H + ((p * NUM_EARS + ear) * nSH + ch) * nBins);
+            }
+        }
+    }
+    freebytes(filters, NUM_EARS * nSH * stride * sizeof(float));
+
+    for (int k = 0; k < nListeners; k++) {
+        t_shbin_listener *l = &r->listeners[k];
+        saf_rotation_init(&l->rot, order);
+        l->Mold = (float *)getbytes(nSH * nSH * sizeof(float));
+        memcpy(l->Mold, l->rot.M, nSH * nSH * sizeof(float));
+        memcpy(l->rot.Mnext, l->rot.M, nSH * nSH * sizeof(float));
+        l->settling = 0;
+        l->fdl = (float_complex *)getbytes(r->nParts * nSH * nBins * sizeof(float_complex));
+        l->acc = (float_complex *)getbytes(NUM_EARS * nBins * sizeof(float_complex));
+        l->twin = -1;
+        l->inStep = 0;
+    }
+    return r;
+}
+
+// ─────────────────────────────────────
+void shbin_free(t_shbin *r) {
+    if (!r) {
+        return;
+    }
+    int nSH = r->nSH;
+    int nBins = r->nBins;
+    if (r->conv) {
+        saf_rotation_free(&r->listeners[0].rot);
+        convolver_free(r->conv);
+        for (int ch = 0; ch < nSH; ch++) {
+            freebytes(r->rotated[ch], r->frameSize * sizeof(t_sample));
+        }
+        freebytes(r->rotated, nSH * sizeof(t_sample *));
+        for (int a = 0; a < 3; a++) {
+            freebytes(r->angles[a], r->frameSize * sizeof(t_sample));
+        }
+        freebytes(r->listeners, sizeof(t_shbin_listener));
+        freebytes(r, sizeof(t_shbin));
+        return;
+    }
+    for (int k = 0; k < r->nListeners; k++) {
+        t_shbin_listener *l = &r->listeners[k];
+        saf_rotation_free(&l->rot);
+        freebytes(l->Mold, nSH * nSH * sizeof(float));
+        freebytes(l->fdl, r->nParts * nSH * nBins * sizeof(float_complex));
+        freebytes(l->acc, NUM_EARS * nBins * sizeof(float_complex));
+    }
+    freebytes(r->listeners, r->nListeners * sizeof(t_shbin_listener));
+    freebytes(r->H, r->nParts * NUM_EARS * nSH * nBins * sizeof(float_complex));
+    freebytes(r->window, nSH * r->nFFT * sizeof(float));
+    freebytes(r->X, nSH * nBins * sizeof(float_complex));
+    freebytes(r->fade, 3 * nSH * nBins * sizeof(float_complex));
+    freebytes(r->Y, nSH * nBins * sizeof(float_complex));
+    freebytes(r->time, r->nFFT * sizeof(float));
+    saf_rfft_destroy(&r->hFFT);
+    freebytes(r, sizeof(t_shbin));
+}
+
+// ─────────────────────────────────────
+void shbin_setflags(t_shbin *r, int flipYaw, int flipPitch, int flipRoll, int rpy) {
+    const t_saf_rotation *rot = &r->listeners[0].rot;
+    if (flipYaw == rot->flip[0] && flipPitch == rot->flip[1] && flipRoll == rot->flip[2] &&
+        rpy == rot->rpy) {
+        return;
+    }
+    for (int k = 0; k < r->nListeners; k++) {
+        t_shbin_listener *l = &r->listeners[k];
+        saf_rotation_setflags(&l->rot, flipYaw, flipPitch, flipRoll, rpy);
+        if (!r->conv) {
+            // a new convention is a jump of its own, nothing to crossfade from
+            memcpy(l->Mold, l->rot.M, r->nSH * r->nSH * sizeof(float));
+            memcpy(l->rot.Mnext, l->rot.M, r->nSH * r->nSH * sizeof(float));
+            l->settling = 0;
+        }
+    }
+}
+
+// ─────────────────────────────────────
+// Moves the matrices of a listener on by one frame, returns 1 while they differ.
+static int shbin_turn(t_shbin *r, t_shbin_listener *l, const float *angles) {
+    int changed = memcmp(angles, l->rot.angles, sizeof(l->rot.angles)) != 0;
+    if (!changed && !l->settling) {
+        return 0;
+    }
+    float *M = l->Mold;
+    l->Mold = l->rot.Mnext;
+    l->rot.Mnext = l->rot.M;
+    l->rot.M = M;
+    if (changed) {
+        saf_rotation_matrix(&l->rot, angles, M);
+        memcpy(l->rot.angles, angles, sizeof(l->rot.angles));
+        l->settling = 2;
+    } else {
+        memcpy(M, l->rot.Mnext, r->nSH * r->nSH * sizeof(float));
+        l->settling--;
+    }
+    return l->settling > 0;
+}
+
+// ─────────────────────────────────────
+// Pairs every steady listener with the first earlier one that is steady at the same angles. Both
+// then rotate the input with the same matrix, and after nParts such frames their delay lines and
+// outputs are the same.
+static void shbin_twins(t_shbin *r) {
+    for (int k = 0; k < r->nListeners; k++) {
+        t_shbin_listener *l = &r->listeners[k];
+        int twin = -1;
+        for (int j = 0; j < k && !l->settling && twin < 0; j++) {
+            const t_shbin_listener *m = &r->listeners[j];
+            if (!m->settling && memcmp(m->rot.angles, l->rot.angles, sizeof(l->rot.angles)) == 0) {
+                twin = j;
+            }
+        }
+        l->inStep = twin < 0 ? 0 : twin == l->twin ? l->inStep + 1 : 1;
+        l->twin = twin;
+    }
+}
+
+// ─────────────────────────────────────
+// Transforms the overlap-save window of every channel into X, and when a listener turns also into
+// the three windowed spectra of the crossfade, whose sum is X.
+static void shbin_spectra(t_shbin *r, int turning) {
+    int P = r->frameSize;
+    int nSH = r->nSH;
+    int nBins = r->nBins;
+    float step = 1.0f / (float)P;
+    for (int ch = 0; ch < nSH; ch++) {
+        float *w = r->window + ch * r->nFFT;
+        if (!turning) {
+            saf_rfft_forward(r->hFFT, w, r->X + ch * nBins);
+            continue;
+        }
+        float_complex *F[3];
+        for (int i = 0; i < 3; i++) {
+            F[i] = r->fade + (i * nSH + ch) * nBins;
+        }
+        for (int t = 0; t < P; t++) {
+            float g = step * (float)(t + 1);
+            r->time[t] = (1.0f - g) * w[t];
+            r->time[P + t] = 0.0f;
+        }
+        saf_rfft_forward(r->hFFT, r->time, F[0]);
+        for (int t = 0; t < P; t++) {
+            float g = step * (float)(t + 1);
+            r->time[t] = g * w[t];
+            r->time[P + t] = (1.0f - g) * w[P + t];
+        }
+        saf_rfft_forward(r->hFFT, r->time, F[1]);
+        for (int t = 0; t < P; t++) {
+            r->time[t] = 0.0f;
+            r->time[P + t] = step * (float)(t + 1) * w[P + t];
+        }
+        saf_rfft_forward(r->hFFT, r->time, F[2]);
+        float *x = (float *)(r->X + ch * nBins);
+        for (int i = 0; i < 2 * nBins; i++) {
+            x[i] = ((float *)F[0])[i] + ((float *)F[1])[i] + ((float *)F[2])[i];
+        }
+    }
+}
+
+// ─────────────────────────────────────
+// Renders one frame for every listener, ypr holds yaw, pitch and roll in degrees per listener and
+// outs the left and right ear of each listener in turn.
+void shbin_process(t_shbin *r, const float *const *ins, float *const *outs, const float *ypr) {
+    int P = r->frameSize;
+    int nSH = r->nSH;
+    int nBins = r->nBins;
+    if (r->conv) {
+        for (int a = 0; a < 3; a++) {
+            for (int t = 0; t < P; t++) {
+                r->angles[a][t] = ypr[a];
+            }
+        }
+        saf_rotation_process(&r->listeners[0].rot, (t_sample **)ins, r->rotated, r->angles, P);
+        convolver_process(r->conv, (const float *const *)r->rotated, outs);
+        return;
+    }
+
+    for (int ch = 0; ch < nSH; ch++) {
+        float *w = r->window + ch * r->nFFT;
+        memmove(w, w + P, P * sizeof(float));
+        memcpy(w + P, ins[ch], P * sizeof(float));
+    }
+    int turning = 0;
+    for (int k = 0; k < r->nListeners; k++) {
+        turning |= shbin_turn(r, &r->listeners[k], ypr + 3 * k);
+    }
+    shbin_twins(r);
+    shbin_spectra(r, turning);
+
+    // a real matrix rotates the real and imaginary parts alike, one order block at a time
+    int b = 2 * nBins;
+    int pos = r->fdlPos;
+    for (int k = 0; k < r->nListeners; k++) {
+        t_shbin_listener *l = &r->listeners[k];
+        float *Y = (float *)(l->fdl + pos * nSH * nBins);
+        if (l->twin >= 0) {
+            // the twin comes first and has already rendered this frame
+            const t_shbin_listener *m = &r->listeners[l->twin];
+            memcpy(Y, m->fdl + pos * nSH * nBins, nSH * nBins * sizeof(float_complex));
+            if (l->inStep >= r->nParts) {
+                for (int ear = 0; ear < NUM_EARS; ear++) {
+                    memcpy(outs[NUM_EARS * k + ear], outs[NUM_EARS * l->twin + ear],
+                           P * sizeof(float));
+                }
+                continue;
+            }
+        } else if (!l->settling) {
+            saf_rotation_multiply(&l->rot, l->rot.M, (const float *)r->X, Y, b);
+        } else {
+            const float *M[3] = {l->Mold, l->rot.Mnext, l->rot.M};
+            saf_rotation_multiply(&l->rot, M[0], (const float *)r->fade, Y, b);
+            for (int i = 1; i < 3; i++) {
+                const float *F = (const float *)(r->fade + i * nSH * nBins);
+                saf_rotation_multiply(&l->rot, M[i], F, (float *)r->Y, b);
+                for (int j = 0; j < nSH * b; j++) {
+                    Y[j] += ((const float *)r->Y)[j];
+                }
+            }
+        }
+
+        memset(l->acc, 0, NUM_EARS * nBins * sizeof(float_complex));
+        for (int p = 0; p < r->nParts; p++) {
+            const float_complex *x = l->fdl + ((pos - p + r->nParts) % r->nParts) * nSH * nBins;
+            for (int ear = 0; ear < NUM_EARS; ear++) {
+                const float_complex *h = r->H + (p * NUM_EARS + ear) * nSH * nBins;
+                float *acc = (float *)(l->acc + ear * nBins);
+                for (int ch = 0; ch < nSH; ch++) {
+                    convolver_cmac(acc, (const float *)(h + ch * nBins),
+                               (const float *)(x + ch * nBins), nBins);
+                }
+            }
+        }
+        for (int ear = 0; ear < NUM_EARS; ear++) {
+            saf_rfft_backward(r->hFFT, l->acc + ear * nBins, r->time);
+            memcpy(outs[NUM_EARS * k + ear], r->time + P, P * sizeof(float));
+        }
+    }
+    r->fdlPos = (pos + 1) % r->nParts;
+}
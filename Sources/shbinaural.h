@@ -0,0 +1,87 @@
+#ifndef SAF_SHBINAURAL_H
+#define SAF_SHBINAURAL_H
+
+#include <m_pd.h>
+#include <_common.h>
+#include <saf.h>
+
+#include "rotation.h"
+#include "convolver.h"
+
+// ─────────────────────────────────────
+// SH-domain binaural renderer used by [saf.binaural~ -listeners N] and [saf.binaural~ -lowlatency].
+// The Ambisonic-to-binaural decoder (LS, MagLS, ... as selected for ambi_bin) is designed once as
+// a set of FIR filters, one per ear and SH channel, and run as a uniformly partitioned
+// overlap-save convolution with one partition per frame. The output of a frame only depends on
+// the input up to its last sample, so with the Pd block as the frame (-lowlatency) the renderer
+// adds no latency of its own, where ambi_bin adds its STFT delay and the frame accumulation.
+//
+// Rotation is linear and frequency independent, so the input spectra of a frame are computed once
+// and rotated per listener in the frequency domain. Only the nSH forward FFTs are shared: each
+// listener still costs one block-diagonal rotation of the new spectra (saf_rotation_multiply), the
+// accumulation of its own frequency-domain delay line against all the filters and two inverse
+// FFTs. Listeners facing the same way share that work too: the first of them renders, the others
+// copy its rotated spectra and, once their delay lines hold the same spectra, its output. The cost
+// then grows with the number of distinct orientations, and only turning listeners are rendered on
+// their own.
+//
+// While a listener turns, its rotation is crossfaded across the frame as in the time domain. With
+// w rising to 1 over a frame, the overlap-save window of frame k then holds
+//   M(k - 2) (1 - w) x(k - 1) + M(k - 1) (w x(k - 1) + (1 - w) x(k)) + M(k) w x(k)
+// so the frame is transformed as three windowed spectra, shared by all listeners, and a turning
+// listener costs three rotations instead of one for two frames.
+//
+// A single listener has nothing to share: its input is rotated in the time domain, with the
+// rotation crossfaded within the frame, and convolved by the non-uniform convolver, so long BRIRs
+// only cost their head on the audio thread.
+#define SHBIN_MAX_LISTENERS 64
+
+typedef struct _shbin_config {
+    int method; // AMBI_BIN_DECODING_METHODS
+    int enableMaxRE;
+    int enableDiffuseMatching;
+    int normType; // NORM_N3D or NORM_SN3D
+    int useDefaultHRIRs;
+    char sofaPath[MAXPDSTRING];
+} t_shbin_config;
+
+typedef struct _shbin_listener {
+    t_saf_rotation rot; // M is the matrix of this frame, Mnext the one of the last frame
+    float *Mold;        // nSH x nSH, matrix of the frame before
+    int settling;       // frames until the three matrices are the same again
+    float_complex *fdl; // nParts x nSH x nBins, rotated input spectra
+    float_complex *acc; // NUM_EARS x nBins
+    int twin;           // earlier listener facing the same way, rendered instead, or -1
+    int inStep;         // frames the rotated spectra have matched those of the twin
+} t_shbin_listener;
+
+typedef struct _shbin {
+    int order;
+    int nSH;
+    int frameSize;
+    int nFFT; // 2 x frameSize
+    int nBins;
+    int nParts;
+    int length; // filter length in samples
+    int nListeners;
+    int fdlPos;
+    void *hFFT;
+    float_complex *H;    // nParts x NUM_EARS x nSH x nBins
+    float *window;       // nSH x nFFT, previous and current frame
+    float_complex *X;    // nSH x nBins
+    float_complex *fade; // 3 x nSH x nBins, windowed spectra of a frame with a turning listener
+    float_complex *Y;    // nSH x nBins
+    float *time;         // nFFT
+    t_shbin_listener *listeners;
+    t_convolver *conv;  // single listener only
+    t_sample **rotated; // nSH x frameSize
+    t_sample *angles[3];
+} t_shbin;
+
+// ─────────────────────────────────────
+t_shbin *shbin_new(const t_shbin_config *c, int order, int frameSize, int nListeners, int fs);
+void shbin_free(t_shbin *r);
+void shbin_setflags(t_shbin *r, int flipYaw, int flipPitch, int flipRoll, int rpy);
+void shbin_process(t_shbin *r, const float *const *ins, float *const *outs, const float *ypr);
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef SAF_SILENCE_H
+#define SAF_SILENCE_H
+
+#include <math.h>
+#include <string.h>
+#include <m_pd.h>
+
+#if (!defined(PD_FLOATSIZE) || PD_FLOATSIZE == 32)
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SAF_SILENCE_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SAF_SILENCE_NEON
+#endif
+#endif
+
+// ─────────────────────────────────────
+// Idle bypass: once every input channel stayed below the threshold for longer than the tail of
+// the object (reverb, STFT overlap, ...) the SAF call can be skipped and zeros written instead.
+#define SAF_IDLE_THRESHOLD 1e-6f // -120 dBFS
+
+typedef struct _saf_idle {
+    int enable;
+    int tailFrames;
+    int silentFrames;
+    t_sample threshold;
+} t_saf_idle;
+
+// ─────────────────────────────────────
+static inline void saf_idle_init(t_saf_idle *s, int tailFrames) {
+    s->enable = 1;
+    s->tailFrames = tailFrames < 0 ? 0 : tailFrames;
+    s->silentFrames = 0;
+    s->threshold = SAF_IDLE_THRESHOLD;
+}
+
+// ─────────────────────────────────────
+static inline void saf_idle_settail(t_saf_idle *s, int tailFrames) {
+    s->tailFrames = tailFrames < 0 ? 0 : tailFrames;
+}
+
+// ─────────────────────────────────────
+// Number of frames of nFrameSize samples needed to cover tailSamples.
+static inline int saf_idle_frames(int tailSamples, int nFrameSize) {
+    return (tailSamples + nFrameSize - 1) / nFrameSize;
+}
+
+// ─────────────────────────────────────
+static inline int saf_idle_channelsilent(const t_sample *in, int n, t_sample threshold) {
+    int i = 0;
+#if defined(SAF_SILENCE_SSE)
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 peak = _mm_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        __m128 a = _mm_and_ps(_mm_loadu_ps(in + i), mask);
+        __m128 b = _mm_and_ps(_mm_loadu_ps(in + i + 4), mask);
+        __m128 c = _mm_and_ps(_mm_loadu_ps(in + i + 8), mask);
+        __m128 d = _mm_and_ps(_mm_loadu_ps(in + i + 12), mask);
+        peak = _mm_max_ps(peak, _mm_max_ps(_mm_max_ps(a, b), _mm_max_ps(c, d)));
+        if (_mm_movemask_ps(_mm_cmpgt_ps(peak, _mm_set1_ps(threshold)))) {
+            return 0;
+        }
+    }
+#elif defined(SAF_SILENCE_NEON)
+    float32x4_t peak = vdupq_n_f32(0);
+    for (; i + 16 <= n; i += 16) {
+        float32x4_t a = vmaxq_f32(vabsq_f32(vld1q_f32(in + i)), vabsq_f32(vld1q_f32(in + i + 4)));
+        float32x4_t b =
+            vmaxq_f32(vabsq_f32(vld1q_f32(in + i + 8)), vabsq_f32(vld1q_f32(in + i + 12)));
+        peak = vmaxq_f32(peak, vmaxq_f32(a, b));
+        float32x2_t p = vpmax_f32(vget_low_f32(peak), vget_high_f32(peak));
+        if (vget_lane_f32(vpmax_f32(p, p), 0) > threshold) {
+            return 0;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (fabsf(in[i]) > threshold) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// ─────────────────────────────────────
+static inline int saf_idle_framesilent(t_sample **ins, int nIn, int n, t_sample threshold) {
+    for (int ch = 0; ch < nIn; ch++) {
+        if (!saf_idle_channelsilent(ins[ch], n, threshold)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// ─────────────────────────────────────
+// Returns 1 when the frame can be skipped, the caller then writes zeros to the outputs.
+static inline int saf_idle_check(t_saf_idle *s, t_sample **ins, int nIn, int n) {
+    if (!s->enable || !saf_idle_framesilent(ins, nIn, n, s->threshold)) {
+        s->silentFrames = 0;
+        return 0;
+    }
+    if (s->silentFrames <= s->tailFrames) {
+        s->silentFrames++;
+        return 0;
+    }
+    return 1;
+}
+
+// ─────────────────────────────────────
+static inline void saf_idle_zero(t_sample **outs, int nOut, int n) {
+    for (int ch = 0; ch < nOut; ch++) {
+        memset(outs[ch], 0, n * sizeof(t_sample));
+    }
+}
+
+#endif
@@ -1,97 +1,342 @@
 #include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include <m_pd.h>
 #include <g_canvas.h>
 
 #include "utilities.h"
+#include "governor.h"
+#include "wakeup.h"
 #include <sldoa.h>
 
+// ─────────────────────────────────────
+// The spatially localised DoA analysis of SAF is far too heavy for Pd's DSP tick, so perform only
+// copies the input into a single-producer single-consumer ring of frames. A worker thread runs
+// sldoa_analysis on every frame in the ring and, at the control rate, hands the per-band azimuth,
+// elevation and energy of each sector to the main thread with pd_queue_mess. When the worker falls
+// behind, perform drops the newest frames instead of waiting.
+#define SLDOA_RING_FRAMES 8    // frames of sldoa_getFrameSize() samples waiting for the worker
+#define SLDOA_DEFAULT_RATE 20 // results per second
+
 static t_class *sldoa_tilde_class;
 
 // ─────────────────────────────────────
+// Written by messages and dsp, applied by the worker between two frames.
+typedef struct _sldoa_tilde_settings {
+    float sr;
+    int order;
+    float minFreq;
+    float maxFreq;
+    float avg; // ms
+    int normType;
+    float rate; // Hz
+} t_sldoa_tilde_settings;
+
 typedef struct _sldoa_tilde {
     t_object obj;
     t_sample sample;
+    t_outlet *outDoa;
 
     void *hAmbi;
-    unsigned hAmbiInit;
-
-    t_sample **aIns;
-    t_sample **aOuts;
-    t_sample **aInsTmp;
-    t_sample **aOutsTmp;
-
+    int nIn;
+    int multichannel;
     int nAmbiFrameSize;
-    int nPdFrameSize;
     int nInAccIndex;
-    int nOutAccIndex;
+    const t_sample **aIns;
+
+    // perform writes the frame at ringWrite, the worker reads the one at ringRead
+    float *ring; // SLDOA_RING_FRAMES x ringIn x nAmbiFrameSize
+    int ringIn;
+    int ringFull; // the frame being accumulated is dropped
+    atomic_uint ringWrite;
+    atomic_uint ringRead;
+    atomic_uint analysed;
+    atomic_uint dropped;
+
+    pthread_t worker;
+    pthread_mutex_t mutex; // settings
+    t_saf_wakeup wakeup;   // posted for every frame, setting and stop
+    atomic_int running;
+    atomic_int dirty;
+    t_sldoa_tilde_settings settings;
+
+    // written by the worker, sent to the outlet by the main thread
+    pthread_mutex_t resultMutex;
+    atomic_int queued;
+    int nBands;
+    int maxSectors;
+    int startBand;
+    int endBand;
+    int *nSectors;  // nBands
+    float *results; // nBands x maxSectors x 3, azimuth, elevation and energy
+    t_atom *atoms;  // 1 + 3 x maxSectors
+
+    t_saf_load load;
+} t_sldoa_tilde;
 
-    int nOrder;
-    int nIn;
-    int nPreviousIn;
+// ╭─────────────────────────────────────╮
+// │             Worker Thread           │
+// ╰─────────────────────────────────────╯
+static void sldoa_tilde_output(t_pd *obj, void *data) {
+    (void)data;
+    if (!obj) {
+        return; // cancelled by sldoa_tilde_free
+    }
+    t_sldoa_tilde *x = (t_sldoa_tilde *)obj;
+    atomic_store(&x->queued, 0);
+    pthread_mutex_lock(&x->resultMutex);
+    int startBand = x->startBand;
+    int endBand = x->endBand;
+    pthread_mutex_unlock(&x->resultMutex);
+
+    // one list per band, <band> followed by <azimuth> <elevation> <energy> of each sector
+    for (int band = startBand; band <= endBand && x->results; band++) {
+        pthread_mutex_lock(&x->resultMutex);
+        int n = x->nSectors[band];
+        const float *r = x->results + band * x->maxSectors * 3;
+        SETFLOAT(&x->atoms[0], band);
+        for (int i = 0; i < 3 * n; i++) {
+            SETFLOAT(&x->atoms[1 + i], r[i]);
+        }
+        pthread_mutex_unlock(&x->resultMutex);
+        outlet_list(x->outDoa, &s_list, 1 + 3 * n, x->atoms);
+    }
+}
 
-    int multichannel;
-} t_sldoa_tilde;
+// ─────────────────────────────────────
+static void sldoa_tilde_publish(t_sldoa_tilde *x) {
+    float *azi, *ele, *energy, *alpha;
+    int *nSectors;
+    int maxSectors, startBand, endBand;
+    sldoa_getDisplayData(x->hAmbi, &azi, &ele, &energy, &alpha, &nSectors, &maxSectors, &startBand,
+                         &endBand);
+
+    pthread_mutex_lock(&x->resultMutex);
+    if (!x->results) {
+        x->nBands = sldoa_getNumberOfBands();
+        x->maxSectors = maxSectors;
+        x->nSectors = (int *)getbytes(x->nBands * sizeof(int));
+        x->results = (float *)getbytes(x->nBands * maxSectors * 3 * sizeof(float));
+        x->atoms = (t_atom *)getbytes((1 + 3 * maxSectors) * sizeof(t_atom));
+    }
+    x->startBand = startBand < 0 ? 0 : startBand;
+    x->endBand = endBand >= x->nBands ? x->nBands - 1 : endBand;
+    for (int band = 0; band < x->nBands; band++) {
+        int n = nSectors[band] > maxSectors ? maxSectors : nSectors[band];
+        float *r = x->results + band * maxSectors * 3;
+        for (int s = 0; s < n; s++) {
+            r[3 * s] = azi[band * maxSectors + s];
+            r[3 * s + 1] = ele[band * maxSectors + s];
+            r[3 * s + 2] = energy[band * maxSectors + s];
+        }
+        x->nSectors[band] = n;
+    }
+    pthread_mutex_unlock(&x->resultMutex);
+
+    // the main thread may lag behind, it always sends the latest results
+    if (!atomic_exchange(&x->queued, 1)) {
+        pd_queue_mess(&pd_maininstance, &x->obj.te_g.g_pd, NULL, sldoa_tilde_output);
+    }
+}
 
 // ─────────────────────────────────────
-static void sldoa_tilde_malloc(t_sldoa_tilde *x) {
-    if (x->aIns) {
-        for (int i = 0; i < x->nPreviousIn; i++) {
-            if (x->aIns[i]) {
-                freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
-            }
-            if (x->aInsTmp[i]) {
-                freebytes(x->aInsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
-            }
+static void sldoa_tilde_apply(t_sldoa_tilde *x, t_sldoa_tilde_settings *cur,
+                              const t_sldoa_tilde_settings *s) {
+    int refresh = 0;
+    if (s->sr != cur->sr) {
+        sldoa_init(x->hAmbi, s->sr);
+        refresh = 1;
+    }
+    if (s->order != cur->order) {
+        sldoa_setMasterOrder(x->hAmbi, s->order);
+        sldoa_setAnaOrderAllBands(x->hAmbi, s->order);
+        refresh = 1;
+    }
+    if (s->minFreq != cur->minFreq) {
+        sldoa_setMinFreq(x->hAmbi, s->minFreq);
+    }
+    if (s->maxFreq != cur->maxFreq) {
+        sldoa_setMaxFreq(x->hAmbi, s->maxFreq);
+    }
+    if (s->avg != cur->avg) {
+        sldoa_setAvg(x->hAmbi, s->avg);
+    }
+    if (s->normType != cur->normType) {
+        sldoa_setNormType(x->hAmbi, s->normType);
+    }
+    if (refresh) {
+        sldoa_refreshSettings(x->hAmbi);
+    }
+    *cur = *s;
+}
+
+// ─────────────────────────────────────
+static void *sldoa_tilde_worker(void *arg) {
+    t_sldoa_tilde *x = (t_sldoa_tilde *)arg;
+    int P = x->nAmbiFrameSize;
+    int nIn = x->ringIn;
+    const float **frame = (const float **)getbytes(nIn * sizeof(float *));
+    t_sldoa_tilde_settings cur;
+    memset(&cur, 0, sizeof(cur));
+    int interval = 1;
+    int frames = 0;
+
+    while (atomic_load(&x->running)) {
+        if (atomic_exchange(&x->dirty, 0)) {
+            t_sldoa_tilde_settings s;
+            pthread_mutex_lock(&x->mutex);
+            s = x->settings;
+            pthread_mutex_unlock(&x->mutex);
+            sldoa_tilde_apply(x, &cur, &s);
+            interval = (int)(cur.sr / (cur.rate * (float)P) + 0.5f);
+            interval = interval < 1 ? 1 : interval;
+        }
+        if (sldoa_getCodecStatus(x->hAmbi) == CODEC_STATUS_NOT_INITIALISED) {
+            sldoa_initCodec(x->hAmbi); // frames arriving meanwhile are dropped by perform
+        }
+
+        unsigned r = atomic_load_explicit(&x->ringRead, memory_order_relaxed);
+        if (r == atomic_load_explicit(&x->ringWrite, memory_order_acquire)) {
+            // a frame posted since the check is remembered by the wakeup
+            saf_wakeup_wait(&x->wakeup);
+            continue;
+        }
+        float *slot = x->ring + (r % SLDOA_RING_FRAMES) * nIn * P;
+        for (int ch = 0; ch < nIn; ch++) {
+            frame[ch] = slot + ch * P;
+        }
+        sldoa_analysis(x->hAmbi, frame, nIn, P, 1);
+        atomic_store_explicit(&x->ringRead, r + 1, memory_order_release);
+        atomic_fetch_add(&x->analysed, 1);
+
+        if (++frames >= interval) {
+            frames = 0;
+            sldoa_tilde_publish(x);
         }
-        freebytes(x->aIns, x->nIn * sizeof(t_sample *));
     }
 
-    // memory allocation
-    x->aIns = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
-    x->aInsTmp = (t_sample **)getbytes(x->nIn * sizeof(t_sample *));
+    freebytes(frame, nIn * sizeof(float *));
+    return NULL;
+}
 
-    for (int i = 0; i < x->nIn; i++) {
-        x->aIns[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
-        x->aInsTmp[i] = (t_sample *)getbytes(x->nAmbiFrameSize * sizeof(t_sample));
+// ─────────────────────────────────────
+static void sldoa_tilde_start(t_sldoa_tilde *x) {
+    atomic_store(&x->running, 1);
+    atomic_store(&x->dirty, 1);
+    if (pthread_create(&x->worker, NULL, sldoa_tilde_worker, (void *)x) != 0) {
+        atomic_store(&x->running, 0);
+        pd_error(x, "[saf.sldoa~] Failed to start the analysis thread");
     }
-    x->nPreviousIn = x->nIn;
 }
 
 // ─────────────────────────────────────
+static void sldoa_tilde_stop(t_sldoa_tilde *x) {
+    if (!atomic_load(&x->running)) {
+        return;
+    }
+    atomic_store(&x->running, 0);
+    saf_wakeup_post(&x->wakeup);
+    pthread_join(x->worker, NULL);
+}
 
 // ─────────────────────────────────────
+static void sldoa_tilde_update(t_sldoa_tilde *x) {
+    atomic_store(&x->dirty, 1);
+    saf_wakeup_post(&x->wakeup);
+}
+
+// ╭─────────────────────────────────────╮
+// │               Methods               │
+// ╰─────────────────────────────────────╯
 static void sldoa_tilde_set(t_sldoa_tilde *x, t_symbol *s, int argc, t_atom *argv) {
     const char *method = s->s_name;
+    pd_assert(x, argc >= 1, "[saf.sldoa~] Expected a value");
+    float f = atom_getfloat(argv);
+    pthread_mutex_lock(&x->mutex);
+    if (strcmp(method, "rate") == 0) {
+        // results per second, the analysis itself always runs on every frame
+        x->settings.rate = f > 0 ? f : SLDOA_DEFAULT_RATE;
+    } else if (strcmp(method, "minfreq") == 0) {
+        x->settings.minFreq = f;
+    } else if (strcmp(method, "maxfreq") == 0) {
+        x->settings.maxFreq = f;
+    } else if (strcmp(method, "avg") == 0) {
+        // averaging of the sector energies, in ms
+        x->settings.avg = f;
+    } else if (strcmp(method, "normtype") == 0) {
+        if (f < 1 || f > 3) {
+            pthread_mutex_unlock(&x->mutex);
+            logpost(x, 1, "[saf.sldoa~] norm_type must be 1-3");
+            logpost(x, 2, "             N3D  = 1");
+            logpost(x, 2, "             SN3D = 2");
+            logpost(x, 2, "             FUMA = 3");
+            return;
+        }
+        x->settings.normType = (int)f;
+    }
+    pthread_mutex_unlock(&x->mutex);
+    sldoa_tilde_update(x);
 }
 
 // ─────────────────────────────────────
-t_int *sldoa_tilde_performmultichannel(t_int *w) {
-    t_sldoa_tilde *x = (t_sldoa_tilde *)(w[1]);
-    int n = (int)(w[2]);
-    t_sample *ins = (t_sample *)(w[3]);
+static void sldoa_tilde_loadreport(t_sldoa_tilde *x) {
+    saf_load_report(&x->load);
+}
 
-    if (n < x->nAmbiFrameSize) {
-        for (int ch = 0; ch < x->nIn; ch++) {
-            memcpy(x->aIns[ch] + x->nInAccIndex, ins + (n * ch), n * sizeof(t_sample));
-        }
-        x->nInAccIndex += n;
+// ─────────────────────────────────────
+static void sldoa_tilde_stats(t_sldoa_tilde *x) {
+    saf_load_stats(&x->load);
+    logpost(x, 2, "[saf.sldoa~] %u frames analysed, %u dropped while the worker was busy",
+            atomic_load(&x->analysed), atomic_load(&x->dropped));
+}
 
-        // Process only if a full frame is ready
-        if (x->nInAccIndex == x->nAmbiFrameSize) {
-            // TODO: process
+// ╭─────────────────────────────────────╮
+// │     Initialization and Perform      │
+// ╰─────────────────────────────────────╯
+static void sldoa_tilde_push(t_sldoa_tilde *x, int n) {
+    int P = x->nAmbiFrameSize;
+    int nIn = x->ringIn;
+    int i = 0;
+    while (i < n) {
+        unsigned w = atomic_load_explicit(&x->ringWrite, memory_order_relaxed);
+        if (x->nInAccIndex == 0) {
+            unsigned r = atomic_load_explicit(&x->ringRead, memory_order_acquire);
+            x->ringFull = w - r >= SLDOA_RING_FRAMES;
         }
-
-    } else {
-        int chunks = n / x->nAmbiFrameSize;
-        for (int chunkIndex = 0; chunkIndex < chunks; chunkIndex++) {
-            // Copia os dados de entrada para cada canal
-            for (int ch = 0; ch < x->nIn; ch++) {
-                memcpy(x->aInsTmp[ch], (t_sample *)w[3] + ch * n + chunkIndex * x->nAmbiFrameSize,
-                       x->nAmbiFrameSize * sizeof(t_sample));
+        int count = n - i < P - x->nInAccIndex ? n - i : P - x->nInAccIndex;
+        if (!x->ringFull) {
+            float *slot = x->ring + (w % SLDOA_RING_FRAMES) * nIn * P;
+            for (int ch = 0; ch < nIn; ch++) {
+                memcpy(slot + ch * P + x->nInAccIndex, x->aIns[ch] + i, count * sizeof(t_sample));
+            }
+        }
+        x->nInAccIndex += count;
+        i += count;
+        if (x->nInAccIndex == P) {
+            x->nInAccIndex = 0;
+            if (x->ringFull) {
+                atomic_fetch_add_explicit(&x->dropped, 1, memory_order_relaxed);
+            } else {
+                atomic_store_explicit(&x->ringWrite, w + 1, memory_order_release);
+                saf_wakeup_post(&x->wakeup);
             }
         }
     }
+}
+
+// ─────────────────────────────────────
+t_int *sldoa_tilde_performmultichannel(t_int *w) {
+    t_sldoa_tilde *x = (t_sldoa_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    t_sample *ins = (t_sample *)(w[3]);
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->ringIn; ch++) {
+        x->aIns[ch] = ins + ch * n;
+    }
+    sldoa_tilde_push(x, n);
+    saf_load_end(&x->load, n);
 
     return (w + 4);
 }
@@ -101,68 +346,63 @@ t_int *sldoa_tilde_perform(t_int *w) {
     t_sldoa_tilde *x = (t_sldoa_tilde *)(w[1]);
     int n = (int)(w[2]);
 
-    if (n < x->nAmbiFrameSize) {
-        for (int ch = 0; ch < x->nIn; ch++) {
-            memcpy(x->aIns[ch] + x->nInAccIndex, (t_sample *)w[3 + ch], n * sizeof(t_sample));
-        }
-        x->nInAccIndex += n;
-        if (x->nInAccIndex == x->nAmbiFrameSize) {
-            // TODO: process
-            x->nInAccIndex = 0;
-        }
-    } else {
-        int chunks = n / x->nAmbiFrameSize;
-        for (int chunkIndex = 0; chunkIndex < chunks; chunkIndex++) {
-            for (int ch = 0; ch < x->nIn; ch++) {
-                memcpy(x->aInsTmp[ch], (t_sample *)w[3 + ch] + (chunkIndex * x->nAmbiFrameSize),
-                       x->nAmbiFrameSize * sizeof(t_sample));
-            }
-            // TODO: process
-        }
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->ringIn; ch++) {
+        x->aIns[ch] = (t_sample *)w[3 + ch];
     }
+    sldoa_tilde_push(x, n);
+    saf_load_end(&x->load, n);
 
     return (w + 3 + x->nIn);
 }
 
 // ─────────────────────────────────────
 void sldoa_tilde_dsp(t_sldoa_tilde *x, t_signal **sp) {
-    // sldoa_getFrameSize has fixed frameSize, for sldoa is 64 for
-    // decoder is 128. In the perform method sometimes I need to accumulate
-    // samples sometimes I need to process 2 or more times to avoid change how
-    // sldoa_ works. I think that in this way is more safe, once that these
-    // functions are tested in the main repo. But maybe worse to implement the own
-    // set of functions.
-
-    x->nAmbiFrameSize = sldoa_getFrameSize();
-    x->nPdFrameSize = sp[0]->s_n;
-    x->nOutAccIndex = 0;
-    x->nInAccIndex = 0;
-    x->nIn = x->multichannel ? sp[0]->s_nchans : x->nIn;
-
-    int sum = x->nIn;
-    int sigvecsize = sum + 2;
+    x->load.sr = sp[0]->s_sr;
+    int nIn = x->multichannel ? sp[0]->s_nchans : x->nIn;
+    if (nIn > MAX_NUM_SH_SIGNALS) {
+        pd_error(x, "[saf.sldoa~] %d channels, only the first %d are analysed", nIn,
+                 MAX_NUM_SH_SIGNALS);
+        nIn = MAX_NUM_SH_SIGNALS;
+    }
 
-    if (x->nPreviousIn != x->nIn) {
-        sldoa_tilde_malloc(x);
-        x->nPreviousIn = x->nIn;
+    pthread_mutex_lock(&x->mutex);
+    x->settings.sr = sp[0]->s_sr;
+    x->settings.order = get_ambisonic_order(nIn);
+    x->settings.order = x->settings.order < 1 ? 1 : x->settings.order;
+    pthread_mutex_unlock(&x->mutex);
+
+    // the ring is only resized while the worker is stopped
+    if (nIn != x->ringIn) {
+        sldoa_tilde_stop(x);
+        if (x->ring) {
+            freebytes(x->ring, SLDOA_RING_FRAMES * x->ringIn * x->nAmbiFrameSize * sizeof(float));
+            freebytes(x->aIns, x->ringIn * sizeof(t_sample *));
+        }
+        x->ring = (float *)getbytes(SLDOA_RING_FRAMES * nIn * x->nAmbiFrameSize * sizeof(float));
+        x->aIns = (const t_sample **)getbytes(nIn * sizeof(t_sample *));
+        x->ringIn = nIn;
+        atomic_store(&x->ringWrite, 0);
+        atomic_store(&x->ringRead, 0);
+        x->nInAccIndex = 0;
+        sldoa_tilde_start(x);
+    } else {
+        sldoa_tilde_update(x);
     }
 
     if (sp[0]->s_nchans > 1 && !x->multichannel) {
-        pd_error(x, "Multichannel mode is off, but input is multichannel, use '-m' flag");
+        pd_error(x,
+                 "[saf.sldoa~] Multichannel mode is off, but input is multichannel, use '-m' flag");
     }
 
-    // add perform method
     if (x->multichannel) {
-        x->nIn = sp[0]->s_nchans;
         dsp_add(sldoa_tilde_performmultichannel, 3, x, sp[0]->s_n, sp[0]->s_vec);
     } else {
-        for (int i = x->nIn; i < sum; i++) {
-            signal_setmultiout(&sp[i], 1);
-        }
+        int sigvecsize = x->nIn + 2;
         t_int *sigvec = getbytes(sigvecsize * sizeof(t_int));
         sigvec[0] = (t_int)x;
         sigvec[1] = (t_int)sp[0]->s_n;
-        for (int i = 0; i < sum; i++) {
+        for (int i = 0; i < x->nIn; i++) {
             sigvec[2 + i] = (t_int)sp[i]->s_vec;
         }
         dsp_addv(sldoa_tilde_perform, sigvecsize, sigvec);
@@ -172,63 +412,92 @@ void sldoa_tilde_dsp(t_sldoa_tilde *x, t_signal **sp) {
 
 // ─────────────────────────────────────
 void *sldoa_tilde_new(t_symbol *s, int argc, t_atom *argv) {
-    if (argc < 1) {
-        pd_error(NULL, "[saf.sldoa~] Wrong number of arguments, use [saf.sldoa~ "
-                       "<num_sources>] or [saf.sldoa~ -m <ambisonic_order>] "
-                       "for multichannel input");
-        return NULL;
-    }
-
     t_sldoa_tilde *x = (t_sldoa_tilde *)pd_new(sldoa_tilde_class);
+
+    // [saf.sldoa~ <ambisonic_order>] or [saf.sldoa~ -m], the order then follows the channels
     int order = 1;
-    int num_sources = 4;
-    if (argv[0].a_type == A_SYMBOL) {
-        if (strcmp(atom_getsymbol(argv)->s_name, "-m") != 0) {
-            pd_error(x, "[saf.sldoa~] Expected '-m' in second argument.");
-            return NULL;
+    x->multichannel = 0;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type == A_SYMBOL && strcmp(atom_getsymbol(argv + i)->s_name, "-m") == 0) {
+            x->multichannel = 1;
+        } else if (argv[i].a_type == A_FLOAT) {
+            order = atom_getint(argv + i);
         }
-        order = (argc >= 1) ? atom_getint(argv + 1) : 1;
-        x->multichannel = 1;
-    } else {
-        num_sources = (argc >= 2) ? atom_getint(argv) : 1;
-        x->multichannel = 0;
     }
+    if (order < 1 || order > MAX_SH_ORDER) {
+        pd_error(x, "[saf.sldoa~] Ambisonic order must be between 1 and %d", MAX_SH_ORDER);
+        order = order < 1 ? 1 : MAX_SH_ORDER;
+    }
+
+    x->nIn = (order + 1) * (order + 1);
+    x->nAmbiFrameSize = sldoa_getFrameSize();
+    x->nInAccIndex = 0;
+    x->aIns = NULL;
+    x->ring = NULL;
+    x->ringIn = 0;
+    x->ringFull = 0;
+    atomic_init(&x->ringWrite, 0);
+    atomic_init(&x->ringRead, 0);
+    atomic_init(&x->analysed, 0);
+    atomic_init(&x->dropped, 0);
+    atomic_init(&x->running, 0);
+    atomic_init(&x->dirty, 0);
+    atomic_init(&x->queued, 0);
+    pthread_mutex_init(&x->mutex, NULL);
+    saf_wakeup_init(&x->wakeup);
+    pthread_mutex_init(&x->resultMutex, NULL);
+    x->nBands = 0;
+    x->maxSectors = 0;
+    x->startBand = 0;
+    x->endBand = -1;
+    x->nSectors = NULL;
+    x->results = NULL;
+    x->atoms = NULL;
 
     sldoa_create(&x->hAmbi);
-    sldoa_init(x->hAmbi, sys_getsr());
-    x->nOrder = order;
-    x->nIn = num_sources;
+    x->settings.sr = 0; // set by dsp, the worker then calls sldoa_init
+    x->settings.order = 0;
+    x->settings.minFreq = sldoa_getMinFreq(x->hAmbi);
+    x->settings.maxFreq = sldoa_getMaxFreq(x->hAmbi);
+    x->settings.avg = sldoa_getAvg(x->hAmbi);
+    x->settings.normType = sldoa_getNormType(x->hAmbi);
+    x->settings.rate = SLDOA_DEFAULT_RATE;
+
+    // nothing to degrade, the analysis does not run on the audio thread
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.sldoa~", 0, NULL);
 
     if (!x->multichannel) {
         for (int i = 1; i < x->nIn; i++) {
             inlet_new(&x->obj, &x->obj.ob_pd, &s_signal, &s_signal);
         }
     }
+    x->outDoa = outlet_new(&x->obj, &s_list);
 
     return x;
 }
 
 // ─────────────────────────────────────
 void sldoa_tilde_free(t_sldoa_tilde *x) {
+    sldoa_tilde_stop(x);
+    pd_queue_cancel(&x->obj.ob_pd);
+    saf_load_free(&x->load);
     sldoa_destroy(&x->hAmbi);
-    for (int i = 0; i < x->nIn; i++) {
-        if (x->aIns) {
-            freebytes(x->aIns[i], x->nAmbiFrameSize * sizeof(t_sample));
-        }
-        if (x->aInsTmp) {
-            freebytes(x->aInsTmp[i], x->nAmbiFrameSize * sizeof(t_sample));
-        }
+    if (x->ring) {
+        freebytes(x->ring, SLDOA_RING_FRAMES * x->ringIn * x->nAmbiFrameSize * sizeof(float));
+        freebytes(x->aIns, x->ringIn * sizeof(t_sample *));
     }
-
-    if (x->aIns) {
-        freebytes(x->aIns, x->nIn * sizeof(t_sample *));
-    }
-    if (x->aInsTmp) {
-        freebytes(x->aInsTmp, x->nIn * sizeof(t_sample *));
+    if (x->results) {
+        freebytes(x->nSectors, x->nBands * sizeof(int));
+        freebytes(x->results, x->nBands * x->maxSectors * 3 * sizeof(float));
+        freebytes(x->atoms, (1 + 3 * x->maxSectors) * sizeof(t_atom));
     }
+    pthread_mutex_destroy(&x->mutex);
+    saf_wakeup_destroy(&x->wakeup);
+    pthread_mutex_destroy(&x->resultMutex);
 }
 
 // ─────────────────────────────────────
+// clang-format off
 void setup_saf0x2esldoa_tilde(void) {
     sldoa_tilde_class =
         class_new(gensym("saf.sldoa~"), (t_newmethod)sldoa_tilde_new, (t_method)sldoa_tilde_free,
@@ -236,9 +505,11 @@ void setup_saf0x2esldoa_tilde(void) {
 
     CLASS_MAINSIGNALIN(sldoa_tilde_class, t_sldoa_tilde, sample);
     class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_dsp, gensym("dsp"), A_CANT, 0);
-
-    // class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_set, gensym("set"), A_GIMME, 0);
-    class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_set, gensym("solo"), A_GIMME, 0);
+    class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_set, gensym("rate"), A_GIMME, 0);
+    class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_set, gensym("minfreq"), A_GIMME, 0);
+    class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_set, gensym("maxfreq"), A_GIMME, 0);
+    class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_set, gensym("avg"), A_GIMME, 0);
     class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_set, gensym("normtype"), A_GIMME, 0);
-    class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_set, gensym("sourcegain"), A_GIMME, 0);
+    class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_stats, gensym("stats"), 0);
+    class_addmethod(sldoa_tilde_class, (t_method)sldoa_tilde_loadreport, gensym("saf_loadreport"), 0);
 }
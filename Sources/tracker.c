@@ -0,0 +1,343 @@
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include "utilities.h"
+#include "wakeup.h"
+
+// ─────────────────────────────────────
+// [saf.tracker] turns direction-of-arrival estimates, e.g. the band lists of [saf.sldoa~], into
+// tracked sources with stable IDs using the particle filter of SAF (tracker3d). Observations are
+// collected on the main thread and handed to a worker thread as one batch per hop, the worker
+// runs one tracker step per batch. Both directions go through lock-free queues of TRACKER_QUEUE
+// hops, so a result is at most that many hops old when it is sent to the outlet and a slow step
+// drops batches instead of blocking Pd.
+#define TRACKER_QUEUE 4 // hops in flight between the main thread and the worker
+#define TRACKER_MAX_OBS 256
+#define TRACKER_MAX_TARGETS 16
+#define TRACKER_DEG2RAD 0.017453292519943295f
+#define TRACKER_RAD2DEG 57.29577951308232f
+
+static t_class *saf_tracker_class;
+
+// ─────────────────────────────────────
+typedef struct _saf_tracker_batch {
+    int nObs;
+    float xyz[3 * TRACKER_MAX_OBS]; // unit vectors
+} t_saf_tracker_batch;
+
+typedef struct _saf_tracker_result {
+    int nTargets;
+    int ids[TRACKER_MAX_TARGETS];
+    float xyz[3 * TRACKER_MAX_TARGETS];
+} t_saf_tracker_result;
+
+// ─────────────────────────────────────
+typedef struct _saf_tracker {
+    t_object obj;
+    t_clock *clock;
+    t_outlet *out;
+    t_outlet *outCount;
+
+    t_float hop;       // ms between tracker steps
+    t_float threshold; // sectors of [saf.sldoa~] below this energy are ignored
+    t_saf_tracker_batch pending;
+
+    // the main thread writes batches and reads results, the worker the other way round
+    t_saf_tracker_batch *batches; // TRACKER_QUEUE
+    t_saf_tracker_result *results;
+    atomic_uint batchWrite;
+    atomic_uint batchRead;
+    atomic_uint resultWrite;
+    atomic_uint resultRead;
+    atomic_uint steps;
+    atomic_uint dropped;
+
+    pthread_t worker;
+    pthread_mutex_t mutex; // config
+    t_saf_wakeup wakeup;   // posted for every batch, config change and stop
+    atomic_int running;
+    atomic_int dirty; // config changed, the worker creates a new tracker
+    tracker3d_config config;
+} t_saf_tracker;
+
+// ╭─────────────────────────────────────╮
+// │             Worker Thread           │
+// ╰─────────────────────────────────────╯
+static void *saf_tracker_worker(void *arg) {
+    t_saf_tracker *x = (t_saf_tracker *)arg;
+    void *hT3d = NULL;
+    float *pos = NULL; // reallocated by tracker3d_step
+    float *var = NULL;
+    int *ids = NULL;
+    int nTargets = 0;
+
+    while (atomic_load(&x->running)) {
+        if (atomic_exchange(&x->dirty, 0)) {
+            tracker3d_config config;
+            pthread_mutex_lock(&x->mutex);
+            config = x->config;
+            pthread_mutex_unlock(&x->mutex);
+            if (hT3d) {
+                tracker3d_destroy(&hT3d);
+            }
+            tracker3d_create(&hT3d, config);
+        }
+
+        unsigned r = atomic_load_explicit(&x->batchRead, memory_order_relaxed);
+        if (r == atomic_load_explicit(&x->batchWrite, memory_order_acquire)) {
+            // a batch posted since the check is remembered by the wakeup
+            saf_wakeup_wait(&x->wakeup);
+            continue;
+        }
+        t_saf_tracker_batch *b = &x->batches[r % TRACKER_QUEUE];
+        tracker3d_step(hT3d, b->xyz, b->nObs, &pos, &var, &ids, &nTargets);
+        atomic_store_explicit(&x->batchRead, r + 1, memory_order_release);
+        atomic_fetch_add(&x->steps, 1);
+
+        unsigned w = atomic_load_explicit(&x->resultWrite, memory_order_relaxed);
+        if (w - atomic_load_explicit(&x->resultRead, memory_order_acquire) >= TRACKER_QUEUE) {
+            continue; // the main thread only sends the latest result anyway
+        }
+        t_saf_tracker_result *res = &x->results[w % TRACKER_QUEUE];
+        res->nTargets = nTargets < TRACKER_MAX_TARGETS ? nTargets : TRACKER_MAX_TARGETS;
+        memcpy(res->ids, ids, res->nTargets * sizeof(int));
+        memcpy(res->xyz, pos, 3 * res->nTargets * sizeof(float));
+        atomic_store_explicit(&x->resultWrite, w + 1, memory_order_release);
+    }
+
+    if (hT3d) {
+        tracker3d_destroy(&hT3d);
+    }
+    free(pos);
+    free(var);
+    free(ids);
+    return NULL;
+}
+
+// ─────────────────────────────────────
+static void saf_tracker_update(t_saf_tracker *x) {
+    atomic_store(&x->dirty, 1);
+    saf_wakeup_post(&x->wakeup);
+}
+
+// ─────────────────────────────────────
+static void saf_tracker_output(t_saf_tracker *x, const t_saf_tracker_result *res) {
+    // one list per target, <id> <azimuth> <elevation>, then the number of targets
+    for (int t = 0; t < res->nTargets; t++) {
+        const float *p = res->xyz + 3 * t;
+        t_atom a[3];
+        SETFLOAT(&a[0], res->ids[t]);
+        SETFLOAT(&a[1], atan2f(p[1], p[0]) * TRACKER_RAD2DEG);
+        SETFLOAT(&a[2], atan2f(p[2], sqrtf(p[0] * p[0] + p[1] * p[1])) * TRACKER_RAD2DEG);
+        outlet_list(x->out, &s_list, 3, a);
+    }
+    outlet_float(x->outCount, res->nTargets);
+}
+
+// ─────────────────────────────────────
+static void saf_tracker_tick(t_saf_tracker *x) {
+    // the observations of this hop go to the worker, dropped when it is TRACKER_QUEUE hops behind
+    unsigned w = atomic_load_explicit(&x->batchWrite, memory_order_relaxed);
+    if (w - atomic_load_explicit(&x->batchRead, memory_order_acquire) < TRACKER_QUEUE) {
+        t_saf_tracker_batch *b = &x->batches[w % TRACKER_QUEUE];
+        b->nObs = x->pending.nObs;
+        memcpy(b->xyz, x->pending.xyz, 3 * x->pending.nObs * sizeof(float));
+        atomic_store_explicit(&x->batchWrite, w + 1, memory_order_release);
+        saf_wakeup_post(&x->wakeup);
+    } else {
+        atomic_fetch_add(&x->dropped, 1);
+    }
+    x->pending.nObs = 0;
+
+    // only the latest finished step is sent
+    unsigned r = atomic_load_explicit(&x->resultRead, memory_order_relaxed);
+    unsigned available = atomic_load_explicit(&x->resultWrite, memory_order_acquire);
+    if (r != available) {
+        saf_tracker_output(x, &x->results[(available - 1) % TRACKER_QUEUE]);
+        atomic_store_explicit(&x->resultRead, available, memory_order_release);
+    }
+
+    clock_delay(x->clock, x->hop);
+}
+
+// ╭─────────────────────────────────────╮
+// │               Methods               │
+// ╰─────────────────────────────────────╯
+static void saf_tracker_observe(t_saf_tracker *x, t_float azi, t_float ele) {
+    if (x->pending.nObs == TRACKER_MAX_OBS) {
+        return;
+    }
+    float *xyz = x->pending.xyz + 3 * x->pending.nObs++;
+    float a = azi * TRACKER_DEG2RAD;
+    float e = ele * TRACKER_DEG2RAD;
+    xyz[0] = cosf(e) * cosf(a);
+    xyz[1] = cosf(e) * sinf(a);
+    xyz[2] = sinf(e);
+}
+
+// ─────────────────────────────────────
+static void saf_tracker_list(t_saf_tracker *x, t_symbol *s, int argc, t_atom *argv) {
+    // a band of [saf.sldoa~]: <band> followed by <azimuth> <elevation> <energy> of each sector
+    for (int i = 1; i + 2 < argc; i += 3) {
+        if (atom_getfloat(argv + i + 2) >= x->threshold) {
+            saf_tracker_observe(x, atom_getfloat(argv + i), atom_getfloat(argv + i + 1));
+        }
+    }
+}
+
+// ─────────────────────────────────────
+static void saf_tracker_doa(t_saf_tracker *x, t_symbol *s, int argc, t_atom *argv) {
+    // any other estimator: pairs of <azimuth> <elevation>
+    pd_assert(x, argc % 2 == 0, "[saf.tracker] Expected 'doa <azimuth> <elevation> ...'");
+    for (int i = 0; i < argc; i += 2) {
+        saf_tracker_observe(x, atom_getfloat(argv + i), atom_getfloat(argv + i + 1));
+    }
+}
+
+// ─────────────────────────────────────
+static void saf_tracker_stats(t_saf_tracker *x) {
+    logpost(x, 2, "[saf.tracker] %u steps of %.0f ms, %u hops dropped while the worker was busy",
+            atomic_load(&x->steps), x->hop, atomic_load(&x->dropped));
+}
+
+// ─────────────────────────────────────
+static void saf_tracker_set(t_saf_tracker *x, t_symbol *s, int argc, t_atom *argv) {
+    const char *method = s->s_name;
+    pd_assert(x, argc >= 1, "[saf.tracker] Expected a value");
+    t_float value = atom_getfloat(argv);
+    if (strcmp(method, "threshold") == 0) {
+        // energy below which the sectors of [saf.sldoa~] are no observation
+        x->threshold = value;
+        return;
+    }
+    pthread_mutex_lock(&x->mutex);
+    if (strcmp(method, "hop") == 0) {
+        // ms between tracker steps, also the time step of the particle filter
+        if (value < 1) {
+            pthread_mutex_unlock(&x->mutex);
+            pd_error(x, "[saf.tracker] hop must be >= 1 ms");
+            return;
+        }
+        x->hop = value;
+        x->config.dt = value / 1000.0f;
+    } else if (strcmp(method, "maxtargets") == 0) {
+        int n = (int)value;
+        x->config.maxNactiveTargets = n < 1 ? 1 : n > TRACKER_MAX_TARGETS ? TRACKER_MAX_TARGETS : n;
+    } else if (strcmp(method, "particles") == 0) {
+        x->config.Np = value < 1 ? 1 : (int)value;
+    } else if (strcmp(method, "measnoise") == 0) {
+        // standard deviation of the observations, in degrees
+        x->config.measNoiseSD = value;
+    } else if (strcmp(method, "noiselikelihood") == 0) {
+        x->config.noiseLikelihood = value;
+    } else if (strcmp(method, "birth") == 0) {
+        x->config.init_birth = value;
+    }
+    pthread_mutex_unlock(&x->mutex);
+    saf_tracker_update(x);
+}
+
+// ─────────────────────────────────────
+static void *saf_tracker_new(t_symbol *s, int argc, t_atom *argv) {
+    t_saf_tracker *x = (t_saf_tracker *)pd_new(saf_tracker_class);
+
+    // [saf.tracker <max_targets> <hop_ms>]
+    int maxTargets = (argc >= 1) ? atom_getint(argv) : 4;
+    x->hop = (argc >= 2) ? atom_getfloat(argv + 1) : 50;
+    if (maxTargets < 1 || maxTargets > TRACKER_MAX_TARGETS) {
+        pd_error(x, "[saf.tracker] Number of targets must be between 1 and %d",
+                 TRACKER_MAX_TARGETS);
+        maxTargets = maxTargets < 1 ? 1 : TRACKER_MAX_TARGETS;
+    }
+    if (x->hop < 1) {
+        pd_error(x, "[saf.tracker] hop must be >= 1 ms, using 50");
+        x->hop = 50;
+    }
+    x->threshold = 0;
+    x->pending.nObs = 0;
+
+    // a few sources around the listener, born in front of it
+    tracker3d_config *c = &x->config;
+    memset(c, 0, sizeof(tracker3d_config));
+    c->Np = 20;
+    c->ARE_UNIQUE_Np = 0;
+    c->maxNactiveTargets = maxTargets;
+    c->noiseLikelihood = 0.2f;
+    c->measNoiseSD = 20.0f;
+    c->noiseSpecDen = 1.0f;
+    c->ALLOW_MULTI_DEATH = 1;
+    c->init_birth = 0.5f;
+    c->alpha_death = 20.0f;
+    c->beta_death = 1.0f;
+    c->dt = x->hop / 1000.0f;
+    c->W_avg_coeff = 0.5f;
+    c->FORCE_KILL_TARGETS = 1;
+    c->forceKillDistance = 0.08f;
+    c->cd = 1.0f / (4.0f * SAF_PI);
+    c->M0[0] = 1.0f; // position on the unit sphere, then velocity
+    for (int i = 0; i < 6; i++) {
+        c->P0[i][i] = 0.25f;
+    }
+
+    x->batches = (t_saf_tracker_batch *)getbytes(TRACKER_QUEUE * sizeof(t_saf_tracker_batch));
+    x->results = (t_saf_tracker_result *)getbytes(TRACKER_QUEUE * sizeof(t_saf_tracker_result));
+    atomic_init(&x->batchWrite, 0);
+    atomic_init(&x->batchRead, 0);
+    atomic_init(&x->resultWrite, 0);
+    atomic_init(&x->resultRead, 0);
+    atomic_init(&x->steps, 0);
+    atomic_init(&x->dropped, 0);
+    atomic_init(&x->running, 1);
+    atomic_init(&x->dirty, 1);
+    pthread_mutex_init(&x->mutex, NULL);
+    saf_wakeup_init(&x->wakeup);
+    if (pthread_create(&x->worker, NULL, saf_tracker_worker, (void *)x) != 0) {
+        // batches then pile up and are dropped, nothing is tracked
+        atomic_store(&x->running, 0);
+        pd_error(x, "[saf.tracker] Failed to start the tracker thread");
+    }
+
+    x->out = outlet_new(&x->obj, &s_list);
+    x->outCount = outlet_new(&x->obj, &s_float);
+    x->clock = clock_new(x, (t_method)saf_tracker_tick);
+    clock_delay(x->clock, x->hop);
+    return x;
+}
+
+// ─────────────────────────────────────
+static void saf_tracker_free(t_saf_tracker *x) {
+    clock_free(x->clock);
+    if (atomic_load(&x->running)) {
+        atomic_store(&x->running, 0);
+        saf_wakeup_post(&x->wakeup);
+        pthread_join(x->worker, NULL);
+    }
+    pthread_mutex_destroy(&x->mutex);
+    saf_wakeup_destroy(&x->wakeup);
+    freebytes(x->batches, TRACKER_QUEUE * sizeof(t_saf_tracker_batch));
+    freebytes(x->results, TRACKER_QUEUE * sizeof(t_saf_tracker_result));
+}
+
+// ─────────────────────────────────────
+// clang-format off
+void saf_tracker_setup(void) {
+    saf_tracker_class = class_new(gensym("saf.tracker"), (t_newmethod)saf_tracker_new,
+                                  (t_method)saf_tracker_free, sizeof(t_saf_tracker),
+                                  CLASS_DEFAULT, A_GIMME, 0);
+
+    class_addlist(saf_tracker_class, (t_method)saf_tracker_list);
+    class_addmethod(saf_tracker_class, (t_method)saf_tracker_doa, gensym("doa"), A_GIMME, 0);
+    class_addmethod(saf_tracker_class, (t_method)saf_tracker_stats, gensym("stats"), 0);
+    class_addmethod(saf_tracker_class, (t_method)saf_tracker_set, gensym("hop"), A_GIMME, 0);
+    class_addmethod(saf_tracker_class, (t_method)saf_tracker_set, gensym("maxtargets"), A_GIMME, 0);
+    class_addmethod(saf_tracker_class, (t_method)saf_tracker_set, gensym("particles"), A_GIMME, 0);
+    class_addmethod(saf_tracker_class, (t_method)saf_tracker_set, gensym("measnoise"), A_GIMME, 0);
+    class_addmethod(saf_tracker_class, (t_method)saf_tracker_set, gensym("noiselikelihood"), A_GIMME, 0);
+    class_addmethod(saf_tracker_class, (t_method)saf_tracker_set, gensym("birth"), A_GIMME, 0);
+    class_addmethod(saf_tracker_class, (t_method)saf_tracker_set, gensym("threshold"), A_GIMME, 0);
+}
@@ -0,0 +1,206 @@
+#include <string.h>
+
+#include <m_pd.h>
+
+#include <saf.h>
+#include "convolver.h"
+#include "tvconv.h"
+
+// ─────────────────────────────────────
+static float tvconv_coord(const t_tvconv *t, int i, int axis) {
+    return t->positions[3 * i + axis];
+}
+
+// ─────────────────────────────────────
+// Moves the k-th smallest position of tree[lo, hi) along axis to k, smaller ones before it.
+static void tvconv_select(t_tvconv *t, int axis, int lo, int hi, int k) {
+    int *idx = t->tree;
+    while (hi - lo > 1) {
+        float pivot = tvconv_coord(t, idx[(lo + hi) / 2], axis);
+        int i = lo;
+        int j = hi - 1;
+        while (i <= j) {
+            while (tvconv_coord(t, idx[i], axis) < pivot) {
+                i++;
+            }
+            while (tvconv_coord(t, idx[j], axis) > pivot) {
+                j--;
+            }
+            if (i <= j) {
+                int tmp = idx[i];
+                idx[i++] = idx[j];
+                idx[j--] = tmp;
+            }
+        }
+        if (k <= j) {
+            hi = j + 1;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            return; // between the two halves, equal to the pivot
+        }
+    }
+}
+
+// ─────────────────────────────────────
+static void tvconv_build(t_tvconv *t, int lo, int hi, int depth) {
+    if (hi - lo < 2) {
+        return;
+    }
+    int mid = (lo + hi) / 2;
+    tvconv_select(t, depth % 3, lo, hi, mid);
+    tvconv_build(t, lo, mid, depth + 1);
+    tvconv_build(t, mid + 1, hi, depth + 1);
+}
+
+// ─────────────────────────────────────
+static void tvconv_search(const t_tvconv *t, const float *xyz, int lo, int hi, int depth,
+                          int *best, float *bestDist) {
+    if (lo >= hi) {
+        return;
+    }
+    int mid = (lo + hi) / 2;
+    int i = t->tree[mid];
+    float dist = 0.0f;
+    for (int a = 0; a < 3; a++) {
+        float d = xyz[a] - tvconv_coord(t, i, a);
+        dist += d * d;
+    }
+    if (dist < *bestDist) {
+        *bestDist = dist;
+        *best = i;
+    }
+
+    // the side of the query first, the other one only if the split plane is closer than the best
+    float d = xyz[depth % 3] - tvconv_coord(t, i, depth % 3);
+    int nearLo = d < 0.0f ? lo : mid + 1;
+    int nearHi = d < 0.0f ? mid : hi;
+    tvconv_search(t, xyz, nearLo, nearHi, depth + 1, best, bestDist);
+    if (d * d < *bestDist) {
+        tvconv_search(t, xyz, d < 0.0f ? mid + 1 : lo, d < 0.0f ? hi : mid, depth + 1, best,
+                      bestDist);
+    }
+}
+
+// ─────────────────────────────────────
+int tvconv_nearest(const t_tvconv *t, const float *xyz) {
+    int best = 0;
+    float bestDist = 1e30f;
+    tvconv_search(t, xyz, 0, t->nPos, 0, &best, &bestDist);
+    return best;
+}
+
+// ─────────────────────────────────────
+t_tvconv *tvconv_new(const float *h, const float *positions, int nPos, int nOut, int length,
+                     int blockSize) {
+    t_tvconv *t = (t_tvconv *)getbytes(sizeof(t_tvconv));
+    t->nOut = nOut;
+    t->nPos = nPos;
+    t->length = length;
+    t->blockSize = blockSize;
+    t->nFFT = 2 * blockSize;
+    t->nBins = blockSize + 1;
+    t->nParts = (length + blockSize - 1) / blockSize;
+    t->fdlPos = 0;
+    t->current = 0;
+    t->switches = 0;
+    saf_rfft_create(&t->hFFT, t->nFFT);
+
+    int nBins = t->nBins;
+    size_t nSpectra = (size_t)nPos * nOut * t->nParts;
+    t->H = (float_complex *)getbytes(nSpectra * nBins * sizeof(float_complex));
+    t->positions = (float *)getbytes(nPos * 3 * sizeof(float));
+    t->tree = (int *)getbytes(nPos * sizeof(int));
+    t->fdl = (float_complex *)getbytes(t->nParts * nBins * sizeof(float_complex));
+    t->window = (float *)getbytes(t->nFFT * sizeof(float));
+    t->acc = (float_complex *)getbytes(nBins * sizeof(float_complex));
+    t->time = (float *)getbytes(t->nFFT * sizeof(float));
+    t->prev = (float *)getbytes(blockSize * sizeof(float));
+    t->fade = (float *)getbytes(blockSize * sizeof(float));
+    for (int i = 0; i < blockSize; i++) {
+        t->fade[i] = (float)(i + 1) / blockSize;
+    }
+
+    for (int m = 0; m < nPos; m++) {
+        for (int o = 0; o < nOut; o++) {
+            const float *f = h + ((size_t)o * nPos + m) * length;
+            float_complex *H = t->H + ((size_t)m * nOut + o) * t->nParts * nBins;
+            for (int p = 0; p < t->nParts; p++) {
+                int n = length - p * blockSize < blockSize ? length - p * blockSize : blockSize;
+                memset(t->time, 0, t->nFFT * sizeof(float));
+                memcpy(t->time, f + p * blockSize, n * sizeof(float));
+                saf_rfft_forward(t->hFFT, t->time, H + p * nBins);
+            }
+        }
+    }
+
+    memcpy(t->positions, positions, nPos * 3 * sizeof(float));
+    for (int m = 0; m < nPos; m++) {
+        t->tree[m] = m;
+    }
+    tvconv_build(t, 0, nPos, 0);
+    return t;
+}
+
+// ─────────────────────────────────────
+void tvconv_free(t_tvconv *t) {
+    if (!t) {
+        return;
+    }
+    int nBins = t->nBins;
+    size_t nSpectra = (size_t)t->nPos * t->nOut * t->nParts;
+    freebytes(t->H, nSpectra * nBins * sizeof(float_complex));
+    freebytes(t->positions, t->nPos * 3 * sizeof(float));
+    freebytes(t->tree, t->nPos * sizeof(int));
+    freebytes(t->fdl, t->nParts * nBins * sizeof(float_complex));
+    freebytes(t->window, t->nFFT * sizeof(float));
+    freebytes(t->acc, nBins * sizeof(float_complex));
+    freebytes(t->time, t->nFFT * sizeof(float));
+    freebytes(t->prev, t->blockSize * sizeof(float));
+    freebytes(t->fade, t->blockSize * sizeof(float));
+    saf_rfft_destroy(&t->hFFT);
+    freebytes(t, sizeof(t_tvconv));
+}
+
+// ─────────────────────────────────────
+// Overlap-save output o of the responses at position m into time + blockSize.
+static void tvconv_output(t_tvconv *t, int m, int o) {
+    int nBins = t->nBins;
+    const float_complex *H = t->H + ((size_t)m * t->nOut + o) * t->nParts * nBins;
+    memset(t->acc, 0, nBins * sizeof(float_complex));
+    for (int p = 0; p < t->nParts; p++) {
+        int slot = (t->fdlPos - p + t->nParts) % t->nParts;
+        convolver_cmac((float *)t->acc, (const float *)(H + p * nBins),
+                       (const float *)(t->fdl + slot * nBins), nBins);
+    }
+    saf_rfft_backward(t->hFFT, t->acc, t->time);
+}
+
+// ─────────────────────────────────────
+void tvconv_process(t_tvconv *t, const float *in, float *const *outs, int target) {
+    int B = t->blockSize;
+    memmove(t->window, t->window + B, B * sizeof(float));
+    memcpy(t->window + B, in, B * sizeof(float));
+    saf_rfft_forward(t->hFFT, t->window, t->fdl + t->fdlPos * t->nBins);
+
+    int fade = target != t->current && target >= 0 && target < t->nPos;
+    for (int o = 0; o < t->nOut; o++) {
+        tvconv_output(t, t->current, o);
+        if (!fade) {
+            memcpy(outs[o], t->time + B, B * sizeof(float));
+            continue;
+        }
+        memcpy(t->prev, t->time + B, B * sizeof(float));
+        tvconv_output(t, target, o);
+        const float *next = t->time + B;
+        float *out = outs[o];
+        for (int i = 0; i < B; i++) {
+            out[i] = t->prev[i] + t->fade[i] * (next[i] - t->prev[i]);
+        }
+    }
+    if (fade) {
+        t->current = target;
+        t->switches++;
+    }
+    t->fdlPos = (t->fdlPos + 1) % t->nParts;
+}
@@ -0,0 +1,49 @@
+#ifndef SAF_TVCONV_H
+#define SAF_TVCONV_H
+
+#include <m_pd.h>
+#include <saf.h>
+
+// ─────────────────────────────────────
+// Time-varying convolution of one input with a grid of measured room responses, one set of nOut
+// filters per listener position, as the tvconv of SAF. The whole grid is transformed once into a
+// single store of partition spectra, so switching to another position only changes an offset and
+// never allocates. The input is transformed once per block into a frequency-domain delay line
+// shared by all positions.
+//
+// A switch happens at a block (partition) boundary: that block is convolved with the old and the
+// new responses and crossfaded linearly, both from the same delay line. The nearest position is
+// found through a k-d tree over the measurement positions.
+typedef struct _tvconv {
+    int nOut;
+    int nPos;
+    int length;
+    int blockSize; // also the partition size
+    int nFFT;
+    int nBins;
+    int nParts;
+    void *hFFT;
+    float_complex *H;   // nPos x nOut x nParts x nBins
+    float *positions;   // nPos x 3, cartesian
+    int *tree;          // nPos, each range holds the median of its split axis in the middle
+    float_complex *fdl; // nParts x nBins
+    int fdlPos;
+    float *window;      // nFFT
+    float_complex *acc; // nBins
+    float *time;        // nFFT
+    float *prev;        // blockSize, output of the old responses during a switch
+    float *fade;        // blockSize
+    int current;        // position of the last block
+    unsigned switches;
+} t_tvconv;
+
+// ─────────────────────────────────────
+// h holds the filter of output o at position m at h + (o * nPos + m) * length.
+t_tvconv *tvconv_new(const float *h, const float *positions, int nPos, int nOut, int length,
+                     int blockSize);
+void tvconv_free(t_tvconv *t);
+int tvconv_nearest(const t_tvconv *t, const float *xyz);
+// Convolves one block, switching to position target. in may be the same buffer as outs[0].
+void tvconv_process(t_tvconv *t, const float *in, float *const *outs, int target);
+
+#endif
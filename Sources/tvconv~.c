@@ -0,0 +1,337 @@
+#include <string.h>
+#include <stdatomic.h>
+
+#include <m_pd.h>
+#include <g_canvas.h>
+#include <s_stuff.h>
+
+#include "utilities.h"
+#include "governor.h"
+#include "designer.h"
+#include "firfile.h"
+#include "tvconv.h"
+
+static t_class *tvconv_tilde_class;
+
+// ─────────────────────────────────────
+typedef struct _tvconv_tilde {
+    t_object obj;
+    t_canvas *glist;
+    t_sample sample;
+
+    int nOut; // from the responses with -m
+    int multichannel;
+    t_sample **aOuts;
+    int nOutAlloc;
+    int blockSize;
+
+    char path[MAXPDSTRING];
+    t_tvconv *conv;
+    int convBlock; // block size of the latest design
+    t_saf_designer designer;
+    float position[3];  // listener, cartesian as in the file, main thread only
+    atomic_int target;  // nearest measurement, published to the audio thread
+    atomic_int current; // measurement and switches of the last block, published to stats
+    atomic_uint switches;
+
+    t_saf_load load;
+} t_tvconv_tilde;
+
+// ─────────────────────────────────────
+typedef struct _tvconv_tilde_design {
+    char path[MAXPDSTRING];
+    int nOut; // 0 to take the outputs from the file
+    int blockSize;
+} t_tvconv_tilde_design;
+
+typedef struct _tvconv_tilde_responses {
+    t_tvconv *conv;
+    const char *error; // NULL when the design succeeded
+    int fs;            // sample rate of the file
+} t_tvconv_tilde_responses;
+
+// ─────────────────────────────────────
+static void *tvconv_tilde_designfilters(const void *args) {
+    const t_tvconv_tilde_design *d = (const t_tvconv_tilde_design *)args;
+    t_tvconv_tilde_responses *r =
+        (t_tvconv_tilde_responses *)getbytes(sizeof(t_tvconv_tilde_responses));
+    t_saf_firs f;
+    if (saf_firs_load(&f, d->path, &r->error)) {
+        if (!f.positions) {
+            r->error = "Expected a SOFA file with one listener position per measurement";
+        } else if (d->nOut && f.nRows != d->nOut) {
+            r->error = "The file has one receiver per output, the number does not match";
+        } else {
+            r->conv = tvconv_new(f.data, f.positions, f.nCols, f.nRows, f.len, d->blockSize);
+        }
+        r->fs = f.fs;
+        saf_firs_free(&f);
+    }
+    return r;
+}
+
+// ─────────────────────────────────────
+static void tvconv_tilde_discardfilters(void *result) {
+    t_tvconv_tilde_responses *r = (t_tvconv_tilde_responses *)result;
+    tvconv_free(r->conv);
+    freebytes(r, sizeof(t_tvconv_tilde_responses));
+}
+
+// ─────────────────────────────────────
+static void tvconv_tilde_installfilters(t_pd *obj, const void *args, void *result) {
+    t_tvconv_tilde *x = (t_tvconv_tilde *)obj;
+    t_tvconv_tilde_responses *r = (t_tvconv_tilde_responses *)result;
+    (void)args;
+    if (!r->conv) {
+        // a file that cannot be used leaves the old responses playing
+        pd_error(x, "[saf.tvconv~] %s", r->error ? r->error : "Could not load the responses");
+        tvconv_tilde_discardfilters(r);
+        return;
+    }
+    t_tvconv *c = r->conv;
+    int target = tvconv_nearest(c, x->position);
+    c->current = target; // no crossfade into the first block
+    atomic_store(&x->target, target);
+    atomic_store(&x->current, target);
+    atomic_store(&x->switches, 0);
+    r->conv = x->conv;
+    x->conv = c;
+    logpost(x, 3, "[saf.tvconv~] %d positions of %d x %d samples loaded", c->nPos, c->nOut,
+            c->length);
+    if (r->fs != (int)x->load.sr) {
+        logpost(x, 2, "[saf.tvconv~] The responses are at %d Hz, Pd runs at %d Hz", r->fs,
+                (int)x->load.sr);
+    }
+    tvconv_tilde_discardfilters(r);
+    if (x->multichannel && c->nOut != x->nOut) {
+        x->nOut = c->nOut;
+        canvas_update_dsp(); // the outlet takes the receiver count of the new responses
+    }
+}
+
+// ─────────────────────────────────────
+static void tvconv_tilde_design(t_tvconv_tilde *x) {
+    x->convBlock = x->blockSize;
+    if (x->path[0] == '\0') {
+        return;
+    }
+    t_tvconv_tilde_design d;
+    pd_snprintf(d.path, MAXPDSTRING, "%s", x->path);
+    d.nOut = x->multichannel ? 0 : x->nOut;
+    d.blockSize = x->convBlock;
+    logpost(x, 2, "[saf.tvconv~] Loading %s...", x->path);
+    saf_designer_start(&x->designer, &d, sizeof(d));
+}
+
+// ╭─────────────────────────────────────╮
+// │               Methods               │
+// ╰─────────────────────────────────────╯
+static void tvconv_tilde_set(t_tvconv_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    pd_assert(x, argc >= 2, "[saf.tvconv~] Expected 'set <method> <value>'");
+    const char *method = atom_getsymbol(argv)->s_name;
+    if (strcmp(method, "position") == 0) {
+        pd_assert(x, argc >= 4, "[saf.tvconv~] Expected 'set position <x> <y> <z>'");
+        for (int a = 0; a < 3; a++) {
+            x->position[a] = atom_getfloat(argv + 1 + a);
+        }
+        // the k-d tree is immutable once built, the search takes no lock and the switch itself
+        // waits for the next block of the audio thread
+        if (x->conv) {
+            atomic_store_explicit(&x->target, tvconv_nearest(x->conv, x->position),
+                                  memory_order_release);
+        }
+        return;
+    } else if (strcmp(method, "file") == 0) {
+        char dir[MAXPDSTRING];
+        char *name;
+        t_symbol *file = atom_getsymbol(argv + 1);
+        int fd = canvas_open(x->glist, file->s_name, "", dir, &name, MAXPDSTRING, 1);
+        if (fd < 0) {
+            pd_error(x, "[saf.tvconv~] Could not find %s", file->s_name);
+            return;
+        }
+        sys_close(fd);
+        pd_snprintf(x->path, MAXPDSTRING, "%s/%s", dir, name);
+    } else {
+        pd_error(x, "[saf.tvconv~] Unknown set method: %s", method);
+        return;
+    }
+    if (x->convBlock > 0) {
+        tvconv_tilde_design(x);
+    }
+}
+
+// ─────────────────────────────────────
+static void tvconv_tilde_loadreport(t_tvconv_tilde *x) {
+    saf_load_report(&x->load);
+}
+
+// ─────────────────────────────────────
+static void tvconv_tilde_stats(t_tvconv_tilde *x) {
+    saf_load_stats(&x->load);
+    t_tvconv *c = x->conv;
+    if (c) {
+        // sizes and positions never change after tvconv_new, the rest is the published snapshot
+        int current = atomic_load_explicit(&x->current, memory_order_relaxed);
+        const float *p = c->positions + 3 * current;
+        logpost(x, 2,
+                "[saf.tvconv~] %d positions, %d outputs, %d taps, at position %d (%.2f %.2f "
+                "%.2f), %u switches",
+                c->nPos, c->nOut, c->length, current, p[0], p[1], p[2],
+                atomic_load_explicit(&x->switches, memory_order_relaxed));
+    }
+}
+
+// ╭─────────────────────────────────────╮
+// │     Initialization and Perform      │
+// ╰─────────────────────────────────────╯
+static void tvconv_tilde_process(t_tvconv_tilde *x, const t_sample *in, int n) {
+    // the responses are swapped on the main thread (designer.h), never while a block is convolved
+    t_tvconv *c = x->conv;
+    if (c && c->nOut == x->nOut && c->blockSize == n) {
+        int target = atomic_load_explicit(&x->target, memory_order_acquire);
+        tvconv_process(c, in, (float *const *)x->aOuts, target);
+        atomic_store_explicit(&x->current, c->current, memory_order_relaxed);
+        atomic_store_explicit(&x->switches, c->switches, memory_order_relaxed);
+        return;
+    }
+    for (int ch = 0; ch < x->nOut; ch++) {
+        memset(x->aOuts[ch], 0, n * sizeof(t_sample));
+    }
+}
+
+// ─────────────────────────────────────
+t_int *tvconv_tilde_performmultichannel(t_int *w) {
+    t_tvconv_tilde *x = (t_tvconv_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    t_sample *in = (t_sample *)(w[3]);
+    t_sample *outs = (t_sample *)(w[4]);
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nOut; ch++) {
+        x->aOuts[ch] = outs + ch * n;
+    }
+    tvconv_tilde_process(x, in, n);
+    saf_load_end(&x->load, n);
+
+    return (w + 5);
+}
+
+// ─────────────────────────────────────
+t_int *tvconv_tilde_perform(t_int *w) {
+    t_tvconv_tilde *x = (t_tvconv_tilde *)(w[1]);
+    int n = (int)(w[2]);
+    t_sample *in = (t_sample *)(w[3]);
+
+    saf_load_begin(&x->load);
+    for (int ch = 0; ch < x->nOut; ch++) {
+        x->aOuts[ch] = (t_sample *)w[4 + ch];
+    }
+    tvconv_tilde_process(x, in, n);
+    saf_load_end(&x->load, n);
+
+    return (w + 4 + x->nOut);
+}
+
+// ─────────────────────────────────────
+void tvconv_tilde_dsp(t_tvconv_tilde *x, t_signal **sp) {
+    x->load.sr = sp[0]->s_sr;
+    x->blockSize = sp[0]->s_n;
+    if (x->multichannel && x->nOut != x->nOutAlloc) {
+        freebytes(x->aOuts, x->nOutAlloc * sizeof(t_sample *));
+        x->aOuts = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
+        x->nOutAlloc = x->nOut;
+    }
+
+    // partitions of one Pd block, the responses are transformed again when the block size changes
+    if (sp[0]->s_n != x->convBlock) {
+        tvconv_tilde_design(x);
+    }
+
+    // the source is mono, with -m only the first input channel is used
+    if (x->multichannel) {
+        signal_setmultiout(&sp[1], x->nOut);
+        dsp_add(tvconv_tilde_performmultichannel, 4, x, sp[0]->s_n, sp[0]->s_vec, sp[1]->s_vec);
+    } else {
+        int sum = 1 + x->nOut;
+        int sigvecsize = sum + 2;
+        for (int i = 1; i < sum; i++) {
+            signal_setmultiout(&sp[i], 1);
+        }
+        t_int *sigvec = getbytes(sigvecsize * sizeof(t_int));
+        sigvec[0] = (t_int)x;
+        sigvec[1] = (t_int)sp[0]->s_n;
+        for (int i = 0; i < sum; i++) {
+            sigvec[2 + i] = (t_int)sp[i]->s_vec;
+        }
+        dsp_addv(tvconv_tilde_perform, sigvecsize, sigvec);
+        freebytes(sigvec, sigvecsize * sizeof(t_int));
+    }
+}
+
+// ─────────────────────────────────────
+void *tvconv_tilde_new(t_symbol *s, int argc, t_atom *argv) {
+    t_tvconv_tilde *x = (t_tvconv_tilde *)pd_new(tvconv_tilde_class);
+    x->glist = canvas_getcurrent();
+
+    // [saf.tvconv~ <outputs>] or [saf.tvconv~ -m], with -m the outputs follow the receivers of
+    // the file
+    int nOut = 1;
+    x->multichannel = 0;
+    for (int i = 0; i < argc; i++) {
+        if (argv[i].a_type == A_SYMBOL && strcmp(atom_getsymbol(argv + i)->s_name, "-m") == 0) {
+            x->multichannel = 1;
+        } else if (argv[i].a_type == A_FLOAT) {
+            nOut = atom_getint(argv + i);
+        }
+    }
+    x->nOut = nOut < 1 ? 1 : nOut;
+    x->nOutAlloc = x->nOut;
+    x->blockSize = 0;
+    x->aOuts = (t_sample **)getbytes(x->nOut * sizeof(t_sample *));
+
+    x->path[0] = '\0';
+    x->conv = NULL;
+    x->convBlock = 0;
+    saf_designer_init(&x->designer, &x->obj.ob_pd, tvconv_tilde_designfilters,
+                      tvconv_tilde_installfilters, tvconv_tilde_discardfilters);
+    x->position[0] = x->position[1] = x->position[2] = 0.0f;
+    atomic_init(&x->target, 0);
+    atomic_init(&x->current, 0);
+    atomic_init(&x->switches, 0);
+
+    saf_load_init(&x->load, &x->obj.ob_pd, "saf.tvconv~", 0, NULL);
+
+    if (x->multichannel) {
+        outlet_new(&x->obj, &s_signal);
+    } else {
+        for (int i = 0; i < x->nOut; i++) {
+            outlet_new(&x->obj, &s_signal);
+        }
+    }
+
+    return (void *)x;
+}
+
+// ─────────────────────────────────────
+void tvconv_tilde_free(t_tvconv_tilde *x) {
+    saf_load_free(&x->load);
+    saf_designer_free(&x->designer);
+    tvconv_free(x->conv);
+    freebytes(x->aOuts, x->nOutAlloc * sizeof(t_sample *));
+}
+
+// ─────────────────────────────────────
+// clang-format off
+void setup_saf0x2etvconv_tilde(void) {
+    tvconv_tilde_class =
+        class_new(gensym("saf.tvconv~"), (t_newmethod)tvconv_tilde_new,
+                  (t_method)tvconv_tilde_free, sizeof(t_tvconv_tilde),
+                  CLASS_DEFAULT | CLASS_MULTICHANNEL, A_GIMME, 0);
+
+    CLASS_MAINSIGNALIN(tvconv_tilde_class, t_tvconv_tilde, sample);
+    class_addmethod(tvconv_tilde_class, (t_method)tvconv_tilde_dsp, gensym("dsp"), A_CANT, 0);
+    class_addmethod(tvconv_tilde_class, (t_method)tvconv_tilde_set, gensym("set"), A_GIMME, 0);
+    class_addmethod(tvconv_tilde_class, (t_method)tvconv_tilde_stats, gensym("stats"), 0);
+    class_addmethod(tvconv_tilde_class, (t_method)tvconv_tilde_loadreport, gensym("saf_loadreport"), 0);
+}
@@ -0,0 +1,59 @@
+#ifndef SAF_WAKEUP_H
+#define SAF_WAKEUP_H
+
+#include <errno.h>
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+
+// ─────────────────────────────────────
+// Counting semaphore that lets the audio thread wake a worker without taking a lock. Every post
+// is remembered, so a wakeup sent before the worker waits is never lost and the worker can block
+// without a timeout. macOS has no unnamed POSIX semaphores, it uses a dispatch semaphore.
+#if defined(__APPLE__)
+typedef dispatch_semaphore_t t_saf_wakeup;
+#else
+typedef sem_t t_saf_wakeup;
+#endif
+
+// ─────────────────────────────────────
+static inline void saf_wakeup_init(t_saf_wakeup *w) {
+#if defined(__APPLE__)
+    *w = dispatch_semaphore_create(0);
+#else
+    sem_init(w, 0, 0);
+#endif
+}
+
+// ─────────────────────────────────────
+static inline void saf_wakeup_destroy(t_saf_wakeup *w) {
+#if defined(__APPLE__)
+    dispatch_release(*w);
+#else
+    sem_destroy(w);
+#endif
+}
+
+// ─────────────────────────────────────
+static inline void saf_wakeup_post(t_saf_wakeup *w) {
+#if defined(__APPLE__)
+    dispatch_semaphore_signal(*w);
+#else
+    sem_post(w);
+#endif
+}
+
+// ─────────────────────────────────────
+static inline void saf_wakeup_wait(t_saf_wakeup *w) {
+#if defined(__APPLE__)
+    dispatch_semaphore_wait(*w, DISPATCH_TIME_FOREVER);
+#else
+    while (sem_wait(w) != 0 && errno == EINTR) {
+    }
+#endif
+}
+
+#endif